@@ -161,12 +161,17 @@ ifdef CONFIG_ELOOP_EPOLL
 L_CFLAGS += -DCONFIG_ELOOP_EPOLL
 endif
 
+ifdef CONFIG_ELOOP_TIMER_HEAP
+L_CFLAGS += -DCONFIG_ELOOP_TIMER_HEAP
+endif
+
 OBJS += src/utils/common.c
 OBJS += src/utils/wpa_debug.c
 OBJS += src/utils/wpabuf.c
 OBJS += src/utils/os_$(CONFIG_OS).c
 OBJS += src/utils/ip_addr.c
 OBJS += src/utils/crc32.c
+OBJS += src/utils/siphash.c
 
 OBJS += src/common/ieee802_11_common.c
 OBJS += src/common/wpa_common.c
@@ -263,6 +268,12 @@ NEED_ETH_P_OUI=y
 NEED_HMAC_SHA256_KDF=y
 endif
 
+ifdef CONFIG_PMK_STORE
+L_CFLAGS += -DCONFIG_PMK_STORE
+OBJS += src/ap/pmk_store.c
+NEED_AES_SIV=y
+endif
+
 ifdef NEED_ETH_P_OUI
 L_CFLAGS += -DCONFIG_ETH_P_OUI
 OBJS += src/ap/eth_p_oui.c
@@ -1034,6 +1045,13 @@ endif
 ifdef CONFIG_RADIUS_SERVER
 L_CFLAGS += -DRADIUS_SERVER
 OBJS += src/radius/radius_server.c
+OBJS += src/utils/prefix_trie.c
+ifdef CONFIG_RADIUS_SERVER_THREADS
+L_CFLAGS += -DCONFIG_RADIUS_SERVER_THREADS
+L_CFLAGS += -DCONFIG_RANDOM_POOL_LOCK
+L_CFLAGS += -DCONFIG_DEBUG_FILE_LOCK
+NEED_WORKER_POOL=y
+endif
 endif
 
 ifdef CONFIG_IPV6
@@ -1123,8 +1141,35 @@ ifdef CONFIG_DEBUG_LINUX_TRACING
 L_CFLAGS += -DCONFIG_DEBUG_LINUX_TRACING
 endif
 
+ifdef CONFIG_FLIGHT_RECORDER
+L_CFLAGS += -DCONFIG_FLIGHT_RECORDER
+OBJS += src/utils/flight_recorder.c
+ifdef CONFIG_FLIGHT_RECORDER_DIR
+L_CFLAGS += -DFLIGHT_RECORDER_DIR=\"$(CONFIG_FLIGHT_RECORDER_DIR)\"
+endif
+endif
+
 ifdef CONFIG_DEBUG_FILE
 L_CFLAGS += -DCONFIG_DEBUG_FILE
+ifdef CONFIG_DEBUG_FILE_ASYNC
+L_CFLAGS += -DCONFIG_DEBUG_FILE_ASYNC
+endif
+endif
+
+ifdef CONFIG_WPA_PSK_THREADS
+L_CFLAGS += -DCONFIG_WPA_PSK_THREADS
+endif
+
+ifdef CONFIG_SAE_THREADS
+L_CFLAGS += -DCONFIG_SAE_THREADS
+L_CFLAGS += -DCONFIG_RANDOM_POOL_LOCK
+L_CFLAGS += -DCONFIG_DEBUG_FILE_LOCK
+NEED_WORKER_POOL=y
+endif
+
+ifdef NEED_WORKER_POOL
+L_CFLAGS += -DCONFIG_WORKER_POOL
+OBJS += src/utils/worker_pool.c
 endif
 
 ifdef CONFIG_ANDROID_LOG
@@ -2463,6 +2463,12 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 	} else if (os_strcmp(buf, "eap_user_file") == 0) {
 		if (hostapd_config_read_eap_user(pos, bss))
 			return 1;
+#ifdef CONFIG_SQLITE
+	} else if (os_strcmp(buf, "eap_user_sqlite_cache") == 0) {
+		bss->eap_user_sqlite_cache = atoi(pos);
+	} else if (os_strcmp(buf, "eap_user_sqlite_cache_ttl") == 0) {
+		bss->eap_user_sqlite_cache_ttl = atoi(pos);
+#endif /* CONFIG_SQLITE */
 	} else if (os_strcmp(buf, "ca_cert") == 0) {
 		os_free(bss->ca_cert);
 		bss->ca_cert = os_strdup(pos);
@@ -2772,6 +2778,14 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		bss->radius->retry_primary_interval = atoi(pos);
 	} else if (os_strcmp(buf, "radius_acct_interim_interval") == 0) {
 		bss->acct_interim_interval = atoi(pos);
+	} else if (os_strcmp(buf, "radius_acct_batch_interval") == 0) {
+		bss->acct_batch_interval = atoi(pos);
+		if (bss->acct_batch_interval < 0) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: invalid radius_acct_batch_interval",
+				   line);
+			return 1;
+		}
 	} else if (os_strcmp(buf, "radius_request_cui") == 0) {
 		bss->radius_request_cui = atoi(pos);
 	} else if (os_strcmp(buf, "radius_auth_req_attr") == 0) {
@@ -2931,6 +2945,14 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 				   line);
 			return 1;
 		}
+	} else if (os_strcmp(buf, "wpa_psk_cache_file") == 0) {
+		os_free(bss->ssid.wpa_psk_cache_file);
+		bss->ssid.wpa_psk_cache_file = os_strdup(pos);
+		if (!bss->ssid.wpa_psk_cache_file) {
+			wpa_printf(MSG_ERROR, "Line %d: allocation failed",
+				   line);
+			return 1;
+		}
 	} else if (os_strcmp(buf, "wpa_key_mgmt") == 0) {
 		bss->wpa_key_mgmt = hostapd_config_parse_key_mgmt(line, pos);
 		if (bss->wpa_key_mgmt == -1)
@@ -3085,6 +3107,16 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		bss->radius_server_acct_port = atoi(pos);
 	} else if (os_strcmp(buf, "radius_server_ipv6") == 0) {
 		bss->radius_server_ipv6 = atoi(pos);
+	} else if (os_strcmp(buf, "radius_server_threads") == 0) {
+		int val = atoi(pos);
+
+		if (val < -1 || val > 64) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid radius_server_threads %d",
+				   line, val);
+			return 1;
+		}
+		bss->radius_server_threads = val;
 #endif /* RADIUS_SERVER */
 	} else if (os_strcmp(buf, "use_pae_group_addr") == 0) {
 		bss->use_pae_group_addr = atoi(pos);
@@ -3652,6 +3684,36 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		bss->disable_pmksa_caching = atoi(pos);
 	} else if (os_strcmp(buf, "okc") == 0) {
 		bss->okc = atoi(pos);
+#ifdef CONFIG_PMK_STORE
+	} else if (os_strcmp(buf, "pmk_store") == 0) {
+		os_free(bss->pmk_store);
+		bss->pmk_store = os_strdup(pos);
+		if (!bss->pmk_store) {
+			wpa_printf(MSG_ERROR, "Line %d: allocation failed",
+				   line);
+			return 1;
+		}
+	} else if (os_strcmp(buf, "pmk_store_key") == 0) {
+		if (os_strlen(pos) != 2 * sizeof(bss->pmk_store_key) ||
+		    hexstr2bin(pos, bss->pmk_store_key,
+			       sizeof(bss->pmk_store_key))) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid pmk_store_key (expected %d hex digits)",
+				   line, (int) (2 * sizeof(bss->pmk_store_key)));
+			return 1;
+		}
+		bss->pmk_store_key_set = 1;
+	} else if (os_strcmp(buf, "pmk_store_slots") == 0) {
+		int val = atoi(pos);
+
+		if (val <= 0 || val > 65536) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid pmk_store_slots %d",
+				   line, val);
+			return 1;
+		}
+		bss->pmk_store_slots = val;
+#endif /* CONFIG_PMK_STORE */
 #ifdef CONFIG_WPS
 	} else if (os_strcmp(buf, "wps_state") == 0) {
 		bss->wps_state = atoi(pos);
@@ -4313,6 +4375,16 @@ static int hostapd_config_fill(struct hostapd_config *conf,
 		bss->sae_require_mfp = atoi(pos);
 	} else if (os_strcmp(buf, "sae_confirm_immediate") == 0) {
 		bss->sae_confirm_immediate = atoi(pos);
+	} else if (os_strcmp(buf, "sae_worker_threads") == 0) {
+		int val = atoi(pos);
+
+		if (val < -1 || val > 64) {
+			wpa_printf(MSG_ERROR,
+				   "Line %d: Invalid sae_worker_threads %d",
+				   line, val);
+			return 1;
+		}
+		bss->sae_worker_threads = val;
 	} else if (os_strcmp(buf, "sae_pwe") == 0) {
 		bss->sae_pwe = atoi(pos);
 	} else if (os_strcmp(buf, "local_pwr_constraint") == 0) {
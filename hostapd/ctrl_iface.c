@@ -22,6 +22,7 @@
 #include <sys/un.h>
 #include <sys/stat.h>
 #include <stddef.h>
+#include <limits.h>
 
 #ifdef CONFIG_CTRL_IFACE_UDP
 #include <netdb.h>
@@ -29,6 +30,7 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/flight_recorder.h"
 #include "utils/module_tests.h"
 #include "common/version.h"
 #include "common/ieee802_11_defs.h"
@@ -1179,6 +1181,21 @@ static int hostapd_ctrl_iface_set_band(struct hostapd_data *hapd,
 }
 
 
+/* Parse a non-negative decimal/hex value for an unsigned int parameter */
+static int hostapd_ctrl_parse_uint(const char *value, unsigned int *val)
+{
+	char *end;
+	long int res;
+
+	errno = 0;
+	res = strtol(value, &end, 0);
+	if (errno || end == value || *end || res < 0 || res > INT_MAX)
+		return -1;
+	*val = res;
+	return 0;
+}
+
+
 static int hostapd_ctrl_iface_set(struct hostapd_data *hapd, char *cmd)
 {
 	char *value;
@@ -1281,10 +1298,29 @@ static int hostapd_ctrl_iface_set(struct hostapd_data *hapd, char *cmd)
 #endif /* CONFIG_DPP */
 	} else if (os_strcasecmp(cmd, "setband") == 0) {
 		ret = hostapd_ctrl_iface_set_band(hapd, value);
+	} else if (os_strcasecmp(cmd, "eloop_timeout_pool_max") == 0) {
+		unsigned int val;
+
+		if (hostapd_ctrl_parse_uint(value, &val) < 0)
+			return -1;
+		eloop_set_timeout_pool_max(val);
+	} else if (os_strcasecmp(cmd, "eloop_handler_stats") == 0) {
+		unsigned int val;
+
+		if (hostapd_ctrl_parse_uint(value, &val) < 0 || val > 1)
+			return -1;
+		ret = eloop_set_handler_stats(val);
+	} else if (os_strcasecmp(cmd, "eloop_slow_handler_ms") == 0) {
+		unsigned int val;
+
+		if (hostapd_ctrl_parse_uint(value, &val) < 0)
+			return -1;
+		eloop_set_slow_handler_threshold(val);
 	} else {
 		ret = hostapd_set_iface(hapd->iconf, hapd->conf, cmd, value);
 		if (ret)
 			return ret;
+		hostapd_invalidate_probe_resp_tmpl();
 
 		if (os_strcasecmp(cmd, "deny_mac_file") == 0) {
 			hostapd_disassoc_deny_mac(hapd);
@@ -1299,8 +1335,12 @@ static int hostapd_ctrl_iface_set(struct hostapd_data *hapd, char *cmd)
 		} else if (os_strcmp(cmd, "wpa_passphrase") == 0 ||
 			   os_strcmp(cmd, "sae_password") == 0 ||
 			   os_strcmp(cmd, "sae_pwe") == 0) {
-			if (hapd->started)
+			if (hapd->started) {
+#ifdef CONFIG_SAE_THREADS
+				auth_sae_workers_sync(hapd);
+#endif /* CONFIG_SAE_THREADS */
 				hostapd_setup_sae_pt(hapd->conf);
+			}
 		} else if (os_strcasecmp(cmd, "transition_disable") == 0) {
 			wpa_auth_set_transition_disable(hapd->wpa_auth,
 							hapd->conf->transition_disable);
@@ -3198,6 +3238,14 @@ static int hostapd_ctrl_iface_receive_process(struct hostapd_data *hapd,
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+#ifdef CONFIG_FLIGHT_RECORDER
+	} else if (os_strcmp(buf, "TRACE_DUMP") == 0) {
+		if (flight_recorder_dump(NULL) < 0)
+			reply_len = -1;
+	} else if (os_strncmp(buf, "TRACE_DUMP ", 11) == 0) {
+		if (flight_recorder_dump(buf + 11) < 0)
+			reply_len = -1;
+#endif /* CONFIG_FLIGHT_RECORDER */
 	} else if (os_strncmp(buf, "NOTE ", 5) == 0) {
 		wpa_printf(MSG_INFO, "NOTE: %s", buf + 5);
 	} else if (os_strcmp(buf, "STATUS") == 0) {
@@ -3205,6 +3253,8 @@ static int hostapd_ctrl_iface_receive_process(struct hostapd_data *hapd,
 						      reply_size);
 	} else if (os_strcmp(buf, "STATUS-DRIVER") == 0) {
 		reply_len = hostapd_drv_status(hapd, reply, reply_size);
+	} else if (os_strcmp(buf, "ELOOP_STATS") == 0) {
+		reply_len = eloop_get_stats(reply, reply_size);
 	} else if (os_strcmp(buf, "MIB") == 0) {
 		reply_len = ieee802_11_get_mib(hapd, reply, reply_size);
 		if (reply_len >= 0) {
@@ -3846,6 +3896,38 @@ static void hostapd_ctrl_iface_msg_cb(void *ctx, int level,
 }
 
 
+/* WPA_EVENT_* bit that a monitor needs to have enabled to receive a message */
+static u32 hostapd_ctrl_event_mask(const char *buf)
+{
+	/* Enable Probe Request events based on explicit request.
+	 * Other events are enabled by default.
+	 */
+	if (str_starts(buf, RX_PROBE_REQUEST))
+		return WPA_EVENT_RX_PROBE_REQUEST;
+	return 0;
+}
+
+
+static int hostapd_ctrl_iface_msg_monitor_cb(void *ctx, int level,
+					     enum wpa_msg_type type,
+					     const char *fmt)
+{
+	struct hostapd_data *hapd = ctx;
+	u32 events;
+
+	if (hapd == NULL)
+		return 0;
+	/* The event name is a literal prefix of the format string */
+	events = hostapd_ctrl_event_mask(fmt);
+	if (type != WPA_MSG_NO_GLOBAL && hapd->iface->interfaces &&
+	    ctrl_iface_has_monitor(&hapd->iface->interfaces->global_ctrl_dst,
+				   level, events))
+		return 1;
+	return type != WPA_MSG_ONLY_GLOBAL &&
+		ctrl_iface_has_monitor(&hapd->ctrl_dst, level, events);
+}
+
+
 int hostapd_ctrl_iface_init(struct hostapd_data *hapd)
 {
 #ifdef CONFIG_CTRL_IFACE_UDP
@@ -3933,6 +4015,7 @@ try_again:
 
 	hapd->msg_ctx = hapd;
 	wpa_msg_register_cb(hostapd_ctrl_iface_msg_cb);
+	wpa_msg_register_monitor_cb(hostapd_ctrl_iface_msg_monitor_cb);
 
 	return 0;
 
@@ -4080,6 +4163,7 @@ fail:
 	}
 	hapd->msg_ctx = hapd;
 	wpa_msg_register_cb(hostapd_ctrl_iface_msg_cb);
+	wpa_msg_register_monitor_cb(hostapd_ctrl_iface_msg_monitor_cb);
 
 	return 0;
 
@@ -4546,8 +4630,18 @@ static void hostapd_global_ctrl_iface_receive(int sock, void *eloop_ctx,
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+#ifdef CONFIG_FLIGHT_RECORDER
+	} else if (os_strcmp(buf, "TRACE_DUMP") == 0) {
+		if (flight_recorder_dump(NULL) < 0)
+			reply_len = -1;
+	} else if (os_strncmp(buf, "TRACE_DUMP ", 11) == 0) {
+		if (flight_recorder_dump(buf + 11) < 0)
+			reply_len = -1;
+#endif /* CONFIG_FLIGHT_RECORDER */
 	} else if (os_strcmp(buf, "FLUSH") == 0) {
 		hostapd_ctrl_iface_flush(interfaces);
+	} else if (os_strcmp(buf, "ELOOP_STATS") == 0) {
+		reply_len = eloop_get_stats(reply, reply_size);
 	} else if (os_strncmp(buf, "ADD ", 4) == 0) {
 		if (hostapd_ctrl_iface_add(interfaces, buf + 4) < 0)
 			reply_len = -1;
@@ -4718,6 +4812,7 @@ try_again:
 	}
 
 	wpa_msg_register_cb(hostapd_ctrl_iface_msg_cb);
+	wpa_msg_register_monitor_cb(hostapd_ctrl_iface_msg_monitor_cb);
 
 	return 0;
 
@@ -4822,6 +4917,7 @@ fail:
 				 interface, NULL);
 
 	wpa_msg_register_cb(hostapd_ctrl_iface_msg_cb);
+	wpa_msg_register_monitor_cb(hostapd_ctrl_iface_msg_monitor_cb);
 
 	return 0;
 
@@ -4883,12 +4979,9 @@ void hostapd_global_ctrl_iface_deinit(struct hapd_interfaces *interfaces)
 static int hostapd_ctrl_check_event_enabled(struct wpa_ctrl_dst *dst,
 					    const char *buf)
 {
-	/* Enable Probe Request events based on explicit request.
-	 * Other events are enabled by default.
-	 */
-	if (str_starts(buf, RX_PROBE_REQUEST))
-		return !!(dst->events & WPA_EVENT_RX_PROBE_REQUEST);
-	return 1;
+	u32 events = hostapd_ctrl_event_mask(buf);
+
+	return (dst->events & events) == events;
 }
 
 
@@ -7,12 +7,811 @@
  */
 
 #include "utils/includes.h"
+#ifdef CONFIG_WORKER_POOL
+#include <pthread.h>
+#endif /* CONFIG_WORKER_POOL */
 
 #include "utils/common.h"
 #include "utils/module_tests.h"
+#include "utils/wpabuf.h"
+#include "utils/worker_pool.h"
+#include "ap/hostapd.h"
+#include "ap/sta_info.h"
+#include "ap/pmk_store.h"
+#include "ap/pmksa_cache_auth.h"
+#include "radius/radius_das.h"
+#include "common/eapol_common.h"
+#include "common/wpa_common.h"
+#include "ap/wpa_auth.h"
+#include "ap/wpa_auth_i.h"
+
+
+static int sta_hash_bench_tests(void)
+{
+	static const unsigned int sizes[] = { 100, 1000, 10000 };
+	const unsigned int ops = 100000;
+	struct hostapd_data hapd;
+	struct sta_info *stas;
+	struct os_reltime start, end, diff;
+	unsigned int i, j, n, chain, max_chain;
+	struct sta_info *sta;
+	u8 addr[ETH_ALEN];
+	int errors = 0;
+
+	wpa_printf(MSG_INFO, "STA hash table benchmark");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		n = sizes[i];
+		os_memset(&hapd, 0, sizeof(hapd));
+		stas = os_calloc(n, sizeof(*stas));
+		if (!stas)
+			return -1;
+
+		/* Locally administered addresses with a common prefix and
+		 * only the last three octets varying */
+		for (j = 0; j < n; j++) {
+			stas[j].addr[0] = 0x02;
+			stas[j].addr[1] = 0x00;
+			stas[j].addr[2] = 0x5e;
+			WPA_PUT_BE24(&stas[j].addr[3], j * 0x10000 / n);
+			ap_sta_hash_add(&hapd, &stas[j]);
+		}
+
+		max_chain = 0;
+		for (j = 0; j < hapd.sta_hash_size; j++) {
+			chain = 0;
+			for (sta = hapd.sta_hash[j]; sta; sta = sta->hnext)
+				chain++;
+			if (chain > max_chain)
+				max_chain = chain;
+		}
+
+		os_get_reltime(&start);
+		for (j = 0; j < ops; j++) {
+			if (ap_get_sta(&hapd, stas[(j * 7919) % n].addr) !=
+			    &stas[(j * 7919) % n])
+				errors++;
+		}
+		os_get_reltime(&end);
+		os_reltime_sub(&end, &start, &diff);
+
+		os_memcpy(addr, stas[0].addr, ETH_ALEN);
+		addr[0] = 0x06;
+		if (ap_get_sta(&hapd, addr))
+			errors++;
+
+		wpa_printf(MSG_INFO,
+			   "STA hash: %u STAs, %u buckets, max chain %u: lookup %u ns/op",
+			   n, hapd.sta_hash_size, max_chain,
+			   (unsigned int) ((diff.sec * 1000000 + diff.usec) *
+					   1000 / ops));
+
+		for (j = 0; j < n; j++)
+			ap_sta_hash_del(&hapd, &stas[j]);
+		if (hapd.sta_hash_entries != 0 || ap_get_sta(&hapd, stas[0].addr))
+			errors++;
+		ap_sta_hash_deinit(&hapd);
+		os_free(stas);
+	}
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d STA hash test(s) failed", errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+#define PMKSA_TEST_ENTRIES 1024
+
+static void pmksa_cache_test_free_cb(struct rsn_pmksa_cache_entry *entry,
+				     void *ctx)
+{
+	int *freed = ctx;
+
+	(*freed)++;
+}
+
+
+static void pmksa_cache_test_id(unsigned int i, u8 *spa, u8 *pmkid,
+				char *identity, size_t identity_size)
+{
+	spa[0] = 0x02;
+	spa[1] = 0x00;
+	spa[2] = 0x5e;
+	WPA_PUT_BE24(&spa[3], i);
+	os_memset(pmkid, 0x5a, PMKID_LEN);
+	WPA_PUT_BE32(pmkid, i);
+	os_snprintf(identity, identity_size, "user-%u", i);
+}
+
+
+static struct rsn_pmksa_cache_entry *
+pmksa_cache_test_add(struct rsn_pmksa_cache *pmksa, unsigned int i,
+		     int session_timeout)
+{
+	static const u8 aa[ETH_ALEN] = { 0x02, 0, 0, 0, 0x01, 0 };
+	struct rsn_pmksa_cache_entry *entry;
+	u8 pmk[PMK_LEN], spa[ETH_ALEN], pmkid[PMKID_LEN];
+	char identity[20];
+
+	pmksa_cache_test_id(i, spa, pmkid, identity, sizeof(identity));
+	os_memset(pmk, 0x11, PMK_LEN);
+	entry = pmksa_cache_auth_create_entry(pmk, PMK_LEN, pmkid, NULL, 0, aa,
+					      spa, session_timeout, NULL,
+					      WPA_KEY_MGMT_IEEE8021X);
+	if (!entry)
+		return NULL;
+	entry->identity_len = os_strlen(identity);
+	entry->identity = os_memdup(identity, entry->identity_len);
+	if (!entry->identity) {
+		os_free(entry);
+		return NULL;
+	}
+	if (pmksa_cache_auth_add_entry(pmksa, entry) < 0)
+		return NULL;
+	return entry;
+}
+
+
+/* Check that entry @i can be found (or not) by its SPA, by its PMKID, and by
+ * its identity through the identity hash list that is used for RADIUS DAS.
+ * An entry that is found by identity is removed from the cache. */
+static int pmksa_cache_test_lookup(struct rsn_pmksa_cache *pmksa,
+				   unsigned int i, int present)
+{
+	struct rsn_pmksa_cache_entry *entry;
+	struct radius_das_attrs attr;
+	u8 spa[ETH_ALEN], pmkid[PMKID_LEN];
+	char identity[20];
+	int errors = 0;
+
+	pmksa_cache_test_id(i, spa, pmkid, identity, sizeof(identity));
+
+	entry = pmksa_cache_auth_get(pmksa, spa, NULL);
+	if (!entry != !present ||
+	    (entry && os_memcmp(entry->pmkid, pmkid, PMKID_LEN) != 0))
+		errors++;
+	entry = pmksa_cache_auth_get(pmksa, NULL, pmkid);
+	if (!entry != !present ||
+	    (entry && os_memcmp(entry->spa, spa, ETH_ALEN) != 0))
+		errors++;
+
+	os_memset(&attr, 0, sizeof(attr));
+	attr.user_name = (const u8 *) identity;
+	attr.user_name_len = os_strlen(identity);
+	if ((pmksa_cache_auth_radius_das_disconnect(pmksa, &attr) == 0) !=
+	    !!present)
+		errors++;
+
+	if (errors)
+		wpa_printf(MSG_ERROR, "PMKSA cache: Entry %u %sfound", i,
+			   present ? "not " : "");
+	return errors ? -1 : 0;
+}
+
+
+static int pmksa_cache_tests(void)
+{
+	struct rsn_pmksa_cache *pmksa;
+	struct rsn_pmksa_cache_entry *entry;
+	struct radius_das_attrs attr;
+	u8 spa[ETH_ALEN], pmkid[PMKID_LEN];
+	char identity[20];
+	unsigned int i;
+	int freed = 0;
+	int ret = -1;
+
+	wpa_printf(MSG_INFO, "PMKSA cache tests");
+
+	pmksa = pmksa_cache_auth_init(pmksa_cache_test_free_cb, &freed);
+	if (!pmksa)
+		return -1;
+
+	for (i = 0; i < PMKSA_TEST_ENTRIES; i++) {
+		if (!pmksa_cache_test_add(pmksa, i, 0))
+			goto fail;
+	}
+	if (freed) {
+		wpa_printf(MSG_ERROR, "PMKSA cache: Entry removed before limit");
+		goto fail;
+	}
+
+	/* A lookup makes entry 0 the most recently used one, so entry 1 is
+	 * the one that is evicted when the cache is full */
+	pmksa_cache_test_id(0, spa, pmkid, identity, sizeof(identity));
+	if (!pmksa_cache_auth_get(pmksa, NULL, pmkid) ||
+	    !pmksa_cache_test_add(pmksa, PMKSA_TEST_ENTRIES, 0) ||
+	    freed != 1) {
+		wpa_printf(MSG_ERROR, "PMKSA cache: No eviction at limit");
+		goto fail;
+	}
+	if (pmksa_cache_test_lookup(pmksa, 1, 0) < 0 ||
+	    pmksa_cache_test_lookup(pmksa, 0, 1) < 0 ||
+	    pmksa_cache_test_lookup(pmksa, PMKSA_TEST_ENTRIES, 1) < 0 ||
+	    freed != 3)
+		goto fail;
+
+	/* Explicit removal */
+	pmksa_cache_test_id(2, spa, pmkid, identity, sizeof(identity));
+	entry = pmksa_cache_auth_get(pmksa, spa, NULL);
+	if (!entry)
+		goto fail;
+	pmksa_cache_free_entry(pmksa, entry);
+	if (freed != 4 || pmksa_cache_test_lookup(pmksa, 2, 0) < 0)
+		goto fail;
+
+	/* RADIUS DAS Disconnect-Request matching by SPA */
+	pmksa_cache_test_id(3, spa, pmkid, identity, sizeof(identity));
+	os_memset(&attr, 0, sizeof(attr));
+	attr.sta_addr = spa;
+	if (pmksa_cache_auth_radius_das_disconnect(pmksa, &attr) < 0 ||
+	    freed != 5 ||
+	    pmksa_cache_auth_radius_das_disconnect(pmksa, &attr) == 0 ||
+	    pmksa_cache_test_lookup(pmksa, 3, 0) < 0) {
+		wpa_printf(MSG_ERROR, "PMKSA cache: DAS match by SPA failed");
+		goto fail;
+	}
+
+	/* All included attributes need to match */
+	pmksa_cache_test_id(5, spa, pmkid, identity, sizeof(identity));
+	os_memset(&attr, 0, sizeof(attr));
+	attr.sta_addr = spa;
+	attr.user_name = (const u8 *) "user-6";
+	attr.user_name_len = 6;
+	if (pmksa_cache_auth_radius_das_disconnect(pmksa, &attr) == 0 ||
+	    freed != 5 || !pmksa_cache_auth_get(pmksa, spa, NULL)) {
+		wpa_printf(MSG_ERROR, "PMKSA cache: DAS matched wrong entry");
+		goto fail;
+	}
+
+	/* RADIUS DAS Disconnect-Request matching by identity */
+	if (pmksa_cache_test_lookup(pmksa, 4, 1) < 0 || freed != 6 ||
+	    pmksa_cache_test_lookup(pmksa, 4, 0) < 0)
+		goto fail;
+
+	/* Expiration; the new entry with a short session timeout is the
+	 * first one on the expiration ordered list */
+	entry = pmksa_cache_test_add(pmksa, PMKSA_TEST_ENTRIES + 1, 10);
+	if (!entry || freed != 6)
+		goto fail;
+	pmksa_cache_auth_test_expire(pmksa);
+	if (freed != 6 || !pmksa_cache_auth_get(pmksa, entry->spa, NULL)) {
+		wpa_printf(MSG_ERROR, "PMKSA cache: Entry expired too early");
+		goto fail;
+	}
+	entry->expiration -= 20;
+	pmksa_cache_auth_test_expire(pmksa);
+	if (freed != 7 ||
+	    pmksa_cache_test_lookup(pmksa, PMKSA_TEST_ENTRIES + 1, 0) < 0 ||
+	    pmksa_cache_test_lookup(pmksa, 5, 1) < 0) {
+		wpa_printf(MSG_ERROR, "PMKSA cache: Expiration failed");
+		goto fail;
+	}
+
+	ret = 0;
+fail:
+	pmksa_cache_auth_deinit(pmksa);
+	return ret;
+}
+
+
+#ifdef CONFIG_IEEE80211R_AP
+
+struct psk_memo_test_ctx {
+	u8 psk[2][PMK_LEN];
+	u8 anonce[WPA_NONCE_LEN];
+	u8 replay_counter[WPA_REPLAY_COUNTER_LEN];
+	int msg1;
+};
+
+
+static const u8 * psk_memo_test_get_psk(void *ctx, const u8 *addr,
+					const u8 *p2p_dev_addr,
+					const u8 *prev_psk, size_t *psk_len,
+					int *vlan_id)
+{
+	struct psk_memo_test_ctx *t = ctx;
+
+	if (vlan_id)
+		*vlan_id = 0;
+	if (psk_len)
+		*psk_len = PMK_LEN;
+	if (!prev_psk)
+		return t->psk[0];
+	if (prev_psk == t->psk[0])
+		return t->psk[1];
+	return NULL;
+}
+
+
+static int psk_memo_test_set_key(void *ctx, int vlan_id, enum wpa_alg alg,
+				 const u8 *addr, int idx, u8 *key,
+				 size_t key_len, enum key_flag key_flag)
+{
+	return 0;
+}
+
+
+static int psk_memo_test_send_eapol(void *ctx, const u8 *addr,
+				    const u8 *data, size_t data_len,
+				    int encrypt)
+{
+	struct psk_memo_test_ctx *t = ctx;
+	const struct wpa_eapol_key *key;
+
+	if (data_len < sizeof(struct ieee802_1x_hdr) + sizeof(*key))
+		return -1;
+	key = (const struct wpa_eapol_key *)
+		(data + sizeof(struct ieee802_1x_hdr));
+	os_memcpy(t->anonce, key->key_nonce, WPA_NONCE_LEN);
+	os_memcpy(t->replay_counter, key->replay_counter,
+		  WPA_REPLAY_COUNTER_LEN);
+	t->msg1++;
+	return 0;
+}
+
+
+static int psk_memo_test_get_vlan(void *ctx, const u8 *sta_addr,
+				  struct vlan_description *vlan)
+{
+	os_memset(vlan, 0, sizeof(*vlan));
+	return 0;
+}
+
+
+/* Run the 4-way handshake up to EAPOL-Key msg 2/4 with an FT-PSK station
+ * that uses the PSK with index @psk_idx */
+static int psk_memo_test_4way(struct wpa_authenticator *wpa_auth,
+			      struct psk_memo_test_ctx *t,
+			      const struct wpa_auth_config *conf,
+			      const u8 *sta_addr, int psk_idx)
+{
+	static const u8 rsne[] = {
+		WLAN_EID_RSN, 20, 0x01, 0x00,
+		0x00, 0x0f, 0xac, 0x04,
+		0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+		0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+		0x00, 0x00
+	};
+	u8 mdie[MOBILITY_DOMAIN_ID_LEN + 1];
+	u8 pmk_r0[PMK_LEN], pmk_r0_name[WPA_PMK_NAME_LEN];
+	u8 pmk_r1[PMK_LEN], pmk_r1_name[WPA_PMK_NAME_LEN];
+	u8 ptk_name[WPA_PMK_NAME_LEN], snonce[WPA_NONCE_LEN];
+	u8 buf[sizeof(struct ieee802_1x_hdr) + sizeof(struct wpa_eapol_key) +
+	       16 + 2 + sizeof(rsne)];
+	struct ieee802_1x_hdr *hdr;
+	struct wpa_eapol_key *key;
+	struct wpa_state_machine *sm;
+	struct wpa_ptk ptk;
+	u8 *mic, *pos;
+	int ret = -1;
+
+	os_memcpy(mdie, conf->mobility_domain, MOBILITY_DOMAIN_ID_LEN);
+	mdie[MOBILITY_DOMAIN_ID_LEN] = 0;
+	t->msg1 = 0;
+	sm = wpa_auth_sta_init(wpa_auth, sta_addr, NULL);
+	if (!sm ||
+	    wpa_validate_wpa_ie(wpa_auth, sm, 2412, rsne, sizeof(rsne),
+				NULL, 0, mdie, sizeof(mdie), NULL, 0) !=
+	    WPA_IE_OK)
+		goto fail;
+	wpa_auth_sm_event(sm, WPA_ASSOC);
+	wpa_auth_sta_associated(wpa_auth, sm);
+	if (t->msg1 != 1)
+		goto fail;
+
+	if (os_get_random(snonce, sizeof(snonce)) < 0 ||
+	    wpa_derive_pmk_r0(t->psk[psk_idx], PMK_LEN, conf->ssid,
+			      conf->ssid_len, conf->mobility_domain,
+			      conf->r0_key_holder, conf->r0_key_holder_len,
+			      sta_addr, pmk_r0, pmk_r0_name,
+			      WPA_KEY_MGMT_FT_PSK) < 0 ||
+	    wpa_derive_pmk_r1(pmk_r0, PMK_LEN, pmk_r0_name,
+			      conf->r1_key_holder, sta_addr,
+			      pmk_r1, pmk_r1_name) < 0 ||
+	    wpa_pmk_r1_to_ptk(pmk_r1, PMK_LEN, snonce, t->anonce, sta_addr,
+			      wpa_auth->addr, pmk_r1_name, &ptk, ptk_name,
+			      WPA_KEY_MGMT_FT_PSK, WPA_CIPHER_CCMP, 0) < 0)
+		goto fail;
+
+	/* EAPOL-Key msg 2/4 */
+	os_memset(buf, 0, sizeof(buf));
+	hdr = (struct ieee802_1x_hdr *) buf;
+	hdr->version = EAPOL_VERSION;
+	hdr->type = IEEE802_1X_TYPE_EAPOL_KEY;
+	WPA_PUT_BE16((u8 *) &hdr->length, sizeof(buf) - sizeof(*hdr));
+	key = (struct wpa_eapol_key *) (hdr + 1);
+	key->type = EAPOL_KEY_TYPE_RSN;
+	WPA_PUT_BE16(key->key_info, WPA_KEY_INFO_TYPE_AES_128_CMAC |
+		     WPA_KEY_INFO_KEY_TYPE | WPA_KEY_INFO_MIC);
+	os_memcpy(key->replay_counter, t->replay_counter,
+		  WPA_REPLAY_COUNTER_LEN);
+	os_memcpy(key->key_nonce, snonce, WPA_NONCE_LEN);
+	mic = (u8 *) (key + 1);
+	pos = mic + 16;
+	WPA_PUT_BE16(pos, sizeof(rsne));
+	os_memcpy(pos + 2, rsne, sizeof(rsne));
+	if (wpa_eapol_key_mic(ptk.kck, ptk.kck_len, WPA_KEY_MGMT_FT_PSK,
+			      WPA_KEY_INFO_TYPE_AES_128_CMAC, buf, sizeof(buf),
+			      mic) < 0)
+		goto fail;
+
+	/* The PSK is remembered as soon as the MIC has been verified, so
+	 * the FT checks that follow are not needed here */
+	wpa_receive(wpa_auth, sm, buf, sizeof(buf));
+	ret = 0;
+fail:
+	wpa_auth_sta_deinit(sm);
+	forced_memzero(pmk_r0, sizeof(pmk_r0));
+	forced_memzero(pmk_r1, sizeof(pmk_r1));
+	forced_memzero(&ptk, sizeof(ptk));
+	return ret;
+}
+
+
+static int psk_memo_ft_tests(void)
+{
+	static const u8 own_addr[ETH_ALEN] = { 0x02, 0, 0, 0, 0x01, 0 };
+	static const u8 sta_addr[ETH_ALEN] = { 0x02, 0, 0, 0, 0x02, 0 };
+	struct wpa_auth_callbacks cb;
+	struct wpa_auth_config conf;
+	struct wpa_authenticator *wpa_auth;
+	struct psk_memo_test_ctx t;
+	int ret = -1;
+
+	wpa_printf(MSG_INFO, "FT-PSK memo tests");
+
+	os_memset(&t, 0, sizeof(t));
+	os_memset(t.psk[0], 0x11, PMK_LEN);
+	os_memset(t.psk[1], 0x22, PMK_LEN);
+
+	os_memset(&cb, 0, sizeof(cb));
+	cb.get_psk = psk_memo_test_get_psk;
+	cb.set_key = psk_memo_test_set_key;
+	cb.send_eapol = psk_memo_test_send_eapol;
+	cb.get_vlan = psk_memo_test_get_vlan;
+
+	os_memset(&conf, 0, sizeof(conf));
+	conf.wpa = WPA_PROTO_RSN;
+	conf.wpa_key_mgmt = WPA_KEY_MGMT_FT_PSK;
+	conf.wpa_group = WPA_CIPHER_CCMP;
+	conf.rsn_pairwise = WPA_CIPHER_CCMP;
+	conf.wpa_group_update_count = 4;
+	conf.wpa_pairwise_update_count = 4;
+	conf.eapol_version = EAPOL_VERSION;
+	conf.ssid_len = 4;
+	os_memcpy(conf.ssid, "test", 4);
+	conf.mobility_domain[0] = 0xa1;
+	conf.mobility_domain[1] = 0xb2;
+	conf.r0_key_holder_len = 6;
+	os_memcpy(conf.r0_key_holder, "r0-kh1", 6);
+	os_memcpy(conf.r1_key_holder, own_addr, FT_R1KH_ID_LEN);
+	conf.r0_key_lifetime = 600;
+
+	wpa_auth = wpa_init(own_addr, &conf, &cb, &t);
+	if (!wpa_auth)
+		return -1;
+
+	/* The station uses the second PSK while xxkey is initialized from
+	 * the first one, so the memo is hit only if the memorized PSK is
+	 * used for the FT key hierarchy. */
+	if (psk_memo_test_4way(wpa_auth, &t, &conf, sta_addr, 1) < 0 ||
+	    wpa_auth->num_psk_memo != 1 || wpa_auth->psk_memo_hits != 0) {
+		wpa_printf(MSG_ERROR, "FT-PSK memo: PSK not remembered");
+		goto fail;
+	}
+
+	if (psk_memo_test_4way(wpa_auth, &t, &conf, sta_addr, 1) < 0 ||
+	    wpa_auth->psk_memo_hits != 1) {
+		wpa_printf(MSG_ERROR, "FT-PSK memo: Remembered PSK not used");
+		goto fail;
+	}
+
+	/* A station that changed its PSK is found by the full search and
+	 * the memo is updated */
+	if (psk_memo_test_4way(wpa_auth, &t, &conf, sta_addr, 0) < 0 ||
+	    wpa_auth->psk_memo_hits != 1 ||
+	    psk_memo_test_4way(wpa_auth, &t, &conf, sta_addr, 0) < 0 ||
+	    wpa_auth->psk_memo_hits != 2 || wpa_auth->num_psk_memo != 1) {
+		wpa_printf(MSG_ERROR, "FT-PSK memo: Changed PSK not handled");
+		goto fail;
+	}
+
+	ret = 0;
+fail:
+	wpa_deinit(wpa_auth);
+	return ret;
+}
+
+#endif /* CONFIG_IEEE80211R_AP */
+
+
+#ifdef CONFIG_PMK_STORE
+
+struct pmk_store_test_ctx {
+	int count;
+	int errors;
+};
+
+
+static int pmk_store_test_cb(void *ctx, int slot, enum pmk_store_type type,
+			     const u8 *data, size_t len)
+{
+	struct pmk_store_test_ctx *t = ctx;
+
+	t->count++;
+	if (type != PMK_STORE_PMKSA || len != 4 || data[0] == 1 ||
+	    data[1] != 0xaa)
+		t->errors++;
+	/* Drop the record with value 2 */
+	return data[0] == 2 ? -1 : 0;
+}
+
+
+static int pmk_store_tests(void)
+{
+	u8 key[PMK_STORE_KEY_LEN];
+	struct pmk_store *store;
+	struct pmk_store_test_ctx t;
+	struct wpabuf *buf;
+	char fname[64];
+	int i, slot[3], ret = -1;
+
+	wpa_printf(MSG_INFO, "PMK store tests");
+
+	os_snprintf(fname, sizeof(fname), "/tmp/hostapd-pmk-store-test-%d",
+		    (int) getpid());
+	os_memset(key, 0x11, sizeof(key));
+	buf = wpabuf_alloc(4);
+	store = pmk_store_open(fname, key, 8);
+	if (!buf || !store)
+		goto fail;
+
+	for (i = 0; i < 3; i++) {
+		wpabuf_put_u8(buf, i);
+		wpabuf_put_u8(buf, 0xaa);
+		wpabuf_put_le16(buf, i);
+		slot[i] = pmk_store_put(store, PMK_STORE_PMKSA, buf);
+		wpabuf_clear_free(buf);
+		buf = wpabuf_alloc(4);
+		if (slot[i] <= 0 || !buf)
+			goto fail;
+	}
+	pmk_store_del(store, slot[1]);
+	pmk_store_close(store);
+
+	os_memset(&t, 0, sizeof(t));
+	store = pmk_store_open(fname, key, 8);
+	if (!store || pmk_store_load(store, pmk_store_test_cb, &t) != 1 ||
+	    t.count != 2 || t.errors) {
+		wpa_printf(MSG_ERROR, "pmk_store: Unexpected records on load");
+		goto fail;
+	}
+	pmk_store_close(store);
+
+	/* The record dropped by the callback must not be there anymore and a
+	 * different key must not accept any of the records */
+	os_memset(&t, 0, sizeof(t));
+	store = pmk_store_open(fname, key, 8);
+	if (!store || pmk_store_load(store, pmk_store_test_cb, &t) != 1) {
+		wpa_printf(MSG_ERROR, "pmk_store: Dropped record restored");
+		goto fail;
+	}
+	pmk_store_close(store);
+
+	key[0] ^= 0x01;
+	os_memset(&t, 0, sizeof(t));
+	store = pmk_store_open(fname, key, 8);
+	if (!store || pmk_store_load(store, pmk_store_test_cb, &t) != 0) {
+		wpa_printf(MSG_ERROR, "pmk_store: Record accepted with wrong key");
+		goto fail;
+	}
+
+	ret = 0;
+fail:
+	if (ret)
+		wpa_printf(MSG_ERROR, "PMK store test failed");
+	pmk_store_close(store);
+	wpabuf_free(buf);
+	unlink(fname);
+	return ret;
+}
+
+#endif /* CONFIG_PMK_STORE */
+
+
+#ifdef CONFIG_WORKER_POOL
+
+#define WORKER_POOL_TEST_JOBS 10
+
+struct worker_pool_test {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int block; /* the first job waits for this to be cleared */
+	int started;
+	int work[WORKER_POOL_TEST_JOBS];
+	int done[WORKER_POOL_TEST_JOBS];
+	int deinit[WORKER_POOL_TEST_JOBS];
+	int order[WORKER_POOL_TEST_JOBS];
+	int num_done;
+};
+
+struct worker_pool_test_job {
+	struct worker_pool_test *t;
+	int idx;
+};
+
+
+static void worker_pool_test_work(void *ctx)
+{
+	struct worker_pool_test_job *job = ctx;
+	struct worker_pool_test *t = job->t;
+	struct timespec ts;
+
+	pthread_mutex_lock(&t->lock);
+	t->work[job->idx]++;
+	if (job->idx == 0) {
+		t->started = 1;
+		pthread_cond_broadcast(&t->cond);
+		/* Keep the only worker busy so that the other jobs remain
+		 * queued; deinit is not allowed to wait for them */
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += 100000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		while (t->block &&
+		       pthread_cond_timedwait(&t->cond, &t->lock, &ts) == 0)
+			;
+	}
+	pthread_mutex_unlock(&t->lock);
+}
+
+
+static void worker_pool_test_done(void *ctx, int deinit)
+{
+	struct worker_pool_test_job *job = ctx;
+	struct worker_pool_test *t = job->t;
+
+	t->done[job->idx]++;
+	t->deinit[job->idx] = deinit;
+	t->order[t->num_done++ % WORKER_POOL_TEST_JOBS] = job->idx;
+}
+
+
+static int worker_pool_test_run(struct worker_pool_test *t,
+				struct worker_pool_test_job *jobs, int block)
+{
+	struct worker_pool *pool;
+	int i;
+
+	os_memset(t->work, 0, sizeof(t->work));
+	os_memset(t->done, 0, sizeof(t->done));
+	os_memset(t->deinit, 0, sizeof(t->deinit));
+	t->num_done = 0;
+	t->started = 0;
+	t->block = block;
+
+	/* A single thread runs the jobs in the order they were submitted */
+	pool = worker_pool_init(1);
+	if (!pool || worker_pool_threads(pool) != 1) {
+		worker_pool_deinit(pool);
+		return -1;
+	}
+
+	for (i = 0; i < WORKER_POOL_TEST_JOBS; i++) {
+		jobs[i].t = t;
+		jobs[i].idx = i;
+		if (worker_pool_submit(pool, worker_pool_test_work,
+				       worker_pool_test_done, &jobs[i]) < 0) {
+			worker_pool_deinit(pool);
+			return -1;
+		}
+	}
+	if (worker_pool_pending(pool) != WORKER_POOL_TEST_JOBS) {
+		worker_pool_deinit(pool);
+		return -1;
+	}
+
+	if (block) {
+		pthread_mutex_lock(&t->lock);
+		while (!t->started)
+			pthread_cond_wait(&t->cond, &t->lock);
+		pthread_mutex_unlock(&t->lock);
+	} else {
+		worker_pool_wait(pool);
+		worker_pool_test_receive(pool);
+		if (worker_pool_pending(pool) != 0) {
+			worker_pool_deinit(pool);
+			return -1;
+		}
+	}
+	worker_pool_deinit(pool);
+	return 0;
+}
+
+
+static int worker_pool_tests(void)
+{
+	struct worker_pool_test t;
+	struct worker_pool_test_job jobs[WORKER_POOL_TEST_JOBS];
+	int i, ret = -1;
+
+	wpa_printf(MSG_INFO, "worker pool tests");
+
+	os_memset(&t, 0, sizeof(t));
+	pthread_mutex_init(&t.lock, NULL);
+	pthread_cond_init(&t.cond, NULL);
+
+	/* All jobs are run and completed through the done callback in the
+	 * order they were submitted */
+	if (worker_pool_test_run(&t, jobs, 0) < 0 ||
+	    t.num_done != WORKER_POOL_TEST_JOBS) {
+		wpa_printf(MSG_ERROR, "worker_pool: Jobs not completed");
+		goto fail;
+	}
+	for (i = 0; i < WORKER_POOL_TEST_JOBS; i++) {
+		if (t.work[i] != 1 || t.done[i] != 1 || t.deinit[i] ||
+		    t.order[i] != i) {
+			wpa_printf(MSG_ERROR,
+				   "worker_pool: Unexpected completion of job %d",
+				   i);
+			goto fail;
+		}
+	}
+
+	/* Deinit with queued jobs: the running job is allowed to finish, the
+	 * queued ones are not run, and all of them are completed once with
+	 * deinit=1 */
+	if (worker_pool_test_run(&t, jobs, 1) < 0 ||
+	    t.num_done != WORKER_POOL_TEST_JOBS) {
+		wpa_printf(MSG_ERROR, "worker_pool: Jobs lost on deinit");
+		goto fail;
+	}
+	for (i = 0; i < WORKER_POOL_TEST_JOBS; i++) {
+		if (t.work[i] != (i == 0) || t.done[i] != 1 || !t.deinit[i]) {
+			wpa_printf(MSG_ERROR,
+				   "worker_pool: Unexpected deinit of job %d",
+				   i);
+			goto fail;
+		}
+	}
+
+	ret = 0;
+fail:
+	if (ret)
+		wpa_printf(MSG_ERROR, "worker pool test failed");
+	pthread_cond_destroy(&t.cond);
+	pthread_mutex_destroy(&t.lock);
+	return ret;
+}
+
+#endif /* CONFIG_WORKER_POOL */
+
 
 int hapd_module_tests(void)
 {
 	wpa_printf(MSG_INFO, "hostapd module tests");
+	if (sta_hash_bench_tests() < 0)
+		return -1;
+	if (pmksa_cache_tests() < 0)
+		return -1;
+#ifdef CONFIG_IEEE80211R_AP
+	if (psk_memo_ft_tests() < 0)
+		return -1;
+	if (wpa_ft_pmk_cache_tests() < 0)
+		return -1;
+#endif /* CONFIG_IEEE80211R_AP */
+#ifdef CONFIG_PMK_STORE
+	if (pmk_store_tests() < 0)
+		return -1;
+#endif /* CONFIG_PMK_STORE */
+#ifdef CONFIG_WORKER_POOL
+	if (worker_pool_tests() < 0)
+		return -1;
+#endif /* CONFIG_WORKER_POOL */
 	return 0;
 }
@@ -271,6 +271,20 @@ static int hostapd_cli_cmd_mib(struct wpa_ctrl *ctrl, int argc, char *argv[])
 }
 
 
+static int hostapd_cli_cmd_eloop_stats(struct wpa_ctrl *ctrl, int argc,
+				       char *argv[])
+{
+	return wpa_ctrl_command(ctrl, "ELOOP_STATS");
+}
+
+
+static int hostapd_cli_cmd_trace_dump(struct wpa_ctrl *ctrl, int argc,
+				      char *argv[])
+{
+	return hostapd_cli_cmd(ctrl, "TRACE_DUMP", 0, argc, argv);
+}
+
+
 static int hostapd_cli_exec(const char *program, const char *arg1,
 			    const char *arg2)
 {
@@ -1569,6 +1583,10 @@ static const struct hostapd_cli_cmd hostapd_cli_commands[] = {
 	  "= pings hostapd" },
 	{ "mib", hostapd_cli_cmd_mib, NULL,
 	  "= get MIB variables (dot1x, dot11, radius)" },
+	{ "eloop_stats", hostapd_cli_cmd_eloop_stats, NULL,
+	  "= get event loop statistics" },
+	{ "trace_dump", hostapd_cli_cmd_trace_dump, NULL,
+	  "[<name>] = write flight recorder contents into the dump directory" },
 	{ "relog", hostapd_cli_cmd_relog, NULL,
 	  "= reload/truncate debug log output file" },
 	{ "status", hostapd_cli_cmd_status, NULL,
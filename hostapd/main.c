@@ -14,6 +14,7 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/flight_recorder.h"
 #include "utils/uuid.h"
 #include "crypto/crypto.h"
 #include "crypto/random.h"
@@ -332,7 +333,9 @@ static void handle_reload(int sig, void *signal_ctx)
 
 static void handle_dump_state(int sig, void *signal_ctx)
 {
-	/* Not used anymore - ignore signal */
+#ifdef CONFIG_FLIGHT_RECORDER
+	flight_recorder_dump(NULL);
+#endif /* CONFIG_FLIGHT_RECORDER */
 }
 #endif /* CONFIG_NATIVE_WINDOWS */
 
@@ -29,6 +29,7 @@
 
 static void accounting_sta_interim(struct hostapd_data *hapd,
 				   struct sta_info *sta);
+static void accounting_batch_update(void *eloop_ctx, void *timeout_ctx);
 
 
 static struct radius_msg * accounting_msg(struct hostapd_data *hapd,
@@ -171,8 +172,18 @@ static int accounting_sta_update_stats(struct hostapd_data *hapd,
 				       struct sta_info *sta,
 				       struct hostap_sta_driver_data *data)
 {
-	if (hostapd_drv_read_sta_data(hapd, data, sta->addr))
+	if (hapd->acct_batch_active &&
+	    sta->acct_batch_gen == hapd->acct_batch_gen) {
+		/* Use the statistics from the batched station dump */
+		os_memset(data, 0, sizeof(*data));
+		data->rx_packets = sta->acct_rx_packets;
+		data->tx_packets = sta->acct_tx_packets;
+		data->rx_bytes = sta->acct_rx_bytes;
+		data->tx_bytes = sta->acct_tx_bytes;
+		data->bytes_64bit = sta->acct_bytes_64bit;
+	} else if (hostapd_drv_read_sta_data(hapd, data, sta->addr)) {
 		return -1;
+	}
 
 	if (!data->bytes_64bit) {
 		/* Extend 32-bit counters from the driver to 64-bit counters */
@@ -198,23 +209,152 @@ static int accounting_sta_update_stats(struct hostapd_data *hapd,
 }
 
 
+static int accounting_sta_update_interval(struct sta_info *sta)
+{
+	if (sta->acct_interim_interval)
+		return sta->acct_interim_interval;
+	return ACCT_DEFAULT_UPDATE_INTERVAL;
+}
+
+
 static void accounting_interim_update(void *eloop_ctx, void *timeout_ctx)
 {
 	struct hostapd_data *hapd = eloop_ctx;
 	struct sta_info *sta = timeout_ctx;
-	int interval;
 
 	if (sta->acct_interim_interval) {
 		accounting_sta_interim(hapd, sta);
-		interval = sta->acct_interim_interval;
 	} else {
 		struct hostap_sta_driver_data data;
 		accounting_sta_update_stats(hapd, sta, &data);
-		interval = ACCT_DEFAULT_UPDATE_INTERVAL;
 	}
 
-	eloop_register_timeout(interval, 0, accounting_interim_update,
-			       hapd, sta);
+	if (hapd->conf->acct_batch_interval) {
+		struct os_reltime now;
+
+		/* Batched updates were enabled with a configuration reload, so
+		 * leave the following updates to the batch timer */
+		os_get_reltime(&now);
+		sta->acct_next_update = now.sec +
+			accounting_sta_update_interval(sta);
+		if (!eloop_is_timeout_registered(accounting_batch_update, hapd,
+						 NULL))
+			eloop_register_timeout(hapd->conf->acct_batch_interval,
+					       0, accounting_batch_update,
+					       hapd, NULL);
+		return;
+	}
+
+	eloop_register_timeout(accounting_sta_update_interval(sta), 0,
+			       accounting_interim_update, hapd, sta);
+}
+
+
+static void accounting_batch_sta_stats(void *ctx, const u8 *addr,
+				       struct hostap_sta_driver_data *data)
+{
+	struct hostapd_data *hapd = ctx;
+	struct sta_info *sta;
+
+	sta = ap_get_sta(hapd, addr);
+	if (!sta || !sta->acct_session_started)
+		return;
+
+	sta->acct_batch_gen = hapd->acct_batch_gen;
+	sta->acct_rx_packets = data->rx_packets;
+	sta->acct_tx_packets = data->tx_packets;
+	sta->acct_rx_bytes = data->rx_bytes;
+	sta->acct_tx_bytes = data->tx_bytes;
+	sta->acct_bytes_64bit = data->bytes_64bit;
+}
+
+
+/*
+ * With acct_batch_interval, a single timer per BSS handles the updates of all
+ * stations. The statistics of the stations are fetched with a single station
+ * dump when at least one station is due for an update. To avoid bursts of
+ * Accounting-Request messages, at most about twice the number of interim
+ * updates that the configured intervals need on average are sent in a single
+ * batch. The remaining ones stay due and since the next update of a station
+ * is scheduled based on the time it was actually sent, a burst is spread
+ * over the following batches.
+ */
+static void accounting_batch_update(void *eloop_ctx, void *timeout_ctx)
+{
+	struct hostapd_data *hapd = eloop_ctx;
+	int batch = hapd->conf->acct_batch_interval;
+	unsigned int num_sta = 0, due = 0, sent = 0, deferred = 0;
+	unsigned int rate = 0, limit;
+	struct hostap_sta_driver_data data;
+	struct sta_info *sta;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+
+	if (!batch) {
+		/* Batched updates were disabled with a configuration reload, so
+		 * go back to a timer for each station */
+		for (sta = hapd->sta_list; sta; sta = sta->next) {
+			if (!sta->acct_session_started ||
+			    eloop_is_timeout_registered(
+				    accounting_interim_update, hapd, sta))
+				continue;
+			eloop_register_timeout(
+				sta->acct_next_update > now.sec ?
+				sta->acct_next_update - now.sec : 0,
+				0, accounting_interim_update, hapd, sta);
+		}
+		return;
+	}
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!sta->acct_session_started)
+			continue;
+		num_sta++;
+		if (sta->acct_interim_interval)
+			rate += 1000 * batch / sta->acct_interim_interval;
+		if (sta->acct_next_update <= now.sec)
+			due++;
+	}
+	if (!num_sta)
+		return; /* restarted from accounting_sta_start() */
+	if (!due)
+		goto out;
+
+	limit = 2 * ((rate + 999) / 1000) + 1;
+
+	hapd->acct_batch_gen++;
+	if (hostapd_drv_read_sta_data_all(hapd, accounting_batch_sta_stats,
+					  hapd) < 0)
+		wpa_printf(MSG_DEBUG,
+			   "RADIUS: Station dump failed - fetch statistics for each station separately");
+	hapd->acct_batch_active = true;
+
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!sta->acct_session_started ||
+		    sta->acct_next_update > now.sec)
+			continue;
+		if (sta->acct_interim_interval) {
+			if (sent >= limit) {
+				deferred++;
+				continue;
+			}
+			accounting_sta_interim(hapd, sta);
+			sent++;
+		} else {
+			accounting_sta_update_stats(hapd, sta, &data);
+		}
+		sta->acct_next_update = now.sec +
+			accounting_sta_update_interval(sta);
+	}
+
+	hapd->acct_batch_active = false;
+	wpa_printf(MSG_DEBUG,
+		   "RADIUS: Batched accounting update: %u station(s), %u due, %u interim update(s) sent, %u deferred",
+		   num_sta, due, sent, deferred);
+
+out:
+	eloop_register_timeout(batch, 0, accounting_batch_update, hapd, NULL);
 }
 
 
@@ -246,12 +386,18 @@ void accounting_sta_start(struct hostapd_data *hapd, struct sta_info *sta)
 	if (!hapd->conf->radius->acct_server)
 		return;
 
-	if (sta->acct_interim_interval)
-		interval = sta->acct_interim_interval;
-	else
-		interval = ACCT_DEFAULT_UPDATE_INTERVAL;
-	eloop_register_timeout(interval, 0, accounting_interim_update,
-			       hapd, sta);
+	interval = accounting_sta_update_interval(sta);
+	if (hapd->conf->acct_batch_interval) {
+		sta->acct_next_update = sta->acct_session_start.sec + interval;
+		if (!eloop_is_timeout_registered(accounting_batch_update, hapd,
+						 NULL))
+			eloop_register_timeout(hapd->conf->acct_batch_interval,
+					       0, accounting_batch_update,
+					       hapd, NULL);
+	} else {
+		eloop_register_timeout(interval, 0, accounting_interim_update,
+				       hapd, sta);
+	}
 
 	msg = accounting_msg(hapd, sta, RADIUS_ACCT_STATUS_TYPE_START);
 	if (msg &&
@@ -494,6 +640,19 @@ static void accounting_interim_error_cb(const u8 *addr, void *ctx)
 		for (i = 1; i < sta->acct_interim_errors; i++)
 			wait_time *= 2;
 	}
+	if (hapd->conf->acct_batch_interval) {
+		struct os_reltime now;
+
+		/* Retry in the first batch after the wait time */
+		os_get_reltime(&now);
+		if (sta->acct_next_update > now.sec + wait_time)
+			sta->acct_next_update = now.sec + wait_time;
+		wpa_printf(MSG_DEBUG,
+			   "Interim RADIUS accounting update failed for " MACSTR
+			   " (error count: %u) - retry in %u seconds",
+			   MAC2STR(addr), sta->acct_interim_errors, wait_time);
+		return;
+	}
 	res = eloop_deplete_timeout(wait_time, 0, accounting_interim_update,
 				    hapd, sta);
 	if (res == 1)
@@ -543,5 +702,6 @@ int accounting_init(struct hostapd_data *hapd)
  */
 void accounting_deinit(struct hostapd_data *hapd)
 {
+	eloop_cancel_timeout(accounting_batch_update, hapd, NULL);
 	accounting_report_state(hapd, 0);
 }
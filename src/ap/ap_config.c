@@ -7,8 +7,13 @@
  */
 
 #include "utils/includes.h"
+#include <fcntl.h>
+#ifdef CONFIG_WPA_PSK_THREADS
+#include <pthread.h>
+#endif /* CONFIG_WPA_PSK_THREADS */
 
 #include "utils/common.h"
+#include "crypto/crypto.h"
 #include "crypto/sha1.h"
 #include "crypto/tls.h"
 #include "radius/radius_client.h"
@@ -22,6 +27,7 @@
 #include "wpa_auth.h"
 #include "sta_info.h"
 #include "airtime_policy.h"
+#include "pmk_store.h"
 #include "ap_config.h"
 
 
@@ -89,11 +95,16 @@ void hostapd_config_defaults_bss(struct hostapd_bss_config *bss)
 
 	bss->radius_server_auth_port = 1812;
 	bss->eap_sim_db_timeout = 1;
+	bss->eap_user_sqlite_cache = 1000;
+	bss->eap_user_sqlite_cache_ttl = 60;
 	bss->eap_sim_id = 3;
 	bss->ap_max_inactivity = AP_MAX_INACTIVITY;
 	bss->eapol_version = EAPOL_VERSION;
 
 	bss->max_listen_interval = 65535;
+#ifdef CONFIG_PMK_STORE
+	bss->pmk_store_slots = PMK_STORE_DEFAULT_SLOTS;
+#endif /* CONFIG_PMK_STORE */
 
 	bss->pwd_group = 19; /* ECC: GF(p=256) */
 
@@ -305,6 +316,372 @@ int hostapd_mac_comp(const void *a, const void *b)
 }
 
 
+#define HOSTAPD_PSK_MAX_THREADS 64
+#define HOSTAPD_PSK_CACHE_SALT_LEN 16
+
+/* Passphrase from wpa_psk_file waiting for PBKDF2 */
+struct hostapd_psk_job {
+	struct hostapd_wpa_psk *psk;
+	char *passphrase;
+	int line;
+	int derived;
+	u8 key[SHA1_MAC_LEN]; /* wpa_psk_cache_file key */
+};
+
+struct hostapd_psk_cache_entry {
+	u8 key[SHA1_MAC_LEN];
+	u8 pmk[PMK_LEN];
+};
+
+struct hostapd_psk_derive {
+	const struct hostapd_ssid *ssid;
+	u8 cache_salt[HOSTAPD_PSK_CACHE_SALT_LEN]; /* wpa_psk_cache_file salt */
+	struct hostapd_psk_job *jobs;
+	size_t num_jobs;
+	size_t jobs_size;
+	size_t next_job;
+};
+
+
+static int hostapd_psk_job_add(struct hostapd_psk_derive *ctx,
+			       struct hostapd_wpa_psk *psk,
+			       const char *passphrase, int line)
+{
+	struct hostapd_psk_job *job;
+
+	if (ctx->num_jobs == ctx->jobs_size) {
+		size_t size = ctx->jobs_size ? 2 * ctx->jobs_size : 16;
+
+		job = os_realloc_array(ctx->jobs, size, sizeof(*job));
+		if (!job)
+			return -1;
+		ctx->jobs = job;
+		ctx->jobs_size = size;
+	}
+
+	job = &ctx->jobs[ctx->num_jobs];
+	os_memset(job, 0, sizeof(*job));
+	job->passphrase = os_strdup(passphrase);
+	if (!job->passphrase)
+		return -1;
+	job->psk = psk;
+	job->line = line;
+	ctx->num_jobs++;
+	return 0;
+}
+
+
+static void hostapd_psk_derive_free(struct hostapd_psk_derive *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->num_jobs; i++)
+		str_clear_free(ctx->jobs[i].passphrase);
+	bin_clear_free(ctx->jobs, ctx->jobs_size * sizeof(ctx->jobs[0]));
+}
+
+
+static void hostapd_psk_derive_run(struct hostapd_psk_derive *ctx)
+{
+	const struct hostapd_ssid *ssid = ctx->ssid;
+	struct hostapd_psk_job *job;
+	size_t i;
+
+	for (;;) {
+#ifdef CONFIG_WPA_PSK_THREADS
+		i = __atomic_fetch_add(&ctx->next_job, 1, __ATOMIC_RELAXED);
+#else /* CONFIG_WPA_PSK_THREADS */
+		i = ctx->next_job++;
+#endif /* CONFIG_WPA_PSK_THREADS */
+		if (i >= ctx->num_jobs)
+			break;
+		job = &ctx->jobs[i];
+		if (job->derived)
+			continue; /* from wpa_psk_cache_file */
+		if (pbkdf2_sha1(job->passphrase, ssid->ssid, ssid->ssid_len,
+				4096, job->psk->psk, PMK_LEN) == 0)
+			job->derived = 1;
+	}
+}
+
+
+#ifdef CONFIG_WPA_PSK_THREADS
+
+static void * hostapd_psk_derive_thread(void *arg)
+{
+	hostapd_psk_derive_run(arg);
+	return NULL;
+}
+
+
+static unsigned int hostapd_psk_derive_threads(struct hostapd_psk_derive *ctx,
+					       size_t count)
+{
+	pthread_t threads[HOSTAPD_PSK_MAX_THREADS];
+	long cpus;
+	unsigned int i, num = 0, max;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	max = cpus > 1 ? cpus : 1;
+	if (max > HOSTAPD_PSK_MAX_THREADS)
+		max = HOSTAPD_PSK_MAX_THREADS;
+	if (max > count)
+		max = count;
+
+	/* The calling thread is one of the workers */
+	for (i = 1; i < max; i++) {
+		if (pthread_create(&threads[num], NULL,
+				   hostapd_psk_derive_thread, ctx) != 0)
+			break;
+		num++;
+	}
+	hostapd_psk_derive_run(ctx);
+	for (i = 0; i < num; i++)
+		pthread_join(threads[i], NULL);
+
+	return num + 1;
+}
+
+#endif /* CONFIG_WPA_PSK_THREADS */
+
+
+static int hostapd_psk_cache_key(const struct hostapd_psk_derive *ctx,
+				 const char *passphrase, u8 *key)
+{
+	const struct hostapd_ssid *ssid = ctx->ssid;
+	const u8 *addr[3];
+	size_t len[3];
+	u8 ssid_len = ssid->ssid_len;
+
+	/* Keyed with the per-file salt so that the cache file cannot be used
+	 * to test passphrase guesses without also knowing the salt and to
+	 * prevent precomputation over common SSIDs. */
+	addr[0] = &ssid_len;
+	len[0] = 1;
+	addr[1] = ssid->ssid;
+	len[1] = ssid->ssid_len;
+	addr[2] = (const u8 *) passphrase;
+	len[2] = os_strlen(passphrase);
+	return hmac_sha1_vector(ctx->cache_salt, sizeof(ctx->cache_salt),
+				3, addr, len, key);
+}
+
+
+static int hostapd_psk_cache_cmp(const void *a, const void *b)
+{
+	return os_memcmp(a, b, SHA1_MAC_LEN);
+}
+
+
+static struct hostapd_psk_cache_entry *
+hostapd_psk_cache_read(const char *fname, u8 *salt, size_t *count)
+{
+	struct hostapd_psk_cache_entry *cache = NULL, *tmp;
+	size_t num = 0, size = 0;
+	char buf[2 * SHA1_MAC_LEN + 1 + 2 * PMK_LEN + 2];
+	FILE *f;
+	int salt_found = 0;
+
+	*count = 0;
+	f = fopen(fname, "r");
+	if (!f)
+		return NULL;
+
+	while (fgets(buf, sizeof(buf), f)) {
+		if (buf[0] == '#')
+			continue;
+		if (os_strncmp(buf, "salt=", 5) == 0) {
+			if (salt_found ||
+			    hexstr2bin(&buf[5], salt,
+				       HOSTAPD_PSK_CACHE_SALT_LEN) ||
+			    (buf[5 + 2 * HOSTAPD_PSK_CACHE_SALT_LEN] != '\n' &&
+			     buf[5 + 2 * HOSTAPD_PSK_CACHE_SALT_LEN] != '\0'))
+				break;
+			salt_found = 1;
+			continue;
+		}
+		if (!salt_found)
+			break;
+		if (num == size) {
+			size = size ? 2 * size : 256;
+			tmp = os_realloc_array(cache, size, sizeof(*cache));
+			if (!tmp)
+				break;
+			cache = tmp;
+		}
+		if (os_strlen(buf) < 2 * SHA1_MAC_LEN + 1 + 2 * PMK_LEN ||
+		    buf[2 * SHA1_MAC_LEN] != ' ' ||
+		    hexstr2bin(buf, cache[num].key, SHA1_MAC_LEN) ||
+		    hexstr2bin(&buf[2 * SHA1_MAC_LEN + 1], cache[num].pmk,
+			       PMK_LEN))
+			continue;
+		num++;
+	}
+	forced_memzero(buf, sizeof(buf));
+	fclose(f);
+
+	if (!salt_found) {
+		/* Missing or invalid salt; the cache will be rebuilt */
+		wpa_printf(MSG_DEBUG,
+			   "Ignoring WPA PSK cache file '%s' without a valid salt",
+			   fname);
+		bin_clear_free(cache, size * sizeof(*cache));
+		return NULL;
+	}
+
+	if (cache)
+		qsort(cache, num, sizeof(*cache), hostapd_psk_cache_cmp);
+	*count = num;
+	return cache;
+}
+
+
+static int hostapd_psk_cache_write(const char *fname,
+				   struct hostapd_psk_derive *ctx)
+{
+	char *tmpname;
+	char salt[2 * HOSTAPD_PSK_CACHE_SALT_LEN + 1];
+	size_t i, len;
+	FILE *f;
+	int fd, res, ret = 0;
+
+	len = os_strlen(fname) + 5;
+	tmpname = os_malloc(len);
+	if (!tmpname)
+		return -1;
+	res = os_snprintf(tmpname, len, "%s.tmp", fname);
+	if (os_snprintf_error(len, res)) {
+		os_free(tmpname);
+		return -1;
+	}
+
+	fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW,
+		  S_IRUSR | S_IWUSR);
+	f = fd >= 0 ? fdopen(fd, "w") : NULL;
+	if (!f) {
+		wpa_printf(MSG_INFO, "Failed to open WPA PSK cache file '%s': %s",
+			   tmpname, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		os_free(tmpname);
+		return -1;
+	}
+
+	fprintf(f, "# hostapd wpa_psk_file PMK cache - do not edit\n");
+	wpa_snprintf_hex(salt, sizeof(salt), ctx->cache_salt,
+			 sizeof(ctx->cache_salt));
+	fprintf(f, "salt=%s\n", salt);
+	for (i = 0; i < ctx->num_jobs; i++) {
+		struct hostapd_psk_job *job = &ctx->jobs[i];
+		char hex[2 * PMK_LEN + 1];
+		size_t j;
+
+		if (!job->derived)
+			continue;
+		for (j = 0; j < SHA1_MAC_LEN; j++)
+			fprintf(f, "%02x", job->key[j]);
+		wpa_snprintf_hex(hex, sizeof(hex), job->psk->psk, PMK_LEN);
+		fprintf(f, " %s\n", hex);
+		forced_memzero(hex, sizeof(hex));
+	}
+	if (fclose(f) != 0 || rename(tmpname, fname) < 0) {
+		wpa_printf(MSG_INFO,
+			   "Failed to write WPA PSK cache file '%s': %s",
+			   fname, strerror(errno));
+		unlink(tmpname);
+		ret = -1;
+	}
+	os_free(tmpname);
+	return ret;
+}
+
+
+static int hostapd_psk_derive(struct hostapd_psk_derive *ctx,
+			      const char *fname, const char *cache_fname)
+{
+	struct hostapd_psk_cache_entry *cache = NULL, *entry;
+	size_t i, cache_count = 0, cached = 0;
+	unsigned int threads = 1;
+	struct os_reltime start, now, diff;
+
+	if (!ctx->num_jobs)
+		return 0;
+
+	os_get_reltime(&start);
+
+	if (cache_fname) {
+		cache = hostapd_psk_cache_read(cache_fname, ctx->cache_salt,
+					       &cache_count);
+		if (!cache &&
+		    os_get_random(ctx->cache_salt,
+				  sizeof(ctx->cache_salt)) < 0) {
+			wpa_printf(MSG_INFO,
+				   "Could not generate salt for WPA PSK cache file '%s'",
+				   cache_fname);
+			cache_fname = NULL;
+		}
+	}
+
+	if (cache_fname) {
+		for (i = 0; i < ctx->num_jobs; i++) {
+			struct hostapd_psk_job *job = &ctx->jobs[i];
+
+			if (hostapd_psk_cache_key(ctx, job->passphrase,
+						  job->key) < 0) {
+				bin_clear_free(cache,
+					       cache_count * sizeof(*cache));
+				cache = NULL;
+				cache_count = 0;
+				cache_fname = NULL;
+				break;
+			}
+			if (!cache)
+				continue;
+			entry = bsearch(job->key, cache, cache_count,
+					sizeof(*cache), hostapd_psk_cache_cmp);
+			if (entry) {
+				os_memcpy(job->psk->psk, entry->pmk, PMK_LEN);
+				job->derived = 1;
+				cached++;
+			}
+		}
+		bin_clear_free(cache, cache_count * sizeof(*cache));
+	}
+
+	ctx->next_job = 0;
+#ifdef CONFIG_WPA_PSK_THREADS
+	if (ctx->num_jobs - cached > 1)
+		threads = hostapd_psk_derive_threads(ctx,
+						     ctx->num_jobs - cached);
+	else
+#endif /* CONFIG_WPA_PSK_THREADS */
+		hostapd_psk_derive_run(ctx);
+
+	for (i = 0; i < ctx->num_jobs; i++) {
+		if (!ctx->jobs[i].derived) {
+			wpa_printf(MSG_ERROR,
+				   "Failed to derive PSK from the passphrase on line %d in '%s'",
+				   ctx->jobs[i].line, fname);
+			return -1;
+		}
+	}
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, &start, &diff);
+	wpa_printf(MSG_DEBUG,
+		   "WPA PSK file: %u passphrase(s) (%u from cache) derived in %ld.%06ld s using %u thread(s)",
+		   (unsigned int) ctx->num_jobs, (unsigned int) cached,
+		   (long) diff.sec, (long) diff.usec, threads);
+
+	/* Rewrite the cache when entries were added or have become stale */
+	if (cache_fname &&
+	    (cached != ctx->num_jobs || cache_count != ctx->num_jobs))
+		hostapd_psk_cache_write(cache_fname, ctx);
+
+	return 0;
+}
+
+
 static int hostapd_config_read_wpa_psk(const char *fname,
 				       struct hostapd_ssid *ssid)
 {
@@ -316,13 +693,19 @@ static int hostapd_config_read_wpa_psk(const char *fname,
 	char *token;
 	char *name;
 	char *value;
-	int line = 0, ret = 0, len, ok;
+	int line = 0, ret = 0, len, ok, derive;
 	u8 addr[ETH_ALEN];
 	struct hostapd_wpa_psk *psk;
+	struct hostapd_psk_derive ctx;
 
 	if (!fname)
 		return 0;
 
+	/* Passphrases are collected while parsing the file and the PSKs are
+	 * derived for all of them at the end since that is the slow part */
+	os_memset(&ctx, 0, sizeof(ctx));
+	ctx.ssid = ssid;
+
 	f = fopen(fname, "r");
 	if (!f) {
 		wpa_printf(MSG_ERROR, "WPA PSK file '%s' not found.", fname);
@@ -410,14 +793,13 @@ static int hostapd_config_read_wpa_psk(const char *fname,
 		}
 
 		ok = 0;
+		derive = 0;
 		len = os_strlen(pos);
 		if (len == 2 * PMK_LEN &&
 		    hexstr2bin(pos, psk->psk, PMK_LEN) == 0)
 			ok = 1;
-		else if (len >= 8 && len < 64 &&
-			 pbkdf2_sha1(pos, ssid->ssid, ssid->ssid_len,
-				     4096, psk->psk, PMK_LEN) == 0)
-			ok = 1;
+		else if (len >= 8 && len < 64)
+			ok = derive = 1;
 		if (!ok) {
 			wpa_printf(MSG_ERROR,
 				   "Invalid PSK '%s' on line %d in '%s'",
@@ -441,11 +823,24 @@ static int hostapd_config_read_wpa_psk(const char *fname,
 
 		psk->wps = wps;
 
+		if (derive && hostapd_psk_job_add(&ctx, psk, pos, line) < 0) {
+			wpa_printf(MSG_ERROR, "WPA PSK allocation failed");
+			os_free(psk);
+			ret = -1;
+			break;
+		}
+
 		psk->next = ssid->wpa_psk;
 		ssid->wpa_psk = psk;
 	}
 
 	fclose(f);
+	forced_memzero(buf, sizeof(buf));
+
+	if (ret == 0 &&
+	    hostapd_psk_derive(&ctx, fname, ssid->wpa_psk_cache_file) < 0)
+		ret = -1;
+	hostapd_psk_derive_free(&ctx);
 
 	return ret;
 }
@@ -769,6 +1164,11 @@ void hostapd_config_free_bss(struct hostapd_bss_config *conf)
 
 	str_clear_free(conf->ssid.wpa_passphrase);
 	os_free(conf->ssid.wpa_psk_file);
+	os_free(conf->ssid.wpa_psk_cache_file);
+#ifdef CONFIG_PMK_STORE
+	os_free(conf->pmk_store);
+	forced_memzero(conf->pmk_store_key, sizeof(conf->pmk_store_key));
+#endif /* CONFIG_PMK_STORE */
 #ifdef CONFIG_WEP
 	hostapd_config_free_wep(&conf->ssid.wep);
 #endif /* CONFIG_WEP */
@@ -1144,6 +1544,42 @@ const u8 * hostapd_get_psk(const struct hostapd_bss_config *conf,
 }
 
 
+/**
+ * hostapd_get_psk_entry - Get the next PSK entry for a station
+ * @conf: BSS configuration
+ * @addr: Station MAC address
+ * @p2p_dev_addr: P2P Device Address of the station or %NULL
+ * @prev: Previously returned entry or %NULL to start from the beginning
+ * Returns: Next matching entry in conf->ssid.wpa_psk or %NULL if none
+ *
+ * This is like hostapd_get_psk(), but continues directly from the previous
+ * entry instead of having to search for it from the beginning of the list, so
+ * iterating over all matching entries is linear in the length of the list.
+ * @prev must be an entry of the current list.
+ */
+const struct hostapd_wpa_psk *
+hostapd_get_psk_entry(const struct hostapd_bss_config *conf,
+		      const u8 *addr, const u8 *p2p_dev_addr,
+		      const struct hostapd_wpa_psk *prev)
+{
+	const struct hostapd_wpa_psk *psk;
+
+	if (p2p_dev_addr && !is_zero_ether_addr(p2p_dev_addr))
+		addr = NULL; /* Use P2P Device Address for matching */
+
+	for (psk = prev ? prev->next : conf->ssid.wpa_psk; psk;
+	     psk = psk->next) {
+		if (psk->group ||
+		    (addr && os_memcmp(psk->addr, addr, ETH_ALEN) == 0) ||
+		    (!addr && p2p_dev_addr &&
+		     os_memcmp(psk->p2p_dev_addr, p2p_dev_addr, ETH_ALEN) == 0))
+			return psk;
+	}
+
+	return NULL;
+}
+
+
 #ifdef CONFIG_SAE_PK
 static bool hostapd_sae_pk_password_without_pk(struct hostapd_bss_config *bss)
 {
@@ -1271,6 +1707,14 @@ static int hostapd_config_check_bss(struct hostapd_bss_config *bss,
 		return -1;
 	}
 
+#ifdef CONFIG_PMK_STORE
+	if (full_config && bss->pmk_store && !bss->pmk_store_key_set) {
+		wpa_printf(MSG_ERROR,
+			   "pmk_store requires pmk_store_key to be set");
+		return -1;
+	}
+#endif /* CONFIG_PMK_STORE */
+
 	if (full_config && !is_zero_ether_addr(bss->bssid)) {
 		size_t i;
 
@@ -111,6 +111,7 @@ struct hostapd_ssid {
 	struct hostapd_wpa_psk *wpa_psk;
 	char *wpa_passphrase;
 	char *wpa_psk_file;
+	char *wpa_psk_cache_file;
 	struct sae_pt *pt;
 
 #ifdef CONFIG_WEP
@@ -302,6 +303,8 @@ struct hostapd_bss_config {
 			 * RADIUS server */
 	struct hostapd_eap_user *eap_user;
 	char *eap_user_sqlite;
+	unsigned int eap_user_sqlite_cache;
+	unsigned int eap_user_sqlite_cache_ttl;
 	char *eap_sim_db;
 	unsigned int eap_sim_db_timeout;
 	int eap_server_erp; /* Whether ERP is enabled on internal EAP server */
@@ -309,6 +312,7 @@ struct hostapd_bss_config {
 	char *nas_identifier;
 	struct hostapd_radius_servers *radius;
 	int acct_interim_interval;
+	int acct_batch_interval; /* batched accounting updates; 0 = disabled */
 	int radius_request_cui;
 	struct hostapd_radius_attr *radius_auth_req_attr;
 	struct hostapd_radius_attr *radius_acct_req_attr;
@@ -454,6 +458,7 @@ struct hostapd_bss_config {
 	int radius_server_auth_port;
 	int radius_server_acct_port;
 	int radius_server_ipv6;
+	int radius_server_threads;
 
 	int use_pae_group_addr; /* Whether to send EAPOL frames to PAE group
 				 * address instead of individual address
@@ -480,6 +485,12 @@ struct hostapd_bss_config {
 
 	int disable_pmksa_caching;
 	int okc; /* Opportunistic Key Caching */
+#ifdef CONFIG_PMK_STORE
+	char *pmk_store; /* file for persistent PMKSA and FT key cache */
+	u8 pmk_store_key[32];
+	int pmk_store_key_set;
+	unsigned int pmk_store_slots;
+#endif /* CONFIG_PMK_STORE */
 
 	int wps_state;
 #ifdef CONFIG_WPS
@@ -670,6 +681,7 @@ struct hostapd_bss_config {
 	unsigned int sae_sync;
 	int sae_require_mfp;
 	int sae_confirm_immediate;
+	int sae_worker_threads;
 	enum sae_pwe sae_pwe;
 	int *sae_groups;
 	struct sae_password_entry *sae_passwords;
@@ -1252,6 +1264,10 @@ int hostapd_rate_found(int *list, int rate);
 const u8 * hostapd_get_psk(const struct hostapd_bss_config *conf,
 			   const u8 *addr, const u8 *p2p_dev_addr,
 			   const u8 *prev_psk, int *vlan_id);
+const struct hostapd_wpa_psk *
+hostapd_get_psk_entry(const struct hostapd_bss_config *conf,
+		      const u8 *addr, const u8 *p2p_dev_addr,
+		      const struct hostapd_wpa_psk *prev);
 int hostapd_setup_wpa_psk(struct hostapd_bss_config *conf);
 int hostapd_vlan_valid(struct hostapd_vlan *vlan,
 		       struct vlan_description *vlan_desc);
@@ -22,6 +22,7 @@
 #include "hs20.h"
 #include "wpa_auth.h"
 #include "ap_drv_ops.h"
+#include "beacon.h"
 
 
 u32 hostapd_sta_flags_to_drv(u32 flags)
@@ -241,6 +242,8 @@ int hostapd_set_ap_wps_ie(struct hostapd_data *hapd)
 	struct wpabuf *beacon, *proberesp, *assocresp;
 	int ret;
 
+	hostapd_invalidate_probe_resp_tmpl();
+
 	if (hapd->driver == NULL || hapd->driver->set_ap_wps_ie == NULL)
 		return 0;
 
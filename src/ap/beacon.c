@@ -34,6 +34,38 @@
 #include "ieee802_11_auth.h"
 
 
+/*
+ * Generation counter for the cached Probe Response frames. The frames contain
+ * elements from several BSSs (e.g., Multiple BSSID and Reduced Neighbor Report
+ * elements), so any Beacon frame update or configuration change invalidates
+ * the cached frames of all BSSs.
+ */
+static unsigned int probe_resp_tmpl_gen;
+
+
+/**
+ * hostapd_invalidate_probe_resp_tmpl - Invalidate cached Probe Response frames
+ *
+ * This needs to be called whenever something that affects the contents of the
+ * Probe Response frames changes without a Beacon frame update.
+ */
+void hostapd_invalidate_probe_resp_tmpl(void)
+{
+	probe_resp_tmpl_gen++;
+}
+
+
+void hostapd_free_probe_resp_tmpl(struct hostapd_data *hapd)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(hapd->probe_resp_tmpl); i++) {
+		os_free(hapd->probe_resp_tmpl[i].buf);
+		hapd->probe_resp_tmpl[i].buf = NULL;
+	}
+}
+
+
 #ifdef NEED_AP_MLME
 
 static u8 * hostapd_eid_bss_load(struct hostapd_data *hapd, u8 *eid, size_t len)
@@ -792,6 +824,56 @@ enum ssid_match_result {
 	CO_LOCATED_SSID_MATCH,
 };
 
+/*
+ * Return a Probe Response frame to @req from the cached frame of the
+ * transmitting BSS, rebuilding it if it has been invalidated. The returned
+ * buffer is owned by the cache and is valid until the next call.
+ */
+static u8 * hostapd_probe_resp_tmpl(struct hostapd_data *hapd,
+				    const struct ieee80211_mgmt *req,
+				    int is_p2p, size_t *resp_len)
+{
+	struct hostapd_data *tx_bss = hostapd_mbssid_get_tx_bss(hapd);
+	struct hostapd_probe_resp_tmpl *tmpl;
+	struct ieee80211_mgmt *resp;
+	const u8 *ie;
+
+	tmpl = &tx_bss->probe_resp_tmpl[!!is_p2p];
+	if (tmpl->buf && tmpl->gen == probe_resp_tmpl_gen) {
+		hapd->probe_resp_tmpl_hits++;
+	} else {
+		hapd->probe_resp_tmpl_misses++;
+		os_free(tmpl->buf);
+		tmpl->buf = hostapd_gen_probe_resp(hapd, NULL, is_p2p,
+						   &tmpl->len, false, NULL, 0);
+		if (!tmpl->buf)
+			return NULL;
+		tmpl->gen = probe_resp_tmpl_gen;
+
+		/* The Station Count in the BSS Load element changes without a
+		 * Beacon frame update, so it is filled in for each request. */
+		tmpl->bss_load_off = 0;
+		ie = get_ie(tmpl->buf + IEEE80211_HDRLEN + sizeof(resp->u.probe_resp),
+			    tmpl->len - IEEE80211_HDRLEN -
+			    sizeof(resp->u.probe_resp), WLAN_EID_BSS_LOAD);
+		if (ie && ie[1] >= 2 && tx_bss->conf->bss_load_update_period
+#ifdef CONFIG_TESTING_OPTIONS
+		    && !tx_bss->conf->bss_load_test_set
+#endif /* CONFIG_TESTING_OPTIONS */
+			)
+			tmpl->bss_load_off = ie + 2 - tmpl->buf;
+	}
+
+	resp = (struct ieee80211_mgmt *) tmpl->buf;
+	os_memcpy(resp->da, req->sa, ETH_ALEN);
+	if (tmpl->bss_load_off)
+		WPA_PUT_LE16(tmpl->buf + tmpl->bss_load_off, tx_bss->num_sta);
+
+	*resp_len = tmpl->len;
+	return tmpl->buf;
+}
+
+
 static enum ssid_match_result ssid_match(struct hostapd_data *hapd,
 					 const u8 *ssid, size_t ssid_len,
 					 const u8 *ssid_list,
@@ -866,6 +948,92 @@ static enum ssid_match_result ssid_match(struct hostapd_data *hapd,
 }
 
 
+static unsigned int sta_track_hash(struct hostapd_iface *iface,
+				   const u8 *addr)
+{
+	return siphash24(iface->sta_seen_hash_key, addr, ETH_ALEN) &
+		(iface->sta_seen_hash_size - 1);
+}
+
+
+static void sta_track_hash_resize(struct hostapd_iface *iface,
+				  unsigned int size)
+{
+	struct hostapd_sta_info **hash, *info, *next;
+	unsigned int i, old_size = iface->sta_seen_hash_size;
+
+	hash = os_calloc(size, sizeof(*hash));
+	if (!hash)
+		return; /* continue with longer hash chains */
+
+	iface->sta_seen_hash_size = size;
+	for (i = 0; i < old_size; i++) {
+		for (info = iface->sta_seen_hash[i]; info; info = next) {
+			unsigned int idx = sta_track_hash(iface, info->addr);
+
+			next = info->hnext;
+			info->hnext = hash[idx];
+			hash[idx] = info;
+		}
+	}
+	os_free(iface->sta_seen_hash);
+	iface->sta_seen_hash = hash;
+
+	wpa_printf(MSG_DEBUG, "%s: STA tracking hash table resized to %u buckets",
+		   iface->bss[0]->conf->iface, size);
+}
+
+
+static int sta_track_hash_add(struct hostapd_iface *iface,
+			      struct hostapd_sta_info *info)
+{
+	unsigned int idx, max_size;
+
+	if (!iface->sta_seen_hash) {
+		if (os_get_random(iface->sta_seen_hash_key,
+				  sizeof(iface->sta_seen_hash_key)) < 0) {
+			wpa_printf(MSG_INFO,
+				   "Could not get random STA tracking hash key");
+			os_memset(iface->sta_seen_hash_key, 0,
+				  sizeof(iface->sta_seen_hash_key));
+		}
+		iface->sta_seen_hash_size = 0;
+		sta_track_hash_resize(iface, STA_HASH_SIZE);
+		if (!iface->sta_seen_hash)
+			return -1;
+	} else if (iface->num_sta_seen >= iface->sta_seen_hash_size) {
+		/* No need to grow beyond the configured number of entries */
+		max_size = STA_HASH_SIZE;
+		while (max_size < iface->conf->track_sta_max_num &&
+		       max_size < STA_HASH_MAX_SIZE)
+			max_size *= 2;
+		if (iface->sta_seen_hash_size < max_size)
+			sta_track_hash_resize(iface,
+					      iface->sta_seen_hash_size * 2);
+	}
+
+	idx = sta_track_hash(iface, info->addr);
+	info->hnext = iface->sta_seen_hash[idx];
+	iface->sta_seen_hash[idx] = info;
+	return 0;
+}
+
+
+static void sta_track_hash_del(struct hostapd_iface *iface,
+			       struct hostapd_sta_info *info)
+{
+	struct hostapd_sta_info **s;
+
+	for (s = &iface->sta_seen_hash[sta_track_hash(iface, info->addr)]; *s;
+	     s = &(*s)->hnext) {
+		if (*s == info) {
+			*s = info->hnext;
+			return;
+		}
+	}
+}
+
+
 void sta_track_expire(struct hostapd_iface *iface, int force)
 {
 	struct os_reltime now;
@@ -887,6 +1055,7 @@ void sta_track_expire(struct hostapd_iface *iface, int force)
 			   MACSTR, iface->bss[0]->conf->iface,
 			   MAC2STR(info->addr));
 		dl_list_del(&info->list);
+		sta_track_hash_del(iface, info);
 		iface->num_sta_seen--;
 		sta_track_del(info);
 	}
@@ -898,11 +1067,14 @@ static struct hostapd_sta_info * sta_track_get(struct hostapd_iface *iface,
 {
 	struct hostapd_sta_info *info;
 
-	dl_list_for_each(info, &iface->sta_seen, struct hostapd_sta_info, list)
-		if (os_memcmp(addr, info->addr, ETH_ALEN) == 0)
-			return info;
+	if (!iface->sta_seen_hash)
+		return NULL;
+
+	info = iface->sta_seen_hash[sta_track_hash(iface, addr)];
+	while (info && os_memcmp(addr, info->addr, ETH_ALEN) != 0)
+		info = info->hnext;
 
-	return NULL;
+	return info;
 }
 
 
@@ -933,6 +1105,11 @@ void sta_track_add(struct hostapd_iface *iface, const u8 *addr, int ssi_signal)
 		sta_track_expire(iface, 1);
 	}
 
+	if (sta_track_hash_add(iface, info) < 0) {
+		os_free(info);
+		return;
+	}
+
 	wpa_printf(MSG_MSGDUMP, "%s: Add STA tracking entry for "
 		   MACSTR, iface->bss[0]->conf->iface, MAC2STR(addr));
 	dl_list_add_tail(&iface->sta_seen, &info->list);
@@ -1229,9 +1406,16 @@ void handle_probe_req(struct hostapd_data *hapd,
 	wpa_msg_ctrl(hapd->msg_ctx, MSG_INFO, RX_PROBE_REQUEST "sa=" MACSTR
 		     " signal=%d", MAC2STR(mgmt->sa), ssi_signal);
 
-	resp = hostapd_gen_probe_resp(hapd, mgmt, elems.p2p != NULL,
-				      &resp_len, false, elems.mbssid_known_bss,
-				      elems.mbssid_known_bss_len);
+	/* Known BSS lists vary between requests, so use the cached frame only
+	 * when the full Multiple BSSID element is sent. */
+	if (elems.mbssid_known_bss_len)
+		resp = hostapd_gen_probe_resp(hapd, mgmt, elems.p2p != NULL,
+					      &resp_len, false,
+					      elems.mbssid_known_bss,
+					      elems.mbssid_known_bss_len);
+	else
+		resp = hostapd_probe_resp_tmpl(hapd, mgmt, elems.p2p != NULL,
+					       &resp_len);
 	if (resp == NULL)
 		return;
 
@@ -1261,7 +1445,8 @@ void handle_probe_req(struct hostapd_data *hapd,
 	if (ret < 0)
 		wpa_printf(MSG_INFO, "handle_probe_req: send failed");
 
-	os_free(resp);
+	if (elems.mbssid_known_bss_len)
+		os_free(resp);
 
 	wpa_printf(MSG_EXCESSIVE, "STA " MACSTR " sent probe request for %s "
 		   "SSID", MAC2STR(mgmt->sa),
@@ -1605,6 +1790,7 @@ int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 #endif /* NEED_AP_MLME */
 
 	os_memset(params, 0, sizeof(*params));
+	hostapd_invalidate_probe_resp_tmpl();
 
 #ifdef NEED_AP_MLME
 #define BEACON_HEAD_BUF_SIZE 256
@@ -18,6 +18,8 @@ void handle_probe_req(struct hostapd_data *hapd,
 int ieee802_11_set_beacon(struct hostapd_data *hapd);
 int ieee802_11_set_beacons(struct hostapd_iface *iface);
 int ieee802_11_update_beacons(struct hostapd_iface *iface);
+void hostapd_invalidate_probe_resp_tmpl(void);
+void hostapd_free_probe_resp_tmpl(struct hostapd_data *hapd);
 int ieee802_11_build_ap_params(struct hostapd_data *hapd,
 			       struct wpa_driver_ap_params *params);
 void ieee802_11_free_ap_params(struct wpa_driver_ap_params *params);
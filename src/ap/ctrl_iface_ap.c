@@ -876,13 +876,17 @@ int hostapd_ctrl_iface_status(struct hostapd_data *hapd, char *buf,
 				  "bss[%d]=%s\n"
 				  "bssid[%d]=" MACSTR "\n"
 				  "ssid[%d]=%s\n"
-				  "num_sta[%d]=%d\n",
+				  "num_sta[%d]=%d\n"
+				  "probe_resp_tmpl_hits[%d]=%u\n"
+				  "probe_resp_tmpl_misses[%d]=%u\n",
 				  (int) i, bss->conf->iface,
 				  (int) i, MAC2STR(bss->own_addr),
 				  (int) i,
 				  wpa_ssid_txt(bss->conf->ssid.ssid,
 					       bss->conf->ssid.ssid_len),
-				  (int) i, bss->num_sta);
+				  (int) i, bss->num_sta,
+				  (int) i, bss->probe_resp_tmpl_hits,
+				  (int) i, bss->probe_resp_tmpl_misses);
 		if (os_snprintf_error(buflen - len, ret))
 			return len;
 		len += ret;
@@ -897,6 +901,33 @@ int hostapd_ctrl_iface_status(struct hostapd_data *hapd, char *buf,
 		len += ret;
 	}
 
+	if (iface->conf->track_sta_max_num) {
+		unsigned int used = 0, max_chain = 0, chain;
+		struct hostapd_sta_info *info;
+
+		for (i = 0; i < iface->sta_seen_hash_size; i++) {
+			chain = 0;
+			for (info = iface->sta_seen_hash[i]; info;
+			     info = info->hnext)
+				chain++;
+			if (chain)
+				used++;
+			if (chain > max_chain)
+				max_chain = chain;
+		}
+
+		ret = os_snprintf(buf + len, buflen - len,
+				  "num_sta_seen=%u\n"
+				  "sta_seen_hash_used=%u/%u\n"
+				  "sta_seen_hash_max_chain=%u\n",
+				  iface->num_sta_seen, used,
+				  iface->sta_seen_hash_size,
+				  max_chain);
+		if (os_snprintf_error(buflen - len, ret))
+			return len;
+		len += ret;
+	}
+
 	return len;
 }
 
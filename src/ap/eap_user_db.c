@@ -8,10 +8,13 @@
 
 #include "includes.h"
 #ifdef CONFIG_SQLITE
+#include <sys/stat.h>
 #include <sqlite3.h>
 #endif /* CONFIG_SQLITE */
 
 #include "common.h"
+#include "utils/list.h"
+#include "utils/siphash.h"
 #include "eap_common/eap_wsc_common.h"
 #include "eap_server/eap_methods.h"
 #include "eap_server/eap.h"
@@ -131,15 +134,366 @@ static int get_wildcard_cb(void *ctx, int argc, char *argv[], char *col[])
 }
 
 
+/* Seconds between the checks for database changes */
+#define EAP_USER_DB_CHECK_INTERVAL 1
+
+struct eap_user_db_entry {
+	struct dl_list list; /* LRU order, most recently used first */
+	struct eap_user_db_entry *hnext;
+	struct os_reltime added;
+	u8 *key;
+	size_t key_len;
+	int phase2;
+	bool found;
+	struct hostapd_eap_user user;
+};
+
+struct eap_user_db {
+	sqlite3 *db;
+	sqlite3_stmt *user_stmt;
+	sqlite3_stmt *wildcard_stmt;
+	sqlite3_stmt *version_stmt;
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	int data_version;
+	struct os_reltime last_check;
+
+	/* Cache of the lookup results; the hash table uses a keyed hash since
+	 * the identities are selected by the peers. */
+	struct dl_list cache; /* struct eap_user_db_entry::list */
+	struct eap_user_db_entry **hash;
+	unsigned int hash_size;
+	unsigned int num_entries;
+	u8 hash_key[SIPHASH_KEY_LEN];
+};
+
+
+static int eap_user_db_step(sqlite3_stmt *stmt,
+			    int (*cb)(void *ctx, int argc, char *argv[],
+				      char *col[]),
+			    void *ctx)
+{
+	char **argv;
+	int argc, i, res;
+
+	argc = sqlite3_column_count(stmt);
+	argv = os_calloc(argc + 1, 2 * sizeof(char *));
+	if (!argv) {
+		sqlite3_reset(stmt);
+		return -1;
+	}
+
+	while ((res = sqlite3_step(stmt)) == SQLITE_ROW) {
+		for (i = 0; i < argc; i++) {
+			argv[i] = (char *) sqlite3_column_text(stmt, i);
+			argv[argc + i] = (char *) sqlite3_column_name(stmt, i);
+		}
+		cb(ctx, argc, argv, &argv[argc]);
+	}
+
+	os_free(argv);
+	sqlite3_reset(stmt);
+	return res == SQLITE_DONE ? 0 : -1;
+}
+
+
+static void eap_user_db_copy(struct hostapd_eap_user *dst,
+			     const struct hostapd_eap_user *src)
+{
+	*dst = *src;
+	if (src->identity)
+		dst->identity = (u8 *) dup_binstr(src->identity,
+						  src->identity_len);
+	if (src->password)
+		dst->password = (u8 *) dup_binstr(src->password,
+						  src->password_len);
+	if ((src->identity && !dst->identity) ||
+	    (src->password && !dst->password)) {
+		bin_clear_free(dst->identity, dst->identity_len);
+		bin_clear_free(dst->password, dst->password_len);
+		os_memset(dst, 0, sizeof(*dst));
+	}
+}
+
+
+static unsigned int eap_user_db_hash(struct eap_user_db *db, const u8 *key,
+				     size_t key_len)
+{
+	return siphash24(db->hash_key, key, key_len) & (db->hash_size - 1);
+}
+
+
+static void eap_user_db_cache_del(struct eap_user_db *db,
+				  struct eap_user_db_entry *entry)
+{
+	struct eap_user_db_entry **pos;
+
+	pos = &db->hash[eap_user_db_hash(db, entry->key, entry->key_len)];
+	for (; *pos; pos = &(*pos)->hnext) {
+		if (*pos == entry) {
+			*pos = entry->hnext;
+			break;
+		}
+	}
+	dl_list_del(&entry->list);
+	db->num_entries--;
+
+	bin_clear_free(entry->user.identity, entry->user.identity_len);
+	bin_clear_free(entry->user.password, entry->user.password_len);
+	os_free(entry->key);
+	os_free(entry);
+}
+
+
+static void eap_user_db_cache_flush(struct eap_user_db *db)
+{
+	struct eap_user_db_entry *entry;
+
+	while ((entry = dl_list_first(&db->cache, struct eap_user_db_entry,
+				      list)))
+		eap_user_db_cache_del(db, entry);
+}
+
+
+static struct eap_user_db_entry *
+eap_user_db_cache_get(struct eap_user_db *db, const u8 *identity,
+		      size_t identity_len, int phase2, unsigned int ttl)
+{
+	struct eap_user_db_entry *entry;
+	struct os_reltime now;
+
+	entry = db->hash[eap_user_db_hash(db, identity, identity_len)];
+	for (; entry; entry = entry->hnext) {
+		if (entry->phase2 == phase2 &&
+		    entry->key_len == identity_len &&
+		    os_memcmp(entry->key, identity, identity_len) == 0)
+			break;
+	}
+	if (!entry)
+		return NULL;
+
+	os_get_reltime(&now);
+	if (os_reltime_expired(&now, &entry->added, ttl)) {
+		eap_user_db_cache_del(db, entry);
+		return NULL;
+	}
+
+	dl_list_del(&entry->list);
+	dl_list_add(&db->cache, &entry->list);
+	return entry;
+}
+
+
+static void eap_user_db_cache_add(struct eap_user_db *db, unsigned int size,
+				  const u8 *identity, size_t identity_len,
+				  int phase2, const struct hostapd_eap_user *user)
+{
+	struct eap_user_db_entry *entry;
+	unsigned int hash;
+
+	if (!size)
+		return;
+
+	while (db->num_entries >= size) {
+		entry = dl_list_last(&db->cache, struct eap_user_db_entry,
+				     list);
+		eap_user_db_cache_del(db, entry);
+	}
+
+	entry = os_zalloc(sizeof(*entry));
+	if (!entry)
+		return;
+	entry->key = os_memdup(identity, identity_len);
+	if (!entry->key) {
+		os_free(entry);
+		return;
+	}
+	entry->key_len = identity_len;
+	entry->phase2 = phase2;
+	os_get_reltime(&entry->added);
+	if (user) {
+		eap_user_db_copy(&entry->user, user);
+		if (!entry->user.next) {
+			os_free(entry->key);
+			os_free(entry);
+			return;
+		}
+		entry->found = true;
+	}
+
+	hash = eap_user_db_hash(db, identity, identity_len);
+	entry->hnext = db->hash[hash];
+	db->hash[hash] = entry;
+	dl_list_add(&db->cache, &entry->list);
+	db->num_entries++;
+}
+
+
+static int eap_user_db_data_version(struct eap_user_db *db)
+{
+	int version = -1;
+
+	if (sqlite3_step(db->version_stmt) == SQLITE_ROW)
+		version = sqlite3_column_int(db->version_stmt, 0);
+	sqlite3_reset(db->version_stmt);
+	return version;
+}
+
+
+static void eap_user_db_close(struct eap_user_db *db)
+{
+	if (!db)
+		return;
+	eap_user_db_cache_flush(db);
+	sqlite3_finalize(db->user_stmt);
+	sqlite3_finalize(db->wildcard_stmt);
+	sqlite3_finalize(db->version_stmt);
+	sqlite3_close(db->db);
+	os_free(db->hash);
+	os_free(db->path);
+	os_free(db);
+}
+
+
+static int eap_user_db_prepare(struct eap_user_db *db, const char *sql,
+			       sqlite3_stmt **stmt)
+{
+	if (sqlite3_prepare_v2(db->db, sql, -1, stmt, NULL) != SQLITE_OK) {
+		wpa_printf(MSG_DEBUG, "DB: Failed to prepare '%s': %s  db: %s",
+			   sql, sqlite3_errmsg(db->db), db->path);
+		*stmt = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+
+static struct eap_user_db * eap_user_db_open(const char *path,
+					     unsigned int cache_size)
+{
+	struct eap_user_db *db;
+	struct stat st;
+
+	db = os_zalloc(sizeof(*db));
+	if (!db)
+		return NULL;
+	dl_list_init(&db->cache);
+	db->path = os_strdup(path);
+	db->hash_size = 16;
+	while (db->hash_size < cache_size / 2 && db->hash_size < 65536)
+		db->hash_size <<= 1;
+	db->hash = os_calloc(db->hash_size, sizeof(*db->hash));
+	if (!db->path || !db->hash ||
+	    os_get_random(db->hash_key, sizeof(db->hash_key)) < 0)
+		goto fail;
+
+	if (sqlite3_open_v2(path, &db->db, SQLITE_OPEN_READWRITE, NULL)) {
+		wpa_printf(MSG_INFO, "DB: Failed to open database %s: %s",
+			   path, sqlite3_errmsg(db->db));
+		goto fail;
+	}
+
+	/* WAL allows the database to be updated while it is kept open here
+	 * without blocking the lookups. This fails if the database is not
+	 * writable, in which case the current journal mode is used. */
+	if (sqlite3_exec(db->db, "PRAGMA journal_mode=WAL;", NULL, NULL,
+			 NULL) != SQLITE_OK)
+		wpa_printf(MSG_DEBUG, "DB: Could not enable WAL mode: %s",
+			   sqlite3_errmsg(db->db));
+
+	/* Missing tables are reported as failed lookups and the statements are
+	 * prepared again once the database has been modified. */
+	eap_user_db_prepare(db,
+			    "SELECT * FROM users WHERE identity=? AND phase2=?;",
+			    &db->user_stmt);
+	eap_user_db_prepare(db, "SELECT identity,methods FROM wildcards;",
+			    &db->wildcard_stmt);
+	if (eap_user_db_prepare(db, "PRAGMA data_version;",
+				&db->version_stmt) < 0)
+		goto fail;
+
+	if (stat(path, &st) == 0) {
+		db->dev = st.st_dev;
+		db->ino = st.st_ino;
+	}
+	db->data_version = eap_user_db_data_version(db);
+	os_get_reltime(&db->last_check);
+
+	wpa_printf(MSG_DEBUG, "DB: Opened EAP user database %s", path);
+	return db;
+
+fail:
+	eap_user_db_close(db);
+	return NULL;
+}
+
+
+static struct eap_user_db * eap_user_db_get(struct hostapd_data *hapd)
+{
+	const struct hostapd_bss_config *conf = hapd->conf;
+	struct eap_user_db *db = hapd->eap_user_db;
+	struct os_reltime now;
+	struct stat st;
+	int version;
+
+	if (db && os_strcmp(db->path, conf->eap_user_sqlite) != 0) {
+		/* Configuration was reloaded with another database */
+		eap_user_db_close(db);
+		db = hapd->eap_user_db = NULL;
+	}
+
+	if (db) {
+		os_get_reltime(&now);
+		if (!os_reltime_expired(&now, &db->last_check,
+					EAP_USER_DB_CHECK_INTERVAL))
+			return db;
+		db->last_check = now;
+
+		version = eap_user_db_data_version(db);
+		if (stat(db->path, &st) < 0 ||
+		    st.st_dev != db->dev || st.st_ino != db->ino) {
+			wpa_printf(MSG_DEBUG,
+				   "DB: EAP user database file %s was replaced - reopen",
+				   db->path);
+			eap_user_db_close(db);
+			db = hapd->eap_user_db = NULL;
+		} else if (version != db->data_version &&
+			   (!db->user_stmt || !db->wildcard_stmt)) {
+			wpa_printf(MSG_DEBUG,
+				   "DB: EAP user database %s was modified - reopen",
+				   db->path);
+			eap_user_db_close(db);
+			db = hapd->eap_user_db = NULL;
+		} else {
+			if (version != db->data_version) {
+				wpa_printf(MSG_DEBUG,
+					   "DB: EAP user database %s was modified - flush cache",
+					   db->path);
+				eap_user_db_cache_flush(db);
+				db->data_version = version;
+			}
+			return db;
+		}
+	}
+
+	hapd->eap_user_db = eap_user_db_open(conf->eap_user_sqlite,
+					     conf->eap_user_sqlite_cache);
+	return hapd->eap_user_db;
+}
+
+
 static const struct hostapd_eap_user *
 eap_user_sqlite_get(struct hostapd_data *hapd, const u8 *identity,
 		    size_t identity_len, int phase2)
 {
-	sqlite3 *db;
+	const struct hostapd_bss_config *conf = hapd->conf;
+	struct eap_user_db *db;
+	struct eap_user_db_entry *entry;
 	struct hostapd_eap_user *user = NULL;
-	char id_str[256], cmd[300];
+	bool failed = false;
+	char id_str[256];
 	size_t i;
-	int res;
 
 	if (identity_len >= sizeof(id_str)) {
 		wpa_printf(MSG_DEBUG, "%s: identity len too big: %d >= %d",
@@ -170,6 +524,24 @@ eap_user_sqlite_get(struct hostapd_data *hapd, const u8 *identity,
 	bin_clear_free(hapd->tmp_eap_user.password,
 		       hapd->tmp_eap_user.password_len);
 	os_memset(&hapd->tmp_eap_user, 0, sizeof(hapd->tmp_eap_user));
+
+	db = eap_user_db_get(hapd);
+	if (!db)
+		return NULL;
+
+	entry = eap_user_db_cache_get(db, identity, identity_len, phase2,
+				      conf->eap_user_sqlite_cache_ttl);
+	if (entry) {
+		wpa_printf(MSG_DEBUG, "DB: Cached result for identity '%s'%s",
+			   id_str, entry->found ? "" : " (not found)");
+		if (!entry->found)
+			return NULL;
+		eap_user_db_copy(&hapd->tmp_eap_user, &entry->user);
+		if (!hapd->tmp_eap_user.next)
+			return NULL;
+		return &hapd->tmp_eap_user;
+	}
+
 	hapd->tmp_eap_user.phase2 = phase2;
 	hapd->tmp_eap_user.identity = os_zalloc(identity_len + 1);
 	if (hapd->tmp_eap_user.identity == NULL)
@@ -177,38 +549,33 @@ eap_user_sqlite_get(struct hostapd_data *hapd, const u8 *identity,
 	os_memcpy(hapd->tmp_eap_user.identity, identity, identity_len);
 	hapd->tmp_eap_user.identity_len = identity_len;
 
-	if (sqlite3_open(hapd->conf->eap_user_sqlite, &db)) {
-		wpa_printf(MSG_INFO, "DB: Failed to open database %s: %s",
-			   hapd->conf->eap_user_sqlite, sqlite3_errmsg(db));
-		sqlite3_close(db);
-		return NULL;
-	}
-
-	res = os_snprintf(cmd, sizeof(cmd),
-			  "SELECT * FROM users WHERE identity='%s' AND phase2=%d;",
-			  id_str, phase2);
-	if (os_snprintf_error(sizeof(cmd), res))
-		goto fail;
-
-	wpa_printf(MSG_DEBUG, "DB: %s", cmd);
-	if (sqlite3_exec(db, cmd, get_user_cb, &hapd->tmp_eap_user, NULL) !=
-	    SQLITE_OK) {
+	wpa_printf(MSG_DEBUG,
+		   "DB: SELECT * FROM users WHERE identity='%s' AND phase2=%d;",
+		   id_str, phase2);
+	if (!db->user_stmt ||
+	    sqlite3_bind_text(db->user_stmt, 1, id_str, identity_len,
+			      SQLITE_STATIC) != SQLITE_OK ||
+	    sqlite3_bind_int(db->user_stmt, 2, phase2) != SQLITE_OK ||
+	    eap_user_db_step(db->user_stmt, get_user_cb,
+			     &hapd->tmp_eap_user) < 0) {
 		wpa_printf(MSG_DEBUG,
 			   "DB: Failed to complete SQL operation: %s  db: %s",
-			   sqlite3_errmsg(db), hapd->conf->eap_user_sqlite);
+			   sqlite3_errmsg(db->db), db->path);
+		failed = true;
 	} else if (hapd->tmp_eap_user.next)
 		user = &hapd->tmp_eap_user;
+	if (db->user_stmt)
+		sqlite3_clear_bindings(db->user_stmt);
 
 	if (user == NULL && !phase2) {
-		os_snprintf(cmd, sizeof(cmd),
-			    "SELECT identity,methods FROM wildcards;");
-		wpa_printf(MSG_DEBUG, "DB: %s", cmd);
-		if (sqlite3_exec(db, cmd, get_wildcard_cb, &hapd->tmp_eap_user,
-				 NULL) != SQLITE_OK) {
+		wpa_printf(MSG_DEBUG, "DB: SELECT identity,methods FROM wildcards;");
+		if (!db->wildcard_stmt ||
+		    eap_user_db_step(db->wildcard_stmt, get_wildcard_cb,
+				     &hapd->tmp_eap_user) < 0) {
 			wpa_printf(MSG_DEBUG,
 				   "DB: Failed to complete SQL operation: %s  db: %s",
-				   sqlite3_errmsg(db),
-				   hapd->conf->eap_user_sqlite);
+				   sqlite3_errmsg(db->db), db->path);
+			failed = true;
 		} else if (hapd->tmp_eap_user.next) {
 			user = &hapd->tmp_eap_user;
 			os_free(user->identity);
@@ -219,12 +586,20 @@ eap_user_sqlite_get(struct hostapd_data *hapd, const u8 *identity,
 		}
 	}
 
-fail:
-	sqlite3_close(db);
+	if (!failed)
+		eap_user_db_cache_add(db, conf->eap_user_sqlite_cache,
+				      identity, identity_len, phase2, user);
 
 	return user;
 }
 
+
+void hostapd_eap_user_db_deinit(struct hostapd_data *hapd)
+{
+	eap_user_db_close(hapd->eap_user_db);
+	hapd->eap_user_db = NULL;
+}
+
 #endif /* CONFIG_SQLITE */
 
 
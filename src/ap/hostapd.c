@@ -133,6 +133,11 @@ static void hostapd_reload_bss(struct hostapd_data *hapd)
 	if (!hapd->started)
 		return;
 
+#ifdef CONFIG_SAE_THREADS
+	/* Pending SAE jobs may use the old SAE password data */
+	auth_sae_workers_sync(hapd);
+#endif /* CONFIG_SAE_THREADS */
+
 	if (hapd->conf->wmm_enabled < 0)
 		hapd->conf->wmm_enabled = hapd->iconf->ieee80211n |
 			hapd->iconf->ieee80211ax;
@@ -455,6 +460,7 @@ void hostapd_free_hapd_data(struct hostapd_data *hapd)
 
 	wpabuf_free(hapd->time_adv);
 	hapd->time_adv = NULL;
+	hostapd_free_probe_resp_tmpl(hapd);
 
 #ifdef CONFIG_INTERWORKING
 	gas_serv_deinit(hapd);
@@ -471,6 +477,7 @@ void hostapd_free_hapd_data(struct hostapd_data *hapd)
 	bin_clear_free(hapd->tmp_eap_user.password,
 		       hapd->tmp_eap_user.password_len);
 	os_memset(&hapd->tmp_eap_user, 0, sizeof(hapd->tmp_eap_user));
+	hostapd_eap_user_db_deinit(hapd);
 #endif /* CONFIG_SQLITE */
 
 #ifdef CONFIG_MESH
@@ -499,6 +506,9 @@ void hostapd_free_hapd_data(struct hostapd_data *hapd)
 		}
 	}
 	eloop_cancel_timeout(auth_sae_process_commit, hapd, NULL);
+#ifdef CONFIG_SAE_THREADS
+	auth_sae_workers_deinit(hapd);
+#endif /* CONFIG_SAE_THREADS */
 #endif /* CONFIG_SAE */
 
 #ifdef CONFIG_IEEE80211AX
@@ -532,15 +542,15 @@ static void sta_track_deinit(struct hostapd_iface *iface)
 {
 	struct hostapd_sta_info *info;
 
-	if (!iface->num_sta_seen)
-		return;
-
 	while ((info = dl_list_first(&iface->sta_seen, struct hostapd_sta_info,
 				     list))) {
 		dl_list_del(&info->list);
 		iface->num_sta_seen--;
 		sta_track_del(info);
 	}
+	os_free(iface->sta_seen_hash);
+	iface->sta_seen_hash = NULL;
+	iface->sta_seen_hash_size = 0;
 }
 
 
@@ -16,6 +16,7 @@
 #include "common/defs.h"
 #include "common/dpp.h"
 #include "utils/list.h"
+#include "utils/siphash.h"
 #include "ap_config.h"
 #include "drivers/driver.h"
 
@@ -33,6 +34,7 @@ struct hostapd_data;
 struct sta_info;
 struct ieee80211_ht_capabilities;
 struct full_dynamic_vlan;
+struct worker_pool;
 enum wps_event;
 union wps_event_data;
 #ifdef CONFIG_MESH
@@ -171,7 +173,14 @@ struct hostapd_data {
 	struct sta_info *sta_list; /* STA info list head */
 #define STA_HASH_SIZE 256
 #define STA_HASH(sta) (sta[5])
-	struct sta_info *sta_hash[STA_HASH_SIZE];
+#define STA_HASH_MAX_SIZE 65536
+	/* Hash table of sta_list entries indexed with a keyed hash of the MAC
+	 * address. The table is allocated when the first entry is added and
+	 * doubled in size when there are more entries than buckets. */
+	struct sta_info **sta_hash;
+	unsigned int sta_hash_size; /* number of buckets; power of two */
+	unsigned int sta_hash_entries;
+	u8 sta_hash_key[SIPHASH_KEY_LEN];
 
 	/*
 	 * Bitfield for indicating which AIDs are allocated. Only AID values
@@ -192,6 +201,9 @@ struct hostapd_data {
 
 	struct radius_client_data *radius;
 	u64 acct_session_id;
+	/* Batched accounting updates (acct_batch_interval) */
+	unsigned int acct_batch_gen; /* station dump generation */
+	bool acct_batch_active; /* statistics from the dump can be used */
 	struct radius_das_data *radius_das;
 
 	struct hostapd_cached_radius_acl *acl_cache;
@@ -201,6 +213,12 @@ struct hostapd_data {
 	struct eapol_authenticator *eapol_auth;
 	struct eap_config *eap_cfg;
 
+	/* Position of the ongoing wpa_auth get_psk() iteration over
+	 * conf->ssid.wpa_psk; psk_iter_psk is only compared, never
+	 * dereferenced */
+	const struct hostapd_wpa_psk *psk_iter;
+	const u8 *psk_iter_psk;
+
 	struct rsn_preauth_interface *preauth_iface;
 	struct os_reltime michael_mic_failure;
 	int michael_mic_failures;
@@ -310,6 +328,18 @@ struct hostapd_data {
 	u64 color_collision_bitmap;
 #endif /* CONFIG_IEEE80211AX */
 
+	/* Probe Response frames built for the generic (non-P2P and P2P) case
+	 * of this BSS; only DA and the BSS Load station count are patched for
+	 * each request, see beacon.c */
+	struct hostapd_probe_resp_tmpl {
+		u8 *buf;
+		size_t len;
+		size_t bss_load_off; /* Station Count offset or 0 if not used */
+		unsigned int gen;
+	} probe_resp_tmpl[2];
+	unsigned int probe_resp_tmpl_hits;
+	unsigned int probe_resp_tmpl_misses;
+
 #ifdef CONFIG_P2P
 	struct p2p_data *p2p;
 	struct p2p_group *p2p_group;
@@ -340,6 +370,7 @@ struct hostapd_data {
 
 #ifdef CONFIG_SQLITE
 	struct hostapd_eap_user tmp_eap_user;
+	struct eap_user_db *eap_user_db;
 #endif /* CONFIG_SQLITE */
 
 #ifdef CONFIG_SAE
@@ -354,6 +385,9 @@ struct hostapd_data {
 	u16 comeback_pending_idx[COMEBACK_PENDING_IDX_SIZE];
 	int dot11RSNASAERetransPeriod; /* msec */
 	struct dl_list sae_commit_queue; /* struct hostapd_sae_commit_queue */
+#ifdef CONFIG_SAE_THREADS
+	struct worker_pool *sae_pool;
+#endif /* CONFIG_SAE_THREADS */
 #endif /* CONFIG_SAE */
 
 #ifdef CONFIG_TESTING_OPTIONS
@@ -455,6 +489,7 @@ struct hostapd_data {
 
 struct hostapd_sta_info {
 	struct dl_list list;
+	struct hostapd_sta_info *hnext; /* next entry in hash table list */
 	u8 addr[ETH_ALEN];
 	struct os_reltime last_seen;
 	int ssi_signal;
@@ -622,7 +657,13 @@ struct hostapd_iface {
 	void (*scan_cb)(struct hostapd_iface *iface);
 	int num_ht40_scan_tries;
 
-	struct dl_list sta_seen; /* struct hostapd_sta_info */
+	struct dl_list sta_seen; /* struct hostapd_sta_info; oldest first */
+	/* Hash table of sta_seen entries indexed with a keyed hash of the MAC
+	 * address; grown with the number of entries up to the power of two
+	 * covering track_sta_max_num */
+	struct hostapd_sta_info **sta_seen_hash;
+	unsigned int sta_seen_hash_size; /* number of buckets; power of two */
+	u8 sta_seen_hash_key[SIPHASH_KEY_LEN];
 	unsigned int num_sta_seen;
 
 	u8 dfs_domain;
@@ -725,6 +766,7 @@ void hostapd_acs_channel_selected(struct hostapd_data *hapd,
 const struct hostapd_eap_user *
 hostapd_get_eap_user(struct hostapd_data *hapd, const u8 *identity,
 		     size_t identity_len, int phase2);
+void hostapd_eap_user_db_deinit(struct hostapd_data *hapd);
 
 struct hostapd_data * hostapd_get_iface(struct hapd_interfaces *interfaces,
 					const char *ifname);
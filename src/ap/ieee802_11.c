@@ -12,6 +12,7 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/worker_pool.h"
 #include "crypto/crypto.h"
 #include "crypto/sha256.h"
 #include "crypto/sha384.h"
@@ -539,21 +540,20 @@ static const char * sae_get_password(struct hostapd_data *hapd,
 }
 
 
-static struct wpabuf * auth_build_sae_commit(struct hostapd_data *hapd,
-					     struct sta_info *sta, int update,
-					     int status_code)
+static const char * auth_sae_commit_password(struct hostapd_data *hapd,
+					     struct sta_info *sta,
+					     int status_code, int *use_pt,
+					     struct sae_password_entry **pw,
+					     struct sae_pt **pt,
+					     const struct sae_pk **pk)
 {
-	struct wpabuf *buf;
-	const char *password = NULL;
-	struct sae_password_entry *pw;
+	const char *password;
 	const char *rx_id = NULL;
-	int use_pt = 0;
-	struct sae_pt *pt = NULL;
-	const struct sae_pk *pk = NULL;
 
+	*use_pt = 0;
 	if (sta->sae->tmp) {
 		rx_id = sta->sae->tmp->pw_id;
-		use_pt = sta->sae->h2e;
+		*use_pt = sta->sae->h2e;
 #ifdef CONFIG_SAE_PK
 		os_memcpy(sta->sae->tmp->own_addr, hapd->own_addr, ETH_ALEN);
 		os_memcpy(sta->sae->tmp->peer_addr, sta->addr, ETH_ALEN);
@@ -561,19 +561,41 @@ static struct wpabuf * auth_build_sae_commit(struct hostapd_data *hapd,
 	}
 
 	if (rx_id && hapd->conf->sae_pwe != SAE_PWE_FORCE_HUNT_AND_PECK)
-		use_pt = 1;
+		*use_pt = 1;
 	else if (status_code == WLAN_STATUS_SUCCESS)
-		use_pt = 0;
+		*use_pt = 0;
 	else if (status_code == WLAN_STATUS_SAE_HASH_TO_ELEMENT ||
 		 status_code == WLAN_STATUS_SAE_PK)
-		use_pt = 1;
+		*use_pt = 1;
 
-	password = sae_get_password(hapd, sta, rx_id, &pw, &pt, &pk);
-	if (!password || (use_pt && !pt)) {
+	password = sae_get_password(hapd, sta, rx_id, pw, pt, pk);
+	if (!password || (*use_pt && !*pt)) {
 		wpa_printf(MSG_DEBUG, "SAE: No password available");
 		return NULL;
 	}
 
+	return password;
+}
+
+
+static struct wpabuf * auth_build_sae_commit(struct hostapd_data *hapd,
+					     struct sta_info *sta, int update,
+					     int status_code)
+{
+	struct wpabuf *buf;
+	const char *password;
+	struct sae_password_entry *pw;
+	const char *rx_id;
+	int use_pt;
+	struct sae_pt *pt = NULL;
+	const struct sae_pk *pk = NULL;
+
+	password = auth_sae_commit_password(hapd, sta, status_code, &use_pt,
+					    &pw, &pt, &pk);
+	if (!password)
+		return NULL;
+	rx_id = sta->sae->tmp ? sta->sae->tmp->pw_id : NULL;
+
 	if (update && use_pt &&
 	    sae_prepare_commit_pt(sta->sae, pt, hapd->own_addr, sta->addr,
 				  NULL, pk) < 0)
@@ -725,6 +747,12 @@ static int use_anti_clogging(struct hostapd_data *hapd)
 	}
 
 #ifdef CONFIG_SAE
+#ifdef CONFIG_SAE_THREADS
+	/* Commit messages being processed in worker threads will result in
+	 * open sessions once the processing has been completed. */
+	if (hapd->sae_pool)
+		open += worker_pool_pending(hapd->sae_pool);
+#endif /* CONFIG_SAE_THREADS */
 	/* In addition to already existing open SAE sessions, check whether
 	 * there are enough pending commit messages in the processing queue to
 	 * potentially result in too many open sessions. */
@@ -869,6 +897,247 @@ void sae_accept_sta(struct hostapd_data *hapd, struct sta_info *sta)
 }
 
 
+#ifdef CONFIG_SAE_THREADS
+
+/* Maximum number of Commit messages in flight per worker thread */
+#define SAE_JOBS_PER_THREAD 4
+
+struct sae_commit_job {
+	struct hostapd_data *hapd;
+	struct sta_info *sta; /* NULL if the STA entry was removed */
+	struct sae_data *sae;
+	u8 own_addr[ETH_ALEN];
+	u8 peer_addr[ETH_ALEN];
+	u8 bssid[ETH_ALEN];
+	char *password;
+	struct sae_pt *pt;
+	const struct sae_pk *pk;
+	int use_pt;
+	int update;
+	u16 status_code;
+	bool prepare_failed;
+	bool process_failed;
+};
+
+static void auth_sae_schedule_queue(struct hostapd_data *hapd,
+				    unsigned int queue_len);
+
+
+static void auth_sae_commit_job_free(struct sae_commit_job *job)
+{
+	str_clear_free(job->password);
+	os_free(job);
+}
+
+
+/* Runs in a worker thread; must only access the job data */
+static void auth_sae_commit_job_work(void *ctx)
+{
+	struct sae_commit_job *job = ctx;
+
+	if (job->update && job->use_pt &&
+	    sae_prepare_commit_pt(job->sae, job->pt, job->own_addr,
+				  job->peer_addr, NULL, job->pk) < 0)
+		job->prepare_failed = true;
+	else if (job->update && !job->use_pt &&
+		 sae_prepare_commit(job->own_addr, job->peer_addr,
+				    (u8 *) job->password,
+				    os_strlen(job->password), job->sae) < 0)
+		job->prepare_failed = true;
+	else if (sae_process_commit(job->sae) < 0)
+		job->process_failed = true;
+}
+
+
+static void auth_sae_commit_job_done(void *ctx, int deinit)
+{
+	struct sae_commit_job *job = ctx;
+	struct hostapd_data *hapd = job->hapd;
+	struct sta_info *sta = job->sta;
+	int resp;
+
+	if (!sta) {
+		/* The STA entry was removed while the job was pending and the
+		 * SAE data was left for the job to free */
+		sae_clear_data(job->sae);
+		os_free(job->sae);
+		auth_sae_commit_job_free(job);
+		if (!deinit)
+			auth_sae_schedule_queue(hapd, 0);
+		return;
+	}
+
+	sta->sae_job = NULL;
+	if (deinit) {
+		auth_sae_commit_job_free(job);
+		return;
+	}
+
+	/* Complete the Nothing -> Committed transition of sae_sm_step() */
+	if (job->prepare_failed) {
+		wpa_printf(MSG_DEBUG, "SAE: Could not pick PWE");
+		resp = sta->sae->tmp && sta->sae->tmp->pw_id ?
+			WLAN_STATUS_UNKNOWN_PASSWORD_IDENTIFIER :
+			WLAN_STATUS_UNSPECIFIED_FAILURE;
+		goto reply;
+	}
+
+	resp = auth_sae_send_commit(hapd, sta, job->bssid, 0,
+				    job->status_code);
+	if (resp)
+		goto reply;
+	sae_set_state(sta, SAE_COMMITTED, "Sent Commit");
+
+	if (job->process_failed) {
+		resp = WLAN_STATUS_UNSPECIFIED_FAILURE;
+		goto reply;
+	}
+
+	if (hapd->conf->sae_confirm_immediate) {
+		resp = auth_sae_send_confirm(hapd, sta, job->bssid);
+		if (resp)
+			goto reply;
+		sae_set_state(sta, SAE_CONFIRMED, "Sent Confirm");
+	}
+	sta->sae->sync = 0;
+
+reply:
+	if (resp != WLAN_STATUS_SUCCESS) {
+		sae_sme_send_external_auth_status(hapd, sta, resp);
+		send_auth_reply(hapd, sta, sta->addr, job->bssid,
+				WLAN_AUTH_SAE, 1, resp, (u8 *) "", 0,
+				"auth-sae");
+		if (sta->added_unassoc) {
+			hostapd_drv_sta_remove(hapd, sta->addr);
+			sta->added_unassoc = 0;
+		}
+	}
+
+	auth_sae_commit_job_free(job);
+	auth_sae_schedule_queue(hapd, 0);
+}
+
+
+/*
+ * Derive the PWE and process the received Commit message in a worker thread.
+ * Returns 0 if the job was started and -1 if the Commit message needs to be
+ * processed synchronously.
+ */
+static int auth_sae_commit_offload(struct hostapd_data *hapd,
+				   struct sta_info *sta, const u8 *bssid,
+				   int update, u16 status_code)
+{
+	struct sae_commit_job *job;
+	const char *password;
+	struct sae_password_entry *pw;
+	struct sae_pt *pt = NULL;
+	const struct sae_pk *pk = NULL;
+	int use_pt;
+
+	if (!hapd->sae_pool || (hapd->conf->mesh & MESH_ENABLED))
+		return -1;
+
+	password = auth_sae_commit_password(hapd, sta, status_code, &use_pt,
+					    &pw, &pt, &pk);
+	if (!password)
+		return -1;
+
+	job = os_zalloc(sizeof(*job));
+	if (!job)
+		return -1;
+	job->password = os_strdup(password);
+	if (!job->password) {
+		os_free(job);
+		return -1;
+	}
+	job->hapd = hapd;
+	job->sta = sta;
+	job->sae = sta->sae;
+	os_memcpy(job->own_addr, hapd->own_addr, ETH_ALEN);
+	os_memcpy(job->peer_addr, sta->addr, ETH_ALEN);
+	os_memcpy(job->bssid, bssid, ETH_ALEN);
+	job->pt = pt;
+	job->pk = pk;
+	job->use_pt = use_pt;
+	job->update = update;
+	job->status_code = status_code;
+
+	if (worker_pool_submit(hapd->sae_pool, auth_sae_commit_job_work,
+			       auth_sae_commit_job_done, job) < 0) {
+		auth_sae_commit_job_free(job);
+		return -1;
+	}
+	sta->sae_job = job;
+	wpa_printf(MSG_DEBUG,
+		   "SAE: Processing Commit from " MACSTR " in a worker thread",
+		   MAC2STR(sta->addr));
+	return 0;
+}
+
+
+/**
+ * auth_sae_job_sta_removed - Detach a pending SAE job from a STA entry
+ * @hapd: BSS data
+ * @sta: STA entry that is about to be freed
+ *
+ * The SAE data of the STA is still in use by a worker thread, so the pending
+ * job takes over its ownership and frees it once the job has been completed.
+ */
+void auth_sae_job_sta_removed(struct hostapd_data *hapd, struct sta_info *sta)
+{
+	if (!sta->sae_job)
+		return;
+	wpa_printf(MSG_DEBUG, "SAE: Drop pending Commit processing for "
+		   MACSTR, MAC2STR(sta->addr));
+	sta->sae_job->sta = NULL;
+	sta->sae_job = NULL;
+	sta->sae = NULL;
+}
+
+
+/**
+ * auth_sae_workers_sync - Wait for pending SAE jobs to be processed
+ * @hapd: BSS data
+ *
+ * This needs to be called before freeing or replacing any configuration data
+ * (e.g., struct sae_pt) that a pending job may be using.
+ */
+void auth_sae_workers_sync(struct hostapd_data *hapd)
+{
+	if (hapd->sae_pool)
+		worker_pool_wait(hapd->sae_pool);
+}
+
+
+/**
+ * auth_sae_workers_deinit - Stop the SAE worker threads
+ * @hapd: BSS data
+ */
+void auth_sae_workers_deinit(struct hostapd_data *hapd)
+{
+	worker_pool_deinit(hapd->sae_pool);
+	hapd->sae_pool = NULL;
+}
+
+
+static void auth_sae_workers_update(struct hostapd_data *hapd)
+{
+	int threads = hapd->conf->sae_worker_threads;
+
+	/* Apply configuration changes once nothing is pending */
+	if (hapd->sae_pool && !worker_pool_pending(hapd->sae_pool) &&
+	    (threads == 0 ||
+	     (threads > 0 &&
+	      worker_pool_threads(hapd->sae_pool) != (unsigned int) threads)))
+		auth_sae_workers_deinit(hapd);
+
+	if (!hapd->sae_pool && threads)
+		hapd->sae_pool = worker_pool_init(threads > 0 ? threads : 0);
+}
+
+#endif /* CONFIG_SAE_THREADS */
+
+
 static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 		       const u8 *bssid, u16 auth_transaction, u16 status_code,
 		       int allow_reuse, int *sta_removed)
@@ -894,6 +1163,14 @@ static int sae_sm_step(struct hostapd_data *hapd, struct sta_info *sta,
 				sta->sae->pk =
 					status_code == WLAN_STATUS_SAE_PK;
 			}
+#ifdef CONFIG_SAE_THREADS
+			/* The rest of this transition is completed in
+			 * auth_sae_commit_job_done() */
+			if (auth_sae_commit_offload(hapd, sta, bssid,
+						    !allow_reuse,
+						    status_code) == 0)
+				break;
+#endif /* CONFIG_SAE_THREADS */
 			ret = auth_sae_send_commit(hapd, sta, bssid,
 						   !allow_reuse, status_code);
 			if (ret)
@@ -1535,15 +1812,61 @@ int auth_sae_init_committed(struct hostapd_data *hapd, struct sta_info *sta)
 }
 
 
+static int auth_sae_job_pending(struct hostapd_data *hapd, const u8 *addr)
+{
+#ifdef CONFIG_SAE_THREADS
+	struct sta_info *sta;
+
+	if (!hapd->sae_pool || !worker_pool_pending(hapd->sae_pool))
+		return 0;
+	sta = ap_get_sta(hapd, addr);
+	return sta && sta->sae_job;
+#else /* CONFIG_SAE_THREADS */
+	return 0;
+#endif /* CONFIG_SAE_THREADS */
+}
+
+
+static void auth_sae_schedule_queue(struct hostapd_data *hapd,
+				    unsigned int queue_len)
+{
+	if (eloop_is_timeout_registered(auth_sae_process_commit, hapd, NULL))
+		return;
+
+#ifdef CONFIG_SAE_THREADS
+	if (hapd->sae_pool) {
+		/* The heavy processing is done in the worker threads, so only
+		 * the number of Commit messages in flight needs to be limited.
+		 * Completion of a job reschedules the queue processing. */
+		if (!dl_list_empty(&hapd->sae_commit_queue) &&
+		    worker_pool_pending(hapd->sae_pool) <
+		    SAE_JOBS_PER_THREAD * worker_pool_threads(hapd->sae_pool))
+			eloop_register_timeout(0, 0, auth_sae_process_commit,
+					       hapd, NULL);
+		return;
+	}
+#endif /* CONFIG_SAE_THREADS */
+
+	eloop_register_timeout(0, queue_len * 50000, auth_sae_process_commit,
+			       hapd, NULL);
+}
+
+
 void auth_sae_process_commit(void *eloop_ctx, void *user_ctx)
 {
 	struct hostapd_data *hapd = eloop_ctx;
 	struct hostapd_sae_commit_queue *q;
 	unsigned int queue_len;
 
-	q = dl_list_first(&hapd->sae_commit_queue,
-			  struct hostapd_sae_commit_queue, list);
-	if (!q)
+	/* Frames from a STA whose earlier Commit message is still being
+	 * processed in a worker thread need to wait to maintain ordering. */
+	dl_list_for_each(q, &hapd->sae_commit_queue,
+			 struct hostapd_sae_commit_queue, list) {
+		if (!auth_sae_job_pending(
+			    hapd, ((const struct ieee80211_mgmt *) q->msg)->sa))
+			break;
+	}
+	if (&q->list == &hapd->sae_commit_queue)
 		return;
 	wpa_printf(MSG_DEBUG,
 		   "SAE: Process next available message from queue");
@@ -1552,11 +1875,8 @@ void auth_sae_process_commit(void *eloop_ctx, void *user_ctx)
 		    q->rssi, 1);
 	os_free(q);
 
-	if (eloop_is_timeout_registered(auth_sae_process_commit, hapd, NULL))
-		return;
 	queue_len = dl_list_len(&hapd->sae_commit_queue);
-	eloop_register_timeout(0, queue_len * 50000, auth_sae_process_commit,
-			       hapd, NULL);
+	auth_sae_schedule_queue(hapd, queue_len);
 }
 
 
@@ -1611,10 +1931,10 @@ static void auth_sae_queue(struct hostapd_data *hapd,
 	dl_list_add_tail(&hapd->sae_commit_queue, &q->list);
 
 queued:
-	if (eloop_is_timeout_registered(auth_sae_process_commit, hapd, NULL))
-		return;
-	eloop_register_timeout(0, queue_len * 50000, auth_sae_process_commit,
-			       hapd, NULL);
+#ifdef CONFIG_SAE_THREADS
+	auth_sae_workers_update(hapd);
+#endif /* CONFIG_SAE_THREADS */
+	auth_sae_schedule_queue(hapd, queue_len);
 }
 
 
@@ -1630,7 +1950,7 @@ static int auth_sae_queued_addr(struct hostapd_data *hapd, const u8 *addr)
 			return 1;
 	}
 
-	return 0;
+	return auth_sae_job_pending(hapd, addr);
 }
 
 #endif /* CONFIG_SAE */
@@ -131,6 +131,11 @@ int auth_sae_init_committed(struct hostapd_data *hapd, struct sta_info *sta);
 void sae_clear_retransmit_timer(struct hostapd_data *hapd,
 				struct sta_info *sta);
 void sae_accept_sta(struct hostapd_data *hapd, struct sta_info *sta);
+#ifdef CONFIG_SAE_THREADS
+void auth_sae_job_sta_removed(struct hostapd_data *hapd, struct sta_info *sta);
+void auth_sae_workers_sync(struct hostapd_data *hapd);
+void auth_sae_workers_deinit(struct hostapd_data *hapd);
+#endif /* CONFIG_SAE_THREADS */
 #else /* CONFIG_SAE */
 static inline void sae_clear_retransmit_timer(struct hostapd_data *hapd,
 					      struct sta_info *sta)
@@ -0,0 +1,486 @@
+/*
+ * hostapd - Persistent PMKSA and FT key cache store
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * PMKSA cache and FT key holder entries are stored in a memory mapped file
+ * that consists of fixed size slots. The first slot contains the file header
+ * and each of the remaining slots can hold one record encrypted and
+ * authenticated with AES-SIV using the configured key. Adding or removing a
+ * cache entry updates only the slot of that entry and since the slot size
+ * divides the page size, each update dirties a single page of the file.
+ * Records that cannot be authenticated (e.g., after the key was changed or
+ * a slot was only partially written when the system went down) are dropped
+ * when the file is loaded.
+ */
+
+#include "utils/includes.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils/common.h"
+#include "utils/wpabuf.h"
+#include "crypto/aes.h"
+#include "crypto/aes_siv.h"
+#include "vlan.h"
+#include "pmk_store.h"
+
+#define PMK_STORE_MAGIC "WPKS"
+#define PMK_STORE_VERSION 1
+#define PMK_STORE_SLOT_LEN 512
+#define PMK_STORE_MAX_SLOTS 65536
+
+/* Header (in slot 0): magic[4] version[2] slot_len[2] num_slots[4]
+ * key_check[16] */
+
+/* Slot: state[1] type[1] length[2] SIV[16] ciphertext */
+#define PMK_STORE_SLOT_HDR_LEN 4
+#define PMK_STORE_SLOT_FREE 0
+#define PMK_STORE_SLOT_USED 1
+#define PMK_STORE_MAX_REC_LEN \
+	(PMK_STORE_SLOT_LEN - PMK_STORE_SLOT_HDR_LEN - AES_BLOCK_SIZE)
+
+struct pmk_store {
+	int fd;
+	u8 *map;
+	size_t map_len;
+	unsigned int num_slots;
+	u8 key[PMK_STORE_KEY_LEN];
+
+	/* Stack of free slot numbers; initially lowest number on top */
+	unsigned int *free_slots;
+	unsigned int num_free;
+};
+
+
+static u8 * pmk_store_slot(struct pmk_store *store, unsigned int slot)
+{
+	return store->map + (size_t) slot * PMK_STORE_SLOT_LEN;
+}
+
+
+static int pmk_store_key_check(const u8 *key, u8 *check)
+{
+	const u8 *addr[1];
+	size_t len[1];
+
+	/* SIV of an empty plaintext to detect a changed key */
+	addr[0] = (const u8 *) PMK_STORE_MAGIC;
+	len[0] = 4;
+	return aes_siv_encrypt(key, PMK_STORE_KEY_LEN, (const u8 *) "", 0,
+			       1, addr, len, check);
+}
+
+
+static int pmk_store_header_valid(struct pmk_store *store, const u8 *check)
+{
+	const u8 *pos = store->map;
+
+	return os_memcmp(pos, PMK_STORE_MAGIC, 4) == 0 &&
+		WPA_GET_LE16(pos + 4) == PMK_STORE_VERSION &&
+		WPA_GET_LE16(pos + 6) == PMK_STORE_SLOT_LEN &&
+		WPA_GET_LE32(pos + 8) == store->num_slots &&
+		os_memcmp_const(pos + 12, check, AES_BLOCK_SIZE) == 0;
+}
+
+
+static void pmk_store_ad(u8 *ad, u8 type, unsigned int slot)
+{
+	/* Bind the record to its type and slot */
+	ad[0] = type;
+	WPA_PUT_LE32(ad + 1, slot);
+}
+
+
+/**
+ * pmk_store_open - Open or create a persistent PMK store
+ * @path: File name
+ * @key: PMK_STORE_KEY_LEN octet key for protecting the records
+ * @num_slots: Maximum number of records in the store
+ * Returns: Pointer to the store or %NULL on failure
+ *
+ * The file is locked for exclusive use. An existing file is reinitialized
+ * if it was created with a different key or number of slots.
+ */
+struct pmk_store * pmk_store_open(const char *path, const u8 *key,
+				  unsigned int num_slots)
+{
+	struct pmk_store *store;
+	u8 check[AES_BLOCK_SIZE];
+	struct stat st;
+	unsigned int slot;
+
+	if (!num_slots || num_slots > PMK_STORE_MAX_SLOTS) {
+		wpa_printf(MSG_ERROR, "PMK store: Invalid number of slots %u",
+			   num_slots);
+		return NULL;
+	}
+
+	if (pmk_store_key_check(key, check) < 0)
+		return NULL;
+
+	store = os_zalloc(sizeof(*store));
+	if (!store)
+		return NULL;
+	store->fd = -1;
+	store->num_slots = num_slots;
+	store->map_len = (size_t) (num_slots + 1) * PMK_STORE_SLOT_LEN;
+	os_memcpy(store->key, key, PMK_STORE_KEY_LEN);
+	store->free_slots = os_calloc(num_slots, sizeof(unsigned int));
+	if (!store->free_slots)
+		goto fail;
+
+	store->fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC,
+			 S_IRUSR | S_IWUSR);
+	if (store->fd < 0) {
+		wpa_printf(MSG_ERROR, "PMK store: Failed to open %s: %s",
+			   path, strerror(errno));
+		goto fail;
+	}
+	if (flock(store->fd, LOCK_EX | LOCK_NB) < 0) {
+		wpa_printf(MSG_ERROR, "PMK store: %s is in use: %s",
+			   path, strerror(errno));
+		goto fail;
+	}
+	if (fstat(store->fd, &st) < 0 ||
+	    (st.st_size != (off_t) store->map_len &&
+	     ftruncate(store->fd, store->map_len) < 0)) {
+		wpa_printf(MSG_ERROR, "PMK store: Failed to size %s: %s",
+			   path, strerror(errno));
+		goto fail;
+	}
+
+	store->map = mmap(NULL, store->map_len, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, store->fd, 0);
+	if (store->map == MAP_FAILED) {
+		wpa_printf(MSG_ERROR, "PMK store: Failed to map %s: %s",
+			   path, strerror(errno));
+		store->map = NULL;
+		goto fail;
+	}
+
+	if (!pmk_store_header_valid(store, check)) {
+		wpa_printf(MSG_INFO, "PMK store: Initialize %s (%u slots)",
+			   path, num_slots);
+		os_memset(store->map, 0, store->map_len);
+		os_memcpy(store->map, PMK_STORE_MAGIC, 4);
+		WPA_PUT_LE16(store->map + 4, PMK_STORE_VERSION);
+		WPA_PUT_LE16(store->map + 6, PMK_STORE_SLOT_LEN);
+		WPA_PUT_LE32(store->map + 8, num_slots);
+		os_memcpy(store->map + 12, check, AES_BLOCK_SIZE);
+	}
+
+	for (slot = num_slots; slot > 0; slot--) {
+		if (pmk_store_slot(store, slot)[0] == PMK_STORE_SLOT_FREE)
+			store->free_slots[store->num_free++] = slot;
+	}
+
+	return store;
+
+fail:
+	pmk_store_close(store);
+	return NULL;
+}
+
+
+/**
+ * pmk_store_close - Close a persistent PMK store
+ * @store: Pointer to the store from pmk_store_open() or %NULL
+ *
+ * The stored records are left in the file.
+ */
+void pmk_store_close(struct pmk_store *store)
+{
+	if (!store)
+		return;
+	if (store->map)
+		munmap(store->map, store->map_len);
+	if (store->fd >= 0)
+		close(store->fd);
+	os_free(store->free_slots);
+	bin_clear_free(store, sizeof(*store));
+}
+
+
+/**
+ * pmk_store_put - Add a record into the store
+ * @store: Pointer to the store from pmk_store_open()
+ * @type: Record type
+ * @rec: Record data
+ * Returns: Slot number (> 0) of the record or -1 on failure
+ */
+int pmk_store_put(struct pmk_store *store, enum pmk_store_type type,
+		  const struct wpabuf *rec)
+{
+	const u8 *addr[1];
+	size_t len[1];
+	u8 ad[5];
+	unsigned int slot;
+	u8 *pos;
+
+	if (!store || !rec)
+		return -1;
+	if (wpabuf_len(rec) > PMK_STORE_MAX_REC_LEN) {
+		wpa_printf(MSG_DEBUG,
+			   "PMK store: Too long record (%zu) - not stored",
+			   wpabuf_len(rec));
+		return -1;
+	}
+	if (!store->num_free) {
+		wpa_printf(MSG_DEBUG, "PMK store: No free slots");
+		return -1;
+	}
+
+	slot = store->free_slots[store->num_free - 1];
+	pos = pmk_store_slot(store, slot);
+	pmk_store_ad(ad, type, slot);
+	addr[0] = ad;
+	len[0] = sizeof(ad);
+	if (aes_siv_encrypt(store->key, PMK_STORE_KEY_LEN, wpabuf_head(rec),
+			    wpabuf_len(rec), 1, addr, len,
+			    pos + PMK_STORE_SLOT_HDR_LEN) < 0)
+		return -1;
+	pos[1] = type;
+	WPA_PUT_LE16(pos + 2, AES_BLOCK_SIZE + wpabuf_len(rec));
+	/* Mark the slot used only after the record has been written */
+	pos[0] = PMK_STORE_SLOT_USED;
+	store->num_free--;
+
+	return slot;
+}
+
+
+/**
+ * pmk_store_del - Remove a record from the store
+ * @store: Pointer to the store from pmk_store_open() or %NULL
+ * @slot: Slot number from pmk_store_put() or pmk_store_load() or 0
+ */
+void pmk_store_del(struct pmk_store *store, int slot)
+{
+	u8 *pos;
+
+	if (!store || slot <= 0 || (unsigned int) slot > store->num_slots)
+		return;
+	pos = pmk_store_slot(store, slot);
+	if (pos[0] == PMK_STORE_SLOT_FREE)
+		return;
+	os_memset(pos, 0, PMK_STORE_SLOT_LEN);
+	store->free_slots[store->num_free++] = slot;
+}
+
+
+/**
+ * pmk_store_load - Load the records from the store
+ * @store: Pointer to the store from pmk_store_open()
+ * @cb: Callback function for each valid record; returns 0 to keep the record
+ *	in the store (using the slot number passed to it) or -1 to remove it
+ * @ctx: Context pointer for cb
+ * Returns: Number of records kept in the store
+ *
+ * This is used once after pmk_store_open() to restore the cache contents.
+ * Records that fail authentication are removed.
+ */
+int pmk_store_load(struct pmk_store *store,
+		   int (*cb)(void *ctx, int slot, enum pmk_store_type type,
+			     const u8 *data, size_t len),
+		   void *ctx)
+{
+	u8 buf[PMK_STORE_MAX_REC_LEN];
+	const u8 *addr[1];
+	size_t len[1], rec_len;
+	u8 ad[5];
+	unsigned int slot;
+	int count = 0, dropped = 0;
+	u8 *pos;
+
+	for (slot = 1; slot <= store->num_slots; slot++) {
+		pos = pmk_store_slot(store, slot);
+		if (pos[0] == PMK_STORE_SLOT_FREE)
+			continue;
+
+		rec_len = WPA_GET_LE16(pos + 2);
+		pmk_store_ad(ad, pos[1], slot);
+		addr[0] = ad;
+		len[0] = sizeof(ad);
+		if (pos[0] != PMK_STORE_SLOT_USED ||
+		    rec_len < AES_BLOCK_SIZE ||
+		    rec_len > AES_BLOCK_SIZE + PMK_STORE_MAX_REC_LEN ||
+		    aes_siv_decrypt(store->key, PMK_STORE_KEY_LEN,
+				    pos + PMK_STORE_SLOT_HDR_LEN, rec_len,
+				    1, addr, len, buf) < 0) {
+			wpa_printf(MSG_DEBUG,
+				   "PMK store: Drop invalid record in slot %u",
+				   slot);
+			pmk_store_del(store, slot);
+			dropped++;
+			continue;
+		}
+
+		if (cb(ctx, slot, pos[1], buf, rec_len - AES_BLOCK_SIZE) < 0) {
+			pmk_store_del(store, slot);
+			dropped++;
+		} else {
+			count++;
+		}
+	}
+	forced_memzero(buf, sizeof(buf));
+
+	wpa_printf(MSG_DEBUG, "PMK store: Restored %d record(s), dropped %d",
+		   count, dropped);
+	return count;
+}
+
+
+/*
+ * Expiration times are kept in os_get_reltime() seconds which do not survive
+ * a reboot, so the records use wall clock time instead. 0 is used for no
+ * expiration.
+ */
+void pmk_store_put_time(struct wpabuf *buf, os_time_t reltime)
+{
+	struct os_reltime now_rel;
+	struct os_time now;
+
+	if (!reltime) {
+		wpabuf_put_le64(buf, 0);
+		return;
+	}
+	os_get_reltime(&now_rel);
+	os_get_time(&now);
+	wpabuf_put_le64(buf, now.sec + (reltime - now_rel.sec));
+}
+
+
+void pmk_store_put_var(struct wpabuf *buf, const u8 *data, size_t len)
+{
+	wpabuf_put_le16(buf, data ? len : 0);
+	if (data)
+		wpabuf_put_data(buf, data, len);
+}
+
+
+void pmk_store_put_vlan(struct wpabuf *buf,
+			const struct vlan_description *vlan)
+{
+	int i, num_tagged = 0;
+
+	if (!vlan || !vlan->notempty) {
+		wpabuf_put_u8(buf, 0);
+		return;
+	}
+	while (num_tagged < MAX_NUM_TAGGED_VLAN && vlan->tagged[num_tagged])
+		num_tagged++;
+	wpabuf_put_u8(buf, 1);
+	wpabuf_put_le32(buf, vlan->untagged);
+	wpabuf_put_u8(buf, num_tagged);
+	for (i = 0; i < num_tagged; i++)
+		wpabuf_put_le32(buf, vlan->tagged[i]);
+}
+
+
+void pmk_store_rec_init(struct pmk_store_rec *rec, const u8 *data,
+			size_t len)
+{
+	rec->pos = data;
+	rec->end = data + len;
+	rec->error = false;
+}
+
+
+const u8 * pmk_store_get(struct pmk_store_rec *rec, size_t len)
+{
+	const u8 *pos = rec->pos;
+
+	if (rec->error || len > (size_t) (rec->end - rec->pos)) {
+		rec->error = true;
+		return NULL;
+	}
+	rec->pos += len;
+	return pos;
+}
+
+
+u8 pmk_store_get_u8(struct pmk_store_rec *rec)
+{
+	const u8 *pos = pmk_store_get(rec, 1);
+
+	return pos ? *pos : 0;
+}
+
+
+u32 pmk_store_get_le32(struct pmk_store_rec *rec)
+{
+	const u8 *pos = pmk_store_get(rec, 4);
+
+	return pos ? WPA_GET_LE32(pos) : 0;
+}
+
+
+u64 pmk_store_get_le64(struct pmk_store_rec *rec)
+{
+	const u8 *pos = pmk_store_get(rec, 8);
+
+	return pos ? WPA_GET_LE64(pos) : 0;
+}
+
+
+/* Returns -1 if the time has already passed or the record is too short */
+int pmk_store_get_time(struct pmk_store_rec *rec, os_time_t *reltime)
+{
+	struct os_reltime now_rel;
+	struct os_time now;
+	u64 wall;
+
+	wall = pmk_store_get_le64(rec);
+	if (rec->error)
+		return -1;
+	if (!wall) {
+		*reltime = 0;
+		return 0;
+	}
+	os_get_reltime(&now_rel);
+	os_get_time(&now);
+	if (wall <= (u64) now.sec)
+		return -1;
+	*reltime = now_rel.sec + (os_time_t) (wall - now.sec);
+	return 0;
+}
+
+
+/* Returns %NULL with *len = 0 for an empty field */
+const u8 * pmk_store_get_var(struct pmk_store_rec *rec, size_t *len)
+{
+	const u8 *pos;
+
+	*len = 0;
+	pos = pmk_store_get(rec, 2);
+	if (!pos || !WPA_GET_LE16(pos))
+		return NULL;
+	pos = pmk_store_get(rec, WPA_GET_LE16(pos));
+	if (pos)
+		*len = rec->pos - pos;
+	return pos;
+}
+
+
+/* Returns 1 if VLAN information was present, 0 if not, -1 on error */
+int pmk_store_get_vlan(struct pmk_store_rec *rec,
+		       struct vlan_description *vlan)
+{
+	int i, num_tagged;
+
+	os_memset(vlan, 0, sizeof(*vlan));
+	if (!pmk_store_get_u8(rec))
+		return rec->error ? -1 : 0;
+	vlan->notempty = 1;
+	vlan->untagged = pmk_store_get_le32(rec);
+	num_tagged = pmk_store_get_u8(rec);
+	if (num_tagged > MAX_NUM_TAGGED_VLAN)
+		return -1;
+	for (i = 0; i < num_tagged; i++)
+		vlan->tagged[i] = pmk_store_get_le32(rec);
+	return rec->error ? -1 : 1;
+}
@@ -0,0 +1,60 @@
+/*
+ * hostapd - Persistent PMKSA and FT key cache store
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef PMK_STORE_H
+#define PMK_STORE_H
+
+#define PMK_STORE_KEY_LEN 32
+#define PMK_STORE_DEFAULT_SLOTS 4096
+
+/* Record types. These are part of the file format, so do not renumber. */
+enum pmk_store_type {
+	PMK_STORE_PMKSA = 1,
+	PMK_STORE_FT_PMK_R0 = 2,
+	PMK_STORE_FT_PMK_R1 = 3,
+};
+
+struct pmk_store;
+struct wpabuf;
+struct vlan_description;
+
+struct pmk_store * pmk_store_open(const char *path, const u8 *key,
+				  unsigned int num_slots);
+void pmk_store_close(struct pmk_store *store);
+int pmk_store_put(struct pmk_store *store, enum pmk_store_type type,
+		  const struct wpabuf *rec);
+void pmk_store_del(struct pmk_store *store, int slot);
+int pmk_store_load(struct pmk_store *store,
+		   int (*cb)(void *ctx, int slot, enum pmk_store_type type,
+			     const u8 *data, size_t len),
+		   void *ctx);
+
+/* Helpers for encoding and decoding the records */
+
+struct pmk_store_rec {
+	const u8 *pos;
+	const u8 *end;
+	bool error;
+};
+
+void pmk_store_put_time(struct wpabuf *buf, os_time_t reltime);
+void pmk_store_put_var(struct wpabuf *buf, const u8 *data, size_t len);
+void pmk_store_put_vlan(struct wpabuf *buf,
+			const struct vlan_description *vlan);
+
+void pmk_store_rec_init(struct pmk_store_rec *rec, const u8 *data,
+			size_t len);
+const u8 * pmk_store_get(struct pmk_store_rec *rec, size_t len);
+u8 pmk_store_get_u8(struct pmk_store_rec *rec);
+u32 pmk_store_get_le32(struct pmk_store_rec *rec);
+u64 pmk_store_get_le64(struct pmk_store_rec *rec);
+int pmk_store_get_time(struct pmk_store_rec *rec, os_time_t *reltime);
+const u8 * pmk_store_get_var(struct pmk_store_rec *rec, size_t *len);
+int pmk_store_get_vlan(struct pmk_store_rec *rec,
+		       struct vlan_description *vlan);
+
+#endif /* PMK_STORE_H */
@@ -10,11 +10,13 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/siphash.h"
 #include "eapol_auth/eapol_auth_sm.h"
 #include "eapol_auth/eapol_auth_sm_i.h"
 #include "radius/radius_das.h"
 #include "sta_info.h"
 #include "ap_config.h"
+#include "pmk_store.h"
 #include "pmksa_cache_auth.h"
 
 
@@ -22,11 +24,19 @@ static const int pmksa_cache_max_entries = 1024;
 static const int dot11RSNAConfigPMKLifetime = 43200;
 
 struct rsn_pmksa_cache {
-#define PMKID_HASH_SIZE 128
-#define PMKID_HASH(pmkid) (unsigned int) ((pmkid)[0] & 0x7f)
-	struct rsn_pmksa_cache_entry *pmkid[PMKID_HASH_SIZE];
-	struct rsn_pmksa_cache_entry *pmksa;
+#define PMKSA_HASH_SIZE 256
+	/* Hash tables use a keyed hash since both the addresses and the
+	 * PMKIDs (e.g., with SAE) can be influenced by the peer. */
+	struct rsn_pmksa_cache_entry *pmkid[PMKSA_HASH_SIZE];
+	struct rsn_pmksa_cache_entry *spa[PMKSA_HASH_SIZE];
+	struct rsn_pmksa_cache_entry *identity[PMKSA_HASH_SIZE];
+	u8 hash_key[SIPHASH_KEY_LEN];
+	struct dl_list pmksa; /* struct rsn_pmksa_cache_entry::list */
+	struct dl_list lru; /* struct rsn_pmksa_cache_entry::lru */
 	int pmksa_count;
+#ifdef CONFIG_PMK_STORE
+	struct pmk_store *store;
+#endif /* CONFIG_PMK_STORE */
 
 	void (*free_cb)(struct rsn_pmksa_cache_entry *entry, void *ctx);
 	void *ctx;
@@ -36,6 +46,13 @@ struct rsn_pmksa_cache {
 static void pmksa_cache_set_expiration(struct rsn_pmksa_cache *pmksa);
 
 
+static unsigned int pmksa_cache_hash(struct rsn_pmksa_cache *pmksa,
+				     const u8 *data, size_t len)
+{
+	return siphash24(pmksa->hash_key, data, len) & (PMKSA_HASH_SIZE - 1);
+}
+
+
 static void _pmksa_cache_free_entry(struct rsn_pmksa_cache_entry *entry)
 {
 	os_free(entry->vlan_desc);
@@ -51,43 +68,46 @@ static void _pmksa_cache_free_entry(struct rsn_pmksa_cache_entry *entry)
 void pmksa_cache_free_entry(struct rsn_pmksa_cache *pmksa,
 			    struct rsn_pmksa_cache_entry *entry)
 {
-	struct rsn_pmksa_cache_entry *pos, *prev;
-	unsigned int hash;
+	struct rsn_pmksa_cache_entry **pos;
 
 	pmksa->pmksa_count--;
 	pmksa->free_cb(entry, pmksa->ctx);
 
-	/* unlink from hash list */
-	hash = PMKID_HASH(entry->pmkid);
-	pos = pmksa->pmkid[hash];
-	prev = NULL;
-	while (pos) {
-		if (pos == entry) {
-			if (prev != NULL)
-				prev->hnext = entry->hnext;
-			else
-				pmksa->pmkid[hash] = entry->hnext;
+	/* unlink from hash lists */
+	pos = &pmksa->pmkid[pmksa_cache_hash(pmksa, entry->pmkid, PMKID_LEN)];
+	for (; *pos; pos = &(*pos)->hnext) {
+		if (*pos == entry) {
+			*pos = entry->hnext;
 			break;
 		}
-		prev = pos;
-		pos = pos->hnext;
 	}
 
-	/* unlink from entry list */
-	pos = pmksa->pmksa;
-	prev = NULL;
-	while (pos) {
-		if (pos == entry) {
-			if (prev != NULL)
-				prev->next = entry->next;
-			else
-				pmksa->pmksa = entry->next;
+	pos = &pmksa->spa[pmksa_cache_hash(pmksa, entry->spa, ETH_ALEN)];
+	for (; *pos; pos = &(*pos)->spa_hnext) {
+		if (*pos == entry) {
+			*pos = entry->spa_hnext;
 			break;
 		}
-		prev = pos;
-		pos = pos->next;
 	}
 
+	if (entry->identity) {
+		pos = &pmksa->identity[pmksa_cache_hash(pmksa, entry->identity,
+							entry->identity_len)];
+		for (; *pos; pos = &(*pos)->id_hnext) {
+			if (*pos == entry) {
+				*pos = entry->id_hnext;
+				break;
+			}
+		}
+	}
+
+	/* unlink from entry lists */
+	dl_list_del(&entry->list);
+	dl_list_del(&entry->lru);
+
+#ifdef CONFIG_PMK_STORE
+	pmk_store_del(pmksa->store, entry->store_slot);
+#endif /* CONFIG_PMK_STORE */
 	_pmksa_cache_free_entry(entry);
 }
 
@@ -98,10 +118,13 @@ void pmksa_cache_free_entry(struct rsn_pmksa_cache *pmksa,
  */
 void pmksa_cache_auth_flush(struct rsn_pmksa_cache *pmksa)
 {
-	while (pmksa->pmksa) {
+	struct rsn_pmksa_cache_entry *entry;
+
+	while ((entry = dl_list_first(&pmksa->pmksa,
+				      struct rsn_pmksa_cache_entry, list))) {
 		wpa_printf(MSG_DEBUG, "RSN: Flush PMKSA cache entry for "
-			   MACSTR, MAC2STR(pmksa->pmksa->spa));
-		pmksa_cache_free_entry(pmksa, pmksa->pmksa);
+			   MACSTR, MAC2STR(entry->spa));
+		pmksa_cache_free_entry(pmksa, entry);
 	}
 }
 
@@ -109,13 +132,16 @@ void pmksa_cache_auth_flush(struct rsn_pmksa_cache *pmksa)
 static void pmksa_cache_expire(void *eloop_ctx, void *timeout_ctx)
 {
 	struct rsn_pmksa_cache *pmksa = eloop_ctx;
+	struct rsn_pmksa_cache_entry *entry;
 	struct os_reltime now;
 
 	os_get_reltime(&now);
-	while (pmksa->pmksa && pmksa->pmksa->expiration <= now.sec) {
+	while ((entry = dl_list_first(&pmksa->pmksa,
+				      struct rsn_pmksa_cache_entry, list)) &&
+	       entry->expiration <= now.sec) {
 		wpa_printf(MSG_DEBUG, "RSN: expired PMKSA cache entry for "
-			   MACSTR, MAC2STR(pmksa->pmksa->spa));
-		pmksa_cache_free_entry(pmksa, pmksa->pmksa);
+			   MACSTR, MAC2STR(entry->spa));
+		pmksa_cache_free_entry(pmksa, entry);
 	}
 
 	pmksa_cache_set_expiration(pmksa);
@@ -124,20 +150,38 @@ static void pmksa_cache_expire(void *eloop_ctx, void *timeout_ctx)
 
 static void pmksa_cache_set_expiration(struct rsn_pmksa_cache *pmksa)
 {
+	struct rsn_pmksa_cache_entry *entry;
 	int sec;
 	struct os_reltime now;
 
 	eloop_cancel_timeout(pmksa_cache_expire, pmksa, NULL);
-	if (pmksa->pmksa == NULL)
+	entry = dl_list_first(&pmksa->pmksa, struct rsn_pmksa_cache_entry,
+			      list);
+	if (entry == NULL)
 		return;
 	os_get_reltime(&now);
-	sec = pmksa->pmksa->expiration - now.sec;
+	sec = entry->expiration - now.sec;
 	if (sec < 0)
 		sec = 0;
 	eloop_register_timeout(sec + 1, 0, pmksa_cache_expire, pmksa, NULL);
 }
 
 
+#ifdef CONFIG_MODULE_TESTS
+/**
+ * pmksa_cache_auth_test_expire - Run PMKSA cache expiration immediately
+ * @pmksa: Pointer to PMKSA cache data from pmksa_cache_auth_init()
+ *
+ * This is used by the module tests to remove entries whose expiration time
+ * has been moved into the past without waiting for the eloop timeout.
+ */
+void pmksa_cache_auth_test_expire(struct rsn_pmksa_cache *pmksa)
+{
+	pmksa_cache_expire(pmksa, NULL);
+}
+#endif /* CONFIG_MODULE_TESTS */
+
+
 static void pmksa_cache_from_eapol_data(struct rsn_pmksa_cache_entry *entry,
 					struct eapol_state_machine *eapol)
 {
@@ -219,35 +263,76 @@ void pmksa_cache_to_eapol_data(struct hostapd_data *hapd,
 }
 
 
+#ifdef CONFIG_PMK_STORE
+static void pmksa_cache_store_entry(struct rsn_pmksa_cache *pmksa,
+				    struct rsn_pmksa_cache_entry *entry)
+{
+	struct wpabuf *buf;
+
+	/* The RADIUS Class attributes are not stored */
+	buf = wpabuf_alloc(300 + entry->identity_len +
+			   (entry->cui ? wpabuf_len(entry->cui) : 0));
+	if (!buf)
+		return;
+	wpabuf_put_data(buf, entry->pmkid, PMKID_LEN);
+	wpabuf_put_u8(buf, entry->pmk_len);
+	wpabuf_put_data(buf, entry->pmk, entry->pmk_len);
+	pmk_store_put_time(buf, entry->expiration);
+	wpabuf_put_le32(buf, entry->akmp);
+	wpabuf_put_data(buf, entry->spa, ETH_ALEN);
+	wpabuf_put_u8(buf, entry->opportunistic);
+	wpabuf_put_u8(buf, entry->eap_type_authsrv);
+	wpabuf_put_le64(buf, entry->acct_multi_session_id);
+	pmk_store_put_vlan(buf, entry->vlan_desc);
+	pmk_store_put_var(buf, entry->identity, entry->identity_len);
+	pmk_store_put_var(buf, entry->cui ? wpabuf_head(entry->cui) : NULL,
+			  entry->cui ? wpabuf_len(entry->cui) : 0);
+
+	entry->store_slot = pmk_store_put(pmksa->store, PMK_STORE_PMKSA, buf);
+	if (entry->store_slot < 0)
+		entry->store_slot = 0;
+	wpabuf_clear_free(buf);
+}
+#endif /* CONFIG_PMK_STORE */
+
+
 static void pmksa_cache_link_entry(struct rsn_pmksa_cache *pmksa,
 				   struct rsn_pmksa_cache_entry *entry)
 {
-	struct rsn_pmksa_cache_entry *pos, *prev;
-	int hash;
-
-	/* Add the new entry; order by expiration time */
-	pos = pmksa->pmksa;
-	prev = NULL;
-	while (pos) {
-		if (pos->expiration > entry->expiration)
+	struct rsn_pmksa_cache_entry *pos;
+	unsigned int hash;
+
+	/* Add the new entry; order by expiration time. New entries usually
+	 * expire last, so search from the end of the list. */
+	dl_list_for_each_reverse(pos, &pmksa->pmksa,
+				 struct rsn_pmksa_cache_entry, list) {
+		if (pos->expiration <= entry->expiration)
 			break;
-		prev = pos;
-		pos = pos->next;
-	}
-	if (prev == NULL) {
-		entry->next = pmksa->pmksa;
-		pmksa->pmksa = entry;
-	} else {
-		entry->next = prev->next;
-		prev->next = entry;
 	}
+	dl_list_add(&pos->list, &entry->list);
+	dl_list_add_tail(&pmksa->lru, &entry->lru);
 
-	hash = PMKID_HASH(entry->pmkid);
+	hash = pmksa_cache_hash(pmksa, entry->pmkid, PMKID_LEN);
 	entry->hnext = pmksa->pmkid[hash];
 	pmksa->pmkid[hash] = entry;
 
+	hash = pmksa_cache_hash(pmksa, entry->spa, ETH_ALEN);
+	entry->spa_hnext = pmksa->spa[hash];
+	pmksa->spa[hash] = entry;
+
+	if (entry->identity) {
+		hash = pmksa_cache_hash(pmksa, entry->identity,
+					entry->identity_len);
+		entry->id_hnext = pmksa->identity[hash];
+		pmksa->identity[hash] = entry;
+	}
+
 	pmksa->pmksa_count++;
-	if (prev == NULL)
+#ifdef CONFIG_PMK_STORE
+	if (pmksa->store && !entry->store_slot)
+		pmksa_cache_store_entry(pmksa, entry);
+#endif /* CONFIG_PMK_STORE */
+	if (entry->list.prev == &pmksa->pmksa)
 		pmksa_cache_set_expiration(pmksa);
 	wpa_printf(MSG_DEBUG, "RSN: added PMKSA cache entry for " MACSTR,
 		   MAC2STR(entry->spa));
@@ -376,12 +461,14 @@ int pmksa_cache_auth_add_entry(struct rsn_pmksa_cache *pmksa,
 	if (pos)
 		pmksa_cache_free_entry(pmksa, pos);
 
-	if (pmksa->pmksa_count >= pmksa_cache_max_entries && pmksa->pmksa) {
-		/* Remove the oldest entry to make room for the new entry */
-		wpa_printf(MSG_DEBUG, "RSN: removed the oldest PMKSA cache "
-			   "entry (for " MACSTR ") to make room for new one",
-			   MAC2STR(pmksa->pmksa->spa));
-		pmksa_cache_free_entry(pmksa, pmksa->pmksa);
+	pos = dl_list_first(&pmksa->lru, struct rsn_pmksa_cache_entry, lru);
+	if (pmksa->pmksa_count >= pmksa_cache_max_entries && pos) {
+		/* Remove the least recently used entry to make room for the
+		 * new entry */
+		wpa_printf(MSG_DEBUG, "RSN: removed the least recently used "
+			   "PMKSA cache entry (for " MACSTR ") to make room "
+			   "for new one", MAC2STR(pos->spa));
+		pmksa_cache_free_entry(pmksa, pos);
 	}
 
 	pmksa_cache_link_entry(pmksa, entry);
@@ -443,22 +530,14 @@ pmksa_cache_add_okc(struct rsn_pmksa_cache *pmksa,
 void pmksa_cache_auth_deinit(struct rsn_pmksa_cache *pmksa)
 {
 	struct rsn_pmksa_cache_entry *entry, *prev;
-	int i;
 
 	if (pmksa == NULL)
 		return;
 
-	entry = pmksa->pmksa;
-	while (entry) {
-		prev = entry;
-		entry = entry->next;
-		_pmksa_cache_free_entry(prev);
-	}
+	dl_list_for_each_safe(entry, prev, &pmksa->pmksa,
+			      struct rsn_pmksa_cache_entry, list)
+		_pmksa_cache_free_entry(entry);
 	eloop_cancel_timeout(pmksa_cache_expire, pmksa, NULL);
-	pmksa->pmksa_count = 0;
-	pmksa->pmksa = NULL;
-	for (i = 0; i < PMKID_HASH_SIZE; i++)
-		pmksa->pmkid[i] = NULL;
 	os_free(pmksa);
 }
 
@@ -474,25 +553,41 @@ struct rsn_pmksa_cache_entry *
 pmksa_cache_auth_get(struct rsn_pmksa_cache *pmksa,
 		     const u8 *spa, const u8 *pmkid)
 {
-	struct rsn_pmksa_cache_entry *entry;
+	struct rsn_pmksa_cache_entry *entry, *found = NULL;
 
 	if (pmkid) {
-		for (entry = pmksa->pmkid[PMKID_HASH(pmkid)]; entry;
-		     entry = entry->hnext) {
+		for (entry = pmksa->pmkid[pmksa_cache_hash(pmksa, pmkid,
+							   PMKID_LEN)];
+		     entry; entry = entry->hnext) {
 			if ((spa == NULL ||
 			     os_memcmp(entry->spa, spa, ETH_ALEN) == 0) &&
-			    os_memcmp(entry->pmkid, pmkid, PMKID_LEN) == 0)
-				return entry;
+			    os_memcmp(entry->pmkid, pmkid, PMKID_LEN) == 0) {
+				found = entry;
+				break;
+			}
 		}
-	} else {
-		for (entry = pmksa->pmksa; entry; entry = entry->next) {
-			if (spa == NULL ||
-			    os_memcmp(entry->spa, spa, ETH_ALEN) == 0)
-				return entry;
+	} else if (spa) {
+		/* Return the entry that expires first like a search through
+		 * the expiration ordered list would. The hash list is in
+		 * reverse order of addition. */
+		for (entry = pmksa->spa[pmksa_cache_hash(pmksa, spa,
+							 ETH_ALEN)];
+		     entry; entry = entry->spa_hnext) {
+			if (os_memcmp(entry->spa, spa, ETH_ALEN) == 0 &&
+			    (!found || entry->expiration <= found->expiration))
+				found = entry;
 		}
+	} else {
+		found = dl_list_first(&pmksa->pmksa,
+				      struct rsn_pmksa_cache_entry, list);
 	}
 
-	return NULL;
+	if (found) {
+		dl_list_del(&found->lru);
+		dl_list_add_tail(&pmksa->lru, &found->lru);
+	}
+
+	return found;
 }
 
 
@@ -513,21 +608,28 @@ struct rsn_pmksa_cache_entry * pmksa_cache_get_okc(
 	struct rsn_pmksa_cache_entry *entry;
 	u8 new_pmkid[PMKID_LEN];
 
-	for (entry = pmksa->pmksa; entry; entry = entry->next) {
+	for (entry = pmksa->spa[pmksa_cache_hash(pmksa, spa, ETH_ALEN)];
+	     entry; entry = entry->spa_hnext) {
 		if (os_memcmp(entry->spa, spa, ETH_ALEN) != 0)
 			continue;
 		if (wpa_key_mgmt_sae(entry->akmp) ||
 		    wpa_key_mgmt_fils(entry->akmp)) {
 			if (os_memcmp(entry->pmkid, pmkid, PMKID_LEN) == 0)
-				return entry;
+				break;
 			continue;
 		}
 		rsn_pmkid(entry->pmk, entry->pmk_len, aa, spa, new_pmkid,
 			  entry->akmp);
 		if (os_memcmp(new_pmkid, pmkid, PMKID_LEN) == 0)
-			return entry;
+			break;
 	}
-	return NULL;
+
+	if (entry) {
+		dl_list_del(&entry->lru);
+		dl_list_add_tail(&pmksa->lru, &entry->lru);
+	}
+
+	return entry;
 }
 
 
@@ -547,12 +649,119 @@ pmksa_cache_auth_init(void (*free_cb)(struct rsn_pmksa_cache_entry *entry,
 	if (pmksa) {
 		pmksa->free_cb = free_cb;
 		pmksa->ctx = ctx;
+		dl_list_init(&pmksa->pmksa);
+		dl_list_init(&pmksa->lru);
+		if (os_get_random(pmksa->hash_key,
+				  sizeof(pmksa->hash_key)) < 0)
+			wpa_printf(MSG_INFO,
+				   "RSN: Could not get random PMKSA hash key");
 	}
 
 	return pmksa;
 }
 
 
+#ifdef CONFIG_PMK_STORE
+
+/**
+ * pmksa_cache_auth_set_store - Store PMKSA cache entries persistently
+ * @pmksa: Pointer to PMKSA cache data from pmksa_cache_auth_init()
+ * @store: Pointer to the store from pmk_store_open()
+ *
+ * Entries that are added after this call are written into the store and
+ * removed from it when they expire or are removed from the cache. The entries
+ * are left in the store when the cache is deinitialized.
+ */
+void pmksa_cache_auth_set_store(struct rsn_pmksa_cache *pmksa,
+				struct pmk_store *store)
+{
+	pmksa->store = store;
+}
+
+
+/**
+ * pmksa_cache_auth_restore - Restore a PMKSA cache entry from the store
+ * @pmksa: Pointer to PMKSA cache data from pmksa_cache_auth_init()
+ * @slot: Slot of the record in the store
+ * @data: Record data from pmk_store_load()
+ * @len: Length of the record data
+ * Returns: 0 if the entry was added or -1 if the record should be dropped
+ */
+int pmksa_cache_auth_restore(struct rsn_pmksa_cache *pmksa, int slot,
+			     const u8 *data, size_t len)
+{
+	struct rsn_pmksa_cache_entry *entry;
+	struct vlan_description vlan;
+	struct pmk_store_rec rec;
+	const u8 *pos;
+	size_t pos_len;
+
+	if (pmksa->pmksa_count >= pmksa_cache_max_entries)
+		return -1;
+
+	entry = os_zalloc(sizeof(*entry));
+	if (!entry)
+		return -1;
+
+	pmk_store_rec_init(&rec, data, len);
+	pos = pmk_store_get(&rec, PMKID_LEN);
+	if (pos)
+		os_memcpy(entry->pmkid, pos, PMKID_LEN);
+	entry->pmk_len = pmk_store_get_u8(&rec);
+	if (entry->pmk_len > PMK_LEN_MAX)
+		goto fail;
+	pos = pmk_store_get(&rec, entry->pmk_len);
+	if (pos)
+		os_memcpy(entry->pmk, pos, entry->pmk_len);
+	if (pmk_store_get_time(&rec, &entry->expiration) < 0 ||
+	    !entry->expiration)
+		goto fail;
+	entry->akmp = pmk_store_get_le32(&rec);
+	pos = pmk_store_get(&rec, ETH_ALEN);
+	if (pos)
+		os_memcpy(entry->spa, pos, ETH_ALEN);
+	entry->opportunistic = pmk_store_get_u8(&rec);
+	entry->eap_type_authsrv = pmk_store_get_u8(&rec);
+	entry->acct_multi_session_id = pmk_store_get_le64(&rec);
+	switch (pmk_store_get_vlan(&rec, &vlan)) {
+	case 1:
+		entry->vlan_desc = os_memdup(&vlan, sizeof(vlan));
+		if (!entry->vlan_desc)
+			goto fail;
+		break;
+	case 0:
+		break;
+	default:
+		goto fail;
+	}
+	pos = pmk_store_get_var(&rec, &pos_len);
+	if (pos) {
+		entry->identity = os_memdup(pos, pos_len);
+		if (!entry->identity)
+			goto fail;
+		entry->identity_len = pos_len;
+	}
+	pos = pmk_store_get_var(&rec, &pos_len);
+	if (pos) {
+		entry->cui = wpabuf_alloc_copy(pos, pos_len);
+		if (!entry->cui)
+			goto fail;
+	}
+	if (rec.error)
+		goto fail;
+
+	entry->store_slot = slot;
+	pmksa_cache_link_entry(pmksa, entry);
+	return 0;
+
+fail:
+	_pmksa_cache_free_entry(entry);
+	return -1;
+}
+
+#endif /* CONFIG_PMK_STORE */
+
+
 static int das_attr_match(struct rsn_pmksa_cache_entry *entry,
 			  struct radius_das_attrs *attr)
 {
@@ -602,21 +811,41 @@ int pmksa_cache_auth_radius_das_disconnect(struct rsn_pmksa_cache *pmksa,
 					   struct radius_das_attrs *attr)
 {
 	int found = 0;
-	struct rsn_pmksa_cache_entry *entry, *prev;
+	struct rsn_pmksa_cache_entry *entry, *next;
 
 	if (attr->acct_session_id)
 		return -1;
 
-	entry = pmksa->pmksa;
-	while (entry) {
-		if (das_attr_match(entry, attr)) {
-			found++;
-			prev = entry;
-			entry = entry->next;
-			pmksa_cache_free_entry(pmksa, prev);
-			continue;
+	/* All included attributes need to match, so when possible, only go
+	 * through the entries on the hash list of one of them. */
+	if (attr->sta_addr) {
+		entry = pmksa->spa[pmksa_cache_hash(pmksa, attr->sta_addr,
+						    ETH_ALEN)];
+		for (; entry; entry = next) {
+			next = entry->spa_hnext;
+			if (das_attr_match(entry, attr)) {
+				found++;
+				pmksa_cache_free_entry(pmksa, entry);
+			}
+		}
+	} else if (attr->user_name) {
+		entry = pmksa->identity[pmksa_cache_hash(
+				pmksa, attr->user_name, attr->user_name_len)];
+		for (; entry; entry = next) {
+			next = entry->id_hnext;
+			if (das_attr_match(entry, attr)) {
+				found++;
+				pmksa_cache_free_entry(pmksa, entry);
+			}
+		}
+	} else {
+		dl_list_for_each_safe(entry, next, &pmksa->pmksa,
+				      struct rsn_pmksa_cache_entry, list) {
+			if (das_attr_match(entry, attr)) {
+				found++;
+				pmksa_cache_free_entry(pmksa, entry);
+			}
 		}
-		entry = entry->next;
 	}
 
 	return found ? 0 : -1;
@@ -647,8 +876,8 @@ int pmksa_cache_auth_list(struct rsn_pmksa_cache *pmksa, char *buf, size_t len)
 		return pos - buf;
 	pos += ret;
 	i = 0;
-	entry = pmksa->pmksa;
-	while (entry) {
+	dl_list_for_each(entry, &pmksa->pmksa, struct rsn_pmksa_cache_entry,
+			 list) {
 		ret = os_snprintf(pos, buf + len - pos, "%d " MACSTR " ",
 				  i, MAC2STR(entry->spa));
 		if (os_snprintf_error(buf + len - pos, ret))
@@ -662,7 +891,6 @@ int pmksa_cache_auth_list(struct rsn_pmksa_cache *pmksa, char *buf, size_t len)
 		if (os_snprintf_error(buf + len - pos, ret))
 			return pos - buf;
 		pos += ret;
-		entry = entry->next;
 	}
 	return pos - buf;
 }
@@ -700,7 +928,8 @@ int pmksa_cache_auth_list_mesh(struct rsn_pmksa_cache *pmksa, const u8 *addr,
 	 * Entry format:
 	 * <BSSID> <PMKID> <PMK> <expiration in seconds>
 	 */
-	for (entry = pmksa->pmksa; entry; entry = entry->next) {
+	dl_list_for_each(entry, &pmksa->pmksa, struct rsn_pmksa_cache_entry,
+			 list) {
 		if (addr && os_memcmp(entry->spa, addr, ETH_ALEN) != 0)
 			continue;
 
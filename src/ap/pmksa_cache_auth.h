@@ -9,13 +9,18 @@
 #ifndef PMKSA_CACHE_H
 #define PMKSA_CACHE_H
 
+#include "utils/list.h"
 #include "radius/radius.h"
 
 /**
  * struct rsn_pmksa_cache_entry - PMKSA cache entry
  */
 struct rsn_pmksa_cache_entry {
-	struct rsn_pmksa_cache_entry *next, *hnext;
+	struct dl_list list; /* ordered by expiration time */
+	struct dl_list lru; /* least recently used first */
+	struct rsn_pmksa_cache_entry *hnext; /* PMKID hash */
+	struct rsn_pmksa_cache_entry *spa_hnext; /* SPA hash */
+	struct rsn_pmksa_cache_entry *id_hnext; /* identity hash */
 	u8 pmkid[PMKID_LEN];
 	u8 pmk[PMK_LEN_MAX];
 	size_t pmk_len;
@@ -32,10 +37,14 @@ struct rsn_pmksa_cache_entry {
 	int opportunistic;
 
 	u64 acct_multi_session_id;
+#ifdef CONFIG_PMK_STORE
+	int store_slot; /* slot in the persistent store or 0 if not stored */
+#endif /* CONFIG_PMK_STORE */
 };
 
 struct rsn_pmksa_cache;
 struct radius_das_attrs;
+struct pmk_store;
 
 struct rsn_pmksa_cache *
 pmksa_cache_auth_init(void (*free_cb)(struct rsn_pmksa_cache_entry *entry,
@@ -73,7 +82,12 @@ int pmksa_cache_auth_radius_das_disconnect(struct rsn_pmksa_cache *pmksa,
 					   struct radius_das_attrs *attr);
 int pmksa_cache_auth_list(struct rsn_pmksa_cache *pmksa, char *buf, size_t len);
 void pmksa_cache_auth_flush(struct rsn_pmksa_cache *pmksa);
+void pmksa_cache_auth_set_store(struct rsn_pmksa_cache *pmksa,
+				struct pmk_store *store);
+int pmksa_cache_auth_restore(struct rsn_pmksa_cache *pmksa, int slot,
+			     const u8 *data, size_t len);
 int pmksa_cache_auth_list_mesh(struct rsn_pmksa_cache *pmksa, const u8 *addr,
 			       char *buf, size_t len);
+void pmksa_cache_auth_test_expire(struct rsn_pmksa_cache *pmksa);
 
 #endif /* PMKSA_CACHE_H */
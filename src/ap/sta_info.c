@@ -10,6 +10,7 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/siphash.h"
 #include "common/ieee802_11_defs.h"
 #include "common/wpa_ctrl.h"
 #include "common/sae.h"
@@ -66,11 +67,21 @@ int ap_for_each_sta(struct hostapd_data *hapd,
 }
 
 
+static unsigned int ap_sta_hash(struct hostapd_data *hapd, const u8 *addr)
+{
+	return siphash24(hapd->sta_hash_key, addr, ETH_ALEN) &
+		(hapd->sta_hash_size - 1);
+}
+
+
 struct sta_info * ap_get_sta(struct hostapd_data *hapd, const u8 *sta)
 {
 	struct sta_info *s;
 
-	s = hapd->sta_hash[STA_HASH(sta)];
+	if (!hapd->sta_hash)
+		return NULL;
+
+	s = hapd->sta_hash[ap_sta_hash(hapd, sta)];
 	while (s != NULL && os_memcmp(s->addr, sta, 6) != 0)
 		s = s->hnext;
 	return s;
@@ -121,32 +132,99 @@ static void ap_sta_list_del(struct hostapd_data *hapd, struct sta_info *sta)
 }
 
 
+static void ap_sta_hash_resize(struct hostapd_data *hapd, unsigned int size)
+{
+	struct sta_info **hash, *sta, *next;
+	unsigned int i, old_size = hapd->sta_hash_size;
+
+	hash = os_calloc(size, sizeof(*hash));
+	if (!hash)
+		return; /* continue with longer hash chains */
+
+	hapd->sta_hash_size = size;
+	for (i = 0; i < old_size; i++) {
+		for (sta = hapd->sta_hash[i]; sta; sta = next) {
+			unsigned int idx = ap_sta_hash(hapd, sta->addr);
+
+			next = sta->hnext;
+			sta->hnext = hash[idx];
+			hash[idx] = sta;
+		}
+	}
+	os_free(hapd->sta_hash);
+	hapd->sta_hash = hash;
+
+	wpa_printf(MSG_DEBUG, "AP: STA hash table resized to %u buckets",
+		   size);
+}
+
+
 void ap_sta_hash_add(struct hostapd_data *hapd, struct sta_info *sta)
 {
-	sta->hnext = hapd->sta_hash[STA_HASH(sta->addr)];
-	hapd->sta_hash[STA_HASH(sta->addr)] = sta;
+	unsigned int idx;
+
+	if (!hapd->sta_hash) {
+		if (os_get_random(hapd->sta_hash_key,
+				  sizeof(hapd->sta_hash_key)) < 0) {
+			wpa_printf(MSG_INFO,
+				   "AP: Could not get random STA hash key");
+			os_memset(hapd->sta_hash_key, 0,
+				  sizeof(hapd->sta_hash_key));
+		}
+		hapd->sta_hash_size = 0;
+		ap_sta_hash_resize(hapd, STA_HASH_SIZE);
+		if (!hapd->sta_hash) {
+			/* Use a single bucket rather than losing the entry */
+			hapd->sta_hash = os_zalloc(sizeof(*hapd->sta_hash));
+			if (!hapd->sta_hash)
+				return;
+			hapd->sta_hash_size = 1;
+		}
+	} else if (hapd->sta_hash_entries >= hapd->sta_hash_size &&
+		   hapd->sta_hash_size < STA_HASH_MAX_SIZE) {
+		ap_sta_hash_resize(hapd, hapd->sta_hash_size * 2);
+	}
+
+	idx = ap_sta_hash(hapd, sta->addr);
+	sta->hnext = hapd->sta_hash[idx];
+	hapd->sta_hash[idx] = sta;
+	hapd->sta_hash_entries++;
 }
 
 
-static void ap_sta_hash_del(struct hostapd_data *hapd, struct sta_info *sta)
+void ap_sta_hash_del(struct hostapd_data *hapd, struct sta_info *sta)
 {
-	struct sta_info *s;
+	struct sta_info **s;
 
-	s = hapd->sta_hash[STA_HASH(sta->addr)];
-	if (s == NULL) return;
-	if (os_memcmp(s->addr, sta->addr, 6) == 0) {
-		hapd->sta_hash[STA_HASH(sta->addr)] = s->hnext;
+	if (!hapd->sta_hash)
 		return;
+
+	for (s = &hapd->sta_hash[ap_sta_hash(hapd, sta->addr)]; *s;
+	     s = &(*s)->hnext) {
+		if (*s == sta) {
+			*s = sta->hnext;
+			hapd->sta_hash_entries--;
+			return;
+		}
 	}
 
-	while (s->hnext != NULL &&
-	       os_memcmp(s->hnext->addr, sta->addr, ETH_ALEN) != 0)
-		s = s->hnext;
-	if (s->hnext != NULL)
-		s->hnext = s->hnext->hnext;
-	else
-		wpa_printf(MSG_DEBUG, "AP: could not remove STA " MACSTR
-			   " from hash table", MAC2STR(sta->addr));
+	wpa_printf(MSG_DEBUG, "AP: could not remove STA " MACSTR
+		   " from hash table", MAC2STR(sta->addr));
+}
+
+
+/**
+ * ap_sta_hash_deinit - Free the STA hash table
+ * @hapd: Pointer to BSS data
+ *
+ * This is called once all STA entries have been removed.
+ */
+void ap_sta_hash_deinit(struct hostapd_data *hapd)
+{
+	os_free(hapd->sta_hash);
+	hapd->sta_hash = NULL;
+	hapd->sta_hash_size = 0;
+	hapd->sta_hash_entries = 0;
 }
 
 
@@ -368,6 +446,9 @@ void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta)
 	os_free(sta->hs20_session_info_url);
 
 #ifdef CONFIG_SAE
+#ifdef CONFIG_SAE_THREADS
+	auth_sae_job_sta_removed(hapd, sta);
+#endif /* CONFIG_SAE_THREADS */
 	sae_clear_data(sta->sae);
 	os_free(sta->sae);
 #endif /* CONFIG_SAE */
@@ -435,6 +516,8 @@ void hostapd_free_stas(struct hostapd_data *hapd)
 			   MAC2STR(prev->addr));
 		ap_free_sta(hapd, prev);
 	}
+
+	ap_sta_hash_deinit(hapd);
 }
 
 
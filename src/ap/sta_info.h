@@ -157,6 +157,14 @@ struct sta_info {
 	u32 last_tx_bytes_hi;
 	u32 last_tx_bytes_lo;
 
+	/* Batched accounting updates: time of the next update and statistics
+	 * from the station dump of generation acct_batch_gen */
+	os_time_t acct_next_update;
+	unsigned int acct_batch_gen;
+	unsigned long acct_rx_packets, acct_tx_packets;
+	unsigned long long acct_rx_bytes, acct_tx_bytes;
+	int acct_bytes_64bit;
+
 	u8 *challenge; /* IEEE 802.11 Shared Key Authentication Challenge */
 
 	struct wpa_state_machine *wpa_sm;
@@ -215,6 +223,11 @@ struct sta_info {
 #ifdef CONFIG_SAE
 	struct sae_data *sae;
 	unsigned int mesh_sae_pmksa_caching:1;
+#ifdef CONFIG_SAE_THREADS
+	/* Pending SAE Commit processing in a worker thread; sae must not be
+	 * accessed while this is set */
+	struct sae_commit_job *sae_job;
+#endif /* CONFIG_SAE_THREADS */
 #endif /* CONFIG_SAE */
 
 	/* valid only if session_timeout_set == 1 */
@@ -323,6 +336,8 @@ int ap_for_each_sta(struct hostapd_data *hapd,
 struct sta_info * ap_get_sta(struct hostapd_data *hapd, const u8 *sta);
 struct sta_info * ap_get_sta_p2p(struct hostapd_data *hapd, const u8 *addr);
 void ap_sta_hash_add(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_sta_hash_del(struct hostapd_data *hapd, struct sta_info *sta);
+void ap_sta_hash_deinit(struct hostapd_data *hapd);
 void ap_free_sta(struct hostapd_data *hapd, struct sta_info *sta);
 void ap_sta_ip6addr_del(struct hostapd_data *hapd, struct sta_info *sta);
 void hostapd_free_stas(struct hostapd_data *hapd);
@@ -10,6 +10,7 @@
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/flight_recorder.h"
 #include "utils/state_machine.h"
 #include "utils/bitfield.h"
 #include "common/ieee802_11_defs.h"
@@ -68,6 +69,7 @@ static void wpa_group_put(struct wpa_authenticator *wpa_auth,
 			  struct wpa_group *group);
 static int ieee80211w_kde_len(struct wpa_state_machine *sm);
 static u8 * ieee80211w_kde_add(struct wpa_state_machine *sm, u8 *pos);
+static void wpa_psk_memo_flush(struct wpa_authenticator *wpa_auth);
 
 static const u32 eapol_key_timeout_first = 100; /* ms */
 static const u32 eapol_key_timeout_subseq = 1000; /* ms */
@@ -495,6 +497,53 @@ static struct wpa_group * wpa_group_init(struct wpa_authenticator *wpa_auth,
 }
 
 
+#ifdef CONFIG_PMK_STORE
+
+static int wpa_auth_pmk_store_restore(void *ctx, int slot,
+				      enum pmk_store_type type,
+				      const u8 *data, size_t len)
+{
+	struct wpa_authenticator *wpa_auth = ctx;
+
+	switch (type) {
+	case PMK_STORE_PMKSA:
+		return pmksa_cache_auth_restore(wpa_auth->pmksa, slot, data,
+						len);
+#ifdef CONFIG_IEEE80211R_AP
+	case PMK_STORE_FT_PMK_R0:
+	case PMK_STORE_FT_PMK_R1:
+		return wpa_ft_pmk_cache_restore(wpa_auth, slot, type, data,
+						len);
+#endif /* CONFIG_IEEE80211R_AP */
+	default:
+		return -1;
+	}
+}
+
+
+static void wpa_auth_pmk_store_init(struct wpa_authenticator *wpa_auth)
+{
+	wpa_auth->pmk_store = pmk_store_open(wpa_auth->conf.pmk_store,
+					     wpa_auth->conf.pmk_store_key,
+					     wpa_auth->conf.pmk_store_slots);
+	if (!wpa_auth->pmk_store) {
+		wpa_printf(MSG_INFO,
+			   "RSN: PMKSA cache will not be stored persistently");
+		return;
+	}
+
+	pmksa_cache_auth_set_store(wpa_auth->pmksa, wpa_auth->pmk_store);
+#ifdef CONFIG_IEEE80211R_AP
+	wpa_ft_pmk_cache_set_store(wpa_auth->ft_pmk_cache,
+				   wpa_auth->pmk_store);
+#endif /* CONFIG_IEEE80211R_AP */
+	pmk_store_load(wpa_auth->pmk_store, wpa_auth_pmk_store_restore,
+		       wpa_auth);
+}
+
+#endif /* CONFIG_PMK_STORE */
+
+
 /**
  * wpa_init - Initialize WPA authenticator
  * @addr: Authenticator address
@@ -512,6 +561,7 @@ struct wpa_authenticator * wpa_init(const u8 *addr,
 	wpa_auth = os_zalloc(sizeof(struct wpa_authenticator));
 	if (!wpa_auth)
 		return NULL;
+	dl_list_init(&wpa_auth->psk_memo_lru);
 	os_memcpy(wpa_auth->addr, addr, ETH_ALEN);
 	os_memcpy(&wpa_auth->conf, conf, sizeof(*conf));
 	wpa_auth->cb = cb;
@@ -552,6 +602,11 @@ struct wpa_authenticator * wpa_init(const u8 *addr,
 	}
 #endif /* CONFIG_IEEE80211R_AP */
 
+#ifdef CONFIG_PMK_STORE
+	if (wpa_auth->conf.pmk_store)
+		wpa_auth_pmk_store_init(wpa_auth);
+#endif /* CONFIG_PMK_STORE */
+
 	if (wpa_auth->conf.wpa_gmk_rekey) {
 		eloop_register_timeout(wpa_auth->conf.wpa_gmk_rekey, 0,
 				       wpa_rekey_gmk, wpa_auth, NULL);
@@ -611,10 +666,15 @@ void wpa_deinit(struct wpa_authenticator *wpa_auth)
 	wpa_ft_deinit(wpa_auth);
 #endif /* CONFIG_IEEE80211R_AP */
 
+#ifdef CONFIG_PMK_STORE
+	pmk_store_close(wpa_auth->pmk_store);
+#endif /* CONFIG_PMK_STORE */
+
 #ifdef CONFIG_P2P
 	bitfield_free(wpa_auth->ip_pool);
 #endif /* CONFIG_P2P */
 
+	wpa_psk_memo_flush(wpa_auth);
 
 	os_free(wpa_auth->wpa_ie);
 
@@ -949,6 +1009,177 @@ static int wpa_receive_error_report(struct wpa_authenticator *wpa_auth,
 }
 
 
+static struct wpa_psk_memo *
+wpa_psk_memo_get(struct wpa_authenticator *wpa_auth, const u8 *addr)
+{
+	struct wpa_psk_memo *memo;
+
+	if (!wpa_auth->psk_memo)
+		return NULL;
+
+	dl_list_for_each(memo, &wpa_auth->psk_memo[WPA_PSK_MEMO_HASH(addr)],
+			 struct wpa_psk_memo, hash) {
+		if (os_memcmp(memo->addr, addr, ETH_ALEN) == 0)
+			return memo;
+	}
+
+	return NULL;
+}
+
+
+static void wpa_psk_memo_del(struct wpa_authenticator *wpa_auth,
+			     struct wpa_psk_memo *memo)
+{
+	dl_list_del(&memo->hash);
+	dl_list_del(&memo->lru);
+	wpa_auth->num_psk_memo--;
+	bin_clear_free(memo, sizeof(*memo));
+}
+
+
+static void wpa_psk_memo_flush(struct wpa_authenticator *wpa_auth)
+{
+	struct wpa_psk_memo *memo, *tmp;
+
+	dl_list_for_each_safe(memo, tmp, &wpa_auth->psk_memo_lru,
+			      struct wpa_psk_memo, lru)
+		wpa_psk_memo_del(wpa_auth, memo);
+	os_free(wpa_auth->psk_memo);
+	wpa_auth->psk_memo = NULL;
+}
+
+
+/* Remember the PSK that completed the 4-way handshake for a station so that
+ * the next handshake from the same address can try it before iterating over
+ * all configured PSKs. */
+static void wpa_psk_memo_set(struct wpa_authenticator *wpa_auth,
+			     const u8 *addr, const u8 *pmk, size_t pmk_len)
+{
+	struct wpa_psk_memo *memo;
+	unsigned int i;
+
+	if (pmk_len > PMK_LEN_MAX)
+		return;
+
+	if (!wpa_auth->psk_memo) {
+		wpa_auth->psk_memo = os_calloc(WPA_PSK_MEMO_HASH_SIZE,
+					       sizeof(struct dl_list));
+		if (!wpa_auth->psk_memo)
+			return;
+		for (i = 0; i < WPA_PSK_MEMO_HASH_SIZE; i++)
+			dl_list_init(&wpa_auth->psk_memo[i]);
+	}
+
+	memo = wpa_psk_memo_get(wpa_auth, addr);
+	if (memo) {
+		dl_list_del(&memo->lru);
+	} else {
+		if (wpa_auth->num_psk_memo >= WPA_PSK_MEMO_MAX)
+			wpa_psk_memo_del(wpa_auth,
+					 dl_list_last(&wpa_auth->psk_memo_lru,
+						      struct wpa_psk_memo,
+						      lru));
+		memo = os_zalloc(sizeof(*memo));
+		if (!memo)
+			return;
+		os_memcpy(memo->addr, addr, ETH_ALEN);
+		dl_list_add(&wpa_auth->psk_memo[WPA_PSK_MEMO_HASH(addr)],
+			    &memo->hash);
+		wpa_auth->num_psk_memo++;
+	}
+	dl_list_add(&wpa_auth->psk_memo_lru, &memo->lru);
+	os_memcpy(memo->pmk, pmk, pmk_len);
+	memo->pmk_len = pmk_len;
+}
+
+
+/**
+ * wpa_psk_memo_try - Try the PSK that was last used by the station
+ * @sm: Pointer to WPA state machine data
+ * @snonce: SNonce from the EAPOL-Key frame
+ * @data: EAPOL-Key frame
+ * @data_len: Length of @data
+ * @ptk: Buffer for the derived PTK
+ * @pmk_len: Buffer for the length of the returned PSK
+ * @vlan_id: Buffer for the VLAN ID of the returned PSK
+ * Returns: Pointer to the matching configured PSK or %NULL if the memorized
+ * PSK did not result in a matching MIC or is not configured anymore
+ *
+ * With a large number of PSKs (e.g., wpa_psk_file), trying all of them for
+ * each EAPOL-Key msg 2/4 is expensive. This allows a returning station to be
+ * matched with a single PTK derivation. With FT-PSK, sm->xxkey is set to the
+ * returned PSK.
+ */
+static const u8 * wpa_psk_memo_try(struct wpa_state_machine *sm,
+				   const u8 *snonce, u8 *data,
+				   size_t data_len, struct wpa_ptk *ptk,
+				   size_t *pmk_len, int *vlan_id)
+{
+	struct wpa_authenticator *wpa_auth = sm->wpa_auth;
+	struct wpa_psk_memo *memo;
+	const u8 *pmk = NULL;
+#ifdef CONFIG_IEEE80211R_AP
+	u8 xxkey[PMK_LEN_MAX];
+	size_t xxkey_len = 0;
+#endif /* CONFIG_IEEE80211R_AP */
+
+	memo = wpa_psk_memo_get(wpa_auth, sm->addr);
+	if (!memo)
+		return NULL;
+
+#ifdef CONFIG_IEEE80211R_AP
+	/* FT-PSK derives the PTK from xxkey instead of the PMK argument */
+	if (wpa_key_mgmt_ft_psk(sm->wpa_key_mgmt)) {
+		xxkey_len = sm->xxkey_len;
+		os_memcpy(xxkey, sm->xxkey, xxkey_len);
+		os_memcpy(sm->xxkey, memo->pmk, memo->pmk_len);
+		sm->xxkey_len = memo->pmk_len;
+	}
+#endif /* CONFIG_IEEE80211R_AP */
+
+	if (wpa_derive_ptk(sm, snonce, memo->pmk, memo->pmk_len, ptk, 0) < 0 ||
+	    wpa_verify_key_mic(sm->wpa_key_mgmt, memo->pmk_len, ptk,
+			       data, data_len) != 0)
+		goto fail;
+
+	/* Make sure the PSK is still configured for this station and return
+	 * the configured copy along with its parameters. */
+	for (;;) {
+		pmk = wpa_auth_get_psk(wpa_auth, sm->addr, sm->p2p_dev_addr,
+				       pmk, pmk_len, vlan_id);
+		if (!pmk)
+			break;
+		if (*pmk_len == memo->pmk_len &&
+		    os_memcmp(pmk, memo->pmk, memo->pmk_len) == 0) {
+			wpa_printf(MSG_DEBUG,
+				   "WPA: Previously used PSK for " MACSTR
+				   " resulted in matching MIC",
+				   MAC2STR(sm->addr));
+			dl_list_del(&memo->lru);
+			dl_list_add(&wpa_auth->psk_memo_lru, &memo->lru);
+			wpa_auth->psk_memo_hits++;
+#ifdef CONFIG_IEEE80211R_AP
+			forced_memzero(xxkey, sizeof(xxkey));
+#endif /* CONFIG_IEEE80211R_AP */
+			return pmk;
+		}
+	}
+
+	wpa_psk_memo_del(wpa_auth, memo);
+fail:
+	forced_memzero(ptk, sizeof(*ptk));
+	*vlan_id = 0;
+#ifdef CONFIG_IEEE80211R_AP
+	if (wpa_key_mgmt_ft_psk(sm->wpa_key_mgmt)) {
+		os_memcpy(sm->xxkey, xxkey, xxkey_len);
+		sm->xxkey_len = xxkey_len;
+		forced_memzero(xxkey, sizeof(xxkey));
+	}
+#endif /* CONFIG_IEEE80211R_AP */
+	return NULL;
+}
+
+
 static int wpa_try_alt_snonce(struct wpa_state_machine *sm, u8 *data,
 			      size_t data_len)
 {
@@ -959,7 +1190,16 @@ static int wpa_try_alt_snonce(struct wpa_state_machine *sm, u8 *data,
 	int vlan_id = 0;
 
 	os_memset(&PTK, 0, sizeof(PTK));
-	for (;;) {
+	if (wpa_key_mgmt_wpa_psk_no_sae(sm->wpa_key_mgmt)) {
+		pmk = wpa_psk_memo_try(sm, sm->alt_SNonce, data, data_len,
+				       &PTK, &pmk_len, &vlan_id);
+		if (pmk) {
+			os_memcpy(sm->PMK, pmk, pmk_len);
+			sm->pmk_len = pmk_len;
+			ok = 1;
+		}
+	}
+	while (!ok) {
 		if (wpa_key_mgmt_wpa_psk(sm->wpa_key_mgmt) &&
 		    !wpa_key_mgmt_sae(sm->wpa_key_mgmt)) {
 			pmk = wpa_auth_get_psk(sm->wpa_auth, sm->addr,
@@ -1007,6 +1247,9 @@ static int wpa_try_alt_snonce(struct wpa_state_machine *sm, u8 *data,
 		   "WPA: Earlier SNonce resulted in matching MIC");
 	sm->alt_snonce_valid = 0;
 
+	if (wpa_key_mgmt_wpa_psk_no_sae(sm->wpa_key_mgmt))
+		wpa_psk_memo_set(sm->wpa_auth, sm->addr, sm->PMK, sm->pmk_len);
+
 	if (vlan_id && wpa_key_mgmt_wpa_psk(sm->wpa_key_mgmt) &&
 	    wpa_auth_update_vlan(sm->wpa_auth, sm->addr, vlan_id) < 0)
 		return -1;
@@ -1068,6 +1311,8 @@ void wpa_receive(struct wpa_authenticator *wpa_auth,
 		   " key_info=0x%x type=%u mic_len=%zu key_data_length=%u",
 		   MAC2STR(sm->addr), key_info, key->type,
 		   mic_len, key_data_length);
+	flight_recorder_record(FR_EV_AUTH_EAPOL_KEY_RX, wpa_auth->conf.ifname,
+			       sm->addr, key_info, key_data_length);
 	wpa_hexdump(MSG_MSGDUMP,
 		    "WPA: EAPOL-Key header (ending before Key MIC)",
 		    key, sizeof(*key));
@@ -1337,6 +1582,9 @@ continue_processing:
 		     wpa_try_alt_snonce(sm, data, data_len))) {
 			wpa_auth_logger(wpa_auth, sm->addr, LOGGER_INFO,
 					"received EAPOL-Key with invalid MIC");
+			flight_recorder_record(FR_EV_AUTH_KEY_MIC_FAILURE,
+					       wpa_auth->conf.ifname, sm->addr,
+					       key_info, 0);
 #ifdef TEST_FUZZ
 			wpa_printf(MSG_INFO,
 				   "TEST: Ignore Key MIC failure for fuzz testing");
@@ -1350,6 +1598,9 @@ continue_processing:
 				     &key_data_length) < 0) {
 			wpa_auth_logger(wpa_auth, sm->addr, LOGGER_INFO,
 					"received EAPOL-Key with invalid MIC");
+			flight_recorder_record(FR_EV_AUTH_KEY_MIC_FAILURE,
+					       wpa_auth->conf.ifname, sm->addr,
+					       key_info, 0);
 #ifdef TEST_FUZZ
 			wpa_printf(MSG_INFO,
 				   "TEST: Ignore Key MIC failure for fuzz testing");
@@ -1828,6 +2079,8 @@ int wpa_auth_sm_event(struct wpa_state_machine *sm, enum wpa_event event)
 
 	wpa_auth_vlogger(sm->wpa_auth, sm->addr, LOGGER_DEBUG,
 			 "event %d notification", event);
+	flight_recorder_record(FR_EV_AUTH_SM_EVENT, sm->wpa_auth->conf.ifname,
+			       sm->addr, event, 0);
 
 	switch (event) {
 	case WPA_AUTH:
@@ -3055,10 +3308,23 @@ SM_STATE(WPA_PTK, PTKCALCNEGOTIATING)
 
 	mic_len = wpa_mic_len(sm->wpa_key_mgmt, sm->pmk_len);
 
+	/* WPA-PSK: try the PSK the station used previously first */
+	if (mic_len && wpa_key_mgmt_wpa_psk_no_sae(sm->wpa_key_mgmt)) {
+		pmk = wpa_psk_memo_try(sm, sm->SNonce, sm->last_rx_eapol_key,
+				       sm->last_rx_eapol_key_len, &PTK,
+				       &pmk_len, &vlan_id);
+		if (pmk) {
+			psk_found = 1;
+			os_memcpy(sm->PMK, pmk, pmk_len);
+			sm->pmk_len = pmk_len;
+			ok = 1;
+		}
+	}
+
 	/* WPA with IEEE 802.1X: use the derived PMK from EAP
 	 * WPA-PSK: iterate through possible PSKs and select the one matching
 	 * the packet */
-	for (;;) {
+	while (!ok) {
 		if (wpa_key_mgmt_wpa_psk(sm->wpa_key_mgmt) &&
 		    !wpa_key_mgmt_sae(sm->wpa_key_mgmt)) {
 			pmk = wpa_auth_get_psk(sm->wpa_auth, sm->addr,
@@ -3145,6 +3411,9 @@ SM_STATE(WPA_PTK, PTKCALCNEGOTIATING)
 		return;
 	}
 
+	if (psk_found)
+		wpa_psk_memo_set(wpa_auth, sm->addr, sm->PMK, sm->pmk_len);
+
 	/*
 	 * Note: last_rx_eapol_key length fields have already been validated in
 	 * wpa_receive().
@@ -3813,6 +4082,9 @@ SM_STATE(WPA_PTK, PTKINITDONE)
 
 		/* FIX: MLME-SetProtection.Request(TA, Tx_Rx) */
 		sm->pairwise_set = true;
+		flight_recorder_record(FR_EV_AUTH_PTK_INSTALLED,
+				       sm->wpa_auth->conf.ifname, sm->addr,
+				       sm->pairwise, sm->keyidx_active);
 
 		wpa_auth_set_ptk_rekey_timer(sm);
 		wpa_auth_store_ptksa(sm->wpa_auth, sm->addr, sm->pairwise,
@@ -3915,6 +4187,9 @@ SM_STEP(WPA_PTK)
 #endif /* CONFIG_DPP */
 		} else {
 			wpa_auth->dot11RSNA4WayHandshakeFailures++;
+			flight_recorder_record(FR_EV_AUTH_4WAY_FAILED,
+					       wpa_auth->conf.ifname, sm->addr,
+					       sm->wpa_ptk_state, sm->TimeoutCtr);
 			wpa_auth_logger(wpa_auth, sm->addr, LOGGER_INFO,
 					"INITPMK - keyAvailable = false");
 			SM_ENTER(WPA_PTK, DISCONNECT);
@@ -3937,6 +4212,9 @@ SM_STEP(WPA_PTK)
 			wpa_auth_logger(wpa_auth, sm->addr, LOGGER_INFO,
 					"no PSK configured for the STA");
 			wpa_auth->dot11RSNA4WayHandshakeFailures++;
+			flight_recorder_record(FR_EV_AUTH_4WAY_FAILED,
+					       wpa_auth->conf.ifname, sm->addr,
+					       sm->wpa_ptk_state, sm->TimeoutCtr);
 			SM_ENTER(WPA_PTK, DISCONNECT);
 		}
 		break;
@@ -3946,6 +4224,9 @@ SM_STEP(WPA_PTK)
 			SM_ENTER(WPA_PTK, PTKCALCNEGOTIATING);
 		else if (sm->TimeoutCtr > conf->wpa_pairwise_update_count) {
 			wpa_auth->dot11RSNA4WayHandshakeFailures++;
+			flight_recorder_record(FR_EV_AUTH_4WAY_FAILED,
+					       wpa_auth->conf.ifname, sm->addr,
+					       sm->wpa_ptk_state, sm->TimeoutCtr);
 			wpa_auth_vlogger(wpa_auth, sm->addr, LOGGER_DEBUG,
 					 "PTKSTART: Retry limit %u reached",
 					 conf->wpa_pairwise_update_count);
@@ -3978,6 +4259,9 @@ SM_STEP(WPA_PTK)
 			 (conf->wpa_disable_eapol_key_retries &&
 			  sm->TimeoutCtr > 1)) {
 			wpa_auth->dot11RSNA4WayHandshakeFailures++;
+			flight_recorder_record(FR_EV_AUTH_4WAY_FAILED,
+					       wpa_auth->conf.ifname, sm->addr,
+					       sm->wpa_ptk_state, sm->TimeoutCtr);
 			wpa_auth_vlogger(wpa_auth, sm->addr, LOGGER_DEBUG,
 					 "PTKINITNEGOTIATING: Retry limit %u reached",
 					 conf->wpa_pairwise_update_count);
@@ -4770,6 +5054,10 @@ int wpa_get_mib(struct wpa_authenticator *wpa_auth, char *buf, size_t buflen)
 		return len;
 	len += ret;
 
+#ifdef CONFIG_IEEE80211R_AP
+	len += wpa_ft_pmk_cache_mib(wpa_auth, buf + len, buflen - len);
+#endif /* CONFIG_IEEE80211R_AP */
+
 	return len;
 }
 
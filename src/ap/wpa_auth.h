@@ -169,6 +169,7 @@ struct ft_remote_r1kh {
 
 struct wpa_auth_config {
 	void *msg_ctx;
+	const char *ifname;
 	int wpa;
 	int extended_key_id;
 	int wpa_key_mgmt;
@@ -277,6 +278,12 @@ struct wpa_auth_config {
 	bool force_kdk_derivation;
 
 	bool radius_psk;
+
+#ifdef CONFIG_PMK_STORE
+	const char *pmk_store;
+	u8 pmk_store_key[32];
+	unsigned int pmk_store_slots;
+#endif /* CONFIG_PMK_STORE */
 };
 
 typedef enum {
@@ -11,6 +11,7 @@
 #include "utils/common.h"
 #include "utils/eloop.h"
 #include "utils/list.h"
+#include "utils/siphash.h"
 #include "common/ieee802_11_defs.h"
 #include "common/ieee802_11_common.h"
 #include "common/ocv.h"
@@ -1199,6 +1200,7 @@ static int wpa_ft_new_seq(struct ft_remote_seq *rkh_seq,
 
 struct wpa_ft_pmk_r0_sa {
 	struct dl_list list;
+	struct wpa_ft_pmk_r0_sa *hnext;
 	u8 pmk_r0[PMK_LEN_MAX];
 	size_t pmk_r0_len;
 	u8 pmk_r0_name[WPA_PMK_NAME_LEN];
@@ -1213,95 +1215,176 @@ struct wpa_ft_pmk_r0_sa {
 	os_time_t session_timeout; /* 0 for no expiration */
 	/* TODO: radius_class, EAP type */
 	int pmk_r1_pushed;
+#ifdef CONFIG_PMK_STORE
+	int store_slot; /* slot in the persistent store or 0 if not stored */
+#endif /* CONFIG_PMK_STORE */
 };
 
 struct wpa_ft_pmk_r1_sa {
 	struct dl_list list;
+	struct wpa_ft_pmk_r1_sa *hnext;
 	u8 pmk_r1[PMK_LEN_MAX];
 	size_t pmk_r1_len;
 	u8 pmk_r1_name[WPA_PMK_NAME_LEN];
 	u8 spa[ETH_ALEN];
 	int pairwise; /* Pairwise cipher suite, WPA_CIPHER_* */
 	struct vlan_description *vlan;
+	os_time_t expiration; /* 0 for no expiration */
 	u8 *identity;
 	size_t identity_len;
 	u8 *radius_cui;
 	size_t radius_cui_len;
 	os_time_t session_timeout; /* 0 for no expiration */
 	/* TODO: radius_class, EAP type */
+#ifdef CONFIG_PMK_STORE
+	int store_slot; /* slot in the persistent store or 0 if not stored */
+#endif /* CONFIG_PMK_STORE */
 };
 
 struct wpa_ft_pmk_cache {
+	/* Entries are ordered by the time they need to be removed from the
+	 * cache, with the entries that do not expire at the end, so that a
+	 * single timeout is needed for expiring them. */
 	struct dl_list pmk_r0; /* struct wpa_ft_pmk_r0_sa */
 	struct dl_list pmk_r1; /* struct wpa_ft_pmk_r1_sa */
+
+	/* PMK-R0 entries are hashed by SPA (PMK-R1 push looks them up with
+	 * the SPA only) and PMK-R1 entries by SPA and PMKR1Name. */
+#define FT_PMK_HASH_SIZE 256
+	struct wpa_ft_pmk_r0_sa *pmk_r0_hash[FT_PMK_HASH_SIZE];
+	struct wpa_ft_pmk_r1_sa *pmk_r1_hash[FT_PMK_HASH_SIZE];
+	u8 hash_key[SIPHASH_KEY_LEN];
+
+	unsigned int num_pmk_r0;
+	unsigned int num_pmk_r1;
+	/* Statistics; probes is the number of entries compared */
+	unsigned int pmk_r0_lookups, pmk_r0_hits, pmk_r0_probes;
+	unsigned int pmk_r1_lookups, pmk_r1_hits, pmk_r1_probes;
+
+#ifdef CONFIG_PMK_STORE
+	struct pmk_store *store;
+#endif /* CONFIG_PMK_STORE */
 };
 
 
-static void wpa_ft_expire_pmk_r0(void *eloop_ctx, void *timeout_ctx);
-static void wpa_ft_expire_pmk_r1(void *eloop_ctx, void *timeout_ctx);
+static void wpa_ft_pmk_cache_expire(void *eloop_ctx, void *timeout_ctx);
 
 
-static void wpa_ft_free_pmk_r0(struct wpa_ft_pmk_r0_sa *r0)
+static unsigned int wpa_ft_pmk_r0_hash(struct wpa_ft_pmk_cache *cache,
+				       const u8 *spa)
 {
-	if (!r0)
-		return;
+	return siphash24(cache->hash_key, spa, ETH_ALEN) &
+		(FT_PMK_HASH_SIZE - 1);
+}
 
-	dl_list_del(&r0->list);
-	eloop_cancel_timeout(wpa_ft_expire_pmk_r0, r0, NULL);
 
-	os_memset(r0->pmk_r0, 0, PMK_LEN_MAX);
-	os_free(r0->vlan);
-	os_free(r0->identity);
-	os_free(r0->radius_cui);
-	os_free(r0);
+static unsigned int wpa_ft_pmk_r1_hash(struct wpa_ft_pmk_cache *cache,
+				       const u8 *spa, const u8 *pmk_r1_name)
+{
+	u8 buf[ETH_ALEN + WPA_PMK_NAME_LEN];
+
+	os_memcpy(buf, spa, ETH_ALEN);
+	os_memcpy(buf + ETH_ALEN, pmk_r1_name, WPA_PMK_NAME_LEN);
+	return siphash24(cache->hash_key, buf, sizeof(buf)) &
+		(FT_PMK_HASH_SIZE - 1);
+}
+
+
+/* Time when an entry needs to be removed or 0 if it does not expire */
+static os_time_t wpa_ft_pmk_deadline(os_time_t expiration,
+				     os_time_t session_timeout)
+{
+	if (!expiration || (session_timeout && session_timeout < expiration))
+		return session_timeout;
+	return expiration;
 }
 
 
-static void wpa_ft_expire_pmk_r0(void *eloop_ctx, void *timeout_ctx)
+static int wpa_ft_pmk_expires_before(os_time_t deadline, os_time_t other)
 {
-	struct wpa_ft_pmk_r0_sa *r0 = eloop_ctx;
+	return deadline && (!other || deadline < other);
+}
+
+
+static void wpa_ft_pmk_cache_set_expiration(struct wpa_ft_pmk_cache *cache)
+{
+	struct wpa_ft_pmk_r0_sa *r0;
+	struct wpa_ft_pmk_r1_sa *r1;
+	os_time_t deadline = 0, r1_deadline;
 	struct os_reltime now;
-	int expires_in;
-	int session_timeout;
+
+	eloop_cancel_timeout(wpa_ft_pmk_cache_expire, cache, NULL);
+
+	r0 = dl_list_first(&cache->pmk_r0, struct wpa_ft_pmk_r0_sa, list);
+	if (r0)
+		deadline = wpa_ft_pmk_deadline(r0->expiration,
+					       r0->session_timeout);
+	r1 = dl_list_first(&cache->pmk_r1, struct wpa_ft_pmk_r1_sa, list);
+	if (r1) {
+		r1_deadline = wpa_ft_pmk_deadline(r1->expiration,
+						  r1->session_timeout);
+		if (wpa_ft_pmk_expires_before(r1_deadline, deadline))
+			deadline = r1_deadline;
+	}
+	if (!deadline)
+		return;
 
 	os_get_reltime(&now);
+	eloop_register_timeout(deadline > now.sec ? deadline - now.sec + 1 : 1,
+			       0, wpa_ft_pmk_cache_expire, cache, NULL);
+}
+
+
+static void wpa_ft_free_pmk_r0(struct wpa_ft_pmk_cache *cache,
+			       struct wpa_ft_pmk_r0_sa *r0)
+{
+	struct wpa_ft_pmk_r0_sa **pos;
 
 	if (!r0)
 		return;
 
-	expires_in = r0->expiration - now.sec;
-	session_timeout = r0->session_timeout - now.sec;
-	/* conditions to remove from cache:
-	 * a) r0->expiration is set and hit
-	 * -or-
-	 * b) r0->session_timeout is set and hit
-	 */
-	if ((!r0->expiration || expires_in > 0) &&
-	    (!r0->session_timeout || session_timeout > 0)) {
-		wpa_printf(MSG_ERROR,
-			   "FT: %s() called for non-expired entry %p",
-			   __func__, r0);
-		eloop_cancel_timeout(wpa_ft_expire_pmk_r0, r0, NULL);
-		if (r0->expiration && expires_in > 0)
-			eloop_register_timeout(expires_in + 1, 0,
-					       wpa_ft_expire_pmk_r0, r0, NULL);
-		if (r0->session_timeout && session_timeout > 0)
-			eloop_register_timeout(session_timeout + 1, 0,
-					       wpa_ft_expire_pmk_r0, r0, NULL);
-		return;
+	for (pos = &cache->pmk_r0_hash[wpa_ft_pmk_r0_hash(cache, r0->spa)];
+	     *pos; pos = &(*pos)->hnext) {
+		if (*pos == r0) {
+			*pos = r0->hnext;
+			break;
+		}
 	}
+	dl_list_del(&r0->list);
+	cache->num_pmk_r0--;
+#ifdef CONFIG_PMK_STORE
+	pmk_store_del(cache->store, r0->store_slot);
+#endif /* CONFIG_PMK_STORE */
 
-	wpa_ft_free_pmk_r0(r0);
+	os_memset(r0->pmk_r0, 0, PMK_LEN_MAX);
+	os_free(r0->vlan);
+	os_free(r0->identity);
+	os_free(r0->radius_cui);
+	os_free(r0);
 }
 
 
-static void wpa_ft_free_pmk_r1(struct wpa_ft_pmk_r1_sa *r1)
+static void wpa_ft_free_pmk_r1(struct wpa_ft_pmk_cache *cache,
+			       struct wpa_ft_pmk_r1_sa *r1)
 {
+	struct wpa_ft_pmk_r1_sa **pos;
+
 	if (!r1)
 		return;
 
+	for (pos = &cache->pmk_r1_hash[wpa_ft_pmk_r1_hash(cache, r1->spa,
+							   r1->pmk_r1_name)];
+	     *pos; pos = &(*pos)->hnext) {
+		if (*pos == r1) {
+			*pos = r1->hnext;
+			break;
+		}
+	}
 	dl_list_del(&r1->list);
-	eloop_cancel_timeout(wpa_ft_expire_pmk_r1, r1, NULL);
+	cache->num_pmk_r1--;
+#ifdef CONFIG_PMK_STORE
+	pmk_store_del(cache->store, r1->store_slot);
+#endif /* CONFIG_PMK_STORE */
 
 	os_memset(r1->pmk_r1, 0, PMK_LEN_MAX);
 	os_free(r1->vlan);
@@ -1311,11 +1394,40 @@ static void wpa_ft_free_pmk_r1(struct wpa_ft_pmk_r1_sa *r1)
 }
 
 
-static void wpa_ft_expire_pmk_r1(void *eloop_ctx, void *timeout_ctx)
+static void wpa_ft_pmk_cache_expire(void *eloop_ctx, void *timeout_ctx)
 {
-	struct wpa_ft_pmk_r1_sa *r1 = eloop_ctx;
+	struct wpa_ft_pmk_cache *cache = eloop_ctx;
+	struct wpa_ft_pmk_r0_sa *r0;
+	struct wpa_ft_pmk_r1_sa *r1;
+	os_time_t deadline;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+
+	/* Remove entries whose expiration or session timeout has been hit */
+	while ((r0 = dl_list_first(&cache->pmk_r0, struct wpa_ft_pmk_r0_sa,
+				   list))) {
+		deadline = wpa_ft_pmk_deadline(r0->expiration,
+					       r0->session_timeout);
+		if (!deadline || deadline > now.sec)
+			break;
+		wpa_printf(MSG_DEBUG, "FT: Expire PMK-R0 for " MACSTR,
+			   MAC2STR(r0->spa));
+		wpa_ft_free_pmk_r0(cache, r0);
+	}
 
-	wpa_ft_free_pmk_r1(r1);
+	while ((r1 = dl_list_first(&cache->pmk_r1, struct wpa_ft_pmk_r1_sa,
+				   list))) {
+		deadline = wpa_ft_pmk_deadline(r1->expiration,
+					       r1->session_timeout);
+		if (!deadline || deadline > now.sec)
+			break;
+		wpa_printf(MSG_DEBUG, "FT: Expire PMK-R1 for " MACSTR,
+			   MAC2STR(r1->spa));
+		wpa_ft_free_pmk_r1(cache, r1);
+	}
+
+	wpa_ft_pmk_cache_set_expiration(cache);
 }
 
 
@@ -1327,6 +1439,10 @@ struct wpa_ft_pmk_cache * wpa_ft_pmk_cache_init(void)
 	if (cache) {
 		dl_list_init(&cache->pmk_r0);
 		dl_list_init(&cache->pmk_r1);
+		if (os_get_random(cache->hash_key,
+				  sizeof(cache->hash_key)) < 0)
+			wpa_printf(MSG_INFO,
+				   "FT: Could not get random PMK cache hash key");
 	}
 
 	return cache;
@@ -1338,18 +1454,162 @@ void wpa_ft_pmk_cache_deinit(struct wpa_ft_pmk_cache *cache)
 	struct wpa_ft_pmk_r0_sa *r0, *r0prev;
 	struct wpa_ft_pmk_r1_sa *r1, *r1prev;
 
+	eloop_cancel_timeout(wpa_ft_pmk_cache_expire, cache, NULL);
+
+#ifdef CONFIG_PMK_STORE
+	/* Leave the entries in the persistent store */
+	cache->store = NULL;
+#endif /* CONFIG_PMK_STORE */
+
 	dl_list_for_each_safe(r0, r0prev, &cache->pmk_r0,
 			      struct wpa_ft_pmk_r0_sa, list)
-		wpa_ft_free_pmk_r0(r0);
+		wpa_ft_free_pmk_r0(cache, r0);
 
 	dl_list_for_each_safe(r1, r1prev, &cache->pmk_r1,
 			      struct wpa_ft_pmk_r1_sa, list)
-		wpa_ft_free_pmk_r1(r1);
+		wpa_ft_free_pmk_r1(cache, r1);
 
 	os_free(cache);
 }
 
 
+#ifdef CONFIG_PMK_STORE
+static int wpa_ft_pmk_store_put(struct wpa_ft_pmk_cache *cache,
+				enum pmk_store_type type, const u8 *spa,
+				const u8 *pmk, size_t pmk_len,
+				const u8 *pmk_name, int pairwise,
+				const struct vlan_description *vlan,
+				os_time_t expiration, os_time_t session_timeout,
+				const u8 *identity, size_t identity_len,
+				const u8 *radius_cui, size_t radius_cui_len)
+{
+	struct wpabuf *buf;
+	int slot;
+
+	buf = wpabuf_alloc(300 + identity_len + radius_cui_len);
+	if (!buf)
+		return 0;
+	wpabuf_put_data(buf, spa, ETH_ALEN);
+	wpabuf_put_u8(buf, pmk_len);
+	wpabuf_put_data(buf, pmk, pmk_len);
+	wpabuf_put_data(buf, pmk_name, WPA_PMK_NAME_LEN);
+	wpabuf_put_le32(buf, pairwise);
+	pmk_store_put_vlan(buf, vlan);
+	pmk_store_put_time(buf, expiration);
+	pmk_store_put_time(buf, session_timeout);
+	pmk_store_put_var(buf, identity, identity_len);
+	pmk_store_put_var(buf, radius_cui, radius_cui_len);
+
+	slot = pmk_store_put(cache->store, type, buf);
+	wpabuf_clear_free(buf);
+	return slot > 0 ? slot : 0;
+}
+#endif /* CONFIG_PMK_STORE */
+
+
+static void wpa_ft_link_pmk_r0(struct wpa_ft_pmk_cache *cache,
+			       struct wpa_ft_pmk_r0_sa *r0)
+{
+	struct wpa_ft_pmk_r0_sa *pos;
+	os_time_t deadline;
+	unsigned int hash;
+
+	/* Search from the end since new entries normally expire last */
+	deadline = wpa_ft_pmk_deadline(r0->expiration, r0->session_timeout);
+	dl_list_for_each_reverse(pos, &cache->pmk_r0, struct wpa_ft_pmk_r0_sa,
+				 list) {
+		if (!wpa_ft_pmk_expires_before(
+			    deadline, wpa_ft_pmk_deadline(pos->expiration,
+							  pos->session_timeout)))
+			break;
+	}
+	dl_list_add(&pos->list, &r0->list);
+
+	hash = wpa_ft_pmk_r0_hash(cache, r0->spa);
+	r0->hnext = cache->pmk_r0_hash[hash];
+	cache->pmk_r0_hash[hash] = r0;
+	cache->num_pmk_r0++;
+
+#ifdef CONFIG_PMK_STORE
+	if (cache->store && !r0->store_slot)
+		r0->store_slot = wpa_ft_pmk_store_put(
+			cache, PMK_STORE_FT_PMK_R0, r0->spa, r0->pmk_r0,
+			r0->pmk_r0_len, r0->pmk_r0_name, r0->pairwise,
+			r0->vlan, r0->expiration, r0->session_timeout,
+			r0->identity, r0->identity_len,
+			r0->radius_cui, r0->radius_cui_len);
+#endif /* CONFIG_PMK_STORE */
+
+	if (r0->list.prev == &cache->pmk_r0)
+		wpa_ft_pmk_cache_set_expiration(cache);
+}
+
+
+static void wpa_ft_link_pmk_r1(struct wpa_ft_pmk_cache *cache,
+			       struct wpa_ft_pmk_r1_sa *r1)
+{
+	struct wpa_ft_pmk_r1_sa *pos;
+	os_time_t deadline;
+	unsigned int hash;
+
+	deadline = wpa_ft_pmk_deadline(r1->expiration, r1->session_timeout);
+	dl_list_for_each_reverse(pos, &cache->pmk_r1, struct wpa_ft_pmk_r1_sa,
+				 list) {
+		if (!wpa_ft_pmk_expires_before(
+			    deadline, wpa_ft_pmk_deadline(pos->expiration,
+							  pos->session_timeout)))
+			break;
+	}
+	dl_list_add(&pos->list, &r1->list);
+
+	hash = wpa_ft_pmk_r1_hash(cache, r1->spa, r1->pmk_r1_name);
+	r1->hnext = cache->pmk_r1_hash[hash];
+	cache->pmk_r1_hash[hash] = r1;
+	cache->num_pmk_r1++;
+
+#ifdef CONFIG_PMK_STORE
+	if (cache->store && !r1->store_slot)
+		r1->store_slot = wpa_ft_pmk_store_put(
+			cache, PMK_STORE_FT_PMK_R1, r1->spa, r1->pmk_r1,
+			r1->pmk_r1_len, r1->pmk_r1_name, r1->pairwise,
+			r1->vlan, r1->expiration, r1->session_timeout,
+			r1->identity, r1->identity_len,
+			r1->radius_cui, r1->radius_cui_len);
+#endif /* CONFIG_PMK_STORE */
+
+	if (r1->list.prev == &cache->pmk_r1)
+		wpa_ft_pmk_cache_set_expiration(cache);
+}
+
+
+int wpa_ft_pmk_cache_mib(struct wpa_authenticator *wpa_auth, char *buf,
+			 size_t buflen)
+{
+	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
+	int ret;
+
+	if (!cache)
+		return 0;
+
+	ret = os_snprintf(buf, buflen,
+			  "hostapdFTPMKR0Entries=%u\n"
+			  "hostapdFTPMKR0Lookups=%u\n"
+			  "hostapdFTPMKR0Hits=%u\n"
+			  "hostapdFTPMKR0Probes=%u\n"
+			  "hostapdFTPMKR1Entries=%u\n"
+			  "hostapdFTPMKR1Lookups=%u\n"
+			  "hostapdFTPMKR1Hits=%u\n"
+			  "hostapdFTPMKR1Probes=%u\n",
+			  cache->num_pmk_r0, cache->pmk_r0_lookups,
+			  cache->pmk_r0_hits, cache->pmk_r0_probes,
+			  cache->num_pmk_r1, cache->pmk_r1_lookups,
+			  cache->pmk_r1_hits, cache->pmk_r1_probes);
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+	return ret;
+}
+
+
 static int wpa_ft_store_pmk_r0(struct wpa_authenticator *wpa_auth,
 			       const u8 *spa, const u8 *pmk_r0,
 			       size_t pmk_r0_len,
@@ -1402,13 +1662,7 @@ static int wpa_ft_store_pmk_r0(struct wpa_authenticator *wpa_auth,
 	if (session_timeout > 0)
 		r0->session_timeout = now.sec + session_timeout;
 
-	dl_list_add(&cache->pmk_r0, &r0->list);
-	if (expires_in > 0)
-		eloop_register_timeout(expires_in + 1, 0, wpa_ft_expire_pmk_r0,
-				       r0, NULL);
-	if (session_timeout > 0)
-		eloop_register_timeout(session_timeout + 1, 0,
-				       wpa_ft_expire_pmk_r0, r0, NULL);
+	wpa_ft_link_pmk_r0(cache, r0);
 
 	return 0;
 }
@@ -1420,13 +1674,15 @@ static int wpa_ft_fetch_pmk_r0(struct wpa_authenticator *wpa_auth,
 {
 	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
 	struct wpa_ft_pmk_r0_sa *r0;
-	struct os_reltime now;
 
-	os_get_reltime(&now);
-	dl_list_for_each(r0, &cache->pmk_r0, struct wpa_ft_pmk_r0_sa, list) {
+	cache->pmk_r0_lookups++;
+	for (r0 = cache->pmk_r0_hash[wpa_ft_pmk_r0_hash(cache, spa)]; r0;
+	     r0 = r0->hnext) {
+		cache->pmk_r0_probes++;
 		if (os_memcmp(r0->spa, spa, ETH_ALEN) == 0 &&
 		    os_memcmp_const(r0->pmk_r0_name, pmk_r0_name,
 				    WPA_PMK_NAME_LEN) == 0) {
+			cache->pmk_r0_hits++;
 			*r0_out = r0;
 			return 0;
 		}
@@ -1488,17 +1744,12 @@ static int wpa_ft_store_pmk_r1(struct wpa_authenticator *wpa_auth,
 			r1->radius_cui_len = radius_cui_len;
 		}
 	}
+	if (expires_in > 0)
+		r1->expiration = now.sec + expires_in;
 	if (session_timeout > 0)
 		r1->session_timeout = now.sec + session_timeout;
 
-	dl_list_add(&cache->pmk_r1, &r1->list);
-
-	if (expires_in > 0)
-		eloop_register_timeout(expires_in + 1, 0, wpa_ft_expire_pmk_r1,
-				       r1, NULL);
-	if (session_timeout > 0)
-		eloop_register_timeout(session_timeout + 1, 0,
-				       wpa_ft_expire_pmk_r1, r1, NULL);
+	wpa_ft_link_pmk_r1(cache, r1);
 
 	return 0;
 }
@@ -1518,10 +1769,15 @@ int wpa_ft_fetch_pmk_r1(struct wpa_authenticator *wpa_auth,
 
 	os_get_reltime(&now);
 
-	dl_list_for_each(r1, &cache->pmk_r1, struct wpa_ft_pmk_r1_sa, list) {
+	cache->pmk_r1_lookups++;
+	for (r1 = cache->pmk_r1_hash[wpa_ft_pmk_r1_hash(cache, spa,
+							pmk_r1_name)];
+	     r1; r1 = r1->hnext) {
+		cache->pmk_r1_probes++;
 		if (os_memcmp(r1->spa, spa, ETH_ALEN) == 0 &&
 		    os_memcmp_const(r1->pmk_r1_name, pmk_r1_name,
 				    WPA_PMK_NAME_LEN) == 0) {
+			cache->pmk_r1_hits++;
 			os_memcpy(pmk_r1, r1->pmk_r1, r1->pmk_r1_len);
 			*pmk_r1_len = r1->pmk_r1_len;
 			if (pairwise)
@@ -1553,6 +1809,253 @@ int wpa_ft_fetch_pmk_r1(struct wpa_authenticator *wpa_auth,
 }
 
 
+#ifdef CONFIG_MODULE_TESTS
+
+struct wpa_ft_pmk_cache_test {
+	int r1; /* PMK-R1 instead of PMK-R0 */
+	int expires_in;
+	int session_timeout;
+};
+
+/* Entries in the order they are added; the order of expiration is 4, 3, 5,
+ * 6, 0, 1 and 2 does not expire. */
+static const struct wpa_ft_pmk_cache_test wpa_ft_pmk_cache_test_entries[] = {
+	{ 0, 300, 0 },
+	{ 1, 0, 0 },
+	{ 0, 0, 0 },
+	{ 0, 100, 0 },
+	{ 1, 50, 0 },
+	{ 0, 0, 200 },
+	{ 1, 400, 250 },
+};
+
+#define FT_PMK_TEST_NUM ARRAY_SIZE(wpa_ft_pmk_cache_test_entries)
+
+
+static void wpa_ft_pmk_cache_test_age(struct wpa_ft_pmk_cache *cache,
+				      os_time_t sec)
+{
+	struct wpa_ft_pmk_r0_sa *r0;
+	struct wpa_ft_pmk_r1_sa *r1;
+
+	dl_list_for_each(r0, &cache->pmk_r0, struct wpa_ft_pmk_r0_sa, list) {
+		if (r0->expiration)
+			r0->expiration -= sec;
+		if (r0->session_timeout)
+			r0->session_timeout -= sec;
+	}
+	dl_list_for_each(r1, &cache->pmk_r1, struct wpa_ft_pmk_r1_sa, list) {
+		if (r1->expiration)
+			r1->expiration -= sec;
+		if (r1->session_timeout)
+			r1->session_timeout -= sec;
+	}
+}
+
+
+/* Age the entries by @sec seconds, run the expiration, and check that the
+ * entries in the @present bitmap are still found and that the timeout is
+ * registered for the entry that expires next in @next seconds (0 for no
+ * timeout). */
+static int wpa_ft_pmk_cache_test_step(struct wpa_authenticator *wpa_auth,
+				      os_time_t sec, unsigned int present,
+				      unsigned int next)
+{
+	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
+	const struct wpa_ft_pmk_r0_sa *r0;
+	u8 spa[ETH_ALEN], name[WPA_PMK_NAME_LEN], pmk[PMK_LEN_MAX];
+	size_t pmk_len;
+	unsigned int i, num_r0 = 0, num_r1 = 0;
+	int found;
+
+	wpa_ft_pmk_cache_test_age(cache, sec);
+	wpa_ft_pmk_cache_expire(cache, NULL);
+
+	for (i = 0; i < FT_PMK_TEST_NUM; i++) {
+		os_memset(spa, 0x02, ETH_ALEN);
+		spa[5] = i;
+		os_memset(name, i, WPA_PMK_NAME_LEN);
+		if (wpa_ft_pmk_cache_test_entries[i].r1)
+			found = wpa_ft_fetch_pmk_r1(wpa_auth, spa, name, pmk,
+						    &pmk_len, NULL, NULL, NULL,
+						    NULL, NULL, NULL,
+						    NULL) == 0;
+		else
+			found = wpa_ft_fetch_pmk_r0(wpa_auth, spa, name,
+						    &r0) == 0;
+		if (found != !!(present & BIT(i))) {
+			wpa_printf(MSG_ERROR, "FT PMK cache: Entry %u %sfound",
+				   i, found ? "" : "not ");
+			return -1;
+		}
+		if (found && wpa_ft_pmk_cache_test_entries[i].r1)
+			num_r1++;
+		else if (found)
+			num_r0++;
+	}
+	if (cache->num_pmk_r0 != num_r0 || cache->num_pmk_r1 != num_r1) {
+		wpa_printf(MSG_ERROR, "FT PMK cache: Unexpected entry count");
+		return -1;
+	}
+
+	/* Allow a second boundary to be crossed between adding the entries
+	 * and registering the timeout. Neither call changes a timeout that
+	 * is within the range. */
+	if (!next) {
+		found = !eloop_is_timeout_registered(wpa_ft_pmk_cache_expire,
+						     cache, NULL);
+	} else {
+		found = eloop_deplete_timeout(next + 1, 0,
+					      wpa_ft_pmk_cache_expire,
+					      cache, NULL) == 0 &&
+			eloop_replenish_timeout(next - 1, 0,
+						wpa_ft_pmk_cache_expire,
+						cache, NULL) == 0;
+	}
+	if (!found) {
+		wpa_printf(MSG_ERROR,
+			   "FT PMK cache: Timeout not set for %u seconds",
+			   next);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int wpa_ft_pmk_cache_tests(void)
+{
+	const struct wpa_ft_pmk_cache_test *t;
+	struct wpa_authenticator *wpa_auth;
+	u8 spa[ETH_ALEN], name[WPA_PMK_NAME_LEN], pmk[PMK_LEN];
+	unsigned int i;
+	int res, ret = -1;
+
+	wpa_printf(MSG_INFO, "FT PMK cache tests");
+
+	wpa_auth = os_zalloc(sizeof(*wpa_auth));
+	if (!wpa_auth)
+		return -1;
+	wpa_auth->ft_pmk_cache = wpa_ft_pmk_cache_init();
+	if (!wpa_auth->ft_pmk_cache)
+		goto fail;
+
+	os_memset(pmk, 0x11, PMK_LEN);
+	for (i = 0; i < FT_PMK_TEST_NUM; i++) {
+		t = &wpa_ft_pmk_cache_test_entries[i];
+		os_memset(spa, 0x02, ETH_ALEN);
+		spa[5] = i;
+		os_memset(name, i, WPA_PMK_NAME_LEN);
+		if (t->r1)
+			res = wpa_ft_store_pmk_r1(wpa_auth, spa, pmk, PMK_LEN,
+						  name, WPA_CIPHER_CCMP, NULL,
+						  t->expires_in,
+						  t->session_timeout,
+						  NULL, 0, NULL, 0);
+		else
+			res = wpa_ft_store_pmk_r0(wpa_auth, spa, pmk, PMK_LEN,
+						  name, WPA_CIPHER_CCMP, NULL,
+						  t->expires_in,
+						  t->session_timeout,
+						  NULL, 0, NULL, 0);
+		if (res < 0)
+			goto fail;
+	}
+
+	if (wpa_ft_pmk_cache_test_step(wpa_auth, 0, 0x7f, 50) < 0 ||
+	    wpa_ft_pmk_cache_test_step(wpa_auth, 60, 0x6f, 40) < 0 ||
+	    wpa_ft_pmk_cache_test_step(wpa_auth, 50, 0x67, 90) < 0 ||
+	    wpa_ft_pmk_cache_test_step(wpa_auth, 100, 0x47, 40) < 0 ||
+	    wpa_ft_pmk_cache_test_step(wpa_auth, 100, 0x06, 0) < 0)
+		goto fail;
+
+	ret = 0;
+fail:
+	wpa_ft_pmk_cache_deinit(wpa_auth->ft_pmk_cache);
+	os_free(wpa_auth);
+	return ret;
+}
+
+#endif /* CONFIG_MODULE_TESTS */
+
+
+#ifdef CONFIG_PMK_STORE
+
+void wpa_ft_pmk_cache_set_store(struct wpa_ft_pmk_cache *cache,
+				struct pmk_store *store)
+{
+	cache->store = store;
+}
+
+
+/* Returns 0 if the entry was added or -1 if the record should be dropped */
+int wpa_ft_pmk_cache_restore(struct wpa_authenticator *wpa_auth, int slot,
+			     enum pmk_store_type type,
+			     const u8 *data, size_t len)
+{
+	struct wpa_ft_pmk_cache *cache = wpa_auth->ft_pmk_cache;
+	struct pmk_store *store = cache->store;
+	const u8 *spa, *pmk, *pmk_name, *identity, *radius_cui;
+	size_t pmk_len, identity_len, radius_cui_len;
+	struct vlan_description vlan;
+	os_time_t expiration, session_timeout;
+	struct pmk_store_rec rec;
+	struct os_reltime now;
+	int pairwise, res;
+
+	pmk_store_rec_init(&rec, data, len);
+	spa = pmk_store_get(&rec, ETH_ALEN);
+	pmk_len = pmk_store_get_u8(&rec);
+	pmk = pmk_store_get(&rec, pmk_len);
+	pmk_name = pmk_store_get(&rec, WPA_PMK_NAME_LEN);
+	pairwise = pmk_store_get_le32(&rec);
+	if (pmk_store_get_vlan(&rec, &vlan) < 0 ||
+	    pmk_store_get_time(&rec, &expiration) < 0 ||
+	    pmk_store_get_time(&rec, &session_timeout) < 0)
+		return -1;
+	identity = pmk_store_get_var(&rec, &identity_len);
+	radius_cui = pmk_store_get_var(&rec, &radius_cui_len);
+	if (rec.error || pmk_len > PMK_LEN_MAX)
+		return -1;
+
+	os_get_reltime(&now);
+	if (expiration)
+		expiration -= now.sec;
+	if (session_timeout)
+		session_timeout -= now.sec;
+
+	/* The entry is already in the store, so add it to the cache without
+	 * writing a new record and then set the slot of the entry that is now
+	 * at the head of its hash chain. */
+	cache->store = NULL;
+	if (type == PMK_STORE_FT_PMK_R0) {
+		res = wpa_ft_store_pmk_r0(wpa_auth, spa, pmk, pmk_len, pmk_name,
+					  pairwise, &vlan, expiration,
+					  session_timeout, identity,
+					  identity_len, radius_cui,
+					  radius_cui_len);
+		if (res == 0)
+			cache->pmk_r0_hash[wpa_ft_pmk_r0_hash(cache, spa)]->
+				store_slot = slot;
+	} else {
+		res = wpa_ft_store_pmk_r1(wpa_auth, spa, pmk, pmk_len, pmk_name,
+					  pairwise, &vlan, expiration,
+					  session_timeout, identity,
+					  identity_len, radius_cui,
+					  radius_cui_len);
+		if (res == 0)
+			cache->pmk_r1_hash[wpa_ft_pmk_r1_hash(cache, spa,
+							      pmk_name)]->
+				store_slot = slot;
+	}
+	cache->store = store;
+
+	return res;
+}
+
+#endif /* CONFIG_PMK_STORE */
+
+
 static int wpa_ft_rrb_init_r0kh_seq(struct ft_remote_r0kh *r0kh)
 {
 	if (r0kh->seq)
@@ -4912,7 +5415,10 @@ void wpa_ft_push_pmk_r1(struct wpa_authenticator *wpa_auth, const u8 *addr)
 	if (!wpa_auth->conf.r1kh_list)
 		return;
 
-	dl_list_for_each(r0, &cache->pmk_r0, struct wpa_ft_pmk_r0_sa, list) {
+	/* The hash list is in reverse order of addition, so this finds the
+	 * most recently added entry for the STA. */
+	for (r0 = cache->pmk_r0_hash[wpa_ft_pmk_r0_hash(cache, addr)]; r0;
+	     r0 = r0->hnext) {
 		if (os_memcmp(r0->spa, addr, ETH_ALEN) == 0) {
 			r0found = r0;
 			break;
@@ -42,6 +42,7 @@ static void hostapd_wpa_auth_conf(struct hostapd_bss_config *conf,
 	int sae_pw_id;
 
 	os_memset(wconf, 0, sizeof(*wconf));
+	wconf->ifname = conf->iface;
 	wconf->wpa = conf->wpa;
 	wconf->extended_key_id = conf->extended_key_id;
 	wconf->wpa_key_mgmt = conf->wpa_key_mgmt;
@@ -69,6 +70,14 @@ static void hostapd_wpa_auth_conf(struct hostapd_bss_config *conf,
 	wconf->ocv = conf->ocv;
 #endif /* CONFIG_OCV */
 	wconf->okc = conf->okc;
+#ifdef CONFIG_PMK_STORE
+	if (conf->pmk_store && conf->pmk_store_key_set) {
+		wconf->pmk_store = conf->pmk_store;
+		os_memcpy(wconf->pmk_store_key, conf->pmk_store_key,
+			  sizeof(wconf->pmk_store_key));
+		wconf->pmk_store_slots = conf->pmk_store_slots;
+	}
+#endif /* CONFIG_PMK_STORE */
 	wconf->ieee80211w = conf->ieee80211w;
 	wconf->beacon_prot = conf->beacon_prot;
 	wconf->group_mgmt_cipher = conf->group_mgmt_cipher;
@@ -380,8 +389,27 @@ static const u8 * hostapd_wpa_auth_get_psk(void *ctx, const u8 *addr,
 	}
 #endif /* CONFIG_OWE */
 
-	psk = hostapd_get_psk(hapd->conf, addr, p2p_dev_addr, prev_psk,
-			      vlan_id);
+	if (!prev_psk || (hapd->psk_iter && prev_psk == hapd->psk_iter_psk)) {
+		const struct hostapd_wpa_psk *entry;
+
+		/* Continue from the entry returned previously instead of
+		 * searching for it to keep the iteration linear */
+		if (!prev_psk)
+			wpa_printf(MSG_DEBUG, "Searching a PSK for " MACSTR,
+				   MAC2STR(addr));
+		entry = hostapd_get_psk_entry(hapd->conf, addr, p2p_dev_addr,
+					      prev_psk ? hapd->psk_iter : NULL);
+		hapd->psk_iter = entry;
+		hapd->psk_iter_psk = entry ? entry->psk : NULL;
+		psk = entry ? entry->psk : NULL;
+		if (entry && vlan_id)
+			*vlan_id = entry->vlan_id;
+	} else {
+		hapd->psk_iter = NULL;
+		hapd->psk_iter_psk = NULL;
+		psk = hostapd_get_psk(hapd->conf, addr, p2p_dev_addr, prev_psk,
+				      vlan_id);
+	}
 	/*
 	 * This is about to iterate over all psks, prev_psk gives the last
 	 * returned psk which should not be returned again.
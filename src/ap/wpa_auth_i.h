@@ -10,6 +10,7 @@
 #define WPA_AUTH_I_H
 
 #include "utils/list.h"
+#include "pmk_store.h"
 
 /* max(dot11RSNAConfigGroupUpdateCount,dot11RSNAConfigPairwiseUpdateCount) */
 #define RSNA_MAX_EAPOL_RETRIES 4
@@ -210,6 +211,19 @@ struct wpa_group {
 
 struct wpa_ft_pmk_cache;
 
+#define WPA_PSK_MEMO_HASH_SIZE 256
+#define WPA_PSK_MEMO_HASH(sta) ((sta)[5])
+#define WPA_PSK_MEMO_MAX 4096
+
+/* PSK that last completed the 4-way handshake for a station */
+struct wpa_psk_memo {
+	struct dl_list hash; /* bucket in wpa_authenticator::psk_memo */
+	struct dl_list lru; /* wpa_authenticator::psk_memo_lru */
+	u8 addr[ETH_ALEN];
+	u8 pmk[PMK_LEN_MAX];
+	size_t pmk_len;
+};
+
 /* per authenticator data */
 struct wpa_authenticator {
 	struct wpa_group *group;
@@ -236,6 +250,14 @@ struct wpa_authenticator {
 
 	struct rsn_pmksa_cache *pmksa;
 	struct wpa_ft_pmk_cache *ft_pmk_cache;
+#ifdef CONFIG_PMK_STORE
+	struct pmk_store *pmk_store;
+#endif /* CONFIG_PMK_STORE */
+
+	struct dl_list *psk_memo; /* WPA_PSK_MEMO_HASH_SIZE buckets or NULL */
+	struct dl_list psk_memo_lru; /* most recently used first */
+	unsigned int num_psk_memo;
+	unsigned int psk_memo_hits;
 
 #ifdef CONFIG_P2P
 	struct bitfield *ip_pool;
@@ -305,6 +327,16 @@ int wpa_write_ftie(struct wpa_auth_config *conf, int key_mgmt, size_t key_len,
 int wpa_auth_derive_ptk_ft(struct wpa_state_machine *sm, struct wpa_ptk *ptk);
 struct wpa_ft_pmk_cache * wpa_ft_pmk_cache_init(void);
 void wpa_ft_pmk_cache_deinit(struct wpa_ft_pmk_cache *cache);
+int wpa_ft_pmk_cache_mib(struct wpa_authenticator *wpa_auth, char *buf,
+			 size_t buflen);
+int wpa_ft_pmk_cache_tests(void);
+#ifdef CONFIG_PMK_STORE
+void wpa_ft_pmk_cache_set_store(struct wpa_ft_pmk_cache *cache,
+				struct pmk_store *store);
+int wpa_ft_pmk_cache_restore(struct wpa_authenticator *wpa_auth, int slot,
+			     enum pmk_store_type type,
+			     const u8 *data, size_t len);
+#endif /* CONFIG_PMK_STORE */
 void wpa_ft_install_ptk(struct wpa_state_machine *sm, int retry);
 int wpa_ft_store_pmk_fils(struct wpa_state_machine *sm, const u8 *pmk_r0,
 			  const u8 *pmk_r0_name);
@@ -207,3 +207,17 @@ int ctrl_iface_level(struct dl_list *ctrl_dst, struct sockaddr_storage *from,
 
 	return -1;
 }
+
+
+int ctrl_iface_has_monitor(struct dl_list *ctrl_dst, int level, u32 events)
+{
+	struct wpa_ctrl_dst *dst;
+
+	dl_list_for_each(dst, ctrl_dst, struct wpa_ctrl_dst, list) {
+		if (level >= dst->debug_level &&
+		    (dst->events & events) == events)
+			return 1;
+	}
+
+	return 0;
+}
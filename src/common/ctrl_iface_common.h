@@ -38,5 +38,6 @@ int ctrl_iface_detach(struct dl_list *ctrl_dst, struct sockaddr_storage *from,
 		      socklen_t fromlen);
 int ctrl_iface_level(struct dl_list *ctrl_dst, struct sockaddr_storage *from,
 		     socklen_t fromlen, const char *level);
+int ctrl_iface_has_monitor(struct dl_list *ctrl_dst, int level, u32 events);
 
 #endif /* CONTROL_IFACE_COMMON_H */
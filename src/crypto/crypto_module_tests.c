@@ -1346,6 +1346,96 @@ static const struct rfc6070_test rfc6070_tests[] =
 #define NUM_RFC6070_TESTS ARRAY_SIZE(rfc6070_tests)
 
 
+/* Reference PBKDF2-SHA1 that computes the full HMAC on each iteration */
+static int pbkdf2_sha1_ref(const char *passphrase, const u8 *ssid,
+			   size_t ssid_len, int iterations, u8 *buf,
+			   size_t buflen)
+{
+	size_t passphrase_len = os_strlen(passphrase);
+	u8 count_buf[4], u[SHA1_MAC_LEN], digest[SHA1_MAC_LEN];
+	const u8 *addr[2];
+	size_t len[2], plen;
+	unsigned int count = 0;
+	int i, j;
+
+	addr[0] = ssid;
+	len[0] = ssid_len;
+	addr[1] = count_buf;
+	len[1] = 4;
+
+	while (buflen > 0) {
+		WPA_PUT_BE32(count_buf, ++count);
+		if (hmac_sha1_vector((const u8 *) passphrase, passphrase_len,
+				     2, addr, len, u))
+			return -1;
+		os_memcpy(digest, u, SHA1_MAC_LEN);
+		for (i = 1; i < iterations; i++) {
+			if (hmac_sha1((const u8 *) passphrase, passphrase_len,
+				      u, SHA1_MAC_LEN, u))
+				return -1;
+			for (j = 0; j < SHA1_MAC_LEN; j++)
+				digest[j] ^= u[j];
+		}
+		plen = buflen > SHA1_MAC_LEN ? SHA1_MAC_LEN : buflen;
+		os_memcpy(buf, digest, plen);
+		buf += plen;
+		buflen -= plen;
+	}
+
+	return 0;
+}
+
+
+static int test_pbkdf2_sha1_perf(void)
+{
+	const char *passphrases[] = {
+		"password",
+		"ThisIsAPassword",
+		/* longer than the HMAC-SHA1 block size */
+		"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"#0123456789",
+	};
+	u8 psk[32], psk_ref[32];
+	struct os_reltime start, end, diff;
+	unsigned int i, rounds = 4;
+	u64 usec = 0, usec_ref = 0;
+
+	wpa_printf(MSG_INFO, "PBKDF2-SHA1 benchmark:");
+
+	for (i = 0; i < rounds * ARRAY_SIZE(passphrases); i++) {
+		const char *p = passphrases[i % ARRAY_SIZE(passphrases)];
+
+		os_get_reltime(&start);
+		if (pbkdf2_sha1(p, (const u8 *) "IEEE", 4, 4096, psk, 32))
+			return 1;
+		os_get_reltime(&end);
+		os_reltime_sub(&end, &start, &diff);
+		usec += diff.sec * 1000000ULL + diff.usec;
+
+		os_get_reltime(&start);
+		if (pbkdf2_sha1_ref(p, (const u8 *) "IEEE", 4, 4096, psk_ref,
+				    32))
+			return 1;
+		os_get_reltime(&end);
+		os_reltime_sub(&end, &start, &diff);
+		usec_ref += diff.sec * 1000000ULL + diff.usec;
+
+		if (os_memcmp(psk, psk_ref, 32) != 0) {
+			wpa_printf(MSG_INFO,
+				   "PBKDF2-SHA1 mismatch with the reference for passphrase %u",
+				   i % (unsigned int) ARRAY_SIZE(passphrases));
+			return 1;
+		}
+	}
+
+	wpa_printf(MSG_INFO,
+		   "%u derivations: pbkdf2_sha1() %llu usec, reference HMAC loop %llu usec",
+		   i, (unsigned long long) usec,
+		   (unsigned long long) usec_ref);
+	return 0;
+}
+
+
 static int test_sha1(void)
 {
 	u8 res[512];
@@ -1414,6 +1504,8 @@ static int test_sha1(void)
 		}
 	}
 
+	ret += test_pbkdf2_sha1_perf();
+
 	if (!ret)
 		wpa_printf(MSG_INFO, "SHA1 test cases passed");
 	return ret;
@@ -29,6 +29,9 @@
 #include <sys/random.h>
 #endif /* CONFIG_GETRANDOM */
 #endif /* __linux__ */
+#ifdef CONFIG_RANDOM_POOL_LOCK
+#include <pthread.h>
+#endif /* CONFIG_RANDOM_POOL_LOCK */
 
 #include "utils/common.h"
 #include "utils/eloop.h"
@@ -62,6 +65,16 @@ static char *random_entropy_file = NULL;
 static unsigned int entropy = 0;
 static unsigned int total_collected = 0;
 
+#ifdef CONFIG_RANDOM_POOL_LOCK
+/* The pool is used both from the eloop thread and from worker threads */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define random_lock() pthread_mutex_lock(&pool_lock)
+#define random_unlock() pthread_mutex_unlock(&pool_lock)
+#else /* CONFIG_RANDOM_POOL_LOCK */
+#define random_lock() do { } while (0)
+#define random_unlock() do { } while (0)
+#endif /* CONFIG_RANDOM_POOL_LOCK */
+
 
 static void random_write_entropy(void);
 
@@ -133,12 +146,14 @@ void random_add_randomness(const void *buf, size_t len)
 	struct os_time t;
 	static unsigned int count = 0;
 
+	random_lock();
 	count++;
 	if (entropy > MIN_COLLECT_ENTROPY && (count & 0x3ff) != 0) {
 		/*
 		 * No need to add more entropy at this point, so save CPU and
 		 * skip the update.
 		 */
+		random_unlock();
 		return;
 	}
 	wpa_printf(MSG_EXCESSIVE, "Add randomness: count=%u entropy=%u",
@@ -153,6 +168,7 @@ void random_add_randomness(const void *buf, size_t len)
 			(const u8 *) pool, sizeof(pool));
 	entropy++;
 	total_collected++;
+	random_unlock();
 }
 
 
@@ -162,9 +178,6 @@ int random_get_bytes(void *buf, size_t len)
 	u8 *bytes = buf;
 	size_t left;
 
-	wpa_printf(MSG_MSGDUMP, "Get randomness: len=%u entropy=%u",
-		   (unsigned int) len, entropy);
-
 #ifdef CONFIG_USE_OPENSSL_RNG
 	/* Start with assumed strong randomness from OpenSSL */
 	ret = crypto_get_random(buf, len);
@@ -178,6 +191,9 @@ int random_get_bytes(void *buf, size_t len)
 #endif /* CONFIG_USE_OPENSSL_RNG */
 
 	/* Mix in additional entropy extracted from the internal pool */
+	random_lock();
+	wpa_printf(MSG_MSGDUMP, "Get randomness: len=%u entropy=%u",
+		   (unsigned int) len, entropy);
 	left = len;
 	while (left) {
 		size_t siz, i;
@@ -190,6 +206,11 @@ int random_get_bytes(void *buf, size_t len)
 			*bytes++ ^= tmp[i];
 		left -= siz;
 	}
+	if (entropy < len)
+		entropy = 0;
+	else
+		entropy -= len;
+	random_unlock();
 
 #ifdef CONFIG_FIPS
 	/* Mix in additional entropy from the crypto module */
@@ -214,11 +235,6 @@ int random_get_bytes(void *buf, size_t len)
 
 	wpa_hexdump_key(MSG_EXCESSIVE, "mixed random", buf, len);
 
-	if (entropy < len)
-		entropy = 0;
-	else
-		entropy -= len;
-
 	return ret;
 }
 
@@ -10,6 +10,68 @@
 
 #include "common.h"
 #include "sha1.h"
+#ifdef CONFIG_CRYPTO_INTERNAL
+#include "crypto.h"
+#include "sha1_i.h"
+
+/*
+ * With the internal SHA-1 implementation, the HMAC inner and outer hash states
+ * after the ipad/opad blocks are computed only once for all the iterations.
+ * Each iteration is then a single compression function call for the inner and
+ * the outer hash instead of four.
+ */
+
+static int pbkdf2_sha1_pad_state(const char *passphrase, size_t passphrase_len,
+				 u8 pad, u32 state[5])
+{
+	struct SHA1Context ctx;
+	u8 block[64];
+	size_t i;
+
+	os_memset(block, 0, sizeof(block));
+	if (passphrase_len > sizeof(block)) {
+		if (sha1_vector(1, (const u8 **) &passphrase, &passphrase_len,
+				block))
+			return -1;
+	} else {
+		os_memcpy(block, passphrase, passphrase_len);
+	}
+	for (i = 0; i < sizeof(block); i++)
+		block[i] ^= pad;
+
+	SHA1Init(&ctx);
+	SHA1Transform(ctx.state, block);
+	os_memcpy(state, ctx.state, sizeof(ctx.state));
+	forced_memzero(block, sizeof(block));
+	forced_memzero(&ctx, sizeof(ctx));
+	return 0;
+}
+
+
+static void pbkdf2_sha1_hash_block(const u32 init[5], u8 *block, u8 *digest)
+{
+	u32 state[5];
+	int i;
+
+	/* block has the 20-octet message at the beginning and the padding for
+	 * a 64 + 20 octet message after it */
+	os_memcpy(state, init, sizeof(state));
+	SHA1Transform(state, block);
+	for (i = 0; i < 5; i++)
+		WPA_PUT_BE32(&digest[4 * i], state[i]);
+	forced_memzero(state, sizeof(state));
+}
+
+
+static void pbkdf2_sha1_pad_block(u8 *block)
+{
+	os_memset(block + SHA1_MAC_LEN, 0, 64 - SHA1_MAC_LEN);
+	block[SHA1_MAC_LEN] = 0x80;
+	WPA_PUT_BE64(&block[56], (64 + SHA1_MAC_LEN) * 8);
+}
+
+#endif /* CONFIG_CRYPTO_INTERNAL */
+
 
 static int pbkdf2_sha1_f(const char *passphrase, const u8 *ssid,
 			 size_t ssid_len, int iterations, unsigned int count,
@@ -21,6 +83,10 @@ static int pbkdf2_sha1_f(const char *passphrase, const u8 *ssid,
 	const u8 *addr[2];
 	size_t len[2];
 	size_t passphrase_len = os_strlen(passphrase);
+#ifdef CONFIG_CRYPTO_INTERNAL
+	u32 istate[5], ostate[5];
+	u8 iblock[64], oblock[64];
+#endif /* CONFIG_CRYPTO_INTERNAL */
 
 	addr[0] = ssid;
 	len[0] = ssid_len;
@@ -42,6 +108,24 @@ static int pbkdf2_sha1_f(const char *passphrase, const u8 *ssid,
 		return -1;
 	os_memcpy(digest, tmp, SHA1_MAC_LEN);
 
+#ifdef CONFIG_CRYPTO_INTERNAL
+	if (pbkdf2_sha1_pad_state(passphrase, passphrase_len, 0x36, istate) ||
+	    pbkdf2_sha1_pad_state(passphrase, passphrase_len, 0x5c, ostate))
+		return -1;
+	pbkdf2_sha1_pad_block(iblock);
+	pbkdf2_sha1_pad_block(oblock);
+	os_memcpy(iblock, tmp, SHA1_MAC_LEN);
+	for (i = 1; i < iterations; i++) {
+		pbkdf2_sha1_hash_block(istate, iblock, oblock);
+		pbkdf2_sha1_hash_block(ostate, oblock, iblock);
+		for (j = 0; j < SHA1_MAC_LEN; j++)
+			digest[j] ^= iblock[j];
+	}
+	forced_memzero(istate, sizeof(istate));
+	forced_memzero(ostate, sizeof(ostate));
+	forced_memzero(iblock, sizeof(iblock));
+	forced_memzero(oblock, sizeof(oblock));
+#else /* CONFIG_CRYPTO_INTERNAL */
 	for (i = 1; i < iterations; i++) {
 		if (hmac_sha1((u8 *) passphrase, passphrase_len, tmp,
 			      SHA1_MAC_LEN, tmp2))
@@ -50,6 +134,7 @@ static int pbkdf2_sha1_f(const char *passphrase, const u8 *ssid,
 		for (j = 0; j < SHA1_MAC_LEN; j++)
 			digest[j] ^= tmp2[j];
 	}
+#endif /* CONFIG_CRYPTO_INTERNAL */
 	forced_memzero(tmp, SHA1_MAC_LEN);
 	forced_memzero(tmp2, SHA1_MAC_LEN);
 
@@ -3438,6 +3438,23 @@ struct wpa_driver_ops {
 	int (*read_sta_data)(void *priv, struct hostap_sta_driver_data *data,
 			     const u8 *addr);
 
+	/**
+	 * read_sta_data_all - Fetch station data for all stations
+	 * @priv: Private driver interface data
+	 * @cb: Function to call for each station
+	 * @ctx: Context pointer for cb
+	 * Returns: 0 on success, -1 on failure
+	 *
+	 * This fetches the data of all the stations of the interface with a
+	 * single request instead of a read_sta_data() call for each station.
+	 * Stations that are not reported (e.g., ones on a VLAN interface) can
+	 * still be queried with read_sta_data().
+	 */
+	int (*read_sta_data_all)(void *priv,
+				 void (*cb)(void *ctx, const u8 *addr,
+					    struct hostap_sta_driver_data *data),
+				 void *ctx);
+
 	/**
 	 * tx_control_port - Send a frame over the 802.1X controlled port
 	 * @priv: Private driver interface data
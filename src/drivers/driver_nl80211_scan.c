@@ -834,13 +834,13 @@ nl80211_parse_bss_info(struct wpa_driver_nl80211_data *drv,
 struct nl80211_bss_info_arg {
 	struct wpa_driver_nl80211_data *drv;
 	struct wpa_scan_results *res;
+	size_t res_size; /* number of allocated entries in res->res */
 };
 
 static int bss_info_handler(struct nl_msg *msg, void *arg)
 {
 	struct nl80211_bss_info_arg *_arg = arg;
 	struct wpa_scan_results *res = _arg->res;
-	struct wpa_scan_res **tmp;
 	struct wpa_scan_res *r;
 
 	r = nl80211_parse_bss_info(_arg->drv, msg);
@@ -851,14 +851,23 @@ static int bss_info_handler(struct nl_msg *msg, void *arg)
 		os_free(r);
 		return NL_SKIP;
 	}
-	tmp = os_realloc_array(res->res, res->num + 1,
-			       sizeof(struct wpa_scan_res *));
-	if (tmp == NULL) {
-		os_free(r);
-		return NL_SKIP;
+	if (res->num >= _arg->res_size) {
+		struct wpa_scan_res **tmp;
+		size_t size;
+
+		/* Grow geometrically to avoid reallocation for each BSS in
+		 * large dumps */
+		size = _arg->res_size ? 2 * _arg->res_size : 32;
+		tmp = os_realloc_array(res->res, size,
+				       sizeof(struct wpa_scan_res *));
+		if (tmp == NULL) {
+			os_free(r);
+			return NL_SKIP;
+		}
+		res->res = tmp;
+		_arg->res_size = size;
 	}
-	tmp[res->num++] = r;
-	res->res = tmp;
+	res->res[res->num++] = r;
 
 	return NL_SKIP;
 }
@@ -961,6 +970,15 @@ try_again:
 
 	arg.drv = drv;
 	arg.res = res;
+	arg.res_size = 0;
+	/* Size the result array based on the previous dump to avoid having to
+	 * grow it while receiving the results */
+	if (drv->last_scan_res_num) {
+		res->res = os_calloc(drv->last_scan_res_num,
+				     sizeof(struct wpa_scan_res *));
+		if (res->res)
+			arg.res_size = drv->last_scan_res_num;
+	}
 	ret = send_and_recv_msgs(drv, msg, bss_info_handler, &arg, NULL, NULL);
 	if (ret == -EAGAIN) {
 		count++;
@@ -979,6 +997,7 @@ try_again:
 
 		wpa_printf(MSG_DEBUG, "nl80211: Received scan results (%lu "
 			   "BSSes)", (unsigned long) res->num);
+		drv->last_scan_res_num = res->num;
 		if (nl80211_get_noise_for_scan_results(drv, &info) == 0) {
 			size_t i;
 
@@ -6,6 +6,10 @@
  * See README for more details.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* recvmmsg() and sendmmsg() */
+#endif /* __linux__ && !_GNU_SOURCE */
+
 #include "includes.h"
 #include <net/if.h>
 #ifdef CONFIG_SQLITE
@@ -15,6 +19,11 @@
 #include "common.h"
 #include "radius.h"
 #include "eloop.h"
+#include "utils/prefix_trie.h"
+#include "utils/siphash.h"
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+#include "utils/worker_pool.h"
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
 #include "eap_server/eap.h"
 #include "ap/ap_config.h"
 #include "crypto/tls.h"
@@ -35,6 +44,48 @@
  */
 #define RADIUS_MAX_SESSION 1000
 
+/**
+ * RADIUS_SESSION_HASH_SIZE - Number of buckets in the session hash table
+ */
+#define RADIUS_SESSION_HASH_SIZE 1024
+
+/**
+ * RADIUS_REPLY_CACHE_SIZE - Maximum number of cached Access-Request replies
+ */
+#define RADIUS_REPLY_CACHE_SIZE 1000
+
+/**
+ * RADIUS_REPLY_CACHE_TIMEOUT - Reply cache entry lifetime in seconds
+ */
+#define RADIUS_REPLY_CACHE_TIMEOUT 30
+
+#define RADIUS_REPLY_HASH_SIZE 1024
+
+/**
+ * RADIUS_SERVER_BATCH - Maximum number of datagrams per receive/send call
+ */
+#define RADIUS_SERVER_BATCH 16
+
+/**
+ * RADIUS_SERVER_MAX_THREADS - Maximum number of EAP worker threads
+ */
+#define RADIUS_SERVER_MAX_THREADS 64
+
+/**
+ * RADIUS_DB_QUEUE_MAX - Maximum number of queued SQLite writes
+ *
+ * Once this many writes are waiting, the queue is flushed synchronously.
+ */
+#define RADIUS_DB_QUEUE_MAX 1000
+
+/**
+ * RADIUS_DB_BUSY_TIMEOUT - SQLite busy timeout in milliseconds
+ */
+#define RADIUS_DB_BUSY_TIMEOUT 1000
+
+/* Source address (16), source port (2), Identifier (1), Authenticator (16) */
+#define RADIUS_REPLY_KEY_LEN 35
+
 static const struct eapol_callbacks radius_server_eapol_cb;
 
 struct radius_client;
@@ -67,7 +118,8 @@ struct radius_server_counters {
  * struct radius_session - Internal RADIUS server data for a session
  */
 struct radius_session {
-	struct radius_session *next;
+	struct dl_list list; /* struct radius_client::sessions */
+	struct radius_session *hnext; /* struct radius_server_data::sess_hash */
 	struct radius_client *client;
 	struct radius_server_data *server;
 	unsigned int sess_id;
@@ -93,6 +145,16 @@ struct radius_session {
 	struct hostapd_radius_attr *accept_attr;
 
 	u32 t_c_timestamp; /* Last read T&C timestamp from user DB */
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	/* Worker thread (shard) that runs the EAP state machine or %NULL */
+	struct worker_pool *worker;
+	/* eap_server_sm_step() is running in the worker; last_msg is the
+	 * request that is being processed */
+	bool job_pending;
+	/* Session was freed while the job was pending */
+	bool removed;
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
 };
 
 /**
@@ -108,7 +170,7 @@ struct radius_client {
 #endif /* CONFIG_IPV6 */
 	char *shared_secret;
 	int shared_secret_len;
-	struct radius_session *sessions;
+	struct dl_list sessions; /* struct radius_session::list */
 	struct radius_server_counters counters;
 
 	u8 next_dac_identifier;
@@ -120,6 +182,41 @@ struct radius_client {
 	u8 pending_dac_disconnect_addr[ETH_ALEN];
 };
 
+/**
+ * struct radius_reply_cache_entry - Reply to a recently received request
+ */
+struct radius_reply_cache_entry {
+	struct dl_list list; /* struct radius_server_data::reply_cache */
+	struct radius_reply_cache_entry *hnext;
+	struct os_reltime added;
+	u8 key[RADIUS_REPLY_KEY_LEN];
+	struct wpabuf *reply;
+};
+
+/**
+ * struct radius_server_io - Buffers for batched receive and send
+ *
+ * The received datagrams are processed directly from the receive buffers and
+ * the replies to them are queued into the send buffers, which are flushed
+ * with a single call once the whole batch has been processed.
+ */
+struct radius_server_io {
+	u8 rx_buf[RADIUS_SERVER_BATCH][RADIUS_MAX_MSG_LEN];
+	struct sockaddr_storage rx_from[RADIUS_SERVER_BATCH];
+	socklen_t rx_fromlen[RADIUS_SERVER_BATCH];
+	int rx_len[RADIUS_SERVER_BATCH];
+	u8 tx_buf[RADIUS_SERVER_BATCH][RADIUS_MAX_MSG_LEN];
+	struct sockaddr_storage tx_to[RADIUS_SERVER_BATCH];
+	socklen_t tx_tolen[RADIUS_SERVER_BATCH];
+	size_t tx_len[RADIUS_SERVER_BATCH];
+	unsigned int tx_count;
+	int tx_sock; /* socket that is being processed or -1 */
+#ifdef __linux__
+	struct mmsghdr msg[RADIUS_SERVER_BATCH];
+	struct iovec iov[RADIUS_SERVER_BATCH];
+#endif /* __linux__ */
+};
+
 /**
  * struct radius_server_data - Internal RADIUS server data
  */
@@ -139,11 +236,41 @@ struct radius_server_data {
 	 */
 	struct radius_client *clients;
 
+	/**
+	 * clients4 - Longest prefix match index of clients by IPv4 address
+	 */
+	struct prefix_trie *clients4;
+
+	/**
+	 * clients6 - Longest prefix match index of clients by IPv6 address
+	 */
+	struct prefix_trie *clients6;
+
 	/**
 	 * next_sess_id - Next session identifier
 	 */
 	unsigned int next_sess_id;
 
+	/**
+	 * sess_hash - Sessions of all clients indexed by session identifier
+	 *
+	 * The session identifiers are assigned sequentially, so the low order
+	 * bits are used as the hash.
+	 */
+	struct radius_session *sess_hash[RADIUS_SESSION_HASH_SIZE];
+
+	/**
+	 * reply_cache - Replies to recent Access-Requests, oldest first
+	 *
+	 * This is used to resend the reply to a retransmitted request without
+	 * processing it again. The entries are indexed by a keyed hash of the
+	 * source address and port, Identifier, and Request Authenticator.
+	 */
+	struct dl_list reply_cache; /* struct radius_reply_cache_entry */
+	struct radius_reply_cache_entry *reply_hash[RADIUS_REPLY_HASH_SIZE];
+	unsigned int reply_cache_len;
+	u8 reply_hash_key[SIPHASH_KEY_LEN];
+
 	/**
 	 * conf_ctx - Context pointer for callbacks
 	 *
@@ -177,6 +304,53 @@ struct radius_server_data {
 	 */
 	struct radius_server_counters counters;
 
+	/**
+	 * io - Buffers for batched receive and send
+	 */
+	struct radius_server_io *io;
+
+	/**
+	 * rx_packets, tx_packets - Number of received and sent datagrams
+	 */
+	u32 rx_packets, tx_packets;
+
+	/**
+	 * rx_calls - Number of receive calls that returned datagrams
+	 */
+	u32 rx_calls;
+
+	/**
+	 * rx_pps, tx_pps - Datagrams in the last full second (rate_sec - 1)
+	 */
+	u32 rx_pps, tx_pps;
+	u32 rx_cur, tx_cur;
+	os_time_t rate_sec;
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	/**
+	 * workers - Single threaded worker pools for the EAP state machines
+	 *
+	 * Each session is assigned to one of these when it is created, so all
+	 * EAP processing for a session happens in the same thread. Socket I/O,
+	 * session management, and the user database remain in the eloop
+	 * thread. The threads are started when the first session is created
+	 * since hostapd may fork into background after the initialization.
+	 */
+	struct worker_pool *workers[RADIUS_SERVER_MAX_THREADS];
+	unsigned int num_workers;
+	int threads; /* configured number of workers, -1 = number of CPUs */
+
+	/**
+	 * worker_jobs - Number of EAP steps run in the workers
+	 */
+	u32 worker_jobs;
+
+	/**
+	 * worker_calls - Number of callbacks proxied to the eloop thread
+	 */
+	u32 worker_calls;
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
 	/**
 	 * get_eap_user - Callback for fetching EAP user information
 	 * @ctx: Context data from conf_ctx
@@ -223,6 +397,15 @@ struct radius_server_data {
 
 #ifdef CONFIG_SQLITE
 	sqlite3 *db;
+
+	/**
+	 * db_writer - Queued writes into the SQLite database
+	 *
+	 * The log and session state writes are committed in grouped
+	 * transactions through a separate database connection, while db is
+	 * used for the reads.
+	 */
+	struct radius_db_writer *db_writer;
 #endif /* CONFIG_SQLITE */
 
 	const struct eap_config *eap_cfg;
@@ -278,6 +461,400 @@ static int db_table_create_sim_provisioning(sqlite3 *db)
 }
 
 #endif /* CONFIG_HS20 */
+
+
+/* Statements for queued writes; the parameters are bound in order */
+enum radius_db_op {
+	RADIUS_DB_AUTHLOG,
+	RADIUS_DB_PENDING_TC,
+	RADIUS_DB_CURRENT_SESSION,
+	RADIUS_DB_LAST_MSK,
+	RADIUS_DB_COA_ACK,
+	RADIUS_DB_COA_NAK,
+	RADIUS_DB_NUM_OPS
+};
+
+static const char * const radius_db_sql[RADIUS_DB_NUM_OPS] = {
+	"INSERT INTO authlog(timestamp,session,nas_ip,username,note) VALUES (?,?,?,?,?)",
+	"INSERT OR REPLACE INTO pending_tc (mac_addr,identity) VALUES (?,?)",
+	"INSERT OR REPLACE INTO current_sessions(mac_addr,identity,start_time,nas,hs20_t_c_filtering) VALUES (?,?,?,?,?)",
+	"UPDATE users SET last_msk=? WHERE identity=?",
+	"UPDATE current_sessions SET hs20_t_c_filtering=0, waiting_coa_ack=0, coa_ack_received=1 WHERE mac_addr=?",
+	"UPDATE current_sessions SET waiting_coa_ack=0 WHERE mac_addr=?",
+};
+
+#define RADIUS_DB_MAX_ARGS 5
+
+struct radius_db_write {
+	struct dl_list list;
+	enum radius_db_op op;
+	unsigned int num_args;
+	struct {
+		char *text; /* %NULL for an integer or SQL NULL */
+		sqlite3_int64 val;
+		bool is_int;
+	} args[RADIUS_DB_MAX_ARGS];
+};
+
+/* A group of writes that is committed as a single transaction */
+struct radius_db_batch {
+	struct radius_db_writer *writer;
+	struct dl_list writes; /* struct radius_db_write */
+	unsigned int num_writes;
+	unsigned int failed; /* set by the thread that commits the batch */
+	bool committed;
+	bool finished;
+};
+
+struct radius_db_writer {
+	sqlite3 *db; /* used only by the thread that commits a batch */
+	sqlite3_stmt *stmt[RADIUS_DB_NUM_OPS];
+	struct dl_list queue; /* struct radius_db_write */
+	unsigned int queue_len;
+	struct radius_db_batch *batch; /* batch that is being committed */
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	struct worker_pool *pool; /* started with the first commit */
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+	/* Statistics */
+	u32 queued;
+	u32 written;
+	u32 failed;
+	u32 commits;
+	u32 stalls;
+	unsigned int queue_max;
+};
+
+
+static void radius_db_write_free(struct radius_db_write *w)
+{
+	unsigned int i;
+
+	for (i = 0; i < w->num_args; i++)
+		os_free(w->args[i].text);
+	os_free(w);
+}
+
+
+static int radius_db_exec(sqlite3 *db, const char *sql)
+{
+	if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+		RADIUS_ERROR("SQLite %s failed: %s", sql, sqlite3_errmsg(db));
+		return -1;
+	}
+	return 0;
+}
+
+
+static int radius_db_write_one(struct radius_db_writer *writer,
+			       struct radius_db_write *w)
+{
+	sqlite3_stmt *stmt;
+	unsigned int i;
+	int res;
+
+	stmt = writer->stmt[w->op];
+	if (!stmt &&
+	    sqlite3_prepare_v2(writer->db, radius_db_sql[w->op], -1,
+			       &writer->stmt[w->op], NULL) != SQLITE_OK) {
+		RADIUS_ERROR("Failed to prepare '%s': %s",
+			     radius_db_sql[w->op], sqlite3_errmsg(writer->db));
+		writer->stmt[w->op] = NULL;
+		return -1;
+	}
+	stmt = writer->stmt[w->op];
+
+	for (i = 0; i < w->num_args; i++) {
+		if (w->args[i].is_int)
+			res = sqlite3_bind_int64(stmt, i + 1, w->args[i].val);
+		else if (w->args[i].text)
+			res = sqlite3_bind_text(stmt, i + 1, w->args[i].text,
+						-1, SQLITE_STATIC);
+		else
+			res = sqlite3_bind_null(stmt, i + 1);
+		if (res != SQLITE_OK)
+			break;
+	}
+	if (i == w->num_args)
+		res = sqlite3_step(stmt);
+	if (res != SQLITE_DONE)
+		RADIUS_ERROR("Failed to write into sqlite database (%s): %s",
+			     radius_db_sql[w->op], sqlite3_errmsg(writer->db));
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	return res == SQLITE_DONE ? 0 : -1;
+}
+
+
+/* Commit a batch; this may be run in a worker thread */
+static void radius_db_commit(void *ctx)
+{
+	struct radius_db_batch *batch = ctx;
+	struct radius_db_writer *writer = batch->writer;
+	struct radius_db_write *w;
+
+	if (radius_db_exec(writer->db, "BEGIN") < 0) {
+		batch->failed = batch->num_writes;
+		return;
+	}
+	dl_list_for_each(w, &batch->writes, struct radius_db_write, list) {
+		if (radius_db_write_one(writer, w) < 0)
+			batch->failed++;
+	}
+	if (radius_db_exec(writer->db, "COMMIT") < 0) {
+		radius_db_exec(writer->db, "ROLLBACK");
+		batch->failed = batch->num_writes;
+		return;
+	}
+	batch->committed = true;
+}
+
+
+static void radius_db_batch_finish(struct radius_db_batch *batch)
+{
+	struct radius_db_writer *writer = batch->writer;
+	struct radius_db_write *w;
+
+	if (batch->committed)
+		writer->commits++;
+	writer->written += batch->num_writes - batch->failed;
+	writer->failed += batch->failed;
+	while ((w = dl_list_first(&batch->writes, struct radius_db_write,
+				  list))) {
+		dl_list_del(&w->list);
+		radius_db_write_free(w);
+	}
+	batch->finished = true;
+	if (writer->batch == batch)
+		writer->batch = NULL;
+}
+
+
+static struct radius_db_batch *
+radius_db_batch_new(struct radius_db_writer *writer)
+{
+	struct radius_db_batch *batch;
+	struct radius_db_write *w;
+
+	batch = os_zalloc(sizeof(*batch));
+	if (!batch)
+		return NULL;
+	batch->writer = writer;
+	dl_list_init(&batch->writes);
+	while ((w = dl_list_first(&writer->queue, struct radius_db_write,
+				  list))) {
+		dl_list_del(&w->list);
+		dl_list_add_tail(&batch->writes, &w->list);
+	}
+	batch->num_writes = writer->queue_len;
+	writer->queue_len = 0;
+	return batch;
+}
+
+
+static void radius_db_commit_timeout(void *eloop_ctx, void *timeout_ctx);
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+static void radius_db_commit_done(void *ctx, int deinit)
+{
+	struct radius_db_batch *batch = ctx;
+	struct radius_db_writer *writer = batch->writer;
+
+	if (!batch->finished)
+		radius_db_batch_finish(batch);
+	os_free(batch);
+
+	/* Everything that was queued while this batch was committed forms
+	 * the next group */
+	if (!deinit && !writer->batch && writer->queue_len)
+		eloop_register_timeout(0, 0, radius_db_commit_timeout, writer,
+				       NULL);
+}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+
+static void radius_db_commit_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct radius_db_writer *writer = eloop_ctx;
+	struct radius_db_batch *batch;
+
+	if (writer->batch || !writer->queue_len)
+		return;
+
+	batch = radius_db_batch_new(writer);
+	if (!batch)
+		return;
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	/* The thread is started here rather than in the initialization since
+	 * hostapd may fork into background after that */
+	if (!writer->pool)
+		writer->pool = worker_pool_init(1);
+	if (writer->pool) {
+		writer->batch = batch;
+		if (worker_pool_submit(writer->pool, radius_db_commit,
+				       radius_db_commit_done, batch) == 0)
+			return;
+		writer->batch = NULL;
+	}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+	radius_db_commit(batch);
+	radius_db_batch_finish(batch);
+	os_free(batch);
+}
+
+
+/* Commit all queued writes before returning */
+static void radius_db_flush(struct radius_db_writer *writer)
+{
+	if (!writer)
+		return;
+
+	eloop_cancel_timeout(radius_db_commit_timeout, writer, NULL);
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	if (writer->batch) {
+		/* The done callback frees the batch once it is delivered */
+		worker_pool_wait(writer->pool);
+		radius_db_batch_finish(writer->batch);
+	}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+	if (writer->queue_len) {
+		struct radius_db_batch *batch;
+
+		batch = radius_db_batch_new(writer);
+		if (!batch)
+			return;
+		radius_db_commit(batch);
+		radius_db_batch_finish(batch);
+		os_free(batch);
+	}
+}
+
+
+/* args: 'i' = int, 'I' = sqlite3_int64, 's' = string or %NULL for SQL NULL */
+static void radius_db_queue(struct radius_server_data *data,
+			    enum radius_db_op op, const char *args, ...)
+{
+	struct radius_db_writer *writer = data->db_writer;
+	struct radius_db_write *w;
+	const char *str;
+	va_list ap;
+	unsigned int i;
+
+	if (!writer)
+		return;
+
+	w = os_zalloc(sizeof(*w));
+	if (!w)
+		return;
+	w->op = op;
+
+	va_start(ap, args);
+	for (i = 0; args[i] && i < RADIUS_DB_MAX_ARGS; i++) {
+		if (args[i] == 'i') {
+			w->args[i].is_int = true;
+			w->args[i].val = va_arg(ap, int);
+			continue;
+		}
+		if (args[i] == 'I') {
+			w->args[i].is_int = true;
+			w->args[i].val = va_arg(ap, sqlite3_int64);
+			continue;
+		}
+		str = va_arg(ap, const char *);
+		if (str) {
+			w->args[i].text = os_strdup(str);
+			if (!w->args[i].text)
+				break;
+		}
+	}
+	va_end(ap);
+	w->num_args = i;
+	if (args[i]) {
+		radius_db_write_free(w);
+		return;
+	}
+
+	dl_list_add_tail(&writer->queue, &w->list);
+	writer->queue_len++;
+	writer->queued++;
+	if (writer->queue_len > writer->queue_max)
+		writer->queue_max = writer->queue_len;
+
+	if (writer->queue_len >= RADIUS_DB_QUEUE_MAX) {
+		/* The database cannot keep up; commit synchronously */
+		writer->stalls++;
+		radius_db_flush(writer);
+		return;
+	}
+
+	if (!writer->batch &&
+	    !eloop_is_timeout_registered(radius_db_commit_timeout, writer,
+					 NULL))
+		eloop_register_timeout(0, 0, radius_db_commit_timeout, writer,
+				       NULL);
+}
+
+
+static struct radius_db_writer * radius_db_writer_init(const char *file)
+{
+	struct radius_db_writer *writer;
+
+	writer = os_zalloc(sizeof(*writer));
+	if (!writer)
+		return NULL;
+	dl_list_init(&writer->queue);
+
+	if (sqlite3_open(file, &writer->db) != SQLITE_OK) {
+		RADIUS_ERROR("Could not open SQLite file '%s' for writing",
+			     file);
+		sqlite3_close(writer->db);
+		os_free(writer);
+		return NULL;
+	}
+	sqlite3_busy_timeout(writer->db, RADIUS_DB_BUSY_TIMEOUT);
+
+	return writer;
+}
+
+
+static void radius_db_writer_deinit(struct radius_db_writer *writer)
+{
+	unsigned int i;
+
+	if (!writer)
+		return;
+
+	radius_db_flush(writer);
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	worker_pool_deinit(writer->pool);
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+	eloop_cancel_timeout(radius_db_commit_timeout, writer, NULL);
+	for (i = 0; i < RADIUS_DB_NUM_OPS; i++)
+		sqlite3_finalize(writer->stmt[i]);
+	sqlite3_close(writer->db);
+	os_free(writer);
+}
+
+
+static void radius_db_time(char *buf, size_t len)
+{
+	struct os_time now;
+	struct os_tm tm;
+
+	/* Same format as strftime('%Y-%m-%d %H:%M:%f','now') in SQLite */
+	os_get_time(&now);
+	if (os_gmtime(now.sec, &tm) < 0) {
+		buf[0] = '\0';
+		return;
+	}
+	os_snprintf(buf, len, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+		    tm.year, tm.month, tm.day, tm.hour, tm.min, tm.sec,
+		    (int) (now.usec / 1000));
+}
+
 #endif /* CONFIG_SQLITE */
 
 
@@ -304,23 +881,14 @@ void srv_log(struct radius_session *sess, const char *fmt, ...)
 	RADIUS_DEBUG("[0x%x %s] %s", sess->sess_id, sess->nas_ip, buf);
 
 #ifdef CONFIG_SQLITE
-	if (sess->server->db) {
-		char *sql;
-		sql = sqlite3_mprintf("INSERT INTO authlog"
-				      "(timestamp,session,nas_ip,username,note)"
-				      " VALUES ("
-				      "strftime('%%Y-%%m-%%d %%H:%%M:%%f',"
-				      "'now'),%u,%Q,%Q,%Q)",
-				      sess->sess_id, sess->nas_ip,
-				      sess->username, buf);
-		if (sql) {
-			if (sqlite3_exec(sess->server->db, sql, NULL, NULL,
-					 NULL) != SQLITE_OK) {
-				RADIUS_ERROR("Failed to add authlog entry into sqlite database: %s",
-					     sqlite3_errmsg(sess->server->db));
-			}
-			sqlite3_free(sql);
-		}
+	if (sess->server->db_writer) {
+		char timestamp[30];
+
+		radius_db_time(timestamp, sizeof(timestamp));
+		radius_db_queue(sess->server, RADIUS_DB_AUTHLOG, "sIsss",
+				timestamp, (sqlite3_int64) sess->sess_id,
+				sess->nas_ip,
+				sess->username, buf);
 	}
 #endif /* CONFIG_SQLITE */
 
@@ -332,62 +900,39 @@ static struct radius_client *
 radius_server_get_client(struct radius_server_data *data, struct in_addr *addr,
 			 int ipv6)
 {
-	struct radius_client *client = data->clients;
-
-	while (client) {
 #ifdef CONFIG_IPV6
-		if (ipv6) {
-			struct in6_addr *addr6;
-			int i;
-
-			addr6 = (struct in6_addr *) addr;
-			for (i = 0; i < 16; i++) {
-				if ((addr6->s6_addr[i] &
-				     client->mask6.s6_addr[i]) !=
-				    (client->addr6.s6_addr[i] &
-				     client->mask6.s6_addr[i])) {
-					i = 17;
-					break;
-				}
-			}
-			if (i == 16) {
-				break;
-			}
-		}
+	if (ipv6)
+		return prefix_trie_lookup(data->clients6,
+					  ((struct in6_addr *) addr)->s6_addr,
+					  128);
 #endif /* CONFIG_IPV6 */
-		if (!ipv6 && (client->addr.s_addr & client->mask.s_addr) ==
-		    (addr->s_addr & client->mask.s_addr)) {
-			break;
-		}
-
-		client = client->next;
-	}
+	if (ipv6)
+		return NULL;
 
-	return client;
+	return prefix_trie_lookup(data->clients4, (const u8 *) &addr->s_addr,
+				  32);
 }
 
 
 static struct radius_session *
-radius_server_get_session(struct radius_client *client, unsigned int sess_id)
+radius_server_get_session(struct radius_server_data *data,
+			  struct radius_client *client, unsigned int sess_id)
 {
-	struct radius_session *sess = client->sessions;
+	struct radius_session *sess;
 
+	sess = data->sess_hash[sess_id % RADIUS_SESSION_HASH_SIZE];
 	while (sess) {
-		if (sess->sess_id == sess_id) {
+		if (sess->sess_id == sess_id && sess->client == client)
 			break;
-		}
-		sess = sess->next;
+		sess = sess->hnext;
 	}
 
 	return sess;
 }
 
 
-static void radius_server_session_free(struct radius_server_data *data,
-				       struct radius_session *sess)
+static void radius_server_session_release(struct radius_session *sess)
 {
-	eloop_cancel_timeout(radius_server_session_timeout, data, sess);
-	eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
 	eap_server_sm_deinit(sess->eap);
 	radius_msg_free(sess->last_msg);
 	os_free(sess->last_from_addr);
@@ -395,43 +940,55 @@ static void radius_server_session_free(struct radius_server_data *data,
 	os_free(sess->username);
 	os_free(sess->nas_ip);
 	os_free(sess);
-	data->num_sess--;
 }
 
 
-static void radius_server_session_remove(struct radius_server_data *data,
-					 struct radius_session *sess)
+static void radius_server_session_free(struct radius_server_data *data,
+				       struct radius_session *sess)
 {
-	struct radius_client *client = sess->client;
-	struct radius_session *session, *prev;
-
-	eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
+	struct radius_session **pos;
 
-	prev = NULL;
-	session = client->sessions;
-	while (session) {
-		if (session == sess) {
-			if (prev == NULL) {
-				client->sessions = sess->next;
-			} else {
-				prev->next = sess->next;
-			}
-			radius_server_session_free(data, sess);
+	pos = &data->sess_hash[sess->sess_id % RADIUS_SESSION_HASH_SIZE];
+	for (; *pos; pos = &(*pos)->hnext) {
+		if (*pos == sess) {
+			*pos = sess->hnext;
 			break;
 		}
-		prev = session;
-		session = session->next;
 	}
-}
+	dl_list_del(&sess->list);
 
+	eloop_cancel_timeout(radius_server_session_timeout, data, sess);
+	eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
+	data->num_sess--;
 
-static void radius_server_session_remove_timeout(void *eloop_ctx,
-						 void *timeout_ctx)
-{
-	struct radius_server_data *data = eloop_ctx;
-	struct radius_session *sess = timeout_ctx;
-	RADIUS_DEBUG("Removing completed session 0x%x", sess->sess_id);
-	radius_server_session_remove(data, sess);
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	if (sess->job_pending) {
+		/* The worker is still using the EAP state machine, so leave
+		 * freeing the session to the job completion callback */
+		sess->removed = true;
+		return;
+	}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+	radius_server_session_release(sess);
+}
+
+
+static void radius_server_session_remove(struct radius_server_data *data,
+					 struct radius_session *sess)
+{
+	eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
+	radius_server_session_free(data, sess);
+}
+
+
+static void radius_server_session_remove_timeout(void *eloop_ctx,
+						 void *timeout_ctx)
+{
+	struct radius_server_data *data = eloop_ctx;
+	struct radius_session *sess = timeout_ctx;
+	RADIUS_DEBUG("Removing completed session 0x%x", sess->sess_id);
+	radius_server_session_remove(data, sess);
 }
 
 
@@ -464,8 +1021,9 @@ radius_server_new_session(struct radius_server_data *data,
 	sess->server = data;
 	sess->client = client;
 	sess->sess_id = data->next_sess_id++;
-	sess->next = client->sessions;
-	client->sessions = sess;
+	dl_list_add(&client->sessions, &sess->list);
+	sess->hnext = data->sess_hash[sess->sess_id % RADIUS_SESSION_HASH_SIZE];
+	data->sess_hash[sess->sess_id % RADIUS_SESSION_HASH_SIZE] = sess;
 	eloop_register_timeout(RADIUS_SESSION_TIMEOUT, 0,
 			       radius_server_session_timeout, data, sess);
 	data->num_sess++;
@@ -665,12 +1223,11 @@ radius_server_get_new_session(struct radius_server_data *data,
 static void radius_srv_hs20_t_c_pending(struct radius_session *sess)
 {
 #ifdef CONFIG_SQLITE
-	char *sql;
 	char addr[3 * ETH_ALEN], *id_str;
 	const u8 *id;
 	size_t id_len;
 
-	if (!sess->server->db || !sess->eap ||
+	if (!sess->server->db_writer || !sess->eap ||
 	    is_zero_ether_addr(sess->mac_addr))
 		return;
 
@@ -685,18 +1242,8 @@ static void radius_srv_hs20_t_c_pending(struct radius_session *sess)
 	os_memcpy(id_str, id, id_len);
 	id_str[id_len] = '\0';
 
-	sql = sqlite3_mprintf("INSERT OR REPLACE INTO pending_tc (mac_addr,identity) VALUES (%Q,%Q)",
-			      addr, id_str);
+	radius_db_queue(sess->server, RADIUS_DB_PENDING_TC, "ss", addr, id_str);
 	os_free(id_str);
-	if (!sql)
-		return;
-
-	if (sqlite3_exec(sess->server->db, sql, NULL, NULL, NULL) !=
-	    SQLITE_OK) {
-		RADIUS_ERROR("Failed to add pending_tc entry into sqlite database: %s",
-			     sqlite3_errmsg(sess->server->db));
-	}
-	sqlite3_free(sql);
 #endif /* CONFIG_SQLITE */
 }
 #endif /* CONFIG_HS20 */
@@ -705,29 +1252,19 @@ static void radius_srv_hs20_t_c_pending(struct radius_session *sess)
 static void radius_server_add_session(struct radius_session *sess)
 {
 #ifdef CONFIG_SQLITE
-	char *sql;
 	char addr_txt[ETH_ALEN * 3];
 	struct os_time now;
 
-	if (!sess->server->db)
+	if (!sess->server->db_writer)
 		return;
 
-
 	os_snprintf(addr_txt, sizeof(addr_txt), MACSTR,
 		    MAC2STR(sess->mac_addr));
 
 	os_get_time(&now);
-	sql = sqlite3_mprintf("INSERT OR REPLACE INTO current_sessions(mac_addr,identity,start_time,nas,hs20_t_c_filtering) VALUES (%Q,%Q,%d,%Q,%u)",
-			      addr_txt, sess->username, now.sec,
-			      sess->nas_ip, sess->t_c_filtering);
-	if (sql) {
-			if (sqlite3_exec(sess->server->db, sql, NULL, NULL,
-					 NULL) != SQLITE_OK) {
-				RADIUS_ERROR("Failed to add current_sessions entry into sqlite database: %s",
-					     sqlite3_errmsg(sess->server->db));
-			}
-			sqlite3_free(sql);
-	}
+	radius_db_queue(sess->server, RADIUS_DB_CURRENT_SESSION, "ssisi",
+			addr_txt, sess->username, (int) now.sec, sess->nas_ip,
+			(int) sess->t_c_filtering);
 #endif /* CONFIG_SQLITE */
 }
 
@@ -736,13 +1273,12 @@ static void db_update_last_msk(struct radius_session *sess, const char *msk)
 {
 #ifdef CONFIG_RADIUS_TEST
 #ifdef CONFIG_SQLITE
-	char *sql = NULL;
 	char *id_str = NULL;
 	const u8 *id;
 	size_t id_len;
 	const char *serial_num;
 
-	if (!sess->server->db)
+	if (!sess->server->db_writer)
 		return;
 
 	serial_num = eap_get_serial_num(sess->eap);
@@ -763,18 +1299,8 @@ static void db_update_last_msk(struct radius_session *sess, const char *msk)
 		id_str[id_len] = '\0';
 	}
 
-	sql = sqlite3_mprintf("UPDATE users SET last_msk=%Q WHERE identity=%Q",
-			      msk, id_str);
+	radius_db_queue(sess->server, RADIUS_DB_LAST_MSK, "ss", msk, id_str);
 	os_free(id_str);
-	if (!sql)
-		return;
-
-	if (sqlite3_exec(sess->server->db, sql, NULL, NULL, NULL) !=
-	    SQLITE_OK) {
-		RADIUS_DEBUG("Failed to update last_msk: %s",
-			     sqlite3_errmsg(sess->server->db));
-	}
-	sqlite3_free(sql);
 #endif /* CONFIG_SQLITE */
 #endif /* CONFIG_RADIUS_TEST */
 }
@@ -1233,6 +1759,114 @@ radius_server_macacl(struct radius_server_data *data,
 }
 
 
+static void radius_server_rate(struct radius_server_data *data,
+			       unsigned int rx, unsigned int tx)
+{
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	if (now.sec != data->rate_sec) {
+		if (now.sec == data->rate_sec + 1) {
+			data->rx_pps = data->rx_cur;
+			data->tx_pps = data->tx_cur;
+		} else {
+			data->rx_pps = data->tx_pps = 0;
+		}
+		data->rx_cur = data->tx_cur = 0;
+		data->rate_sec = now.sec;
+	}
+	data->rx_cur += rx;
+	data->tx_cur += tx;
+	data->rx_packets += rx;
+	data->tx_packets += tx;
+}
+
+
+static void radius_server_flush(struct radius_server_data *data)
+{
+	struct radius_server_io *io = data->io;
+	unsigned int i, sent = 0;
+	int res;
+
+	if (!io->tx_count)
+		return;
+
+#ifdef __linux__
+	for (i = 0; i < io->tx_count; i++) {
+		io->iov[i].iov_base = io->tx_buf[i];
+		io->iov[i].iov_len = io->tx_len[i];
+		os_memset(&io->msg[i], 0, sizeof(io->msg[i]));
+		io->msg[i].msg_hdr.msg_name = &io->tx_to[i];
+		io->msg[i].msg_hdr.msg_namelen = io->tx_tolen[i];
+		io->msg[i].msg_hdr.msg_iov = &io->iov[i];
+		io->msg[i].msg_hdr.msg_iovlen = 1;
+	}
+	while (sent < io->tx_count) {
+		res = sendmmsg(io->tx_sock, &io->msg[sent],
+			       io->tx_count - sent, 0);
+		if (res <= 0) {
+			wpa_printf(MSG_INFO, "sendmmsg[RADIUS SRV]: %s",
+				   strerror(errno));
+			/* Skip the datagram that could not be sent */
+			sent++;
+			continue;
+		}
+		sent += res;
+		radius_server_rate(data, 0, res);
+	}
+#else /* __linux__ */
+	for (i = 0; i < io->tx_count; i++) {
+		res = sendto(io->tx_sock, io->tx_buf[i], io->tx_len[i], 0,
+			     (struct sockaddr *) &io->tx_to[i],
+			     io->tx_tolen[i]);
+		if (res < 0) {
+			wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s",
+				   strerror(errno));
+			continue;
+		}
+		sent++;
+	}
+	radius_server_rate(data, 0, sent);
+#endif /* __linux__ */
+
+	io->tx_count = 0;
+}
+
+
+/*
+ * Send a datagram. Replies to the datagrams of the batch that is being
+ * processed are queued and sent once the batch has been processed.
+ */
+static int radius_server_send(struct radius_server_data *data, int sock,
+			      const struct wpabuf *buf,
+			      const struct sockaddr *to, socklen_t tolen)
+{
+	struct radius_server_io *io = data->io;
+	int res;
+
+	if (io && io->tx_sock == sock && wpabuf_len(buf) <= RADIUS_MAX_MSG_LEN &&
+	    tolen <= sizeof(io->tx_to[0])) {
+		if (io->tx_count == RADIUS_SERVER_BATCH)
+			radius_server_flush(data);
+		os_memcpy(io->tx_buf[io->tx_count], wpabuf_head(buf),
+			  wpabuf_len(buf));
+		io->tx_len[io->tx_count] = wpabuf_len(buf);
+		os_memcpy(&io->tx_to[io->tx_count], to, tolen);
+		io->tx_tolen[io->tx_count] = tolen;
+		io->tx_count++;
+		return 0;
+	}
+
+	res = sendto(sock, wpabuf_head(buf), wpabuf_len(buf), 0, to, tolen);
+	if (res < 0) {
+		wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s", strerror(errno));
+		return -1;
+	}
+	radius_server_rate(data, 0, 1);
+	return 0;
+}
+
+
 static int radius_server_reject(struct radius_server_data *data,
 				struct radius_client *client,
 				struct radius_msg *request,
@@ -1282,11 +1916,8 @@ static int radius_server_reject(struct radius_server_data *data,
 	data->counters.access_rejects++;
 	client->counters.access_rejects++;
 	buf = radius_msg_get_buf(msg);
-	if (sendto(data->auth_sock, wpabuf_head(buf), wpabuf_len(buf), 0,
-		   (struct sockaddr *) from, sizeof(*from)) < 0) {
-		wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s", strerror(errno));
+	if (radius_server_send(data, data->auth_sock, buf, from, fromlen) < 0)
 		ret = -1;
-	}
 
 	radius_msg_free(msg);
 
@@ -1339,107 +1970,223 @@ static void radius_server_hs20_t_c_check(struct radius_session *sess,
 }
 
 
-static int radius_server_request(struct radius_server_data *data,
-				 struct radius_msg *msg,
-				 struct sockaddr *from, socklen_t fromlen,
-				 struct radius_client *client,
-				 const char *from_addr, int from_port,
-				 struct radius_session *force_sess)
+static void radius_server_reply_key(const struct sockaddr *from,
+				    struct radius_msg *msg, u8 *key)
 {
-	struct wpabuf *eap = NULL;
-	int res, state_included = 0;
-	u8 statebuf[4];
-	unsigned int state;
-	struct radius_session *sess;
-	struct radius_msg *reply;
-	int is_complete = 0;
+	struct radius_hdr *hdr = radius_msg_get_hdr(msg);
 
-	if (force_sess)
-		sess = force_sess;
-	else {
-		res = radius_msg_get_attr(msg, RADIUS_ATTR_STATE, statebuf,
-					  sizeof(statebuf));
-		state_included = res >= 0;
-		if (res == sizeof(statebuf)) {
-			state = WPA_GET_BE32(statebuf);
-			sess = radius_server_get_session(client, state);
-		} else {
-			sess = NULL;
-		}
+	os_memset(key, 0, RADIUS_REPLY_KEY_LEN);
+	if (from->sa_family == AF_INET) {
+		const struct sockaddr_in *sin =
+			(const struct sockaddr_in *) from;
+
+		os_memcpy(key, &sin->sin_addr, 4);
+		os_memcpy(key + 16, &sin->sin_port, 2);
 	}
+#ifdef CONFIG_IPV6
+	if (from->sa_family == AF_INET6) {
+		const struct sockaddr_in6 *sin6 =
+			(const struct sockaddr_in6 *) from;
 
-	if (sess) {
-		RADIUS_DEBUG("Request for session 0x%x", sess->sess_id);
-	} else if (state_included) {
-		RADIUS_DEBUG("State attribute included but no session found");
-		radius_server_reject(data, client, msg, from, fromlen,
-				     from_addr, from_port);
-		return -1;
-	} else {
-		sess = radius_server_get_new_session(data, client, msg,
-						     from_addr);
-		if (sess == NULL) {
-			RADIUS_DEBUG("Could not create a new session");
-			radius_server_reject(data, client, msg, from, fromlen,
-					     from_addr, from_port);
-			return -1;
-		}
+		os_memcpy(key, &sin6->sin6_addr, 16);
+		os_memcpy(key + 16, &sin6->sin6_port, 2);
 	}
+#endif /* CONFIG_IPV6 */
+	key[18] = hdr->identifier;
+	os_memcpy(key + 19, hdr->authenticator, 16);
+}
 
-	if (sess->last_from_port == from_port &&
-	    sess->last_identifier == radius_msg_get_hdr(msg)->identifier &&
-	    os_memcmp(sess->last_authenticator,
-		      radius_msg_get_hdr(msg)->authenticator, 16) == 0) {
-		RADIUS_DEBUG("Duplicate message from %s", from_addr);
-		data->counters.dup_access_requests++;
-		client->counters.dup_access_requests++;
 
-		if (sess->last_reply) {
-			struct wpabuf *buf;
-			buf = radius_msg_get_buf(sess->last_reply);
-			res = sendto(data->auth_sock, wpabuf_head(buf),
-				     wpabuf_len(buf), 0,
-				     (struct sockaddr *) from, fromlen);
-			if (res < 0) {
-				wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s",
-					   strerror(errno));
-			}
-			return 0;
+static unsigned int radius_server_reply_hash(struct radius_server_data *data,
+					     const u8 *key)
+{
+	return siphash24(data->reply_hash_key, key, RADIUS_REPLY_KEY_LEN) &
+		(RADIUS_REPLY_HASH_SIZE - 1);
+}
+
+
+static void radius_server_reply_free(struct radius_server_data *data,
+				     struct radius_reply_cache_entry *entry)
+{
+	struct radius_reply_cache_entry **pos;
+
+	pos = &data->reply_hash[radius_server_reply_hash(data, entry->key)];
+	for (; *pos; pos = &(*pos)->hnext) {
+		if (*pos == entry) {
+			*pos = entry->hnext;
+			break;
 		}
+	}
+	dl_list_del(&entry->list);
+	data->reply_cache_len--;
+	wpabuf_free(entry->reply);
+	os_free(entry);
+}
 
-		RADIUS_DEBUG("No previous reply available for duplicate "
-			     "message");
-		return -1;
+
+static void radius_server_reply_expire(struct radius_server_data *data)
+{
+	struct radius_reply_cache_entry *entry;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	while ((entry = dl_list_first(&data->reply_cache,
+				      struct radius_reply_cache_entry,
+				      list))) {
+		if (data->reply_cache_len < RADIUS_REPLY_CACHE_SIZE &&
+		    !os_reltime_expired(&now, &entry->added,
+					RADIUS_REPLY_CACHE_TIMEOUT))
+			break;
+		radius_server_reply_free(data, entry);
 	}
+}
 
-	eap = radius_msg_get_eap(msg);
-	if (eap == NULL && sess->macacl) {
-		reply = radius_server_macacl(data, client, sess, msg);
-		if (reply == NULL)
-			return -1;
-		goto send_reply;
+
+static const struct wpabuf *
+radius_server_reply_get(struct radius_server_data *data,
+			const struct sockaddr *from, struct radius_msg *msg)
+{
+	struct radius_reply_cache_entry *entry;
+	u8 key[RADIUS_REPLY_KEY_LEN];
+
+	if (dl_list_empty(&data->reply_cache))
+		return NULL;
+
+	radius_server_reply_expire(data);
+	radius_server_reply_key(from, msg, key);
+	entry = data->reply_hash[radius_server_reply_hash(data, key)];
+	for (; entry; entry = entry->hnext) {
+		if (os_memcmp(entry->key, key, RADIUS_REPLY_KEY_LEN) == 0)
+			return entry->reply;
 	}
-	if (eap == NULL) {
-		RADIUS_DEBUG("No EAP-Message in RADIUS packet from %s",
-			     from_addr);
+
+	return NULL;
+}
+
+
+static void radius_server_reply_add(struct radius_server_data *data,
+				    const struct sockaddr *from,
+				    struct radius_msg *msg,
+				    const struct wpabuf *reply)
+{
+	struct radius_reply_cache_entry *entry;
+	unsigned int hash;
+
+	radius_server_reply_expire(data);
+
+	entry = os_zalloc(sizeof(*entry));
+	if (!entry)
+		return;
+	entry->reply = wpabuf_dup(reply);
+	if (!entry->reply) {
+		os_free(entry);
+		return;
+	}
+	radius_server_reply_key(from, msg, entry->key);
+	os_get_reltime(&entry->added);
+
+	hash = radius_server_reply_hash(data, entry->key);
+	entry->hnext = data->reply_hash[hash];
+	data->reply_hash[hash] = entry;
+	dl_list_add_tail(&data->reply_cache, &entry->list);
+	data->reply_cache_len++;
+}
+
+
+/* Store a request whose processing continues asynchronously */
+static void radius_server_save_msg(struct radius_session *sess,
+				   struct radius_msg *msg,
+				   struct sockaddr *from, socklen_t fromlen,
+				   const char *from_addr, int from_port)
+{
+	if (sess->last_msg != msg)
+		radius_msg_free(sess->last_msg);
+	sess->last_msg = msg;
+	sess->last_from_port = from_port;
+	if (from_addr != sess->last_from_addr) {
+		os_free(sess->last_from_addr);
+		sess->last_from_addr = os_strdup(from_addr);
+	}
+	if (from != (struct sockaddr *) &sess->last_from) {
+		sess->last_fromlen = fromlen;
+		os_memcpy(&sess->last_from, from, fromlen);
+	}
+}
+
+
+static int radius_server_send_reply(struct radius_server_data *data,
+				    struct radius_session *sess,
+				    struct radius_msg *msg,
+				    struct radius_msg *reply,
+				    struct sockaddr *from, socklen_t fromlen,
+				    const char *from_addr, int from_port,
+				    int is_complete)
+{
+	struct radius_client *client = sess->client;
+
+	if (reply) {
+		struct wpabuf *buf;
+		struct radius_hdr *hdr;
+
+		RADIUS_DEBUG("Reply to %s:%d", from_addr, from_port);
+		if (wpa_debug_level <= MSG_MSGDUMP) {
+			radius_msg_dump(reply);
+		}
+
+		switch (radius_msg_get_hdr(reply)->code) {
+		case RADIUS_CODE_ACCESS_ACCEPT:
+			srv_log(sess, "Sending Access-Accept");
+			data->counters.access_accepts++;
+			client->counters.access_accepts++;
+			break;
+		case RADIUS_CODE_ACCESS_REJECT:
+			srv_log(sess, "Sending Access-Reject");
+			data->counters.access_rejects++;
+			client->counters.access_rejects++;
+			break;
+		case RADIUS_CODE_ACCESS_CHALLENGE:
+			data->counters.access_challenges++;
+			client->counters.access_challenges++;
+			break;
+		}
+		buf = radius_msg_get_buf(reply);
+		radius_server_send(data, data->auth_sock, buf, from, fromlen);
+		radius_server_reply_add(data, from, msg, buf);
+		radius_msg_free(sess->last_reply);
+		sess->last_reply = reply;
+		sess->last_from_port = from_port;
+		hdr = radius_msg_get_hdr(msg);
+		sess->last_identifier = hdr->identifier;
+		os_memcpy(sess->last_authenticator, hdr->authenticator, 16);
+	} else {
 		data->counters.packets_dropped++;
 		client->counters.packets_dropped++;
-		return -1;
 	}
 
-	RADIUS_DUMP("Received EAP data", wpabuf_head(eap), wpabuf_len(eap));
+	if (is_complete) {
+		RADIUS_DEBUG("Removing completed session 0x%x after timeout",
+			     sess->sess_id);
+		eloop_cancel_timeout(radius_server_session_remove_timeout,
+				     data, sess);
+		eloop_register_timeout(RADIUS_SESSION_MAINTAIN, 0,
+				       radius_server_session_remove_timeout,
+				       data, sess);
+	}
 
-	/* FIX: if Code is Request, Success, or Failure, send Access-Reject;
-	 * RFC3579 Sect. 2.6.2.
-	 * Include EAP-Response/Nak with no preferred method if
-	 * code == request.
-	 * If code is not 1-4, discard the packet silently.
-	 * Or is this already done by the EAP state machine? */
+	return 0;
+}
 
-	wpabuf_free(sess->eap_if->eapRespData);
-	sess->eap_if->eapRespData = eap;
-	sess->eap_if->eapResp = true;
-	eap_server_sm_step(sess->eap);
+
+/* Build and send the reply once the EAP state machine has been stepped */
+static int radius_server_eap_done(struct radius_server_data *data,
+				  struct radius_session *sess,
+				  struct radius_msg *msg,
+				  struct sockaddr *from, socklen_t fromlen,
+				  const char *from_addr, int from_port)
+{
+	struct radius_client *client = sess->client;
+	struct radius_msg *reply;
+	int is_complete = 0;
 
 	if ((sess->eap_if->eapReq || sess->eap_if->eapSuccess ||
 	     sess->eap_if->eapFail) && sess->eap_if->eapReqData) {
@@ -1450,13 +2197,8 @@ static int radius_server_request(struct radius_server_data *data,
 		RADIUS_DEBUG("No EAP data from the state machine, but eapFail "
 			     "set");
 	} else if (eap_sm_method_pending(sess->eap)) {
-		radius_msg_free(sess->last_msg);
-		sess->last_msg = msg;
-		sess->last_from_port = from_port;
-		os_free(sess->last_from_addr);
-		sess->last_from_addr = os_strdup(from_addr);
-		sess->last_fromlen = fromlen;
-		os_memcpy(&sess->last_from, from, fromlen);
+		radius_server_save_msg(sess, msg, from, fromlen, from_addr,
+				       from_port);
 		return -2;
 	} else {
 		RADIUS_DEBUG("No EAP data from the state machine - ignore this"
@@ -1481,62 +2223,244 @@ static int radius_server_request(struct radius_server_data *data,
 
 	reply = radius_server_encapsulate_eap(data, client, sess, msg);
 
-send_reply:
-	if (reply) {
-		struct wpabuf *buf;
-		struct radius_hdr *hdr;
+	return radius_server_send_reply(data, sess, msg, reply, from, fromlen,
+					from_addr, from_port, is_complete);
+}
+
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+
+static void radius_server_eap_work(void *ctx)
+{
+	struct radius_session *sess = ctx;
+
+	eap_server_sm_step(sess->eap);
+}
+
+
+static void radius_server_eap_work_done(void *ctx, int deinit)
+{
+	struct radius_session *sess = ctx;
+	struct radius_msg *msg;
+
+	sess->job_pending = false;
+	if (sess->removed) {
+		radius_server_session_release(sess);
+		return;
+	}
+	if (deinit)
+		return;
+
+	msg = sess->last_msg;
+	sess->last_msg = NULL;
+	if (radius_server_eap_done(sess->server, sess, msg,
+				   (struct sockaddr *) &sess->last_from,
+				   sess->last_fromlen, sess->last_from_addr,
+				   sess->last_from_port) == -2)
+		return; /* msg was stored with the session */
+
+	radius_msg_free(msg);
+}
+
+
+static int radius_server_eap_submit(struct radius_server_data *data,
+				    struct radius_session *sess,
+				    struct radius_msg *msg,
+				    struct sockaddr *from, socklen_t fromlen,
+				    const char *from_addr, int from_port)
+{
+	radius_server_save_msg(sess, msg, from, fromlen, from_addr, from_port);
+	sess->job_pending = true;
+	if (worker_pool_submit(sess->worker, radius_server_eap_work,
+			       radius_server_eap_work_done, sess) < 0) {
+		sess->job_pending = false;
+		sess->last_msg = NULL;
+		data->counters.packets_dropped++;
+		sess->client->counters.packets_dropped++;
+		return -1;
+	}
+	data->worker_jobs++;
+
+	return -2;
+}
+
+
+static struct worker_pool *
+radius_server_get_worker(struct radius_server_data *data,
+			 struct radius_session *sess)
+{
+	unsigned int threads;
+	long cpus;
+
+	if (!data->threads)
+		return NULL;
+
+	if (!data->num_workers) {
+		if (data->threads < 0) {
+			cpus = sysconf(_SC_NPROCESSORS_ONLN);
+			threads = cpus > 0 ? cpus : 1;
+		} else {
+			threads = data->threads;
+		}
+		if (threads > RADIUS_SERVER_MAX_THREADS)
+			threads = RADIUS_SERVER_MAX_THREADS;
+
+		while (data->num_workers < threads) {
+			data->workers[data->num_workers] = worker_pool_init(1);
+			if (!data->workers[data->num_workers])
+				break;
+			data->num_workers++;
+		}
+		if (!data->num_workers) {
+			RADIUS_ERROR("Failed to start worker threads - running EAP in the event loop");
+			data->threads = 0;
+			return NULL;
+		}
+		RADIUS_DEBUG("Running EAP in %u worker thread(s)",
+			     data->num_workers);
+	}
+
+	/* Session identifiers are sequential, so this spreads the sessions
+	 * evenly over the workers */
+	return data->workers[sess->sess_id % data->num_workers];
+}
+
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+
+static int radius_server_request(struct radius_server_data *data,
+				 struct radius_msg *msg,
+				 struct sockaddr *from, socklen_t fromlen,
+				 struct radius_client *client,
+				 const char *from_addr, int from_port,
+				 struct radius_session *force_sess)
+{
+	struct wpabuf *eap = NULL;
+	int res, state_included = 0;
+	u8 statebuf[4];
+	unsigned int state;
+	struct radius_session *sess;
+	struct radius_msg *reply;
+
+	if (!force_sess) {
+		const struct wpabuf *buf;
+
+		buf = radius_server_reply_get(data, from, msg);
+		if (buf) {
+			RADIUS_DEBUG("Duplicate message from %s - resend cached reply",
+				     from_addr);
+			data->counters.dup_access_requests++;
+			client->counters.dup_access_requests++;
+			radius_server_send(data, data->auth_sock, buf, from,
+					   fromlen);
+			return 0;
+		}
+	}
+
+	if (force_sess)
+		sess = force_sess;
+	else {
+		res = radius_msg_get_attr(msg, RADIUS_ATTR_STATE, statebuf,
+					  sizeof(statebuf));
+		state_included = res >= 0;
+		if (res == sizeof(statebuf)) {
+			state = WPA_GET_BE32(statebuf);
+			sess = radius_server_get_session(data, client, state);
+		} else {
+			sess = NULL;
+		}
+	}
+
+	if (sess) {
+		RADIUS_DEBUG("Request for session 0x%x", sess->sess_id);
+	} else if (state_included) {
+		RADIUS_DEBUG("State attribute included but no session found");
+		radius_server_reject(data, client, msg, from, fromlen,
+				     from_addr, from_port);
+		return -1;
+	} else {
+		sess = radius_server_get_new_session(data, client, msg,
+						     from_addr);
+		if (sess == NULL) {
+			RADIUS_DEBUG("Could not create a new session");
+			radius_server_reject(data, client, msg, from, fromlen,
+					     from_addr, from_port);
+			return -1;
+		}
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+		sess->worker = radius_server_get_worker(data, sess);
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+	}
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	if (sess->job_pending) {
+		RADIUS_DEBUG("Previous request for session 0x%x is still being processed - drop message from %s",
+			     sess->sess_id, from_addr);
+		data->counters.packets_dropped++;
+		client->counters.packets_dropped++;
+		return -1;
+	}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+	if (sess->last_from_port == from_port &&
+	    sess->last_identifier == radius_msg_get_hdr(msg)->identifier &&
+	    os_memcmp(sess->last_authenticator,
+		      radius_msg_get_hdr(msg)->authenticator, 16) == 0) {
+		RADIUS_DEBUG("Duplicate message from %s", from_addr);
+		data->counters.dup_access_requests++;
+		client->counters.dup_access_requests++;
 
-		RADIUS_DEBUG("Reply to %s:%d", from_addr, from_port);
-		if (wpa_debug_level <= MSG_MSGDUMP) {
-			radius_msg_dump(reply);
+		if (sess->last_reply) {
+			struct wpabuf *buf;
+			buf = radius_msg_get_buf(sess->last_reply);
+			radius_server_send(data, data->auth_sock, buf, from,
+					   fromlen);
+			return 0;
 		}
 
-		switch (radius_msg_get_hdr(reply)->code) {
-		case RADIUS_CODE_ACCESS_ACCEPT:
-			srv_log(sess, "Sending Access-Accept");
-			data->counters.access_accepts++;
-			client->counters.access_accepts++;
-			break;
-		case RADIUS_CODE_ACCESS_REJECT:
-			srv_log(sess, "Sending Access-Reject");
-			data->counters.access_rejects++;
-			client->counters.access_rejects++;
-			break;
-		case RADIUS_CODE_ACCESS_CHALLENGE:
-			data->counters.access_challenges++;
-			client->counters.access_challenges++;
-			break;
-		}
-		buf = radius_msg_get_buf(reply);
-		res = sendto(data->auth_sock, wpabuf_head(buf),
-			     wpabuf_len(buf), 0,
-			     (struct sockaddr *) from, fromlen);
-		if (res < 0) {
-			wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s",
-				   strerror(errno));
-		}
-		radius_msg_free(sess->last_reply);
-		sess->last_reply = reply;
-		sess->last_from_port = from_port;
-		hdr = radius_msg_get_hdr(msg);
-		sess->last_identifier = hdr->identifier;
-		os_memcpy(sess->last_authenticator, hdr->authenticator, 16);
-	} else {
+		RADIUS_DEBUG("No previous reply available for duplicate "
+			     "message");
+		return -1;
+	}
+
+	eap = radius_msg_get_eap(msg);
+	if (eap == NULL && sess->macacl) {
+		reply = radius_server_macacl(data, client, sess, msg);
+		if (reply == NULL)
+			return -1;
+		return radius_server_send_reply(data, sess, msg, reply, from,
+						fromlen, from_addr, from_port,
+						0);
+	}
+	if (eap == NULL) {
+		RADIUS_DEBUG("No EAP-Message in RADIUS packet from %s",
+			     from_addr);
 		data->counters.packets_dropped++;
 		client->counters.packets_dropped++;
+		return -1;
 	}
 
-	if (is_complete) {
-		RADIUS_DEBUG("Removing completed session 0x%x after timeout",
-			     sess->sess_id);
-		eloop_cancel_timeout(radius_server_session_remove_timeout,
-				     data, sess);
-		eloop_register_timeout(RADIUS_SESSION_MAINTAIN, 0,
-				       radius_server_session_remove_timeout,
-				       data, sess);
-	}
+	RADIUS_DUMP("Received EAP data", wpabuf_head(eap), wpabuf_len(eap));
 
-	return 0;
+	/* FIX: if Code is Request, Success, or Failure, send Access-Reject;
+	 * RFC3579 Sect. 2.6.2.
+	 * Include EAP-Response/Nak with no preferred method if
+	 * code == request.
+	 * If code is not 1-4, discard the packet silently.
+	 * Or is this already done by the EAP state machine? */
+
+	wpabuf_free(sess->eap_if->eapRespData);
+	sess->eap_if->eapRespData = eap;
+	sess->eap_if->eapResp = true;
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	if (sess->worker)
+		return radius_server_eap_submit(data, sess, msg, from, fromlen,
+						from_addr, from_port);
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+	eap_server_sm_step(sess->eap);
+
+	return radius_server_eap_done(data, sess, msg, from, fromlen,
+				      from_addr, from_port);
 }
 
 
@@ -1587,8 +2511,6 @@ static void radius_server_receive_coa_resp(struct radius_server_data *data,
 	struct radius_hdr *hdr;
 #ifdef CONFIG_SQLITE
 	char addrtxt[3 * ETH_ALEN];
-	char *sql;
-	int res;
 #endif /* CONFIG_SQLITE */
 
 	if (!client->pending_dac_coa_req) {
@@ -1623,88 +2545,53 @@ static void radius_server_receive_coa_resp(struct radius_server_data *data,
 	client->pending_dac_coa_req = NULL;
 
 #ifdef CONFIG_SQLITE
-	if (!data->db)
+	if (!data->db_writer)
 		return;
 
 	os_snprintf(addrtxt, sizeof(addrtxt), MACSTR,
 		    MAC2STR(client->pending_dac_coa_addr));
 
-	if (ack) {
-		sql = sqlite3_mprintf("UPDATE current_sessions SET hs20_t_c_filtering=0, waiting_coa_ack=0, coa_ack_received=1 WHERE mac_addr=%Q",
-				      addrtxt);
-	} else {
-		sql = sqlite3_mprintf("UPDATE current_sessions SET waiting_coa_ack=0 WHERE mac_addr=%Q",
-				      addrtxt);
-	}
-	if (!sql)
-		return;
-
-	res = sqlite3_exec(data->db, sql, NULL, NULL, NULL);
-	sqlite3_free(sql);
-	if (res != SQLITE_OK) {
-		RADIUS_ERROR("Failed to update current_sessions entry: %s",
-			     sqlite3_errmsg(data->db));
-		return;
-	}
+	radius_db_queue(data, ack ? RADIUS_DB_COA_ACK : RADIUS_DB_COA_NAK,
+			"s", addrtxt);
 #endif /* CONFIG_SQLITE */
 }
 
 
-static void radius_server_receive_auth(int sock, void *eloop_ctx,
-				       void *sock_ctx)
+static void radius_server_handle_auth(struct radius_server_data *data,
+				      const u8 *buf, int len,
+				      struct sockaddr *from, socklen_t fromlen)
 {
-	struct radius_server_data *data = eloop_ctx;
-	u8 *buf = NULL;
-	union {
-		struct sockaddr_storage ss;
-		struct sockaddr_in sin;
+	struct sockaddr_in *from4 = (struct sockaddr_in *) from;
 #ifdef CONFIG_IPV6
-		struct sockaddr_in6 sin6;
+	struct sockaddr_in6 *from6 = (struct sockaddr_in6 *) from;
 #endif /* CONFIG_IPV6 */
-	} from;
-	socklen_t fromlen;
-	int len;
 	struct radius_client *client = NULL;
 	struct radius_msg *msg = NULL;
 	char abuf[50];
 	int from_port = 0;
 
-	buf = os_malloc(RADIUS_MAX_MSG_LEN);
-	if (buf == NULL) {
-		goto fail;
-	}
-
-	fromlen = sizeof(from);
-	len = recvfrom(sock, buf, RADIUS_MAX_MSG_LEN, 0,
-		       (struct sockaddr *) &from.ss, &fromlen);
-	if (len < 0) {
-		wpa_printf(MSG_INFO, "recvfrom[radius_server]: %s",
-			   strerror(errno));
-		goto fail;
-	}
-
 #ifdef CONFIG_IPV6
 	if (data->ipv6) {
-		if (inet_ntop(AF_INET6, &from.sin6.sin6_addr, abuf,
+		if (inet_ntop(AF_INET6, &from6->sin6_addr, abuf,
 			      sizeof(abuf)) == NULL)
 			abuf[0] = '\0';
-		from_port = ntohs(from.sin6.sin6_port);
+		from_port = ntohs(from6->sin6_port);
 		RADIUS_DEBUG("Received %d bytes from %s:%d",
 			     len, abuf, from_port);
 
 		client = radius_server_get_client(data,
 						  (struct in_addr *)
-						  &from.sin6.sin6_addr, 1);
+						  &from6->sin6_addr, 1);
 	}
 #endif /* CONFIG_IPV6 */
 
 	if (!data->ipv6) {
-		os_strlcpy(abuf, inet_ntoa(from.sin.sin_addr), sizeof(abuf));
-		from_port = ntohs(from.sin.sin_port);
+		os_strlcpy(abuf, inet_ntoa(from4->sin_addr), sizeof(abuf));
+		from_port = ntohs(from4->sin_port);
 		RADIUS_DEBUG("Received %d bytes from %s:%d",
 			     len, abuf, from_port);
 
-		client = radius_server_get_client(data, &from.sin.sin_addr, 0);
+		client = radius_server_get_client(data, &from4->sin_addr, 0);
 	}
 
 	RADIUS_DUMP("Received data", buf, len);
@@ -1723,9 +2610,6 @@ static void radius_server_receive_auth(int sock, void *eloop_ctx,
 		goto fail;
 	}
 
-	os_free(buf);
-	buf = NULL;
-
 	if (wpa_debug_level <= MSG_MSGDUMP) {
 		radius_msg_dump(msg);
 	}
@@ -1769,31 +2653,24 @@ static void radius_server_receive_auth(int sock, void *eloop_ctx,
 		goto fail;
 	}
 
-	if (radius_server_request(data, msg, (struct sockaddr *) &from,
-				  fromlen, client, abuf, from_port, NULL) ==
+	if (radius_server_request(data, msg, from, fromlen, client, abuf,
+				  from_port, NULL) ==
 	    -2)
 		return; /* msg was stored with the session */
 
 fail:
 	radius_msg_free(msg);
-	os_free(buf);
 }
 
 
-static void radius_server_receive_acct(int sock, void *eloop_ctx,
-				       void *sock_ctx)
+static void radius_server_handle_acct(struct radius_server_data *data,
+				      const u8 *buf, int len,
+				      struct sockaddr *from, socklen_t fromlen)
 {
-	struct radius_server_data *data = eloop_ctx;
-	u8 *buf = NULL;
-	union {
-		struct sockaddr_storage ss;
-		struct sockaddr_in sin;
+	struct sockaddr_in *from4 = (struct sockaddr_in *) from;
 #ifdef CONFIG_IPV6
-		struct sockaddr_in6 sin6;
+	struct sockaddr_in6 *from6 = (struct sockaddr_in6 *) from;
 #endif /* CONFIG_IPV6 */
-	} from;
-	socklen_t fromlen;
-	int len, res;
 	struct radius_client *client = NULL;
 	struct radius_msg *msg = NULL, *resp = NULL;
 	char abuf[50];
@@ -1801,42 +2678,28 @@ static void radius_server_receive_acct(int sock, void *eloop_ctx,
 	struct radius_hdr *hdr;
 	struct wpabuf *rbuf;
 
-	buf = os_malloc(RADIUS_MAX_MSG_LEN);
-	if (buf == NULL) {
-		goto fail;
-	}
-
-	fromlen = sizeof(from);
-	len = recvfrom(sock, buf, RADIUS_MAX_MSG_LEN, 0,
-		       (struct sockaddr *) &from.ss, &fromlen);
-	if (len < 0) {
-		wpa_printf(MSG_INFO, "recvfrom[radius_server]: %s",
-			   strerror(errno));
-		goto fail;
-	}
-
 #ifdef CONFIG_IPV6
 	if (data->ipv6) {
-		if (inet_ntop(AF_INET6, &from.sin6.sin6_addr, abuf,
+		if (inet_ntop(AF_INET6, &from6->sin6_addr, abuf,
 			      sizeof(abuf)) == NULL)
 			abuf[0] = '\0';
-		from_port = ntohs(from.sin6.sin6_port);
+		from_port = ntohs(from6->sin6_port);
 		RADIUS_DEBUG("Received %d bytes from %s:%d",
 			     len, abuf, from_port);
 
 		client = radius_server_get_client(data,
 						  (struct in_addr *)
-						  &from.sin6.sin6_addr, 1);
+						  &from6->sin6_addr, 1);
 	}
 #endif /* CONFIG_IPV6 */
 
 	if (!data->ipv6) {
-		os_strlcpy(abuf, inet_ntoa(from.sin.sin_addr), sizeof(abuf));
-		from_port = ntohs(from.sin.sin_port);
+		os_strlcpy(abuf, inet_ntoa(from4->sin_addr), sizeof(abuf));
+		from_port = ntohs(from4->sin_port);
 		RADIUS_DEBUG("Received %d bytes from %s:%d",
 			     len, abuf, from_port);
 
-		client = radius_server_get_client(data, &from.sin.sin_addr, 0);
+		client = radius_server_get_client(data, &from4->sin_addr, 0);
 	}
 
 	RADIUS_DUMP("Received data", buf, len);
@@ -1855,9 +2718,6 @@ static void radius_server_receive_acct(int sock, void *eloop_ctx,
 		goto fail;
 	}
 
-	os_free(buf);
-	buf = NULL;
-
 	if (wpa_debug_level <= MSG_MSGDUMP) {
 		radius_msg_dump(msg);
 	}
@@ -1900,17 +2760,81 @@ static void radius_server_receive_acct(int sock, void *eloop_ctx,
 	rbuf = radius_msg_get_buf(resp);
 	data->counters.acct_responses++;
 	client->counters.acct_responses++;
-	res = sendto(data->acct_sock, wpabuf_head(rbuf), wpabuf_len(rbuf), 0,
-		     (struct sockaddr *) &from.ss, fromlen);
-	if (res < 0) {
-		wpa_printf(MSG_INFO, "sendto[RADIUS SRV]: %s",
-			   strerror(errno));
-	}
+	radius_server_send(data, data->acct_sock, rbuf, from, fromlen);
 
 fail:
 	radius_msg_free(resp);
 	radius_msg_free(msg);
-	os_free(buf);
+}
+
+
+static void radius_server_receive(struct radius_server_data *data, int sock,
+				  void (*handle)(struct radius_server_data *data,
+						 const u8 *buf, int len,
+						 struct sockaddr *from,
+						 socklen_t fromlen))
+{
+	struct radius_server_io *io = data->io;
+	int i, num;
+
+#ifdef __linux__
+	for (i = 0; i < RADIUS_SERVER_BATCH; i++) {
+		io->iov[i].iov_base = io->rx_buf[i];
+		io->iov[i].iov_len = RADIUS_MAX_MSG_LEN;
+		os_memset(&io->msg[i], 0, sizeof(io->msg[i]));
+		io->msg[i].msg_hdr.msg_name = &io->rx_from[i];
+		io->msg[i].msg_hdr.msg_namelen = sizeof(io->rx_from[i]);
+		io->msg[i].msg_hdr.msg_iov = &io->iov[i];
+		io->msg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	num = recvmmsg(sock, io->msg, RADIUS_SERVER_BATCH, MSG_DONTWAIT, NULL);
+	if (num < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			wpa_printf(MSG_INFO, "recvmmsg[radius_server]: %s",
+				   strerror(errno));
+		return;
+	}
+	for (i = 0; i < num; i++) {
+		io->rx_len[i] = io->msg[i].msg_len;
+		io->rx_fromlen[i] = io->msg[i].msg_hdr.msg_namelen;
+	}
+#else /* __linux__ */
+	io->rx_fromlen[0] = sizeof(io->rx_from[0]);
+	io->rx_len[0] = recvfrom(sock, io->rx_buf[0], RADIUS_MAX_MSG_LEN, 0,
+				 (struct sockaddr *) &io->rx_from[0],
+				 &io->rx_fromlen[0]);
+	if (io->rx_len[0] < 0) {
+		wpa_printf(MSG_INFO, "recvfrom[radius_server]: %s",
+			   strerror(errno));
+		return;
+	}
+	num = 1;
+#endif /* __linux__ */
+
+	radius_server_rate(data, num, 0);
+	data->rx_calls++;
+
+	io->tx_sock = sock;
+	for (i = 0; i < num; i++)
+		handle(data, io->rx_buf[i], io->rx_len[i],
+		       (struct sockaddr *) &io->rx_from[i], io->rx_fromlen[i]);
+	radius_server_flush(data);
+	io->tx_sock = -1;
+}
+
+
+static void radius_server_receive_auth(int sock, void *eloop_ctx,
+				       void *sock_ctx)
+{
+	radius_server_receive(eloop_ctx, sock, radius_server_handle_auth);
+}
+
+
+static void radius_server_receive_acct(int sock, void *eloop_ctx,
+				       void *sock_ctx)
+{
+	radius_server_receive(eloop_ctx, sock, radius_server_handle_acct);
 }
 
 
@@ -1985,16 +2909,13 @@ static int radius_server_open_socket6(int port)
 
 
 static void radius_server_free_sessions(struct radius_server_data *data,
-					struct radius_session *sessions)
+					struct dl_list *sessions)
 {
 	struct radius_session *session, *prev;
 
-	session = sessions;
-	while (session) {
-		prev = session;
-		session = session->next;
-		radius_server_session_free(data, prev);
-	}
+	dl_list_for_each_safe(session, prev, sessions, struct radius_session,
+			      list)
+		radius_server_session_free(data, session);
 }
 
 
@@ -2008,7 +2929,7 @@ static void radius_server_free_clients(struct radius_server_data *data,
 		prev = client;
 		client = client->next;
 
-		radius_server_free_sessions(data, prev->sessions);
+		radius_server_free_sessions(data, &prev->sessions);
 		os_free(prev->shared_secret);
 		radius_msg_free(prev->pending_dac_coa_req);
 		radius_msg_free(prev->pending_dac_disconnect_req);
@@ -2018,7 +2939,9 @@ static void radius_server_free_clients(struct radius_server_data *data,
 
 
 static struct radius_client *
-radius_server_read_clients(const char *client_file, int ipv6)
+radius_server_read_clients(const char *client_file, int ipv6,
+			   struct prefix_trie **clients4,
+			   struct prefix_trie **clients6)
 {
 	FILE *f;
 	const int buf_size = 1024;
@@ -2122,6 +3045,7 @@ radius_server_read_clients(const char *client_file, int ipv6)
 			failed = 1;
 			break;
 		}
+		dl_list_init(&entry->sessions);
 		entry->shared_secret = os_strdup(pos);
 		if (entry->shared_secret == NULL) {
 			failed = 1;
@@ -2156,12 +3080,31 @@ radius_server_read_clients(const char *client_file, int ipv6)
 			tail->next = entry;
 			tail = entry;
 		}
+
+		if (!ipv6 &&
+		    prefix_trie_add(clients4, (const u8 *) &entry->addr.s_addr,
+				    mask, entry) < 0) {
+			failed = 1;
+			break;
+		}
+#ifdef CONFIG_IPV6
+		if (ipv6 &&
+		    prefix_trie_add(clients6, entry->addr6.s6_addr, mask,
+				    entry) < 0) {
+			failed = 1;
+			break;
+		}
+#endif /* CONFIG_IPV6 */
 	}
 
 	if (failed) {
 		RADIUS_ERROR("Invalid line %d in '%s'", line, client_file);
 		radius_server_free_clients(NULL, clients);
 		clients = NULL;
+		prefix_trie_free(*clients4);
+		*clients4 = NULL;
+		prefix_trie_free(*clients6);
+		*clients6 = NULL;
 	}
 
 	os_free(buf);
@@ -2171,6 +3114,36 @@ radius_server_read_clients(const char *client_file, int ipv6)
 }
 
 
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+static int radius_server_conf_threads(struct radius_server_data *data,
+				      int threads)
+{
+	const struct eap_config *cfg = data->eap_cfg;
+
+	/* These use eloop from within the EAP methods */
+	if (cfg->eap_sim_db_priv || cfg->wps) {
+		RADIUS_ERROR("Worker threads cannot be used with EAP-SIM/AKA database or WPS");
+		return -1;
+	}
+	/* TNCS connection list and IDs are process-global without locking */
+	if (cfg->tnc) {
+		RADIUS_ERROR("Worker threads cannot be used with TNC");
+		return -1;
+	}
+#ifdef CONFIG_ERP
+	/* The ERP keys returned to the EAP methods are shared by sessions */
+	if (cfg->erp) {
+		RADIUS_ERROR("Worker threads cannot be used with ERP");
+		return -1;
+	}
+#endif /* CONFIG_ERP */
+
+	data->threads = threads;
+	return 0;
+}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+
 /**
  * radius_server_init - Initialize RADIUS server
  * @conf: Configuration for the RADIUS server
@@ -2200,6 +3173,12 @@ radius_server_init(struct radius_server_conf *conf)
 	data->auth_sock = -1;
 	data->acct_sock = -1;
 	dl_list_init(&data->erp_keys);
+	dl_list_init(&data->reply_cache);
+	if (os_get_random(data->reply_hash_key,
+			  sizeof(data->reply_hash_key)) < 0) {
+		os_free(data);
+		return NULL;
+	}
 	os_get_reltime(&data->start_time);
 	data->conf_ctx = conf->conf_ctx;
 	conf->eap_cfg->backend_auth = true;
@@ -2243,6 +3222,10 @@ radius_server_init(struct radius_server_conf *conf)
 				     conf->sqlite_file);
 			goto fail;
 		}
+		sqlite3_busy_timeout(data->db, RADIUS_DB_BUSY_TIMEOUT);
+		data->db_writer = radius_db_writer_init(conf->sqlite_file);
+		if (!data->db_writer)
+			goto fail;
 	}
 #endif /* CONFIG_SQLITE */
 
@@ -2251,8 +3234,24 @@ radius_server_init(struct radius_server_conf *conf)
 		data->dump_msk_file = os_strdup(conf->dump_msk_file);
 #endif /* CONFIG_RADIUS_TEST */
 
+	data->io = os_zalloc(sizeof(*data->io));
+	if (!data->io)
+		goto fail;
+	data->io->tx_sock = -1;
+
+	if (conf->threads) {
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+		if (radius_server_conf_threads(data, conf->threads) < 0)
+			goto fail;
+#else /* CONFIG_RADIUS_SERVER_THREADS */
+		RADIUS_DEBUG("Worker threads not supported in this build - running EAP in the event loop");
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+	}
+
 	data->clients = radius_server_read_clients(conf->client_file,
-						   conf->ipv6);
+						   conf->ipv6,
+						   &data->clients4,
+						   &data->clients6);
 	if (data->clients == NULL) {
 		wpa_printf(MSG_ERROR, "No RADIUS clients configured");
 		goto fail;
@@ -2325,6 +3324,10 @@ void radius_server_erp_flush(struct radius_server_data *data)
  */
 void radius_server_deinit(struct radius_server_data *data)
 {
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	unsigned int i;
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
 	if (data == NULL)
 		return;
 
@@ -2338,7 +3341,16 @@ void radius_server_deinit(struct radius_server_data *data)
 		close(data->acct_sock);
 	}
 
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	/* Complete the pending jobs before the sessions are freed */
+	for (i = 0; i < data->num_workers; i++)
+		worker_pool_deinit(data->workers[i]);
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
 	radius_server_free_clients(data, data->clients);
+	os_free(data->io);
+	prefix_trie_free(data->clients4);
+	prefix_trie_free(data->clients6);
 
 	os_free(data->eap_req_id_text);
 #ifdef CONFIG_RADIUS_TEST
@@ -2349,12 +3361,20 @@ void radius_server_deinit(struct radius_server_data *data)
 	os_free(data->t_c_server_url);
 
 #ifdef CONFIG_SQLITE
+	/* Commit the queued writes before exiting */
+	radius_db_writer_deinit(data->db_writer);
 	if (data->db)
 		sqlite3_close(data->db);
 #endif /* CONFIG_SQLITE */
 
 	radius_server_erp_flush(data);
 
+	while (!dl_list_empty(&data->reply_cache))
+		radius_server_reply_free(
+			data, dl_list_first(&data->reply_cache,
+					    struct radius_reply_cache_entry,
+					    list));
+
 	os_free(data);
 }
 
@@ -2374,6 +3394,10 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
 	char *end, *pos;
 	struct os_reltime now;
 	struct radius_client *cli;
+	u32 rx_pps, tx_pps;
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	unsigned int pending;
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
 
 	/* RFC 2619 - RADIUS Authentication Server MIB */
 
@@ -2438,6 +3462,72 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
 	}
 	pos += ret;
 
+	/* Datagrams in the last full second */
+	if (now.sec == data->rate_sec) {
+		rx_pps = data->rx_pps;
+		tx_pps = data->tx_pps;
+	} else if (now.sec == data->rate_sec + 1) {
+		rx_pps = data->rx_cur;
+		tx_pps = data->tx_cur;
+	} else {
+		rx_pps = tx_pps = 0;
+	}
+	ret = os_snprintf(pos, end - pos,
+			  "radiusServRxPackets=%u\n"
+			  "radiusServTxPackets=%u\n"
+			  "radiusServRxCalls=%u\n"
+			  "radiusServRxPacketsPerSec=%u\n"
+			  "radiusServTxPacketsPerSec=%u\n",
+			  data->rx_packets, data->tx_packets, data->rx_calls,
+			  rx_pps, tx_pps);
+	if (os_snprintf_error(end - pos, ret)) {
+		*pos = '\0';
+		return pos - buf;
+	}
+	pos += ret;
+
+#ifdef CONFIG_SQLITE
+	if (data->db_writer) {
+		struct radius_db_writer *writer = data->db_writer;
+
+		ret = os_snprintf(pos, end - pos,
+				  "radiusServDbWritesQueued=%u\n"
+				  "radiusServDbWritesCommitted=%u\n"
+				  "radiusServDbWritesFailed=%u\n"
+				  "radiusServDbTransactions=%u\n"
+				  "radiusServDbQueueLen=%u\n"
+				  "radiusServDbQueueMax=%u\n"
+				  "radiusServDbQueueStalls=%u\n",
+				  writer->queued, writer->written,
+				  writer->failed, writer->commits,
+				  writer->queue_len, writer->queue_max,
+				  writer->stalls);
+		if (os_snprintf_error(end - pos, ret)) {
+			*pos = '\0';
+			return pos - buf;
+		}
+		pos += ret;
+	}
+#endif /* CONFIG_SQLITE */
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	pending = 0;
+	for (idx = 0; idx < data->num_workers; idx++)
+		pending += worker_pool_pending(data->workers[idx]);
+	ret = os_snprintf(pos, end - pos,
+			  "radiusServWorkerThreads=%u\n"
+			  "radiusServWorkerJobs=%u\n"
+			  "radiusServWorkerJobsPending=%u\n"
+			  "radiusServWorkerCalls=%u\n",
+			  data->num_workers, data->worker_jobs, pending,
+			  data->worker_calls);
+	if (os_snprintf_error(end - pos, ret)) {
+		*pos = '\0';
+		return pos - buf;
+	}
+	pos += ret;
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
 	for (cli = data->clients, idx = 0; cli; cli = cli->next, idx++) {
 		char abuf[50], mbuf[50];
 #ifdef CONFIG_IPV6
@@ -2501,11 +3591,10 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
 }
 
 
-static int radius_server_get_eap_user(void *ctx, const u8 *identity,
-				      size_t identity_len, int phase2,
-				      struct eap_user *user)
+static int radius_server_eap_user(struct radius_session *sess,
+				  const u8 *identity, size_t identity_len,
+				  int phase2, struct eap_user *user)
 {
-	struct radius_session *sess = ctx;
 	struct radius_server_data *data = sess->server;
 	int ret;
 
@@ -2527,6 +3616,84 @@ static int radius_server_get_eap_user(void *ctx, const u8 *identity,
 }
 
 
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+
+/*
+ * The user database and the log are owned by the eloop thread, so EAP
+ * callbacks from a worker thread are run in the eloop thread while the worker
+ * waits for them.
+ */
+struct radius_server_call {
+	struct radius_session *sess;
+	const u8 *identity;
+	size_t identity_len;
+	int phase2;
+	struct eap_user *user;
+	const char *msg;
+	int ret;
+};
+
+
+static void radius_server_call_get_eap_user(void *ctx)
+{
+	struct radius_server_call *call = ctx;
+
+	call->sess->server->worker_calls++;
+	call->ret = radius_server_eap_user(call->sess, call->identity,
+					   call->identity_len, call->phase2,
+					   call->user);
+}
+
+
+static void radius_server_call_log_msg(void *ctx)
+{
+	struct radius_server_call *call = ctx;
+
+	call->sess->server->worker_calls++;
+	srv_log(call->sess, "EAP: %s", call->msg);
+}
+
+
+static void radius_server_call(struct radius_session *sess,
+			       void (*func)(void *ctx),
+			       struct radius_server_call *call)
+{
+	call->sess = sess;
+	if (worker_pool_call(sess->worker, func, call) < 0)
+		RADIUS_DEBUG("Worker stopped before callback for session 0x%x",
+			     sess->sess_id);
+}
+
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+
+static int radius_server_get_eap_user(void *ctx, const u8 *identity,
+				      size_t identity_len, int phase2,
+				      struct eap_user *user)
+{
+	struct radius_session *sess = ctx;
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	if (sess->job_pending) {
+		struct radius_server_call call;
+
+		os_memset(&call, 0, sizeof(call));
+		call.identity = identity;
+		call.identity_len = identity_len;
+		call.phase2 = phase2;
+		call.user = user;
+		call.ret = -1;
+		radius_server_call(sess, radius_server_call_get_eap_user,
+				   &call);
+		return call.ret;
+	}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
+	return radius_server_eap_user(sess, identity, identity_len, phase2,
+				      user);
+}
+
+
 static const char * radius_server_get_eap_req_id_text(void *ctx, size_t *len)
 {
 	struct radius_session *sess = ctx;
@@ -2539,6 +3706,18 @@ static const char * radius_server_get_eap_req_id_text(void *ctx, size_t *len)
 static void radius_server_log_msg(void *ctx, const char *msg)
 {
 	struct radius_session *sess = ctx;
+
+#ifdef CONFIG_RADIUS_SERVER_THREADS
+	if (sess->job_pending) {
+		struct radius_server_call call;
+
+		os_memset(&call, 0, sizeof(call));
+		call.msg = msg;
+		radius_server_call(sess, radius_server_call_log_msg, &call);
+		return;
+	}
+#endif /* CONFIG_RADIUS_SERVER_THREADS */
+
 	srv_log(sess, "EAP: %s", msg);
 }
 
@@ -2608,7 +3787,8 @@ void radius_server_eap_pending_cb(struct radius_server_data *data, void *ctx)
 		return;
 
 	for (cli = data->clients; cli; cli = cli->next) {
-		for (s = cli->sessions; s; s = s->next) {
+		dl_list_for_each(s, &cli->sessions, struct radius_session,
+				 list) {
 			if (s->eap == ctx && s->last_msg) {
 				sess = s;
 				break;
@@ -2740,6 +3920,9 @@ int radius_server_dac_request(struct radius_server_data *data, const char *req)
 		return -1;
 	}
 
+	/* The session may have been added by a write that is still queued */
+	radius_db_flush(data->db_writer);
+
 	os_snprintf(addrtxt, sizeof(addrtxt), MACSTR, MAC2STR(addr));
 
 	sql = sqlite3_mprintf("SELECT * FROM current_sessions WHERE mac_addr=%Q",
@@ -58,6 +58,15 @@ struct radius_server_conf {
 	 */
 	int ipv6;
 
+	/**
+	 * threads - Number of worker threads for EAP processing
+	 *
+	 * 0 = run EAP in the event loop thread, -1 = one thread per online
+	 * CPU. This requires CONFIG_RADIUS_SERVER_THREADS=y and cannot be
+	 * used with EAP-SIM/AKA database, WPS, or ERP.
+	 */
+	int threads;
+
 	/**
 	 * get_eap_user - Callback for fetching EAP user information
 	 * @ctx: Context data from conf_ctx
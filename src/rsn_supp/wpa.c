@@ -10,6 +10,7 @@
 #include "includes.h"
 
 #include "common.h"
+#include "utils/flight_recorder.h"
 #include "crypto/aes.h"
 #include "crypto/aes_wrap.h"
 #include "crypto/crypto.h"
@@ -1119,6 +1120,8 @@ static int wpa_supplicant_install_ptk(struct wpa_sm *sm,
 	sm->ptk.tk_len = 0;
 	sm->ptk.installed = 1;
 	sm->tk_set = true;
+	flight_recorder_record(FR_EV_SUPP_PTK_INSTALLED, sm->ifname, sm->bssid,
+			       sm->pairwise_cipher, sm->keyidx_active);
 
 	if (sm->wpa_ptk_rekey) {
 		eloop_cancel_timeout(wpa_sm_rekey_ptk, sm, NULL);
@@ -1237,6 +1240,8 @@ static int wpa_supplicant_install_gtk(struct wpa_sm *sm,
 		return -1;
 	}
 	forced_memzero(gtk_buf, sizeof(gtk_buf));
+	flight_recorder_record(FR_EV_SUPP_GTK_INSTALLED, sm->ifname, NULL,
+			       sm->group_cipher, gd->keyidx);
 
 	if (wnm_sleep) {
 		sm->gtk_wnm_sleep.gtk_len = gd->gtk_len;
@@ -3349,6 +3354,8 @@ int wpa_sm_rx_eapol(struct wpa_sm *sm, const u8 *src_addr,
 
 	eapol_sm_notify_lower_layer_success(sm->eapol, 0);
 	key_info = WPA_GET_BE16(key->key_info);
+	flight_recorder_record(FR_EV_SUPP_EAPOL_KEY_RX, sm->ifname, src_addr,
+			       key_info, key_data_len);
 	ver = key_info & WPA_KEY_INFO_TYPE_MASK;
 	if (ver != WPA_KEY_INFO_TYPE_HMAC_MD5_RC4 &&
 	    ver != WPA_KEY_INFO_TYPE_AES_128_CMAC &&
@@ -3444,8 +3451,11 @@ int wpa_sm_rx_eapol(struct wpa_sm *sm, const u8 *src_addr,
 	}
 
 	if ((key_info & WPA_KEY_INFO_MIC) &&
-	    wpa_supplicant_verify_eapol_key_mic(sm, key, ver, tmp, data_len))
+	    wpa_supplicant_verify_eapol_key_mic(sm, key, ver, tmp, data_len)) {
+		flight_recorder_record(FR_EV_SUPP_KEY_MIC_FAILURE, sm->ifname,
+				       src_addr, key_info, 0);
 		goto out;
+	}
 
 #ifdef CONFIG_FILS
 	if (!mic_len && (key_info & WPA_KEY_INFO_ENCR_KEY_DATA)) {
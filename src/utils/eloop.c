@@ -39,11 +39,23 @@
 #include <sys/event.h>
 #endif /* CONFIG_ELOOP_KQUEUE */
 
+#ifndef ELOOP_TIMEOUT_POOL_MAX
+/*
+ * Default maximum number of released timeout entries to keep for reuse. This
+ * can be changed at runtime with eloop_set_timeout_pool_max().
+ */
+#define ELOOP_TIMEOUT_POOL_MAX 256
+#endif /* ELOOP_TIMEOUT_POOL_MAX */
+
+#define ELOOP_HANDLER_STATS_SIZE 128
+#define ELOOP_HANDLER_HIST_BUCKETS 6
+
 struct eloop_sock {
 	int sock;
 	void *eloop_data;
 	void *user_data;
 	eloop_sock_handler handler;
+	const char *name; /* name of handler for statistics */
 	WPA_TRACE_REF(eloop);
 	WPA_TRACE_REF(user);
 	WPA_TRACE_INFO
@@ -55,6 +67,11 @@ struct eloop_timeout {
 	void *eloop_data;
 	void *user_data;
 	eloop_timeout_handler handler;
+	const char *name; /* name of handler for statistics */
+#ifdef CONFIG_ELOOP_TIMER_HEAP
+	size_t heap_idx;
+	u64 seq;
+#endif /* CONFIG_ELOOP_TIMER_HEAP */
 	WPA_TRACE_REF(eloop);
 	WPA_TRACE_REF(user);
 	WPA_TRACE_INFO
@@ -67,8 +84,25 @@ struct eloop_signal {
 	int signaled;
 };
 
+enum eloop_handler_type {
+	ELOOP_HANDLER_SOCK,
+	ELOOP_HANDLER_TIMEOUT,
+};
+
+struct eloop_handler_stats {
+	const void *handler;
+	const char *name;
+	enum eloop_handler_type type;
+	unsigned long count;
+	unsigned long long total_usec;
+	unsigned int max_usec;
+	/* <100 us, <1 ms, <10 ms, <100 ms, <1 s, >=1 s */
+	unsigned long hist[ELOOP_HANDLER_HIST_BUCKETS];
+};
+
 struct eloop_sock_table {
 	size_t count;
+	size_t size; /* number of allocated entries in table */
 	struct eloop_sock *table;
 	eloop_event_type type;
 	int changed;
@@ -102,7 +136,44 @@ struct eloop_data {
 	struct eloop_sock_table writers;
 	struct eloop_sock_table exceptions;
 
+#ifdef CONFIG_ELOOP_TIMER_HEAP
+	/*
+	 * Pending timeouts are kept in a binary min-heap ordered by expiration
+	 * time (ties broken by registration order) and in a hash table keyed
+	 * by (handler, eloop_data, user_data) for cancel/lookup operations.
+	 * The list member of struct eloop_timeout is used for the hash bucket.
+	 */
+	struct eloop_timeout **timeout_heap;
+	size_t timeout_count;
+	size_t timeout_heap_size;
+	struct dl_list *timeout_hash;
+	size_t timeout_hash_size; /* power of two */
+	u64 timeout_seq;
+#else /* CONFIG_ELOOP_TIMER_HEAP */
 	struct dl_list timeout;
+#endif /* CONFIG_ELOOP_TIMER_HEAP */
+
+	/*
+	 * Released timeout entries are kept in a free list (up to
+	 * timeout_pool_max entries) to avoid heap allocations for timeouts that
+	 * are continuously re-registered.
+	 */
+	struct dl_list timeout_pool;
+	size_t timeout_pool_count;
+	size_t timeout_pool_max;
+	unsigned long timeout_alloc;
+	unsigned long timeout_reuse;
+	unsigned long timeout_free;
+	unsigned long sock_table_alloc;
+
+	/*
+	 * Optional per-handler execution time statistics (open addressing hash
+	 * table keyed by the handler function address). Allocated only when
+	 * enabled with eloop_set_handler_stats().
+	 */
+	struct eloop_handler_stats *handler_stats;
+	unsigned int handler_stats_dropped;
+	unsigned int slow_handler_ms;
 
 	size_t signal_count;
 	struct eloop_signal *signals;
@@ -163,7 +234,11 @@ static void eloop_trace_sock_remove_ref(struct eloop_sock_table *table)
 int eloop_init(void)
 {
 	os_memset(&eloop, 0, sizeof(eloop));
+#ifndef CONFIG_ELOOP_TIMER_HEAP
 	dl_list_init(&eloop.timeout);
+#endif /* CONFIG_ELOOP_TIMER_HEAP */
+	dl_list_init(&eloop.timeout_pool);
+	eloop.timeout_pool_max = ELOOP_TIMEOUT_POOL_MAX;
 #ifdef CONFIG_ELOOP_EPOLL
 	eloop.epollfd = epoll_create1(0);
 	if (eloop.epollfd < 0) {
@@ -258,6 +333,7 @@ static int eloop_sock_queue(int sock, eloop_event_type type)
 
 static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
                                      int sock, eloop_sock_handler handler,
+                                     const char *name,
                                      void *eloop_data, void *user_data)
 {
 #ifdef CONFIG_ELOOP_EPOLL
@@ -268,9 +344,9 @@ static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
 #endif /* CONFIG_ELOOP_EPOLL */
 #if defined(CONFIG_ELOOP_EPOLL) || defined(CONFIG_ELOOP_KQUEUE)
 	struct eloop_sock *temp_table;
-	size_t next;
 #endif /* CONFIG_ELOOP_EPOLL || CONFIG_ELOOP_KQUEUE */
 	struct eloop_sock *tmp;
+	size_t next;
 	int new_max_sock;
 
 	if (sock > eloop.max_sock)
@@ -353,20 +429,28 @@ static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
 #endif /* CONFIG_ELOOP_KQUEUE */
 
 	eloop_trace_sock_remove_ref(table);
-	tmp = os_realloc_array(table->table, table->count + 1,
-			       sizeof(struct eloop_sock));
-	if (tmp == NULL) {
-		eloop_trace_sock_add_ref(table);
-		return -1;
+	if (table->count == table->size) {
+		next = table->size ? table->size * 2 : 4;
+		tmp = os_realloc_array(table->table, next,
+				       sizeof(struct eloop_sock));
+		if (tmp == NULL) {
+			eloop_trace_sock_add_ref(table);
+			return -1;
+		}
+		table->table = tmp;
+		table->size = next;
+		eloop.sock_table_alloc++;
+	} else {
+		tmp = table->table;
 	}
 
 	tmp[table->count].sock = sock;
 	tmp[table->count].eloop_data = eloop_data;
 	tmp[table->count].user_data = user_data;
 	tmp[table->count].handler = handler;
+	tmp[table->count].name = name;
 	wpa_trace_record(&tmp[table->count]);
 	table->count++;
-	table->table = tmp;
 	eloop.max_sock = new_max_sock;
 	eloop.count++;
 	table->changed = 1;
@@ -430,6 +514,190 @@ static void eloop_sock_table_remove_sock(struct eloop_sock_table *table,
 }
 
 
+static struct eloop_handler_stats *
+eloop_handler_stats_get(const void *handler, const char *name,
+			enum eloop_handler_type type)
+{
+	size_t i, idx;
+
+	idx = ((uintptr_t) handler >> 2) % ELOOP_HANDLER_STATS_SIZE;
+	for (i = 0; i < ELOOP_HANDLER_STATS_SIZE; i++) {
+		struct eloop_handler_stats *st = &eloop.handler_stats[idx];
+
+		if (st->handler == handler)
+			return st;
+		if (!st->handler) {
+			st->handler = handler;
+			st->name = name;
+			st->type = type;
+			return st;
+		}
+		idx = (idx + 1) % ELOOP_HANDLER_STATS_SIZE;
+	}
+
+	return NULL;
+}
+
+
+static void eloop_handler_done(const void *handler, const char *name,
+			       enum eloop_handler_type type,
+			       struct os_reltime *start)
+{
+	struct os_reltime now, diff;
+	struct eloop_handler_stats *st;
+	unsigned int usec, limit;
+	int bucket;
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, start, &diff);
+	if (diff.sec >= 4000)
+		usec = 4000000000U;
+	else
+		usec = diff.sec * 1000000 + diff.usec;
+
+	if (eloop.slow_handler_ms && usec / 1000 >= eloop.slow_handler_ms) {
+		wpa_printf(MSG_INFO,
+			   "ELOOP: Slow %s handler %s (%p) took %u.%06u seconds",
+			   type == ELOOP_HANDLER_SOCK ? "socket" : "timeout",
+			   name ? name : "?", handler,
+			   usec / 1000000, usec % 1000000);
+		wpa_trace_dump_funcname("eloop slow handler", (void *) handler);
+	}
+
+	if (!eloop.handler_stats)
+		return;
+	st = eloop_handler_stats_get(handler, name, type);
+	if (!st) {
+		eloop.handler_stats_dropped++;
+		return;
+	}
+	st->count++;
+	st->total_usec += usec;
+	if (usec > st->max_usec)
+		st->max_usec = usec;
+	for (bucket = 0, limit = 100;
+	     bucket < ELOOP_HANDLER_HIST_BUCKETS - 1 && usec >= limit;
+	     bucket++, limit *= 10)
+		;
+	st->hist[bucket]++;
+}
+
+
+static void eloop_call_sock_handler(eloop_sock_handler handler,
+				    const char *name, int sock,
+				    void *eloop_data, void *user_data)
+{
+	struct os_reltime start;
+
+	if (!eloop.handler_stats && !eloop.slow_handler_ms) {
+		handler(sock, eloop_data, user_data);
+		return;
+	}
+
+	os_get_reltime(&start);
+	handler(sock, eloop_data, user_data);
+	eloop_handler_done(handler, name, ELOOP_HANDLER_SOCK, &start);
+}
+
+
+static void eloop_call_timeout_handler(eloop_timeout_handler handler,
+				       const char *name,
+				       void *eloop_data, void *user_data)
+{
+	struct os_reltime start;
+
+	if (!eloop.handler_stats && !eloop.slow_handler_ms) {
+		handler(eloop_data, user_data);
+		return;
+	}
+
+	os_get_reltime(&start);
+	handler(eloop_data, user_data);
+	eloop_handler_done(handler, name, ELOOP_HANDLER_TIMEOUT, &start);
+}
+
+
+int eloop_set_handler_stats(int enabled)
+{
+	os_free(eloop.handler_stats);
+	eloop.handler_stats = NULL;
+	eloop.handler_stats_dropped = 0;
+	if (!enabled)
+		return 0;
+
+	eloop.handler_stats = os_calloc(ELOOP_HANDLER_STATS_SIZE,
+					sizeof(struct eloop_handler_stats));
+	return eloop.handler_stats ? 0 : -1;
+}
+
+
+void eloop_set_slow_handler_threshold(unsigned int msec)
+{
+	eloop.slow_handler_ms = msec;
+}
+
+
+static int eloop_handler_stats_cmp(const void *a, const void *b)
+{
+	const struct eloop_handler_stats *sa = a, *sb = b;
+
+	if (sa->max_usec > sb->max_usec)
+		return -1;
+	if (sa->max_usec < sb->max_usec)
+		return 1;
+	return 0;
+}
+
+
+static int eloop_handler_stats_text(char *buf, size_t buflen)
+{
+	struct eloop_handler_stats *sorted;
+	char *pos = buf, *end = buf + buflen;
+	size_t i, num = 0;
+	int ret;
+
+	if (!eloop.handler_stats)
+		return 0;
+
+	sorted = os_calloc(ELOOP_HANDLER_STATS_SIZE,
+			   sizeof(struct eloop_handler_stats));
+	if (!sorted)
+		return 0;
+	for (i = 0; i < ELOOP_HANDLER_STATS_SIZE; i++) {
+		if (eloop.handler_stats[i].handler)
+			sorted[num++] = eloop.handler_stats[i];
+	}
+	qsort(sorted, num, sizeof(struct eloop_handler_stats),
+	      eloop_handler_stats_cmp);
+
+	ret = os_snprintf(pos, end - pos, "handler_stats_dropped=%u\n",
+			  eloop.handler_stats_dropped);
+	if (os_snprintf_error(end - pos, ret))
+		goto out;
+	pos += ret;
+
+	for (i = 0; i < num; i++) {
+		struct eloop_handler_stats *st = &sorted[i];
+
+		ret = os_snprintf(pos, end - pos,
+				  "handler=%p name=%s type=%s count=%lu total_usec=%llu max_usec=%u hist=%lu,%lu,%lu,%lu,%lu,%lu\n",
+				  st->handler, st->name ? st->name : "?",
+				  st->type == ELOOP_HANDLER_SOCK ?
+				  "socket" : "timeout",
+				  st->count, st->total_usec, st->max_usec,
+				  st->hist[0], st->hist[1], st->hist[2],
+				  st->hist[3], st->hist[4], st->hist[5]);
+		if (os_snprintf_error(end - pos, ret))
+			break;
+		pos += ret;
+	}
+
+out:
+	os_free(sorted);
+	return pos - buf;
+}
+
+
 #ifdef CONFIG_ELOOP_POLL
 
 static struct pollfd * find_pollfd(struct pollfd **pollfds_map, int fd, int mx)
@@ -538,7 +806,9 @@ static int eloop_sock_table_dispatch_table(struct eloop_sock_table *table,
 		if (!(pfd->revents & revents))
 			continue;
 
-		table->table[i].handler(table->table[i].sock,
+		eloop_call_sock_handler(table->table[i].handler,
+					table->table[i].name,
+					table->table[i].sock,
 					table->table[i].eloop_data,
 					table->table[i].user_data);
 		if (table->changed)
@@ -600,7 +870,9 @@ static void eloop_sock_table_dispatch(struct eloop_sock_table *table,
 	table->changed = 0;
 	for (i = 0; i < table->count; i++) {
 		if (FD_ISSET(table->table[i].sock, fds)) {
-			table->table[i].handler(table->table[i].sock,
+			eloop_call_sock_handler(table->table[i].handler,
+						table->table[i].name,
+						table->table[i].sock,
 						table->table[i].eloop_data,
 						table->table[i].user_data);
 			if (table->changed)
@@ -622,8 +894,9 @@ static void eloop_sock_table_dispatch(struct epoll_event *events, int nfds)
 		table = &eloop.fd_table[events[i].data.fd];
 		if (table->handler == NULL)
 			continue;
-		table->handler(table->sock, table->eloop_data,
-			       table->user_data);
+		eloop_call_sock_handler(table->handler, table->name,
+					table->sock, table->eloop_data,
+					table->user_data);
 		if (eloop.readers.changed ||
 		    eloop.writers.changed ||
 		    eloop.exceptions.changed)
@@ -644,8 +917,9 @@ static void eloop_sock_table_dispatch(struct kevent *events, int nfds)
 		table = &eloop.fd_table[events[i].ident];
 		if (table->handler == NULL)
 			continue;
-		table->handler(table->sock, table->eloop_data,
-			       table->user_data);
+		eloop_call_sock_handler(table->handler, table->name,
+					table->sock, table->eloop_data,
+					table->user_data);
 		if (eloop.readers.changed ||
 		    eloop.writers.changed ||
 		    eloop.exceptions.changed)
@@ -718,11 +992,12 @@ static void eloop_sock_table_destroy(struct eloop_sock_table *table)
 }
 
 
-int eloop_register_read_sock(int sock, eloop_sock_handler handler,
-			     void *eloop_data, void *user_data)
+int eloop_register_read_sock_name(int sock, eloop_sock_handler handler,
+				  const char *name,
+				  void *eloop_data, void *user_data)
 {
-	return eloop_register_sock(sock, EVENT_TYPE_READ, handler,
-				   eloop_data, user_data);
+	return eloop_register_sock_name(sock, EVENT_TYPE_READ, handler, name,
+					eloop_data, user_data);
 }
 
 
@@ -747,15 +1022,15 @@ static struct eloop_sock_table *eloop_get_sock_table(eloop_event_type type)
 }
 
 
-int eloop_register_sock(int sock, eloop_event_type type,
-			eloop_sock_handler handler,
-			void *eloop_data, void *user_data)
+int eloop_register_sock_name(int sock, eloop_event_type type,
+			     eloop_sock_handler handler, const char *name,
+			     void *eloop_data, void *user_data)
 {
 	struct eloop_sock_table *table;
 
 	assert(sock >= 0);
 	table = eloop_get_sock_table(type);
-	return eloop_sock_table_add_sock(table, sock, handler,
+	return eloop_sock_table_add_sock(table, sock, handler, name,
 					 eloop_data, user_data);
 }
 
@@ -769,18 +1044,343 @@ void eloop_unregister_sock(int sock, eloop_event_type type)
 }
 
 
-int eloop_register_timeout(unsigned int secs, unsigned int usecs,
-			   eloop_timeout_handler handler,
-			   void *eloop_data, void *user_data)
+static int eloop_timeout_match(struct eloop_timeout *timeout,
+			       eloop_timeout_handler handler,
+			       void *eloop_data, void *user_data)
 {
-	struct eloop_timeout *timeout, *tmp;
-	os_time_t now_sec;
+	return timeout->handler == handler &&
+		timeout->eloop_data == eloop_data &&
+		timeout->user_data == user_data;
+}
+
+
+#ifdef CONFIG_ELOOP_TIMER_HEAP
+
+static int eloop_timeout_before(struct eloop_timeout *a,
+				struct eloop_timeout *b)
+{
+	if (os_reltime_before(&a->time, &b->time))
+		return 1;
+	if (os_reltime_before(&b->time, &a->time))
+		return 0;
+	return a->seq < b->seq;
+}
+
+
+static void eloop_timeout_heap_set(size_t idx, struct eloop_timeout *timeout)
+{
+	eloop.timeout_heap[idx] = timeout;
+	timeout->heap_idx = idx;
+}
+
+
+static void eloop_timeout_heap_up(size_t idx)
+{
+	struct eloop_timeout *timeout = eloop.timeout_heap[idx];
+
+	while (idx > 0) {
+		size_t parent = (idx - 1) / 2;
+
+		if (!eloop_timeout_before(timeout, eloop.timeout_heap[parent]))
+			break;
+		eloop_timeout_heap_set(idx, eloop.timeout_heap[parent]);
+		idx = parent;
+	}
+	eloop_timeout_heap_set(idx, timeout);
+}
+
+
+static void eloop_timeout_heap_down(size_t idx)
+{
+	struct eloop_timeout *timeout = eloop.timeout_heap[idx];
+
+	for (;;) {
+		size_t child = 2 * idx + 1;
+
+		if (child >= eloop.timeout_count)
+			break;
+		if (child + 1 < eloop.timeout_count &&
+		    eloop_timeout_before(eloop.timeout_heap[child + 1],
+					 eloop.timeout_heap[child]))
+			child++;
+		if (!eloop_timeout_before(eloop.timeout_heap[child], timeout))
+			break;
+		eloop_timeout_heap_set(idx, eloop.timeout_heap[child]);
+		idx = child;
+	}
+	eloop_timeout_heap_set(idx, timeout);
+}
+
+
+static size_t eloop_timeout_hash(eloop_timeout_handler handler,
+				 void *eloop_data, void *user_data)
+{
+	u64 h;
+
+	h = (u64) (uintptr_t) handler;
+	h = (h ^ (u64) (uintptr_t) eloop_data) * 0x9e3779b97f4a7c15ULL;
+	h = (h ^ (u64) (uintptr_t) user_data) * 0x9e3779b97f4a7c15ULL;
+	h ^= h >> 32;
+	return (size_t) h & (eloop.timeout_hash_size - 1);
+}
+
+
+static int eloop_timeout_hash_resize(size_t size)
+{
+	struct dl_list *hash, *old = eloop.timeout_hash;
+	size_t i, old_size = eloop.timeout_hash_size;
+	struct eloop_timeout *timeout, *prev;
+
+	hash = os_calloc(size, sizeof(struct dl_list));
+	if (!hash)
+		return -1;
+	for (i = 0; i < size; i++)
+		dl_list_init(&hash[i]);
+
+	eloop.timeout_hash = hash;
+	eloop.timeout_hash_size = size;
+	for (i = 0; i < old_size; i++) {
+		dl_list_for_each_safe(timeout, prev, &old[i],
+				      struct eloop_timeout, list) {
+			dl_list_del(&timeout->list);
+			dl_list_add_tail(&hash[eloop_timeout_hash(
+						     timeout->handler,
+						     timeout->eloop_data,
+						     timeout->user_data)],
+					 &timeout->list);
+		}
+	}
+	os_free(old);
+
+	return 0;
+}
+
+
+static int eloop_timeout_add(struct eloop_timeout *timeout)
+{
+	if (eloop.timeout_count == eloop.timeout_heap_size) {
+		struct eloop_timeout **heap;
+		size_t size;
+
+		size = eloop.timeout_heap_size ? eloop.timeout_heap_size * 2 :
+			16;
+		heap = os_realloc_array(eloop.timeout_heap, size,
+					sizeof(struct eloop_timeout *));
+		if (!heap)
+			return -1;
+		eloop.timeout_heap = heap;
+		eloop.timeout_heap_size = size;
+	}
+
+	if (eloop.timeout_count + 1 > 2 * eloop.timeout_hash_size &&
+	    eloop_timeout_hash_resize(eloop.timeout_hash_size ?
+				      eloop.timeout_hash_size * 2 : 16) < 0 &&
+	    !eloop.timeout_hash)
+		return -1;
+
+	timeout->seq = eloop.timeout_seq++;
+	dl_list_add_tail(&eloop.timeout_hash[eloop_timeout_hash(
+				     timeout->handler, timeout->eloop_data,
+				     timeout->user_data)],
+			 &timeout->list);
+	eloop_timeout_heap_set(eloop.timeout_count++, timeout);
+	eloop_timeout_heap_up(timeout->heap_idx);
+
+	return 0;
+}
+
+
+static void eloop_timeout_del(struct eloop_timeout *timeout)
+{
+	size_t idx = timeout->heap_idx;
+
+	dl_list_del(&timeout->list);
+	eloop.timeout_count--;
+	if (idx == eloop.timeout_count)
+		return;
+	eloop_timeout_heap_set(idx, eloop.timeout_heap[eloop.timeout_count]);
+	if (idx > 0 &&
+	    eloop_timeout_before(eloop.timeout_heap[idx],
+				 eloop.timeout_heap[(idx - 1) / 2]))
+		eloop_timeout_heap_up(idx);
+	else
+		eloop_timeout_heap_down(idx);
+}
+
+
+static struct eloop_timeout * eloop_timeout_first(void)
+{
+	if (eloop.timeout_count == 0)
+		return NULL;
+	return eloop.timeout_heap[0];
+}
+
+
+static struct eloop_timeout *
+eloop_timeout_find(eloop_timeout_handler handler, void *eloop_data,
+		   void *user_data)
+{
+	struct eloop_timeout *tmp, *found = NULL;
+
+	if (eloop.timeout_count == 0)
+		return NULL;
+
+	/* Return the first one to expire to match the sorted list behavior */
+	dl_list_for_each(tmp, &eloop.timeout_hash[eloop_timeout_hash(
+					  handler, eloop_data, user_data)],
+			 struct eloop_timeout, list) {
+		if (eloop_timeout_match(tmp, handler, eloop_data, user_data) &&
+		    (!found || eloop_timeout_before(tmp, found)))
+			found = tmp;
+	}
+
+	return found;
+}
+
+#else /* CONFIG_ELOOP_TIMER_HEAP */
+
+static int eloop_timeout_add(struct eloop_timeout *timeout)
+{
+	struct eloop_timeout *tmp;
+
+	/* Maintain timeouts in order of increasing time */
+	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
+		if (os_reltime_before(&timeout->time, &tmp->time)) {
+			dl_list_add(tmp->list.prev, &timeout->list);
+			return 0;
+		}
+	}
+	dl_list_add_tail(&eloop.timeout, &timeout->list);
+
+	return 0;
+}
+
+
+static void eloop_timeout_del(struct eloop_timeout *timeout)
+{
+	dl_list_del(&timeout->list);
+}
+
+
+static struct eloop_timeout * eloop_timeout_first(void)
+{
+	return dl_list_first(&eloop.timeout, struct eloop_timeout, list);
+}
+
+
+static struct eloop_timeout *
+eloop_timeout_find(eloop_timeout_handler handler, void *eloop_data,
+		   void *user_data)
+{
+	struct eloop_timeout *tmp;
+
+	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
+		if (eloop_timeout_match(tmp, handler, eloop_data, user_data))
+			return tmp;
+	}
+
+	return NULL;
+}
+
+#endif /* CONFIG_ELOOP_TIMER_HEAP */
+
+
+static struct eloop_timeout * eloop_timeout_alloc(void)
+{
+	struct eloop_timeout *timeout;
+
+	timeout = dl_list_first(&eloop.timeout_pool, struct eloop_timeout,
+				list);
+	if (timeout) {
+		dl_list_del(&timeout->list);
+		eloop.timeout_pool_count--;
+		eloop.timeout_reuse++;
+		os_memset(timeout, 0, sizeof(*timeout));
+		return timeout;
+	}
 
 	timeout = os_zalloc(sizeof(*timeout));
+	if (timeout)
+		eloop.timeout_alloc++;
+	return timeout;
+}
+
+
+static void eloop_timeout_release(struct eloop_timeout *timeout)
+{
+	if (eloop.timeout_pool_count < eloop.timeout_pool_max) {
+		dl_list_add(&eloop.timeout_pool, &timeout->list);
+		eloop.timeout_pool_count++;
+		return;
+	}
+
+	os_free(timeout);
+	eloop.timeout_free++;
+}
+
+
+static void eloop_timeout_pool_trim(size_t max)
+{
+	struct eloop_timeout *timeout;
+
+	while (eloop.timeout_pool_count > max) {
+		timeout = dl_list_first(&eloop.timeout_pool,
+					struct eloop_timeout, list);
+		dl_list_del(&timeout->list);
+		eloop.timeout_pool_count--;
+		os_free(timeout);
+		eloop.timeout_free++;
+	}
+}
+
+
+void eloop_set_timeout_pool_max(unsigned int max)
+{
+	eloop.timeout_pool_max = max;
+	eloop_timeout_pool_trim(max);
+}
+
+
+int eloop_get_stats(char *buf, size_t buflen)
+{
+	int ret, res;
+
+	ret = os_snprintf(buf, buflen,
+			  "timeout_pool_max=%u\n"
+			  "timeout_pool_free=%u\n"
+			  "timeout_alloc=%lu\n"
+			  "timeout_reuse=%lu\n"
+			  "timeout_free=%lu\n"
+			  "sock_count=%u\n"
+			  "sock_table_alloc=%lu\n",
+			  (unsigned int) eloop.timeout_pool_max,
+			  (unsigned int) eloop.timeout_pool_count,
+			  eloop.timeout_alloc,
+			  eloop.timeout_reuse,
+			  eloop.timeout_free,
+			  (unsigned int) eloop.count,
+			  eloop.sock_table_alloc);
+	if (os_snprintf_error(buflen, ret))
+		return 0;
+
+	res = eloop_handler_stats_text(buf + ret, buflen - ret);
+	return ret + res;
+}
+
+
+int eloop_register_timeout_name(unsigned int secs, unsigned int usecs,
+				eloop_timeout_handler handler,
+				const char *name,
+				void *eloop_data, void *user_data)
+{
+	struct eloop_timeout *timeout;
+	os_time_t now_sec;
+
+	timeout = eloop_timeout_alloc();
 	if (timeout == NULL)
 		return -1;
 	if (os_get_reltime(&timeout->time) < 0) {
-		os_free(timeout);
+		eloop_timeout_release(timeout);
 		return -1;
 	}
 	now_sec = timeout->time.sec;
@@ -797,19 +1397,16 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
 	timeout->eloop_data = eloop_data;
 	timeout->user_data = user_data;
 	timeout->handler = handler;
+	timeout->name = name;
+
+	if (eloop_timeout_add(timeout) < 0) {
+		eloop_timeout_release(timeout);
+		return -1;
+	}
 	wpa_trace_add_ref(timeout, eloop, eloop_data);
 	wpa_trace_add_ref(timeout, user, user_data);
 	wpa_trace_record(timeout);
 
-	/* Maintain timeouts in order of increasing time */
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (os_reltime_before(&timeout->time, &tmp->time)) {
-			dl_list_add(tmp->list.prev, &timeout->list);
-			return 0;
-		}
-	}
-	dl_list_add_tail(&eloop.timeout, &timeout->list);
-
 	return 0;
 
 overflow:
@@ -820,27 +1417,28 @@ overflow:
 	wpa_printf(MSG_DEBUG,
 		   "ELOOP: Too long timeout (secs=%u usecs=%u) to ever happen - ignore it",
 		   secs,usecs);
-	os_free(timeout);
+	eloop_timeout_release(timeout);
 	return 0;
 }
 
 
 static void eloop_remove_timeout(struct eloop_timeout *timeout)
 {
-	dl_list_del(&timeout->list);
+	eloop_timeout_del(timeout);
 	wpa_trace_remove_ref(timeout, eloop, timeout->eloop_data);
 	wpa_trace_remove_ref(timeout, user, timeout->user_data);
-	os_free(timeout);
+	eloop_timeout_release(timeout);
 }
 
 
-int eloop_cancel_timeout(eloop_timeout_handler handler,
-			 void *eloop_data, void *user_data)
+static int eloop_cancel_timeout_list(struct dl_list *list,
+				     eloop_timeout_handler handler,
+				     void *eloop_data, void *user_data)
 {
 	struct eloop_timeout *timeout, *prev;
 	int removed = 0;
 
-	dl_list_for_each_safe(timeout, prev, &eloop.timeout,
+	dl_list_for_each_safe(timeout, prev, list,
 			      struct eloop_timeout, list) {
 		if (timeout->handler == handler &&
 		    (timeout->eloop_data == eloop_data ||
@@ -856,46 +1454,59 @@ int eloop_cancel_timeout(eloop_timeout_handler handler,
 }
 
 
+int eloop_cancel_timeout(eloop_timeout_handler handler,
+			 void *eloop_data, void *user_data)
+{
+#ifdef CONFIG_ELOOP_TIMER_HEAP
+	size_t i;
+	int removed = 0;
+
+	if (eloop.timeout_count == 0)
+		return 0;
+
+	if (eloop_data != ELOOP_ALL_CTX && user_data != ELOOP_ALL_CTX)
+		return eloop_cancel_timeout_list(
+			&eloop.timeout_hash[eloop_timeout_hash(
+					handler, eloop_data, user_data)],
+			handler, eloop_data, user_data);
+
+	/* Wildcard match - need to go through all hash buckets */
+	for (i = 0; i < eloop.timeout_hash_size; i++)
+		removed += eloop_cancel_timeout_list(&eloop.timeout_hash[i],
+						     handler, eloop_data,
+						     user_data);
+	return removed;
+#else /* CONFIG_ELOOP_TIMER_HEAP */
+	return eloop_cancel_timeout_list(&eloop.timeout, handler, eloop_data,
+					 user_data);
+#endif /* CONFIG_ELOOP_TIMER_HEAP */
+}
+
+
 int eloop_cancel_timeout_one(eloop_timeout_handler handler,
 			     void *eloop_data, void *user_data,
 			     struct os_reltime *remaining)
 {
-	struct eloop_timeout *timeout, *prev;
-	int removed = 0;
+	struct eloop_timeout *timeout;
 	struct os_reltime now;
 
 	os_get_reltime(&now);
 	remaining->sec = remaining->usec = 0;
 
-	dl_list_for_each_safe(timeout, prev, &eloop.timeout,
-			      struct eloop_timeout, list) {
-		if (timeout->handler == handler &&
-		    (timeout->eloop_data == eloop_data) &&
-		    (timeout->user_data == user_data)) {
-			removed = 1;
-			if (os_reltime_before(&now, &timeout->time))
-				os_reltime_sub(&timeout->time, &now, remaining);
-			eloop_remove_timeout(timeout);
-			break;
-		}
-	}
-	return removed;
+	timeout = eloop_timeout_find(handler, eloop_data, user_data);
+	if (!timeout)
+		return 0;
+	if (os_reltime_before(&now, &timeout->time))
+		os_reltime_sub(&timeout->time, &now, remaining);
+	eloop_remove_timeout(timeout);
+	return 1;
 }
 
 
 int eloop_is_timeout_registered(eloop_timeout_handler handler,
 				void *eloop_data, void *user_data)
 {
-	struct eloop_timeout *tmp;
-
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (tmp->handler == handler &&
-		    tmp->eloop_data == eloop_data &&
-		    tmp->user_data == user_data)
-			return 1;
-	}
-
-	return 0;
+	return eloop_timeout_find(handler, eloop_data, user_data) != NULL;
 }
 
 
@@ -905,29 +1516,25 @@ int eloop_deplete_timeout(unsigned int req_secs, unsigned int req_usecs,
 {
 	struct os_reltime now, requested, remaining;
 	struct eloop_timeout *tmp;
+	const char *name;
 
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (tmp->handler == handler &&
-		    tmp->eloop_data == eloop_data &&
-		    tmp->user_data == user_data) {
-			requested.sec = req_secs;
-			requested.usec = req_usecs;
-			os_get_reltime(&now);
-			os_reltime_sub(&tmp->time, &now, &remaining);
-			if (os_reltime_before(&requested, &remaining)) {
-				eloop_cancel_timeout(handler, eloop_data,
-						     user_data);
-				eloop_register_timeout(requested.sec,
-						       requested.usec,
-						       handler, eloop_data,
-						       user_data);
-				return 1;
-			}
-			return 0;
-		}
-	}
+	tmp = eloop_timeout_find(handler, eloop_data, user_data);
+	if (!tmp)
+		return -1;
+	name = tmp->name;
 
-	return -1;
+	requested.sec = req_secs;
+	requested.usec = req_usecs;
+	os_get_reltime(&now);
+	os_reltime_sub(&tmp->time, &now, &remaining);
+	if (os_reltime_before(&requested, &remaining)) {
+		eloop_cancel_timeout(handler, eloop_data, user_data);
+		eloop_register_timeout_name(requested.sec, requested.usec,
+					    handler, name, eloop_data,
+					    user_data);
+		return 1;
+	}
+	return 0;
 }
 
 
@@ -937,30 +1544,63 @@ int eloop_replenish_timeout(unsigned int req_secs, unsigned int req_usecs,
 {
 	struct os_reltime now, requested, remaining;
 	struct eloop_timeout *tmp;
+	const char *name;
 
-	dl_list_for_each(tmp, &eloop.timeout, struct eloop_timeout, list) {
-		if (tmp->handler == handler &&
-		    tmp->eloop_data == eloop_data &&
-		    tmp->user_data == user_data) {
-			requested.sec = req_secs;
-			requested.usec = req_usecs;
-			os_get_reltime(&now);
-			os_reltime_sub(&tmp->time, &now, &remaining);
-			if (os_reltime_before(&remaining, &requested)) {
-				eloop_cancel_timeout(handler, eloop_data,
-						     user_data);
-				eloop_register_timeout(requested.sec,
-						       requested.usec,
-						       handler, eloop_data,
-						       user_data);
-				return 1;
-			}
-			return 0;
+	tmp = eloop_timeout_find(handler, eloop_data, user_data);
+	if (!tmp)
+		return -1;
+	name = tmp->name;
+
+	requested.sec = req_secs;
+	requested.usec = req_usecs;
+	os_get_reltime(&now);
+	os_reltime_sub(&tmp->time, &now, &remaining);
+	if (os_reltime_before(&remaining, &requested)) {
+		eloop_cancel_timeout(handler, eloop_data, user_data);
+		eloop_register_timeout_name(requested.sec, requested.usec,
+					    handler, name, eloop_data,
+					    user_data);
+		return 1;
+	}
+	return 0;
+}
+
+
+#ifdef CONFIG_MODULE_TESTS
+int eloop_test_timeout_order(eloop_timeout_handler handler, void **user_data,
+			     int max)
+{
+	struct eloop_timeout *timeout;
+	struct dl_list expired;
+	int num = 0;
+
+	/* Take out all timeouts in the order eloop_run() would process them
+	 * and put them back in the same order to keep FIFO order for equal
+	 * expiration times */
+	dl_list_init(&expired);
+	while ((timeout = eloop_timeout_first())) {
+		eloop_timeout_del(timeout);
+		if (timeout->handler == handler && num < max)
+			user_data[num++] = timeout->user_data;
+		dl_list_add_tail(&expired, &timeout->list);
+	}
+	while ((timeout = dl_list_first(&expired, struct eloop_timeout,
+					list))) {
+		dl_list_del(&timeout->list);
+		if (eloop_timeout_add(timeout) < 0) {
+			wpa_printf(MSG_ERROR,
+				   "ELOOP: Lost timeout while checking order");
+			wpa_trace_remove_ref(timeout, eloop,
+					     timeout->eloop_data);
+			wpa_trace_remove_ref(timeout, user,
+					     timeout->user_data);
+			eloop_timeout_release(timeout);
 		}
 	}
 
-	return -1;
+	return num;
 }
+#endif /* CONFIG_MODULE_TESTS */
 
 
 #ifndef CONFIG_NATIVE_WINDOWS
@@ -1096,7 +1736,7 @@ void eloop_run(void)
 #endif /* CONFIG_ELOOP_SELECT */
 
 	while (!eloop.terminate &&
-	       (!dl_list_empty(&eloop.timeout) || eloop.readers.count > 0 ||
+	       (eloop_timeout_first() || eloop.readers.count > 0 ||
 		eloop.writers.count > 0 || eloop.exceptions.count > 0)) {
 		struct eloop_timeout *timeout;
 
@@ -1113,8 +1753,7 @@ void eloop_run(void)
 				break;
 		}
 
-		timeout = dl_list_first(&eloop.timeout, struct eloop_timeout,
-					list);
+		timeout = eloop_timeout_first();
 		if (timeout) {
 			os_get_reltime(&now);
 			if (os_reltime_before(&now, &timeout->time))
@@ -1193,8 +1832,7 @@ void eloop_run(void)
 
 
 		/* check if some registered timeouts have occurred */
-		timeout = dl_list_first(&eloop.timeout, struct eloop_timeout,
-					list);
+		timeout = eloop_timeout_first();
 		if (timeout) {
 			os_get_reltime(&now);
 			if (!os_reltime_before(&now, &timeout->time)) {
@@ -1202,8 +1840,12 @@ void eloop_run(void)
 				void *user_data = timeout->user_data;
 				eloop_timeout_handler handler =
 					timeout->handler;
+				const char *name = timeout->name;
+
 				eloop_remove_timeout(timeout);
-				handler(eloop_data, user_data);
+				eloop_call_timeout_handler(handler, name,
+							   eloop_data,
+							   user_data);
 			}
 
 		}
@@ -1261,12 +1903,11 @@ void eloop_terminate(void)
 
 void eloop_destroy(void)
 {
-	struct eloop_timeout *timeout, *prev;
+	struct eloop_timeout *timeout;
 	struct os_reltime now;
 
 	os_get_reltime(&now);
-	dl_list_for_each_safe(timeout, prev, &eloop.timeout,
-			      struct eloop_timeout, list) {
+	while ((timeout = eloop_timeout_first())) {
 		int sec, usec;
 		sec = timeout->time.sec - now.sec;
 		usec = timeout->time.usec - now.usec;
@@ -1283,6 +1924,12 @@ void eloop_destroy(void)
 		wpa_trace_dump("eloop timeout", timeout);
 		eloop_remove_timeout(timeout);
 	}
+	eloop_timeout_pool_trim(0);
+	eloop_set_handler_stats(0);
+#ifdef CONFIG_ELOOP_TIMER_HEAP
+	os_free(eloop.timeout_heap);
+	os_free(eloop.timeout_hash);
+#endif /* CONFIG_ELOOP_TIMER_HEAP */
 	eloop_sock_table_destroy(&eloop.readers);
 	eloop_sock_table_destroy(&eloop.writers);
 	eloop_sock_table_destroy(&eloop.exceptions);
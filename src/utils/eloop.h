@@ -86,9 +86,26 @@ int eloop_init(void);
  * socket. The handler function is responsible for clearing the event after
  * having processed it in order to avoid eloop from calling the handler again
  * for the same event.
+ *
+ * This is a macro that records the name of @handler for handler statistics
+ * and slow handler reports; see eloop_register_read_sock_name().
  */
-int eloop_register_read_sock(int sock, eloop_sock_handler handler,
-			     void *eloop_data, void *user_data);
+#define eloop_register_read_sock(sock, handler, eloop_data, user_data) \
+	eloop_register_read_sock_name((sock), (handler), #handler, \
+				      (eloop_data), (user_data))
+
+/**
+ * eloop_register_read_sock_name - Register handler for read events
+ * @sock: File descriptor number for the socket
+ * @handler: Callback function to be called when data is available for reading
+ * @name: Name of @handler (a string constant) or %NULL
+ * @eloop_data: Callback context data (eloop_ctx)
+ * @user_data: Callback context data (sock_ctx)
+ * Returns: 0 on success, -1 on failure
+ */
+int eloop_register_read_sock_name(int sock, eloop_sock_handler handler,
+				  const char *name,
+				  void *eloop_data, void *user_data);
 
 /**
  * eloop_unregister_read_sock - Unregister handler for read events
@@ -113,10 +130,27 @@ void eloop_unregister_read_sock(int sock);
  * socket. The handler function is responsible for clearing the event after
  * having processed it in order to avoid eloop from calling the handler again
  * for the same event.
+ *
+ * This is a macro that records the name of @handler for handler statistics
+ * and slow handler reports; see eloop_register_sock_name().
  */
-int eloop_register_sock(int sock, eloop_event_type type,
-			eloop_sock_handler handler,
-			void *eloop_data, void *user_data);
+#define eloop_register_sock(sock, type, handler, eloop_data, user_data) \
+	eloop_register_sock_name((sock), (type), (handler), #handler, \
+				 (eloop_data), (user_data))
+
+/**
+ * eloop_register_sock_name - Register handler for socket events
+ * @sock: File descriptor number for the socket
+ * @type: Type of event to wait for
+ * @handler: Callback function to be called when the event is triggered
+ * @name: Name of @handler (a string constant) or %NULL
+ * @eloop_data: Callback context data (eloop_ctx)
+ * @user_data: Callback context data (sock_ctx)
+ * Returns: 0 on success, -1 on failure
+ */
+int eloop_register_sock_name(int sock, eloop_event_type type,
+			     eloop_sock_handler handler, const char *name,
+			     void *eloop_data, void *user_data);
 
 /**
  * eloop_unregister_sock - Unregister handler for socket events
@@ -175,10 +209,28 @@ void eloop_unregister_event(void *event, size_t event_size);
  *
  * Register a timeout that will cause the handler function to be called after
  * given time.
+ *
+ * This is a macro that records the name of @handler for handler statistics
+ * and slow handler reports; see eloop_register_timeout_name().
  */
-int eloop_register_timeout(unsigned int secs, unsigned int usecs,
-			   eloop_timeout_handler handler,
-			   void *eloop_data, void *user_data);
+#define eloop_register_timeout(secs, usecs, handler, eloop_data, user_data) \
+	eloop_register_timeout_name((secs), (usecs), (handler), #handler, \
+				    (eloop_data), (user_data))
+
+/**
+ * eloop_register_timeout_name - Register timeout
+ * @secs: Number of seconds to the timeout
+ * @usecs: Number of microseconds to the timeout
+ * @handler: Callback function to be called when timeout occurs
+ * @name: Name of @handler (a string constant) or %NULL
+ * @eloop_data: Callback context data (eloop_ctx)
+ * @user_data: Callback context data (sock_ctx)
+ * Returns: 0 on success, -1 on failure
+ */
+int eloop_register_timeout_name(unsigned int secs, unsigned int usecs,
+				eloop_timeout_handler handler,
+				const char *name,
+				void *eloop_data, void *user_data);
 
 /**
  * eloop_cancel_timeout - Cancel timeouts
@@ -364,4 +416,52 @@ int eloop_terminated(void);
  */
 void eloop_wait_for_read_sock(int sock);
 
+/**
+ * eloop_set_timeout_pool_max - Set maximum number of cached timeout entries
+ * @max: Maximum number of released timeout entries to keep for reuse
+ *
+ * Released timeout entries are kept in a free list up to this limit so that
+ * timeouts that are continuously re-registered do not require heap
+ * allocations. Setting this to 0 disables caching.
+ */
+void eloop_set_timeout_pool_max(unsigned int max);
+
+/**
+ * eloop_set_handler_stats - Enable/disable per-handler execution statistics
+ * @enabled: Whether to collect statistics
+ * Returns: 0 on success, -1 on failure
+ *
+ * When enabled, the execution time of each socket and timeout handler call is
+ * measured and accumulated per handler function (call count, total and maximum
+ * time, and a latency histogram) and reported with the handler name recorded
+ * at registration. The statistics are included in the output of
+ * eloop_get_stats(). Enabling the statistics clears any previously collected
+ * values.
+ */
+int eloop_set_handler_stats(int enabled);
+
+/**
+ * eloop_set_slow_handler_threshold - Set threshold for logging slow handlers
+ * @msec: Threshold in milliseconds or 0 to disable logging
+ *
+ * Socket and timeout handlers that take at least the specified time to
+ * complete are reported in the debug log.
+ */
+void eloop_set_slow_handler_threshold(unsigned int msec);
+
+/**
+ * eloop_get_stats - Get event loop statistics in text format
+ * @buf: Buffer for the statistics
+ * @buflen: Length of the buffer
+ * Returns: Number of bytes written into buf
+ */
+int eloop_get_stats(char *buf, size_t buflen);
+
+#ifdef CONFIG_MODULE_TESTS
+/* Report user_data of pending @handler timeouts in the order they would be
+ * run without changing the registered timeouts */
+int eloop_test_timeout_order(eloop_timeout_handler handler, void **user_data,
+			     int max);
+#endif /* CONFIG_MODULE_TESTS */
+
 #endif /* ELOOP_H */
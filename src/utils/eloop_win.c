@@ -110,8 +110,9 @@ static int eloop_prepare_handles(void)
 }
 
 
-int eloop_register_read_sock(int sock, eloop_sock_handler handler,
-			     void *eloop_data, void *user_data)
+int eloop_register_read_sock_name(int sock, eloop_sock_handler handler,
+				  const char *name,
+				  void *eloop_data, void *user_data)
 {
 	WSAEVENT event;
 	struct eloop_sock *tmp;
@@ -234,9 +235,10 @@ void eloop_unregister_event(void *event, size_t event_size)
 }
 
 
-int eloop_register_timeout(unsigned int secs, unsigned int usecs,
-			   eloop_timeout_handler handler,
-			   void *eloop_data, void *user_data)
+int eloop_register_timeout_name(unsigned int secs, unsigned int usecs,
+				eloop_timeout_handler handler,
+				const char *name,
+				void *eloop_data, void *user_data)
 {
 	struct eloop_timeout *timeout, *tmp;
 	os_time_t now_sec;
@@ -386,6 +388,23 @@ int eloop_deplete_timeout(unsigned int req_secs, unsigned int req_usecs,
 }
 
 
+#ifdef CONFIG_MODULE_TESTS
+int eloop_test_timeout_order(eloop_timeout_handler handler, void **user_data,
+			     int max)
+{
+	struct eloop_timeout *timeout;
+	int num = 0;
+
+	dl_list_for_each(timeout, &eloop.timeout, struct eloop_timeout, list) {
+		if (timeout->handler == handler && num < max)
+			user_data[num++] = timeout->user_data;
+	}
+
+	return num;
+}
+#endif /* CONFIG_MODULE_TESTS */
+
+
 int eloop_replenish_timeout(unsigned int req_secs, unsigned int req_usecs,
 			    eloop_timeout_handler handler, void *eloop_data,
 			    void *user_data)
@@ -698,3 +717,25 @@ int eloop_sock_requeue(void)
 {
 	return 0;
 }
+
+
+void eloop_set_timeout_pool_max(unsigned int max)
+{
+}
+
+
+int eloop_set_handler_stats(int enabled)
+{
+	return enabled ? -1 : 0;
+}
+
+
+void eloop_set_slow_handler_threshold(unsigned int msec)
+{
+}
+
+
+int eloop_get_stats(char *buf, size_t buflen)
+{
+	return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * In-memory binary flight recorder
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * The flight recorder keeps the most recent state machine events in a fixed
+ * size ring of small binary records so that the history leading to a failure
+ * is available even when debug logging is disabled. Recording an event only
+ * stores a timestamp and a few integers; no formatting is done until the ring
+ * is dumped into a file with flight_recorder_dump(). The dump file can be
+ * decoded with wpa_supplicant/utils/flight_recorder.py.
+ */
+
+#include "includes.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <net/if.h>
+
+#include "common.h"
+#include "flight_recorder.h"
+
+#ifndef FLIGHT_RECORDER_RECORDS
+#define FLIGHT_RECORDER_RECORDS 4096 /* must be a power of two */
+#endif /* FLIGHT_RECORDER_RECORDS */
+
+#define FLIGHT_RECORDER_MAGIC "WPFR"
+#define FLIGHT_RECORDER_VERSION 1
+#define FLIGHT_RECORDER_HDR_LEN 24
+#define FLIGHT_RECORDER_REC_LEN 32
+
+#ifndef FLIGHT_RECORDER_DIR
+#define FLIGHT_RECORDER_DIR "/var/run/wpa_flight_recorder"
+#endif /* FLIGHT_RECORDER_DIR */
+
+/* Number of sequence numbers to try for the default dump file name */
+#define FLIGHT_RECORDER_NAME_TRIES 100
+
+#define FLIGHT_RECORDER_IFCACHE_SIZE 8
+#define FLIGHT_RECORDER_IFNAME_LEN 17
+
+struct flight_recorder_entry {
+	u32 seq;
+	u16 event;
+	u32 sec;
+	u32 usec;
+	u32 ifindex;
+	u8 addr[ETH_ALEN];
+	u32 arg0;
+	u32 arg1;
+};
+
+struct flight_recorder_ifcache {
+	const char *ifname;
+	char name[FLIGHT_RECORDER_IFNAME_LEN];
+	u32 ifindex;
+};
+
+static struct flight_recorder_entry fr_ring[FLIGHT_RECORDER_RECORDS];
+static u32 fr_seq;
+static struct flight_recorder_ifcache fr_ifcache[FLIGHT_RECORDER_IFCACHE_SIZE];
+static char *fr_dir;
+static unsigned int fr_dump_count;
+
+
+static u32 flight_recorder_ifindex(const char *ifname)
+{
+	struct flight_recorder_ifcache *c;
+
+	if (!ifname)
+		return 0;
+
+	/* Interface names are stored in long-lived per-interface data, so the
+	 * pointer is a cheap key; the name comparison catches reuse. */
+	c = &fr_ifcache[((uintptr_t) ifname >> 4) &
+			(FLIGHT_RECORDER_IFCACHE_SIZE - 1)];
+	if (c->ifname == ifname &&
+	    os_strncmp(c->name, ifname, sizeof(c->name)) == 0)
+		return c->ifindex;
+
+	c->ifname = ifname;
+	os_strlcpy(c->name, ifname, sizeof(c->name));
+	c->ifindex = if_nametoindex(ifname);
+	return c->ifindex;
+}
+
+
+/**
+ * flight_recorder_record - Record an event into the flight recorder
+ * @event: Event identifier (FR_EV_*)
+ * @ifname: Network interface name or %NULL
+ * @addr: Peer MAC address or %NULL
+ * @arg0: Event specific value
+ * @arg1: Event specific value
+ *
+ * The oldest record is overwritten once the ring is full.
+ */
+void flight_recorder_record(enum flight_recorder_event event,
+			    const char *ifname, const u8 *addr,
+			    u32 arg0, u32 arg1)
+{
+	struct flight_recorder_entry *e;
+	struct os_time now;
+
+	os_get_time(&now);
+	e = &fr_ring[fr_seq & (FLIGHT_RECORDER_RECORDS - 1)];
+	e->seq = fr_seq++;
+	e->event = event;
+	e->sec = now.sec;
+	e->usec = now.usec;
+	e->ifindex = flight_recorder_ifindex(ifname);
+	if (addr)
+		os_memcpy(e->addr, addr, ETH_ALEN);
+	else
+		os_memset(e->addr, 0, ETH_ALEN);
+	e->arg0 = arg0;
+	e->arg1 = arg1;
+}
+
+
+/**
+ * flight_recorder_set_dir - Set the directory for flight recorder dumps
+ * @dir: Directory name or %NULL to use the build time default
+ *	(CONFIG_FLIGHT_RECORDER_DIR)
+ * Returns: 0 on success, -1 on failure
+ */
+int flight_recorder_set_dir(const char *dir)
+{
+	char *tmp = NULL;
+
+	if (dir) {
+		tmp = os_strdup(dir);
+		if (!tmp)
+			return -1;
+	}
+	os_free(fr_dir);
+	fr_dir = tmp;
+	return 0;
+}
+
+
+/* Make sure the dump directory exists and cannot be modified by other users */
+static int flight_recorder_check_dir(const char *dir)
+{
+	struct stat st;
+
+	if (mkdir(dir, S_IRWXU) < 0 && errno != EEXIST) {
+		wpa_printf(MSG_ERROR, "flight_recorder: mkdir(%s): %s",
+			   dir, strerror(errno));
+		return -1;
+	}
+
+	if (lstat(dir, &st) < 0) {
+		wpa_printf(MSG_ERROR, "flight_recorder: lstat(%s): %s",
+			   dir, strerror(errno));
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		wpa_printf(MSG_ERROR,
+			   "flight_recorder: %s is not a private directory",
+			   dir);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/* Create a new dump file; an existing file is never opened */
+static int flight_recorder_create(const char *dir, const char *name,
+				  char *path, size_t path_len)
+{
+	unsigned int i;
+	int fd = -1, res;
+
+	for (i = 0; i < FLIGHT_RECORDER_NAME_TRIES; i++) {
+		if (name)
+			res = os_snprintf(path, path_len, "%s/%s", dir, name);
+		else
+			res = os_snprintf(path, path_len,
+					  "%s/flight-recorder-%d-%u.bin",
+					  dir, (int) getpid(), fr_dump_count++);
+		if (os_snprintf_error(path_len, res))
+			return -1;
+
+		fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW |
+			  O_CLOEXEC, S_IRUSR | S_IWUSR);
+		if (fd >= 0 || errno != EEXIST || name)
+			break;
+	}
+	if (fd < 0)
+		wpa_printf(MSG_ERROR, "flight_recorder: Failed to create %s: %s",
+			   path, strerror(errno));
+
+	return fd;
+}
+
+
+/**
+ * flight_recorder_dump - Write the flight recorder contents into a file
+ * @name: File name within the dump directory or %NULL to use
+ *	flight-recorder-<pid>-<count>.bin
+ * Returns: 0 on success, -1 on failure
+ *
+ * The file is created in the directory set with flight_recorder_set_dir() and
+ * the name must not contain a directory component. Existing files are not
+ * overwritten. Records are written oldest first in little endian byte order.
+ * The contents of the ring are not cleared.
+ */
+int flight_recorder_dump(const char *name)
+{
+	const char *dir = fr_dir ? fr_dir : FLIGHT_RECORDER_DIR;
+	char path[256];
+	struct os_time now;
+	u32 count, first, i;
+	u8 *buf, *pos;
+	size_t len;
+	int fd, res;
+
+	if (name && (!name[0] || name[0] == '.' || os_strchr(name, '/'))) {
+		wpa_printf(MSG_INFO, "flight_recorder: Invalid file name");
+		return -1;
+	}
+
+	if (flight_recorder_check_dir(dir) < 0)
+		return -1;
+
+	count = fr_seq < FLIGHT_RECORDER_RECORDS ?
+		fr_seq : FLIGHT_RECORDER_RECORDS;
+	first = fr_seq - count;
+	len = FLIGHT_RECORDER_HDR_LEN + count * FLIGHT_RECORDER_REC_LEN;
+	buf = os_zalloc(len);
+	if (!buf)
+		return -1;
+
+	os_get_time(&now);
+	pos = buf;
+	os_memcpy(pos, FLIGHT_RECORDER_MAGIC, 4);
+	pos += 4;
+	WPA_PUT_LE16(pos, FLIGHT_RECORDER_VERSION);
+	pos += 2;
+	WPA_PUT_LE16(pos, FLIGHT_RECORDER_REC_LEN);
+	pos += 2;
+	WPA_PUT_LE32(pos, count);
+	pos += 4;
+	WPA_PUT_LE32(pos, fr_seq);
+	pos += 4;
+	WPA_PUT_LE32(pos, now.sec);
+	pos += 4;
+	WPA_PUT_LE32(pos, now.usec);
+	pos += 4;
+
+	for (i = 0; i < count; i++) {
+		const struct flight_recorder_entry *e;
+
+		e = &fr_ring[(first + i) & (FLIGHT_RECORDER_RECORDS - 1)];
+		WPA_PUT_LE32(pos, e->seq);
+		WPA_PUT_LE16(pos + 4, e->event);
+		os_memcpy(pos + 6, e->addr, ETH_ALEN);
+		WPA_PUT_LE32(pos + 12, e->sec);
+		WPA_PUT_LE32(pos + 16, e->usec);
+		WPA_PUT_LE32(pos + 20, e->ifindex);
+		WPA_PUT_LE32(pos + 24, e->arg0);
+		WPA_PUT_LE32(pos + 28, e->arg1);
+		pos += FLIGHT_RECORDER_REC_LEN;
+	}
+
+	fd = flight_recorder_create(dir, name, path, sizeof(path));
+	if (fd < 0) {
+		os_free(buf);
+		return -1;
+	}
+	res = write(fd, buf, len);
+	close(fd);
+	os_free(buf);
+	if (res < 0 || (size_t) res != len) {
+		wpa_printf(MSG_ERROR, "flight_recorder: Failed to write %s",
+			   path);
+		unlink(path);
+		return -1;
+	}
+
+	wpa_printf(MSG_INFO, "flight_recorder: Wrote %u records to %s",
+		   count, path);
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * In-memory binary flight recorder
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+/*
+ * Event identifiers stored in the flight recorder. These values are part of
+ * the dump file format (see wpa_supplicant/utils/flight_recorder.py), so only
+ * add new values at the end and never renumber existing ones.
+ */
+enum flight_recorder_event {
+	FR_EV_NONE = 0,
+
+	/* wpa_supplicant/events.c and wpa_supplicant.c */
+	FR_EV_WPAS_DRIVER_EVENT = 1, /* arg0 = enum wpa_event_type */
+	FR_EV_WPAS_STATE = 2, /* arg0 = old wpa_states, arg1 = new */
+	FR_EV_WPAS_ASSOC = 3, /* addr = BSSID, arg0 = freq,
+			       * arg1 = FT/FILS completed */
+	FR_EV_WPAS_ASSOC_REJECT = 4, /* addr = BSSID, arg0 = status,
+				      * arg1 = timed_out */
+	FR_EV_WPAS_DISASSOC = 5, /* addr = peer, arg0 = reason,
+				  * arg1 = locally_generated */
+	FR_EV_WPAS_DEAUTH = 6, /* addr = peer, arg0 = reason,
+				* arg1 = locally_generated */
+
+	/* src/rsn_supp/wpa.c */
+	FR_EV_SUPP_EAPOL_KEY_RX = 32, /* addr = src, arg0 = key_info,
+				       * arg1 = key data length */
+	FR_EV_SUPP_KEY_MIC_FAILURE = 33, /* addr = src, arg0 = key_info */
+	FR_EV_SUPP_PTK_INSTALLED = 34, /* addr = BSSID, arg0 = cipher,
+					* arg1 = key index */
+	FR_EV_SUPP_GTK_INSTALLED = 35, /* arg0 = cipher, arg1 = key index */
+	FR_EV_SUPP_4WAY_FAILED = 36, /* addr = BSSID, arg0 = reason code */
+
+	/* src/ap/wpa_auth.c */
+	FR_EV_AUTH_SM_EVENT = 64, /* addr = STA, arg0 = enum wpa_event */
+	FR_EV_AUTH_EAPOL_KEY_RX = 65, /* addr = STA, arg0 = key_info,
+				       * arg1 = key data length */
+	FR_EV_AUTH_KEY_MIC_FAILURE = 66, /* addr = STA, arg0 = key_info */
+	FR_EV_AUTH_PTK_INSTALLED = 67, /* addr = STA, arg0 = cipher,
+					* arg1 = key index */
+	FR_EV_AUTH_4WAY_FAILED = 68, /* addr = STA, arg0 = WPA_PTK state,
+				      * arg1 = TimeoutCtr */
+};
+
+#ifdef CONFIG_FLIGHT_RECORDER
+
+void flight_recorder_record(enum flight_recorder_event event,
+			    const char *ifname, const u8 *addr,
+			    u32 arg0, u32 arg1);
+int flight_recorder_set_dir(const char *dir);
+int flight_recorder_dump(const char *name);
+
+#else /* CONFIG_FLIGHT_RECORDER */
+
+static inline void flight_recorder_record(enum flight_recorder_event event,
+					  const char *ifname, const u8 *addr,
+					  u32 arg0, u32 arg1)
+{
+}
+
+static inline int flight_recorder_set_dir(const char *dir)
+{
+	return -1;
+}
+
+static inline int flight_recorder_dump(const char *name)
+{
+	return -1;
+}
+
+#endif /* CONFIG_FLIGHT_RECORDER */
+
+#endif /* FLIGHT_RECORDER_H */
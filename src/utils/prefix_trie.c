@@ -0,0 +1,156 @@
+/*
+ * Path compressed binary trie for longest prefix match
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Each node stores its full prefix and only nodes that either have a value or
+ * two children are kept, so a lookup visits at most one node per prefix length
+ * that exists in the trie, i.e., O(key length) regardless of the number of
+ * prefixes.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "prefix_trie.h"
+
+struct prefix_trie {
+	struct prefix_trie *child[2];
+	void *value;
+	unsigned int prefix_len;
+	u8 prefix[PREFIX_TRIE_MAX_LEN];
+};
+
+
+static int prefix_trie_bit(const u8 *key, unsigned int bit)
+{
+	return (key[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+
+/* Number of leading bits that match, given that the first @from bits match */
+static unsigned int prefix_trie_common(const u8 *a, const u8 *b,
+				       unsigned int from, unsigned int max)
+{
+	unsigned int i, bits;
+	u8 diff;
+
+	for (i = from / 8; i * 8 < max; i++) {
+		diff = a[i] ^ b[i];
+		if (diff) {
+			bits = i * 8;
+			while (!(diff & 0x80)) {
+				diff <<= 1;
+				bits++;
+			}
+			return bits < max ? bits : max;
+		}
+	}
+
+	return max;
+}
+
+
+static struct prefix_trie * prefix_trie_node(const u8 *prefix,
+					     unsigned int prefix_len,
+					     void *value)
+{
+	struct prefix_trie *node;
+	unsigned int len = (prefix_len + 7) / 8;
+
+	node = os_zalloc(sizeof(*node));
+	if (!node)
+		return NULL;
+	node->value = value;
+	node->prefix_len = prefix_len;
+	os_memcpy(node->prefix, prefix, len);
+	if (prefix_len % 8)
+		node->prefix[len - 1] &= 0xff << (8 - prefix_len % 8);
+	return node;
+}
+
+
+int prefix_trie_add(struct prefix_trie **root, const u8 *prefix,
+		    unsigned int prefix_len, void *value)
+{
+	struct prefix_trie **pos = root, *node, *split, *leaf;
+	unsigned int matched = 0, common;
+
+	if (!value || prefix_len > PREFIX_TRIE_MAX_LEN * 8)
+		return -1;
+
+	while ((node = *pos)) {
+		common = prefix_trie_common(node->prefix, prefix, matched,
+					    prefix_len < node->prefix_len ?
+					    prefix_len : node->prefix_len);
+		if (common < node->prefix_len) {
+			/* The new prefix branches off within this node */
+			split = prefix_trie_node(prefix, common, NULL);
+			if (!split)
+				return -1;
+			split->child[prefix_trie_bit(node->prefix, common)] =
+				node;
+			if (common == prefix_len) {
+				split->value = value;
+			} else {
+				leaf = prefix_trie_node(prefix, prefix_len,
+							value);
+				if (!leaf) {
+					os_free(split);
+					return -1;
+				}
+				split->child[prefix_trie_bit(prefix, common)] =
+					leaf;
+			}
+			*pos = split;
+			return 0;
+		}
+
+		matched = node->prefix_len;
+		if (matched == prefix_len) {
+			if (node->value)
+				return 1;
+			node->value = value;
+			return 0;
+		}
+		pos = &node->child[prefix_trie_bit(prefix, matched)];
+	}
+
+	*pos = prefix_trie_node(prefix, prefix_len, value);
+	return *pos ? 0 : -1;
+}
+
+
+void * prefix_trie_lookup(const struct prefix_trie *root, const u8 *key,
+			  unsigned int key_len)
+{
+	const struct prefix_trie *node = root;
+	unsigned int matched = 0;
+	void *best = NULL;
+
+	while (node) {
+		if (node->prefix_len > key_len ||
+		    prefix_trie_common(node->prefix, key, matched,
+				       node->prefix_len) < node->prefix_len)
+			break;
+		matched = node->prefix_len;
+		if (node->value)
+			best = node->value;
+		if (matched == key_len)
+			break;
+		node = node->child[prefix_trie_bit(key, matched)];
+	}
+
+	return best;
+}
+
+
+void prefix_trie_free(struct prefix_trie *root)
+{
+	if (!root)
+		return;
+	prefix_trie_free(root->child[0]);
+	prefix_trie_free(root->child[1]);
+	os_free(root);
+}
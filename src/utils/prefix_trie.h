@@ -0,0 +1,47 @@
+/*
+ * Path compressed binary trie for longest prefix match
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef PREFIX_TRIE_H
+#define PREFIX_TRIE_H
+
+/* Maximum key length in octets (IPv6 address) */
+#define PREFIX_TRIE_MAX_LEN 16
+
+struct prefix_trie;
+
+/**
+ * prefix_trie_add - Add a prefix into a trie
+ * @root: Pointer to the root of the trie (%NULL for an empty trie)
+ * @prefix: Prefix; bits after @prefix_len are ignored
+ * @prefix_len: Prefix length in bits (0..PREFIX_TRIE_MAX_LEN * 8)
+ * @value: Value to return for lookups that match this prefix (not %NULL)
+ * Returns: 0 on success, 1 if the prefix was already in the trie (the
+ * existing value is kept), or -1 on failure
+ */
+int prefix_trie_add(struct prefix_trie **root, const u8 *prefix,
+		    unsigned int prefix_len, void *value);
+
+/**
+ * prefix_trie_lookup - Find the longest matching prefix
+ * @root: Root of the trie
+ * @key: Key to search for
+ * @key_len: Key length in bits
+ * Returns: Value of the longest prefix of @key in the trie or %NULL if none
+ * matches
+ */
+void * prefix_trie_lookup(const struct prefix_trie *root, const u8 *key,
+			  unsigned int key_len);
+
+/**
+ * prefix_trie_free - Free a trie
+ * @root: Root of the trie or %NULL
+ *
+ * The values are not freed.
+ */
+void prefix_trie_free(struct prefix_trie *root);
+
+#endif /* PREFIX_TRIE_H */
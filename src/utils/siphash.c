@@ -0,0 +1,95 @@
+/*
+ * SipHash-2-4 keyed hash function
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * Implementation of SipHash-2-4 as described in "SipHash: a fast short-input
+ * PRF" by Jean-Philippe Aumasson and Daniel J. Bernstein.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "siphash.h"
+
+#define ROTL64(x, b) (u64) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0, v1, v2, v3)		\
+	do {					\
+		v0 += v1;			\
+		v1 = ROTL64(v1, 13);		\
+		v1 ^= v0;			\
+		v0 = ROTL64(v0, 32);		\
+		v2 += v3;			\
+		v3 = ROTL64(v3, 16);		\
+		v3 ^= v2;			\
+		v0 += v3;			\
+		v3 = ROTL64(v3, 21);		\
+		v3 ^= v0;			\
+		v2 += v1;			\
+		v1 = ROTL64(v1, 17);		\
+		v1 ^= v2;			\
+		v2 = ROTL64(v2, 32);		\
+	} while (0)
+
+
+u64 siphash24(const u8 *key, const u8 *data, size_t len)
+{
+	u64 k0 = WPA_GET_LE64(key);
+	u64 k1 = WPA_GET_LE64(key + 8);
+	u64 v0 = k0 ^ 0x736f6d6570736575ULL;
+	u64 v1 = k1 ^ 0x646f72616e646f6dULL;
+	u64 v2 = k0 ^ 0x6c7967656e657261ULL;
+	u64 v3 = k1 ^ 0x7465646279746573ULL;
+	u64 b = ((u64) len) << 56;
+	u64 m;
+	size_t left;
+
+	for (left = len; left >= 8; left -= 8, data += 8) {
+		m = WPA_GET_LE64(data);
+		v3 ^= m;
+		SIPROUND(v0, v1, v2, v3);
+		SIPROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+
+	switch (left) {
+	case 7:
+		b |= ((u64) data[6]) << 48;
+		/* fall through */
+	case 6:
+		b |= ((u64) data[5]) << 40;
+		/* fall through */
+	case 5:
+		b |= ((u64) data[4]) << 32;
+		/* fall through */
+	case 4:
+		b |= ((u64) data[3]) << 24;
+		/* fall through */
+	case 3:
+		b |= ((u64) data[2]) << 16;
+		/* fall through */
+	case 2:
+		b |= ((u64) data[1]) << 8;
+		/* fall through */
+	case 1:
+		b |= ((u64) data[0]);
+		break;
+	case 0:
+		break;
+	}
+
+	v3 ^= b;
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	v0 ^= b;
+
+	v2 ^= 0xff;
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+
+	return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,26 @@
+/*
+ * SipHash-2-4 keyed hash function
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef SIPHASH_H
+#define SIPHASH_H
+
+#define SIPHASH_KEY_LEN 16
+
+/**
+ * siphash24 - SipHash-2-4 of a buffer
+ * @key: 128-bit secret key (SIPHASH_KEY_LEN octets)
+ * @data: Data to hash
+ * @len: Length of the data in octets
+ * Returns: 64-bit hash value
+ *
+ * This is meant for hash table indexes that use peer controlled data (e.g.,
+ * MAC addresses) as the key. With a random key, the peer cannot select values
+ * that collide in the hash table.
+ */
+u64 siphash24(const u8 *key, const u8 *data, size_t len);
+
+#endif /* SIPHASH_H */
@@ -7,6 +7,9 @@
  */
 
 #include "utils/includes.h"
+#ifdef CONFIG_FLIGHT_RECORDER
+#include <dirent.h>
+#endif /* CONFIG_FLIGHT_RECORDER */
 
 #include "utils/common.h"
 #include "utils/const_time.h"
@@ -18,6 +21,9 @@
 #include "utils/ip_addr.h"
 #include "utils/eloop.h"
 #include "utils/json.h"
+#include "utils/siphash.h"
+#include "utils/prefix_trie.h"
+#include "utils/flight_recorder.h"
 #include "utils/module_tests.h"
 
 
@@ -292,6 +298,138 @@ static int trace_tests(void)
 }
 
 
+#ifdef CONFIG_FLIGHT_RECORDER
+
+static int flight_recorder_check(const char *dir, const char *name,
+				 const u8 *addr)
+{
+	char path[256];
+	char *buf;
+	const u8 *pos;
+	size_t len;
+	u32 count, i;
+	int ret = -1;
+
+	os_snprintf(path, sizeof(path), "%s/%s", dir, name);
+	buf = os_readfile(path, &len);
+	if (!buf || len < 24 || os_memcmp(buf, "WPFR", 4) != 0)
+		goto out;
+	count = WPA_GET_LE32((u8 *) buf + 8);
+	if (count < 3 || len != 24 + count * 32 ||
+	    WPA_GET_LE32((u8 *) buf + 12) !=
+	    WPA_GET_LE32((u8 *) buf + 24 + (count - 1) * 32) + 1)
+		goto out;
+
+	/* The last three records are the ones added by the test */
+	pos = (u8 *) buf + 24 + (count - 3) * 32;
+	for (i = 0; i < 3; i++, pos += 32) {
+		if (WPA_GET_LE16(pos + 4) != FR_EV_AUTH_SM_EVENT + i ||
+		    os_memcmp(pos + 6, i == 1 ? addr : (u8 *) "\0\0\0\0\0\0",
+			      ETH_ALEN) != 0 ||
+		    WPA_GET_LE32(pos + 20) != 0 ||
+		    WPA_GET_LE32(pos + 24) != 100 + i ||
+		    WPA_GET_LE32(pos + 28) != 200 + i)
+			goto out;
+	}
+	ret = 0;
+out:
+	os_free(buf);
+	return ret;
+}
+
+
+static int flight_recorder_tests(void)
+{
+	static const char *bad_names[] = { "", ".", "..", "../x", "a/b",
+					   ".hidden" };
+	const u8 addr[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+	char dir[] = "/tmp/flight-recorder-test-XXXXXX";
+	char path[256];
+	struct dirent *ent;
+	DIR *d;
+	unsigned int i;
+	int errors = 0, res;
+
+	wpa_printf(MSG_INFO, "flight recorder tests");
+
+	if (!mkdtemp(dir))
+		return -1;
+
+	for (i = 0; i < 3; i++)
+		flight_recorder_record(FR_EV_AUTH_SM_EVENT + i, NULL,
+				       i == 1 ? addr : NULL, 100 + i, 200 + i);
+
+	if (flight_recorder_set_dir(dir) < 0 ||
+	    flight_recorder_dump("test.bin") < 0 ||
+	    flight_recorder_check(dir, "test.bin", addr) < 0) {
+		wpa_printf(MSG_ERROR, "flight recorder dump failed");
+		errors++;
+	}
+
+	/* Existing files are not overwritten */
+	if (flight_recorder_dump("test.bin") == 0) {
+		wpa_printf(MSG_ERROR, "flight recorder overwrote a file");
+		errors++;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bad_names); i++) {
+		if (flight_recorder_dump(bad_names[i]) == 0) {
+			wpa_printf(MSG_ERROR,
+				   "flight recorder accepted file name '%s'",
+				   bad_names[i]);
+			errors++;
+		}
+	}
+
+	/* Default file names are unique */
+	if (flight_recorder_dump(NULL) < 0 || flight_recorder_dump(NULL) < 0) {
+		wpa_printf(MSG_ERROR, "flight recorder default dump failed");
+		errors++;
+	}
+
+	/* The dump directory must not be a symlink */
+	os_snprintf(path, sizeof(path), "%s/link", dir);
+	if (symlink(dir, path) < 0 ||
+	    flight_recorder_set_dir(path) < 0 ||
+	    flight_recorder_dump("link.bin") == 0) {
+		wpa_printf(MSG_ERROR, "flight recorder followed a symlink");
+		errors++;
+	}
+
+	flight_recorder_set_dir(NULL);
+
+	i = 0;
+	d = opendir(dir);
+	while (d && (ent = readdir(d))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		res = os_snprintf(path, sizeof(path), "%s/%s", dir,
+				  ent->d_name);
+		if (os_snprintf_error(sizeof(path), res))
+			continue;
+		unlink(path);
+		i++;
+	}
+	if (d)
+		closedir(d);
+	rmdir(dir);
+	if (i != 4) {
+		wpa_printf(MSG_ERROR, "flight recorder created %u files", i);
+		errors++;
+	}
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d flight recorder test(s) failed",
+			   errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+#endif /* CONFIG_FLIGHT_RECORDER */
+
+
 static int base64_tests(void)
 {
 	int errors = 0;
@@ -356,6 +494,223 @@ static int base64_tests(void)
 }
 
 
+static int siphash_tests(void)
+{
+	/* Test vectors from the SipHash reference implementation: key and
+	 * message are 00 01 02 .. */
+	static const struct {
+		size_t len;
+		u64 hash;
+	} tests[] = {
+		{ 0, 0x726fdb47dd0e0e31ULL },
+		{ 1, 0x74f839c593dc67fdULL },
+		{ 7, 0xab0200f58b01d137ULL },
+		{ 8, 0x93f5f5799a932462ULL },
+		{ 15, 0xa129ca6149be45e5ULL },
+		{ 63, 0x958a324ceb064572ULL },
+	};
+	u8 key[SIPHASH_KEY_LEN], data[64];
+	unsigned int i;
+	int errors = 0;
+
+	wpa_printf(MSG_INFO, "siphash tests");
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = i;
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		if (siphash24(key, data, tests[i].len) != tests[i].hash) {
+			wpa_printf(MSG_ERROR,
+				   "siphash: Mismatch for %u octet input",
+				   (unsigned int) tests[i].len);
+			errors++;
+		}
+	}
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d siphash test(s) failed", errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+struct prefix_trie_test {
+	u8 prefix[4];
+	unsigned int len;
+};
+
+
+static u32 prefix_trie_rand(u32 *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return *state >> 8;
+}
+
+
+static int prefix_trie_match(const u8 *prefix, const u8 *key,
+			     unsigned int len)
+{
+	u32 mask = len ? 0xffffffff << (32 - len) : 0;
+
+	return ((WPA_GET_BE32(prefix) ^ WPA_GET_BE32(key)) & mask) == 0;
+}
+
+
+static const struct prefix_trie_test *
+prefix_trie_linear(const struct prefix_trie_test *entries, unsigned int n,
+		   const u8 *key)
+{
+	const struct prefix_trie_test *best = NULL;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		if (prefix_trie_match(entries[i].prefix, key, entries[i].len) &&
+		    (!best || entries[i].len > best->len))
+			best = &entries[i];
+	}
+
+	return best;
+}
+
+
+static int prefix_trie_tests(void)
+{
+	static const struct prefix_trie_test fixed[] = {
+		{ { 10, 1, 2, 0 }, 24 },
+		{ { 0, 0, 0, 0 }, 0 },
+		{ { 10, 1, 2, 3 }, 32 },
+		{ { 10, 0, 0, 0 }, 8 },
+		{ { 10, 1, 255, 255 }, 16 },
+		{ { 10, 1, 2, 4 }, 30 },
+	};
+	static const struct {
+		u8 key[4];
+		int entry;
+	} lookups[] = {
+		{ { 10, 1, 2, 3 }, 2 },
+		{ { 10, 1, 2, 5 }, 5 },
+		{ { 10, 1, 2, 8 }, 0 },
+		{ { 10, 1, 3, 1 }, 4 },
+		{ { 10, 2, 0, 1 }, 3 },
+		{ { 192, 168, 1, 1 }, 1 },
+	};
+	static const unsigned int sizes[] = { 10, 1000, 10000 };
+	const struct prefix_trie_test *res[1000], *ref[1000];
+	u8 keys[1000][4];
+	const unsigned int ops = ARRAY_SIZE(keys);
+	struct prefix_trie *trie = NULL;
+	struct prefix_trie_test *entries;
+	struct os_reltime start, end, diff_trie, diff_linear;
+	unsigned int i, j, n;
+	u32 state = 1, val;
+	int errors = 0;
+
+	wpa_printf(MSG_INFO, "prefix trie tests");
+
+	for (i = 0; i < ARRAY_SIZE(fixed); i++) {
+		if (prefix_trie_add(&trie, fixed[i].prefix, fixed[i].len,
+				    (void *) &fixed[i]) != 0)
+			errors++;
+	}
+	if (prefix_trie_add(&trie, fixed[0].prefix, fixed[0].len,
+			    (void *) &fixed[1]) != 1 ||
+	    prefix_trie_add(&trie, fixed[0].prefix, 129,
+			    (void *) &fixed[1]) != -1)
+		errors++;
+	for (i = 0; i < ARRAY_SIZE(lookups); i++) {
+		if (prefix_trie_lookup(trie, lookups[i].key, 32) !=
+		    &fixed[lookups[i].entry]) {
+			wpa_printf(MSG_ERROR, "prefix trie: lookup %u failed",
+				   i);
+			errors++;
+		}
+	}
+	prefix_trie_free(trie);
+	trie = NULL;
+	if (prefix_trie_lookup(NULL, lookups[0].key, 32))
+		errors++;
+
+	entries = os_calloc(sizes[ARRAY_SIZE(sizes) - 1], sizeof(*entries));
+	if (!entries)
+		return -1;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		n = sizes[i];
+		for (j = 0; j < n; j++) {
+			/* Mostly /16../32 prefixes within 10.0.0.0/8 so that
+			 * the prefixes overlap */
+			val = 0x0a000000 | (prefix_trie_rand(&state) &
+					    0x00ffffff);
+			WPA_PUT_BE32(entries[j].prefix, val);
+			entries[j].len = 16 + prefix_trie_rand(&state) % 17;
+			if (j % 100 == 0)
+				entries[j].len = 8;
+			if (prefix_trie_add(&trie, entries[j].prefix,
+					    entries[j].len, &entries[j]) < 0)
+				errors++;
+		}
+
+		for (j = 0; j < ops; j++) {
+			/* Address within a random entry with random host bits;
+			 * some are moved outside the prefix */
+			os_memcpy(keys[j],
+				  entries[prefix_trie_rand(&state) % n].prefix, 4);
+			val = prefix_trie_rand(&state);
+			keys[j][3] ^= val & 0xff;
+			if (j % 4 == 0)
+				keys[j][2] ^= (val >> 8) & 0xff;
+			if (j % 16 == 0)
+				keys[j][0] ^= 0x80;
+		}
+
+		os_get_reltime(&start);
+		for (j = 0; j < ops; j++)
+			res[j] = prefix_trie_lookup(trie, keys[j], 32);
+		os_get_reltime(&end);
+		os_reltime_sub(&end, &start, &diff_trie);
+
+		os_get_reltime(&start);
+		for (j = 0; j < ops; j++)
+			ref[j] = prefix_trie_linear(entries, n, keys[j]);
+		os_get_reltime(&end);
+		os_reltime_sub(&end, &start, &diff_linear);
+
+		for (j = 0; j < ops; j++) {
+			if (res[j] != ref[j]) {
+				wpa_printf(MSG_ERROR,
+					   "prefix trie: mismatch with %u entries for %u.%u.%u.%u",
+					   n, keys[j][0], keys[j][1], keys[j][2],
+					   keys[j][3]);
+				errors++;
+			}
+		}
+
+		wpa_printf(MSG_INFO,
+			   "prefix trie: %u entries: lookup %u ns/op (linear scan %u ns/op)",
+			   n, (unsigned int) ((diff_trie.sec * 1000000 +
+					       diff_trie.usec) * 1000 / ops),
+			   (unsigned int) ((diff_linear.sec * 1000000 +
+					    diff_linear.usec) * 1000 / ops));
+
+		prefix_trie_free(trie);
+		trie = NULL;
+	}
+
+	os_free(entries);
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d prefix trie test(s) failed", errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
 static int common_tests(void)
 {
 	char buf[3], longbuf[100];
@@ -842,6 +1197,229 @@ static int eloop_tests(void)
 }
 
 
+static void eloop_bench_cb(void *eloop_data, void *user_ctx)
+{
+}
+
+
+static long eloop_timeout_allocs(void)
+{
+	char buf[500], *pos;
+
+	if (eloop_get_stats(buf, sizeof(buf)) <= 0)
+		return -1;
+	pos = os_strstr(buf, "timeout_alloc=");
+	if (!pos)
+		return -1;
+	return atol(pos + 14);
+}
+
+
+static void eloop_order_cb(void *eloop_data, void *user_ctx)
+{
+}
+
+
+#define ELOOP_ORDER_TEST_NUM 200
+#define ELOOP_ORDER_TEST_STEP 37 /* coprime with ELOOP_ORDER_TEST_NUM */
+
+static int eloop_order_check(const char *title, const int *expected, int num)
+{
+	void *order[ELOOP_ORDER_TEST_NUM + 1];
+	int i, res;
+
+	res = eloop_test_timeout_order(eloop_order_cb, order, ARRAY_SIZE(order));
+	if (res != num) {
+		wpa_printf(MSG_ERROR, "eloop: %s: %d timeouts (expected %d)",
+			   title, res, num);
+		return -1;
+	}
+	for (i = 0; i < num; i++) {
+		if ((int) (uintptr_t) order[i] != expected[i] + 1) {
+			wpa_printf(MSG_ERROR,
+				   "eloop: %s: timeout %d run as #%d (expected %d)",
+				   title, (int) (uintptr_t) order[i] - 1, i,
+				   expected[i]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+static int eloop_timeout_order_tests(void)
+{
+	int expected[ELOOP_ORDER_TEST_NUM];
+	struct os_reltime remaining;
+	void *first = NULL, *last, *cancelled;
+	int i, j, k, num, errors = 0;
+
+	wpa_printf(MSG_INFO, "eloop timeout order tests");
+
+	/* Register in an order that differs from the expiration order; timeout
+	 * j expires k = j * STEP % NUM steps of 10 ms after the first one */
+	for (j = 0; j < ELOOP_ORDER_TEST_NUM; j++) {
+		k = j * ELOOP_ORDER_TEST_STEP % ELOOP_ORDER_TEST_NUM;
+		expected[k] = j;
+		if (eloop_register_timeout(1000 + k / 100, (k % 100) * 10000,
+					   eloop_order_cb, NULL,
+					   (void *) (uintptr_t) (j + 1)) < 0) {
+			wpa_printf(MSG_ERROR, "eloop: Failed to register timeout");
+			errors++;
+			goto out;
+		}
+	}
+	num = ELOOP_ORDER_TEST_NUM;
+	if (eloop_order_check("register", expected, num) < 0)
+		errors++;
+
+	/* Cancel the one in the middle and report its remaining time */
+	cancelled = (void *) (uintptr_t) (expected[num / 2] + 1);
+	if (eloop_cancel_timeout_one(eloop_order_cb, NULL, cancelled,
+				     &remaining) != 1 ||
+	    remaining.sec < 1000 || remaining.sec > 1001 ||
+	    eloop_cancel_timeout_one(eloop_order_cb, NULL, cancelled,
+				     &remaining) != 0 ||
+	    eloop_is_timeout_registered(eloop_order_cb, NULL, cancelled)) {
+		wpa_printf(MSG_ERROR, "eloop: Unexpected cancel result");
+		errors++;
+	}
+	os_memmove(&expected[num / 2], &expected[num / 2 + 1],
+		   (num - num / 2 - 1) * sizeof(expected[0]));
+	num--;
+	if (eloop_order_check("cancel", expected, num) < 0)
+		errors++;
+
+	/* Deplete moves the last timeout to the front, but never later */
+	last = (void *) (uintptr_t) (expected[num - 1] + 1);
+	if (eloop_deplete_timeout(2000, 0, eloop_order_cb, NULL, last) != 0 ||
+	    eloop_deplete_timeout(10, 0, eloop_order_cb, NULL, last) != 1 ||
+	    eloop_deplete_timeout(10, 0, eloop_order_cb, NULL, cancelled) !=
+	    -1) {
+		wpa_printf(MSG_ERROR, "eloop: Unexpected deplete result");
+		errors++;
+	}
+	os_memmove(&expected[1], &expected[0],
+		   (num - 1) * sizeof(expected[0]));
+	expected[0] = (int) (uintptr_t) last - 1;
+	if (eloop_order_check("deplete", expected, num) < 0)
+		errors++;
+
+	/* Replenish moves the first timeout to the end, but never earlier */
+	first = (void *) (uintptr_t) (expected[0] + 1);
+	if (eloop_replenish_timeout(1, 0, eloop_order_cb, NULL, first) != 0 ||
+	    eloop_replenish_timeout(2000, 0, eloop_order_cb, NULL, first) !=
+	    1 ||
+	    eloop_replenish_timeout(10, 0, eloop_order_cb, NULL, cancelled) !=
+	    -1) {
+		wpa_printf(MSG_ERROR, "eloop: Unexpected replenish result");
+		errors++;
+	}
+	os_memmove(&expected[0], &expected[1],
+		   (num - 1) * sizeof(expected[0]));
+	expected[num - 1] = (int) (uintptr_t) first - 1;
+	if (eloop_order_check("replenish", expected, num) < 0)
+		errors++;
+
+out:
+	i = eloop_cancel_timeout(eloop_order_cb, NULL, ELOOP_ALL_CTX);
+	if (!errors && i != num) {
+		wpa_printf(MSG_ERROR,
+			   "eloop: unexpected number of removed timeouts %d (expected %d)",
+			   i, num);
+		errors++;
+	}
+	if (eloop_is_timeout_registered(eloop_order_cb, NULL, first)) {
+		wpa_printf(MSG_ERROR, "eloop: Timeout left after cancel");
+		errors++;
+	}
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d eloop timeout order test(s) failed",
+			   errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+static int eloop_timeout_bench_tests(void)
+{
+	static const unsigned int sizes[] = {
+		10, 100, 1000, 10000,
+#ifdef CONFIG_ELOOP_TIMER_HEAP
+		100000,
+#endif /* CONFIG_ELOOP_TIMER_HEAP */
+	};
+	const unsigned int ops = 1000;
+	unsigned int i, j, n;
+	struct os_reltime start, end, diff;
+	int removed, errors = 0;
+	long allocs;
+
+	wpa_printf(MSG_INFO, "eloop timeout benchmark");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		n = sizes[i];
+		for (j = 0; j < n; j++) {
+			if (eloop_register_timeout(1000 + j % 1000,
+						   (j * 7919) % 1000000,
+						   eloop_bench_cb, NULL,
+						   (void *) (uintptr_t) (j + 1))
+			    < 0) {
+				errors++;
+				break;
+			}
+		}
+
+		allocs = eloop_timeout_allocs();
+		os_get_reltime(&start);
+		for (j = 0; j < ops; j++) {
+			void *ctx = (void *) (uintptr_t) (n + 1 + j);
+
+			if (eloop_register_timeout(1000 + j % 1000,
+						   (j * 104729) % 1000000,
+						   eloop_bench_cb, NULL, ctx) < 0 ||
+			    !eloop_is_timeout_registered(eloop_bench_cb, NULL,
+							 ctx) ||
+			    eloop_cancel_timeout(eloop_bench_cb, NULL, ctx) != 1)
+				errors++;
+		}
+		os_get_reltime(&end);
+		os_reltime_sub(&end, &start, &diff);
+		if (eloop_timeout_allocs() > allocs + 1) {
+			wpa_printf(MSG_ERROR,
+				   "eloop: timeout entries not reused from the pool");
+			errors++;
+		}
+
+		wpa_printf(MSG_INFO,
+			   "eloop: %u pending timeouts: register+lookup+cancel %u ns/op",
+			   n, (unsigned int) ((diff.sec * 1000000 + diff.usec) *
+					      1000 / ops));
+
+		removed = eloop_cancel_timeout(eloop_bench_cb, NULL,
+					       ELOOP_ALL_CTX);
+		if (removed != (int) n) {
+			wpa_printf(MSG_ERROR,
+				   "eloop: unexpected number of removed timeouts %d (expected %u)",
+				   removed, n);
+			errors++;
+		}
+	}
+
+	if (errors) {
+		wpa_printf(MSG_ERROR, "%d eloop timeout test(s) failed",
+			   errors);
+		return -1;
+	}
+
+	return 0;
+}
+
+
 #ifdef CONFIG_JSON
 struct json_test_data {
 	const char *json;
@@ -1218,13 +1796,20 @@ int utils_module_tests(void)
 	if (printf_encode_decode_tests() < 0 ||
 	    ext_password_tests() < 0 ||
 	    trace_tests() < 0 ||
+#ifdef CONFIG_FLIGHT_RECORDER
+	    flight_recorder_tests() < 0 ||
+#endif /* CONFIG_FLIGHT_RECORDER */
 	    bitfield_tests() < 0 ||
 	    base64_tests() < 0 ||
+	    siphash_tests() < 0 ||
+	    prefix_trie_tests() < 0 ||
 	    common_tests() < 0 ||
 	    os_tests() < 0 ||
 	    wpabuf_tests() < 0 ||
 	    ip_addr_tests() < 0 ||
 	    eloop_tests() < 0 ||
+	    eloop_timeout_order_tests() < 0 ||
+	    eloop_timeout_bench_tests() < 0 ||
 	    json_tests() < 0 ||
 	    const_time_tests() < 0 ||
 	    int_array_tests() < 0)
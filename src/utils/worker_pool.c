@@ -0,0 +1,314 @@
+/*
+ * Worker thread pool with completion delivery through eloop
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ *
+ * CPU intensive operations (e.g., SAE group operations) can be run in a small
+ * pool of worker threads so that the single threaded event loop remains
+ * responsive. Completed jobs are collected on a list and the eloop thread is
+ * woken up through an eventfd to call the done callback of each job, so all
+ * state changes based on the result happen in the eloop thread.
+ *
+ * A job can also call a function in the eloop thread and wait for it to
+ * return, e.g., to access data that is owned by the eloop thread. The calls
+ * are delivered through the same eventfd.
+ */
+
+#include "includes.h"
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "common.h"
+#include "list.h"
+#include "eloop.h"
+#include "worker_pool.h"
+
+#define WORKER_POOL_MAX_THREADS 64
+
+struct worker_pool_job {
+	struct dl_list list;
+	void (*work)(void *ctx);
+	void (*done)(void *ctx, int deinit);
+	void *ctx;
+};
+
+struct worker_pool_call {
+	struct dl_list list;
+	void (*func)(void *ctx);
+	void *ctx;
+	int state; /* 0 = queued, 1 = running, 2 = done */
+};
+
+struct worker_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t cond; /* queue is not empty or stop is set */
+	pthread_cond_t idle; /* queue is empty and nothing is running */
+	pthread_cond_t call_done; /* a call has returned or stop is set */
+	struct dl_list queue; /* jobs waiting for a worker */
+	struct dl_list calls; /* calls waiting for the eloop thread */
+	struct dl_list completed; /* jobs waiting for the done callback */
+	unsigned int running;
+	unsigned int pending; /* accessed only from the eloop thread */
+	int stop;
+	int efd;
+	unsigned int num_threads;
+	pthread_t threads[WORKER_POOL_MAX_THREADS];
+};
+
+
+static void * worker_pool_thread(void *arg)
+{
+	struct worker_pool *pool = arg;
+	struct worker_pool_job *job;
+	u64 one = 1;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->stop && dl_list_empty(&pool->queue))
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		if (pool->stop)
+			break;
+
+		job = dl_list_first(&pool->queue, struct worker_pool_job, list);
+		dl_list_del(&job->list);
+		pool->running++;
+		pthread_mutex_unlock(&pool->lock);
+
+		job->work(job->ctx);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->running--;
+		dl_list_add_tail(&pool->completed, &job->list);
+		if (!pool->running && dl_list_empty(&pool->queue))
+			pthread_cond_broadcast(&pool->idle);
+		if (write(pool->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+			wpa_printf(MSG_ERROR, "worker_pool: eventfd write: %s",
+				   strerror(errno));
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+
+static void worker_pool_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct worker_pool *pool = eloop_ctx;
+	struct worker_pool_job *job;
+	struct worker_pool_call *call;
+	struct dl_list completed;
+	u64 val;
+
+	if (read(sock, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		wpa_printf(MSG_ERROR, "worker_pool: eventfd read: %s",
+			   strerror(errno));
+
+	dl_list_init(&completed);
+	pthread_mutex_lock(&pool->lock);
+	while ((call = dl_list_first(&pool->calls, struct worker_pool_call,
+				     list))) {
+		dl_list_del(&call->list);
+		call->state = 1;
+		pthread_mutex_unlock(&pool->lock);
+		call->func(call->ctx);
+		pthread_mutex_lock(&pool->lock);
+		call->state = 2;
+		pthread_cond_broadcast(&pool->call_done);
+	}
+	while ((job = dl_list_first(&pool->completed, struct worker_pool_job,
+				    list))) {
+		dl_list_del(&job->list);
+		dl_list_add_tail(&completed, &job->list);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	while ((job = dl_list_first(&completed, struct worker_pool_job,
+				    list))) {
+		dl_list_del(&job->list);
+		pool->pending--;
+		job->done(job->ctx, 0);
+		os_free(job);
+	}
+}
+
+
+struct worker_pool * worker_pool_init(unsigned int num_threads)
+{
+	struct worker_pool *pool;
+	long cpus;
+
+	if (!num_threads) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		num_threads = cpus > 0 ? cpus : 1;
+	}
+	if (num_threads > WORKER_POOL_MAX_THREADS)
+		num_threads = WORKER_POOL_MAX_THREADS;
+
+	pool = os_zalloc(sizeof(*pool));
+	if (!pool)
+		return NULL;
+	dl_list_init(&pool->queue);
+	dl_list_init(&pool->completed);
+	dl_list_init(&pool->calls);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+	pthread_cond_init(&pool->call_done, NULL);
+
+	pool->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (pool->efd < 0) {
+		wpa_printf(MSG_ERROR, "worker_pool: eventfd: %s",
+			   strerror(errno));
+		goto fail;
+	}
+	if (eloop_register_read_sock(pool->efd, worker_pool_receive, pool,
+				     NULL) < 0)
+		goto fail;
+
+	for (; pool->num_threads < num_threads; pool->num_threads++) {
+		if (pthread_create(&pool->threads[pool->num_threads], NULL,
+				   worker_pool_thread, pool) != 0) {
+			wpa_printf(MSG_ERROR,
+				   "worker_pool: Failed to create thread");
+			break;
+		}
+	}
+	if (!pool->num_threads) {
+		eloop_unregister_read_sock(pool->efd);
+		goto fail;
+	}
+
+	wpa_printf(MSG_DEBUG, "worker_pool: Started %u thread(s)",
+		   pool->num_threads);
+	return pool;
+
+fail:
+	if (pool->efd >= 0)
+		close(pool->efd);
+	pthread_cond_destroy(&pool->call_done);
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	os_free(pool);
+	return NULL;
+}
+
+
+void worker_pool_deinit(struct worker_pool *pool)
+{
+	struct worker_pool_job *job;
+	unsigned int i;
+
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_cond_broadcast(&pool->call_done);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	eloop_unregister_read_sock(pool->efd);
+	close(pool->efd);
+
+	while ((job = dl_list_first(&pool->completed, struct worker_pool_job,
+				    list)) ||
+	       (job = dl_list_first(&pool->queue, struct worker_pool_job,
+				    list))) {
+		dl_list_del(&job->list);
+		job->done(job->ctx, 1);
+		os_free(job);
+	}
+
+	pthread_cond_destroy(&pool->call_done);
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	os_free(pool);
+}
+
+
+int worker_pool_submit(struct worker_pool *pool, void (*work)(void *ctx),
+		       void (*done)(void *ctx, int deinit), void *ctx)
+{
+	struct worker_pool_job *job;
+
+	job = os_zalloc(sizeof(*job));
+	if (!job)
+		return -1;
+	job->work = work;
+	job->done = done;
+	job->ctx = ctx;
+
+	pthread_mutex_lock(&pool->lock);
+	dl_list_add_tail(&pool->queue, &job->list);
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+	pool->pending++;
+
+	return 0;
+}
+
+
+int worker_pool_call(struct worker_pool *pool, void (*func)(void *ctx),
+		     void *ctx)
+{
+	struct worker_pool_call call;
+	u64 one = 1;
+	int ret;
+
+	call.func = func;
+	call.ctx = ctx;
+	call.state = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->stop) {
+		pthread_mutex_unlock(&pool->lock);
+		return -1;
+	}
+	dl_list_add_tail(&pool->calls, &call.list);
+	if (write(pool->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		wpa_printf(MSG_ERROR, "worker_pool: eventfd write: %s",
+			   strerror(errno));
+	/* A call that has already been started is always completed */
+	while (call.state != 2 && !(pool->stop && call.state == 0))
+		pthread_cond_wait(&pool->call_done, &pool->lock);
+	ret = call.state == 2 ? 0 : -1;
+	if (ret)
+		dl_list_del(&call.list);
+	pthread_mutex_unlock(&pool->lock);
+
+	return ret;
+}
+
+
+void worker_pool_wait(struct worker_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	while (pool->running || !dl_list_empty(&pool->queue))
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+unsigned int worker_pool_pending(struct worker_pool *pool)
+{
+	return pool->pending;
+}
+
+
+unsigned int worker_pool_threads(struct worker_pool *pool)
+{
+	return pool->num_threads;
+}
+
+
+#ifdef CONFIG_MODULE_TESTS
+void worker_pool_test_receive(struct worker_pool *pool)
+{
+	worker_pool_receive(pool->efd, pool, NULL);
+}
+#endif /* CONFIG_MODULE_TESTS */
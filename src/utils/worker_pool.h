@@ -0,0 +1,90 @@
+/*
+ * Worker thread pool with completion delivery through eloop
+ *
+ * This software may be distributed under the terms of the BSD license.
+ * See README for more details.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+struct worker_pool;
+
+/**
+ * worker_pool_init - Start a pool of worker threads
+ * @num_threads: Number of threads or 0 to use the number of online CPUs
+ * Returns: Pointer to the pool or %NULL on failure
+ */
+struct worker_pool * worker_pool_init(unsigned int num_threads);
+
+/**
+ * worker_pool_deinit - Stop the worker threads and free the pool
+ * @pool: Pool from worker_pool_init() or %NULL
+ *
+ * Jobs that are already running are allowed to finish. Jobs that have not
+ * been started are not run. The done callback is called with deinit=1 for
+ * all jobs whose done callback has not yet been called.
+ */
+void worker_pool_deinit(struct worker_pool *pool);
+
+/**
+ * worker_pool_submit - Queue a job for a worker thread
+ * @pool: Pool from worker_pool_init()
+ * @work: Function to run in a worker thread
+ * @done: Function to call from the eloop thread once @work has returned
+ * @ctx: Context data for @work and @done
+ * Returns: 0 on success, -1 on failure
+ *
+ * @work must not use any data that is accessed from the eloop thread while
+ * the job is pending. @done is called with deinit=0 after @work has been run
+ * or with deinit=1 if the pool is being deinitialized. @done may submit new
+ * jobs, but must not deinitialize the pool.
+ */
+int worker_pool_submit(struct worker_pool *pool, void (*work)(void *ctx),
+		       void (*done)(void *ctx, int deinit), void *ctx);
+
+/**
+ * worker_pool_call - Call a function in the eloop thread from a job
+ * @pool: Pool that is running the job
+ * @func: Function to call from the eloop thread
+ * @ctx: Context data for @func
+ * Returns: 0 after @func has returned or -1 if the pool is being
+ * deinitialized and @func was not called
+ *
+ * This is used by the work function of a job to access data that is owned by
+ * the eloop thread. The worker thread is blocked until @func has returned.
+ * This must not be called from the eloop thread.
+ */
+int worker_pool_call(struct worker_pool *pool, void (*func)(void *ctx),
+		     void *ctx);
+
+/**
+ * worker_pool_wait - Wait for all submitted jobs to be run
+ * @pool: Pool from worker_pool_init()
+ *
+ * This blocks the calling thread until no job is queued or running. The done
+ * callbacks are still called through eloop. This must not be used with a pool
+ * whose jobs use worker_pool_call() since the calls would never be run.
+ */
+void worker_pool_wait(struct worker_pool *pool);
+
+/**
+ * worker_pool_pending - Number of jobs whose done callback is pending
+ * @pool: Pool from worker_pool_init()
+ * Returns: Number of submitted jobs that have not yet been completed
+ */
+unsigned int worker_pool_pending(struct worker_pool *pool);
+
+/**
+ * worker_pool_threads - Number of worker threads
+ * @pool: Pool from worker_pool_init()
+ * Returns: Number of worker threads in the pool
+ */
+unsigned int worker_pool_threads(struct worker_pool *pool);
+
+#ifdef CONFIG_MODULE_TESTS
+/* Call the done callbacks of completed jobs without going through eloop */
+void worker_pool_test_receive(struct worker_pool *pool);
+#endif /* CONFIG_MODULE_TESTS */
+
+#endif /* WORKER_POOL_H */
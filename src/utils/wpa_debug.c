@@ -14,6 +14,11 @@
 #include <syslog.h>
 #endif /* CONFIG_DEBUG_SYSLOG */
 
+#if defined(CONFIG_DEBUG_FILE_ASYNC) && \
+	(!defined(CONFIG_DEBUG_FILE) || defined(CONFIG_ANDROID_LOG))
+#undef CONFIG_DEBUG_FILE_ASYNC
+#endif
+
 #ifdef CONFIG_DEBUG_LINUX_TRACING
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -33,6 +38,24 @@ int wpa_debug_timestamp = 0;
 int wpa_debug_syslog = 0;
 #ifndef CONFIG_NO_STDOUT_DEBUG
 static FILE *out_file = NULL;
+
+#if defined(CONFIG_DEBUG_FILE_LOCK) || defined(CONFIG_DEBUG_FILE_ASYNC)
+#include <pthread.h>
+
+/*
+ * Debug messages may be printed from worker threads. Printing holds this lock
+ * for reading while using out_file and the asynchronous writer; they are
+ * replaced and freed only with the lock held for writing.
+ */
+static pthread_rwlock_t out_file_lock = PTHREAD_RWLOCK_INITIALIZER;
+#define wpa_debug_file_lock() pthread_rwlock_rdlock(&out_file_lock)
+#define wpa_debug_file_wrlock() pthread_rwlock_wrlock(&out_file_lock)
+#define wpa_debug_file_unlock() pthread_rwlock_unlock(&out_file_lock)
+#else /* CONFIG_DEBUG_FILE_LOCK || CONFIG_DEBUG_FILE_ASYNC */
+#define wpa_debug_file_lock() do { } while (0)
+#define wpa_debug_file_wrlock() do { } while (0)
+#define wpa_debug_file_unlock() do { } while (0)
+#endif /* CONFIG_DEBUG_FILE_LOCK || CONFIG_DEBUG_FILE_ASYNC */
 #endif /* CONFIG_NO_STDOUT_DEBUG */
 
 
@@ -79,6 +102,469 @@ void set_log_level(int log_level, int debug_timestamp, int debug_show_keys)
 #include <fcntl.h>
 #endif /* CONFIG_DEBUG_FILE */
 
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+
+/*
+ * Asynchronous debug file writer. Debug lines are formatted on the calling
+ * thread and copied into a ring buffer under push_lock, which serializes the
+ * event loop and any worker threads that print. A separate writer thread
+ * batches the ring to the log file, so the event loop never blocks on file
+ * I/O; if the writer falls behind, lines that do not fit into the ring are
+ * dropped and counted.
+ */
+
+#ifndef WPA_DEBUG_ASYNC_RING_SIZE
+#define WPA_DEBUG_ASYNC_RING_SIZE (1024 * 1024) /* must be a power of two */
+#endif /* WPA_DEBUG_ASYNC_RING_SIZE */
+#define WPA_DEBUG_ASYNC_FLUSH_MS 100
+#define WPA_DEBUG_LINE_LEN 256
+
+struct wpa_debug_async {
+	char *ring;
+	size_t head; /* updated only under push_lock */
+	size_t tail; /* updated only by the writer thread */
+	unsigned long dropped;
+	unsigned long dropped_reported;
+	int fd;
+	int running;
+	int thread_started;
+	int atfork_registered;
+	int stop;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_mutex_t flush_lock; /* serializes consumers of the ring */
+	pthread_mutex_t push_lock; /* serializes producers */
+};
+
+static struct wpa_debug_async debug_async = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.flush_lock = PTHREAD_MUTEX_INITIALIZER,
+	.push_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#define wpa_debug_async_active() (out_file && debug_async.running)
+
+
+static void wpa_debug_async_write_fd(int fd, const char *data, size_t len)
+{
+	ssize_t res;
+
+	while (len > 0) {
+		res = write(fd, data, len);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		data += res;
+		len -= res;
+	}
+}
+
+
+static void wpa_debug_async_flush(struct wpa_debug_async *a)
+{
+	size_t head, tail, pos, part;
+	unsigned long dropped;
+
+	head = __atomic_load_n(&a->head, __ATOMIC_ACQUIRE);
+	tail = a->tail;
+	while (tail != head) {
+		pos = tail & (WPA_DEBUG_ASYNC_RING_SIZE - 1);
+		part = WPA_DEBUG_ASYNC_RING_SIZE - pos;
+		if (part > head - tail)
+			part = head - tail;
+		wpa_debug_async_write_fd(a->fd, &a->ring[pos], part);
+		tail += part;
+		__atomic_store_n(&a->tail, tail, __ATOMIC_RELEASE);
+	}
+
+	dropped = __atomic_load_n(&a->dropped, __ATOMIC_RELAXED);
+	if (dropped != a->dropped_reported) {
+		char buf[100];
+		int res;
+
+		res = os_snprintf(buf, sizeof(buf),
+				  "wpa_debug: %lu debug message(s) dropped (log writer too slow)\n",
+				  dropped - a->dropped_reported);
+		if (!os_snprintf_error(sizeof(buf), res))
+			wpa_debug_async_write_fd(a->fd, buf, res);
+		a->dropped_reported = dropped;
+	}
+}
+
+
+static void * wpa_debug_async_thread(void *ctx)
+{
+	struct wpa_debug_async *a = ctx;
+	struct timespec ts;
+	int stop;
+
+	for (;;) {
+		pthread_mutex_lock(&a->lock);
+		if (!a->stop) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += WPA_DEBUG_ASYNC_FLUSH_MS * 1000000L;
+			if (ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&a->cond, &a->lock, &ts);
+		}
+		stop = a->stop;
+		pthread_mutex_unlock(&a->lock);
+
+		pthread_mutex_lock(&a->flush_lock);
+		wpa_debug_async_flush(a);
+		pthread_mutex_unlock(&a->flush_lock);
+		if (stop)
+			break;
+	}
+
+	return NULL;
+}
+
+
+static int wpa_debug_async_start_thread(struct wpa_debug_async *a)
+{
+	a->stop = 0;
+	if (pthread_create(&a->thread, NULL, wpa_debug_async_thread, a))
+		return -1;
+	a->thread_started = 1;
+	return 0;
+}
+
+
+/*
+ * Threads do not survive fork(), e.g., when daemonizing. Flush the ring before
+ * forking so that nothing is written twice and let the child start its own
+ * writer thread once it logs something.
+ */
+
+static void wpa_debug_async_atfork_prepare(void)
+{
+	if (!debug_async.running)
+		return;
+	pthread_mutex_lock(&debug_async.push_lock);
+	pthread_mutex_lock(&debug_async.flush_lock);
+	wpa_debug_async_flush(&debug_async);
+}
+
+
+static void wpa_debug_async_atfork_parent(void)
+{
+	if (!debug_async.running)
+		return;
+	pthread_mutex_unlock(&debug_async.flush_lock);
+	pthread_mutex_unlock(&debug_async.push_lock);
+}
+
+
+static void wpa_debug_async_atfork_child(void)
+{
+	pthread_mutex_init(&debug_async.lock, NULL);
+	pthread_cond_init(&debug_async.cond, NULL);
+	pthread_mutex_init(&debug_async.flush_lock, NULL);
+	pthread_mutex_init(&debug_async.push_lock, NULL);
+	debug_async.thread_started = 0;
+}
+
+
+static int wpa_debug_async_start(int fd)
+{
+	struct wpa_debug_async *a = &debug_async;
+
+	if (!a->atfork_registered) {
+		if (pthread_atfork(wpa_debug_async_atfork_prepare,
+				   wpa_debug_async_atfork_parent,
+				   wpa_debug_async_atfork_child))
+			return -1;
+		a->atfork_registered = 1;
+	}
+
+	a->ring = os_malloc(WPA_DEBUG_ASYNC_RING_SIZE);
+	if (!a->ring)
+		return -1;
+	a->head = a->tail = 0;
+	a->dropped = a->dropped_reported = 0;
+	a->fd = fd;
+	if (wpa_debug_async_start_thread(a) < 0) {
+		os_free(a->ring);
+		a->ring = NULL;
+		return -1;
+	}
+	a->running = 1;
+	return 0;
+}
+
+
+static void wpa_debug_async_stop(void)
+{
+	struct wpa_debug_async *a = &debug_async;
+
+	if (!a->running)
+		return;
+
+	if (a->thread_started) {
+		/* The writer thread drains the ring before exiting */
+		pthread_mutex_lock(&a->lock);
+		a->stop = 1;
+		pthread_cond_signal(&a->cond);
+		pthread_mutex_unlock(&a->lock);
+		pthread_join(a->thread, NULL);
+		a->thread_started = 0;
+	} else {
+		wpa_debug_async_flush(a);
+	}
+
+	a->running = 0;
+	os_free(a->ring);
+	a->ring = NULL;
+}
+
+
+static void wpa_debug_async_push(const char *data, size_t len)
+{
+	struct wpa_debug_async *a = &debug_async;
+	size_t head, tail, pos, part;
+
+	pthread_mutex_lock(&a->push_lock);
+	if (!a->thread_started && wpa_debug_async_start_thread(a) < 0) {
+		/* No writer thread available; write synchronously */
+		wpa_debug_async_flush(a);
+		wpa_debug_async_write_fd(a->fd, data, len);
+		pthread_mutex_unlock(&a->push_lock);
+		return;
+	}
+
+	head = a->head;
+	tail = __atomic_load_n(&a->tail, __ATOMIC_ACQUIRE);
+	if (len > WPA_DEBUG_ASYNC_RING_SIZE - (head - tail)) {
+		__atomic_add_fetch(&a->dropped, 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&a->push_lock);
+		return;
+	}
+
+	pos = head & (WPA_DEBUG_ASYNC_RING_SIZE - 1);
+	part = WPA_DEBUG_ASYNC_RING_SIZE - pos;
+	if (part > len)
+		part = len;
+	os_memcpy(&a->ring[pos], data, part);
+	os_memcpy(a->ring, data + part, len - part);
+	__atomic_store_n(&a->head, head + len, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&a->push_lock);
+
+	/* Wake up the writer early if the ring is getting full */
+	if (head + len - tail >= WPA_DEBUG_ASYNC_RING_SIZE / 2)
+		pthread_cond_signal(&a->cond);
+}
+
+
+/* A debug line being formatted; grows from the stack buffer to heap */
+struct wpa_debug_line {
+	char *buf;
+	size_t len;
+	size_t size;
+	char stack[WPA_DEBUG_LINE_LEN];
+};
+
+
+static char * wpa_debug_line_reserve(struct wpa_debug_line *line, size_t len)
+{
+	char *nbuf;
+	size_t nsize;
+
+	if (line->size - line->len > len)
+		return &line->buf[line->len];
+
+	nsize = line->size * 2;
+	while (nsize - line->len <= len)
+		nsize *= 2;
+	if (line->buf == line->stack) {
+		nbuf = os_malloc(nsize);
+		if (nbuf)
+			os_memcpy(nbuf, line->buf, line->len);
+	} else {
+		nbuf = os_realloc(line->buf, nsize);
+	}
+	if (!nbuf)
+		return NULL;
+	line->buf = nbuf;
+	line->size = nsize;
+	return &line->buf[line->len];
+}
+
+
+static void wpa_debug_line_vprintf(struct wpa_debug_line *line,
+				   const char *fmt, va_list ap)
+{
+	va_list ap2;
+	char *pos;
+	int res;
+
+	va_copy(ap2, ap);
+	res = vsnprintf(&line->buf[line->len], line->size - line->len, fmt,
+			ap2);
+	va_end(ap2);
+	if (res < 0)
+		return;
+	if ((size_t) res < line->size - line->len) {
+		line->len += res;
+		return;
+	}
+
+	pos = wpa_debug_line_reserve(line, res);
+	if (!pos) {
+		/* Keep the truncated output */
+		line->len = line->size - 1;
+		return;
+	}
+	vsnprintf(pos, line->size - line->len, fmt, ap);
+	line->len += res;
+}
+
+
+static void wpa_debug_line_printf(struct wpa_debug_line *line,
+				  const char *fmt, ...)
+	PRINTF_FORMAT(2, 3);
+
+static void wpa_debug_line_printf(struct wpa_debug_line *line,
+				  const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	wpa_debug_line_vprintf(line, fmt, ap);
+	va_end(ap);
+}
+
+
+static void wpa_debug_line_hex(struct wpa_debug_line *line, const u8 *buf,
+			       size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	char *pos;
+	size_t i;
+
+	pos = wpa_debug_line_reserve(line, 3 * len);
+	if (!pos)
+		return;
+	for (i = 0; i < len; i++) {
+		*pos++ = ' ';
+		*pos++ = hex[buf[i] >> 4];
+		*pos++ = hex[buf[i] & 0x0f];
+	}
+	line->len += 3 * len;
+	line->buf[line->len] = '\0';
+}
+
+
+static void wpa_debug_line_start(struct wpa_debug_line *line)
+{
+	struct os_time tv;
+
+	line->buf = line->stack;
+	line->len = 0;
+	line->size = sizeof(line->stack);
+	line->buf[0] = '\0';
+
+	if (wpa_debug_timestamp) {
+		os_get_time(&tv);
+		wpa_debug_line_printf(line, "%ld.%06u: ", (long) tv.sec,
+				      (unsigned int) tv.usec);
+	}
+}
+
+
+static void wpa_debug_line_end(struct wpa_debug_line *line)
+{
+	wpa_debug_async_push(line->buf, line->len);
+	if (line->buf != line->stack)
+		bin_clear_free(line->buf, line->size);
+	else
+		forced_memzero(line->buf, line->len);
+}
+
+
+static void wpa_debug_async_vprintf(const char *fmt, va_list ap)
+{
+	struct wpa_debug_line line;
+
+	wpa_debug_line_start(&line);
+	wpa_debug_line_vprintf(&line, fmt, ap);
+	wpa_debug_line_printf(&line, "\n");
+	wpa_debug_line_end(&line);
+}
+
+
+static void wpa_debug_async_hexdump(const char *title, const u8 *buf,
+				    size_t len, int show)
+{
+	struct wpa_debug_line line;
+
+	wpa_debug_line_start(&line);
+	wpa_debug_line_printf(&line, "%s - hexdump(len=%lu):",
+			      title, (unsigned long) len);
+	if (buf == NULL)
+		wpa_debug_line_printf(&line, " [NULL]");
+	else if (show)
+		wpa_debug_line_hex(&line, buf, len);
+	else
+		wpa_debug_line_printf(&line, " [REMOVED]");
+	wpa_debug_line_printf(&line, "\n");
+	wpa_debug_line_end(&line);
+}
+
+
+static void wpa_debug_async_hexdump_ascii(const char *title, const u8 *pos,
+					  size_t len, int show)
+{
+	struct wpa_debug_line line;
+	const size_t line_len = 16;
+	size_t i, llen;
+
+	wpa_debug_line_start(&line);
+	if (!show) {
+		wpa_debug_line_printf(&line,
+				      "%s - hexdump_ascii(len=%lu): [REMOVED]\n",
+				      title, (unsigned long) len);
+		goto done;
+	}
+	if (pos == NULL) {
+		wpa_debug_line_printf(&line,
+				      "%s - hexdump_ascii(len=%lu): [NULL]\n",
+				      title, (unsigned long) len);
+		goto done;
+	}
+	wpa_debug_line_printf(&line, "%s - hexdump_ascii(len=%lu):\n",
+			      title, (unsigned long) len);
+	while (len) {
+		char ascii[16 + 1];
+
+		llen = len > line_len ? line_len : len;
+		wpa_debug_line_printf(&line, "    ");
+		wpa_debug_line_hex(&line, pos, llen);
+		for (i = 0; i < llen; i++)
+			ascii[i] = isprint(pos[i]) ? pos[i] : '_';
+		ascii[llen] = '\0';
+		wpa_debug_line_printf(&line, "%*s   %-16s\n",
+				      (int) (3 * (line_len - llen)), "", ascii);
+		pos += llen;
+		len -= llen;
+	}
+done:
+	wpa_debug_line_end(&line);
+}
+
+#else /* CONFIG_DEBUG_FILE_ASYNC */
+
+#define wpa_debug_async_active() 0
+
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
+
 
 void wpa_debug_print_timestamp(void)
 {
@@ -90,7 +576,8 @@ void wpa_debug_print_timestamp(void)
 
 	os_get_time(&tv);
 #ifdef CONFIG_DEBUG_FILE
-	if (out_file)
+	/* Asynchronous output adds the timestamp into the same line */
+	if (out_file && !wpa_debug_async_active())
 		fprintf(out_file, "%ld.%06u: ", (long) tv.sec,
 			(unsigned int) tv.usec);
 #endif /* CONFIG_DEBUG_FILE */
@@ -238,7 +725,15 @@ void wpa_printf(int level, const char *fmt, ...)
 			va_end(ap);
 		}
 #endif /* CONFIG_DEBUG_SYSLOG */
+		wpa_debug_file_lock();
 		wpa_debug_print_timestamp();
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+		if (wpa_debug_async_active()) {
+			va_start(ap, fmt);
+			wpa_debug_async_vprintf(fmt, ap);
+			va_end(ap);
+		} else
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
 #ifdef CONFIG_DEBUG_FILE
 		if (out_file) {
 			va_start(ap, fmt);
@@ -247,6 +742,7 @@ void wpa_printf(int level, const char *fmt, ...)
 			va_end(ap);
 		}
 #endif /* CONFIG_DEBUG_FILE */
+		wpa_debug_file_unlock();
 		if (!wpa_debug_syslog && !out_file) {
 			va_start(ap, fmt);
 			vprintf(fmt, ap);
@@ -365,7 +861,13 @@ static void _wpa_hexdump(int level, const char *title, const u8 *buf,
 			return;
 	}
 #endif /* CONFIG_DEBUG_SYSLOG */
+	wpa_debug_file_lock();
 	wpa_debug_print_timestamp();
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+	if (wpa_debug_async_active())
+		wpa_debug_async_hexdump(title, buf, len, show);
+	else
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
 #ifdef CONFIG_DEBUG_FILE
 	if (out_file) {
 		fprintf(out_file, "%s - hexdump(len=%lu):",
@@ -381,6 +883,7 @@ static void _wpa_hexdump(int level, const char *title, const u8 *buf,
 		fprintf(out_file, "\n");
 	}
 #endif /* CONFIG_DEBUG_FILE */
+	wpa_debug_file_unlock();
 	if (!wpa_debug_syslog && !out_file) {
 		printf("%s - hexdump(len=%lu):", title, (unsigned long) len);
 		if (buf == NULL) {
@@ -443,7 +946,13 @@ static void _wpa_hexdump_ascii(int level, const char *title, const void *buf,
 	if (wpa_debug_syslog)
 		_wpa_hexdump(level, title, buf, len, show, 1);
 #endif /* CONFIG_DEBUG_SYSLOG */
+	wpa_debug_file_lock();
 	wpa_debug_print_timestamp();
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+	if (wpa_debug_async_active())
+		wpa_debug_async_hexdump_ascii(title, buf, len, show);
+	else
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
 #ifdef CONFIG_DEBUG_FILE
 	if (out_file) {
 		if (!show) {
@@ -483,6 +992,7 @@ static void _wpa_hexdump_ascii(int level, const char *title, const void *buf,
 	}
 file_done:
 #endif /* CONFIG_DEBUG_FILE */
+	wpa_debug_file_unlock();
 	if (!wpa_debug_syslog && !out_file) {
 		if (!show) {
 			printf("%s - hexdump_ascii(len=%lu): [REMOVED]\n",
@@ -566,6 +1076,10 @@ int wpa_debug_open_file(const char *path)
 {
 #ifdef CONFIG_DEBUG_FILE
 	int out_fd;
+	FILE *f;
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+	int async_res;
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
 
 	if (!path)
 		return 0;
@@ -593,16 +1107,27 @@ int wpa_debug_open_file(const char *path)
 	}
 #endif /* __linux__ */
 
-	out_file = fdopen(out_fd, "a");
-	if (out_file == NULL) {
+	f = fdopen(out_fd, "a");
+	if (f == NULL) {
 		wpa_printf(MSG_ERROR, "wpa_debug_open_file: Failed to open "
 			   "output file, using standard output");
 		close(out_fd);
 		return -1;
 	}
 #ifndef _WIN32
-	setvbuf(out_file, NULL, _IOLBF, 0);
+	setvbuf(f, NULL, _IOLBF, 0);
 #endif /* _WIN32 */
+	wpa_debug_file_wrlock();
+	out_file = f;
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+	async_res = wpa_debug_async_start(out_fd);
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
+	wpa_debug_file_unlock();
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+	if (async_res < 0)
+		wpa_printf(MSG_ERROR,
+			   "wpa_debug_open_file: Failed to start asynchronous log writer, using synchronous output");
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
 #else /* CONFIG_DEBUG_FILE */
 	(void)path;
 #endif /* CONFIG_DEBUG_FILE */
@@ -615,8 +1140,14 @@ void wpa_debug_close_file(void)
 #ifdef CONFIG_DEBUG_FILE
 	if (!out_file)
 		return;
+	/* Wait for other threads to finish printing */
+	wpa_debug_file_wrlock();
+#ifdef CONFIG_DEBUG_FILE_ASYNC
+	wpa_debug_async_stop();
+#endif /* CONFIG_DEBUG_FILE_ASYNC */
 	fclose(out_file);
 	out_file = NULL;
+	wpa_debug_file_unlock();
 	os_free(last_path);
 	last_path = NULL;
 #endif /* CONFIG_DEBUG_FILE */
@@ -655,193 +1186,161 @@ void wpa_msg_register_ifname_cb(wpa_msg_get_ifname_func func)
 }
 
 
-void wpa_msg(void *ctx, int level, const char *fmt, ...)
+static wpa_msg_monitor_cb_func wpa_msg_monitor_cb = NULL;
+
+void wpa_msg_register_monitor_cb(wpa_msg_monitor_cb_func func)
 {
-	va_list ap;
-	char *buf;
-	int buflen;
+	wpa_msg_monitor_cb = func;
+}
+
+
+/* Messages shorter than this are formatted without heap allocation */
+#define WPA_MSG_STACK_BUF_LEN 256
+
+enum wpa_msg_print {
+	WPA_MSG_PRINT_NONE,
+	WPA_MSG_PRINT,
+	WPA_MSG_PRINT_IFNAME,
+};
+
+
+static int wpa_msg_wanted(void *ctx, int level, enum wpa_msg_type type,
+			  enum wpa_msg_print print, const char *fmt)
+{
+#ifndef CONFIG_NO_STDOUT_DEBUG
+	if (print != WPA_MSG_PRINT_NONE && level >= wpa_debug_level)
+		return 1;
+#ifdef CONFIG_DEBUG_LINUX_TRACING
+	if (print != WPA_MSG_PRINT_NONE && wpa_debug_tracing_file)
+		return 1;
+#endif /* CONFIG_DEBUG_LINUX_TRACING */
+#endif /* CONFIG_NO_STDOUT_DEBUG */
+	if (wpa_msg_aidl_cb)
+		return 1;
+	if (!wpa_msg_cb)
+		return 0;
+	return !wpa_msg_monitor_cb ||
+		wpa_msg_monitor_cb(ctx, level, type, fmt);
+}
+
+
+static void wpa_msg_va(void *ctx, int level, enum wpa_msg_type type,
+		       enum wpa_msg_print print, const char *fmt, va_list ap)
+{
+	char stack_buf[WPA_MSG_STACK_BUF_LEN];
+	char *buf = stack_buf;
+	size_t buflen = sizeof(stack_buf);
 	int len;
-	char prefix[130];
+	va_list ap2;
 
-	va_start(ap, fmt);
-	buflen = vsnprintf(NULL, 0, fmt, ap) + 1;
-	va_end(ap);
+	/* Skip formatting if nobody is going to see the message */
+	if (!wpa_msg_wanted(ctx, level, type, print, fmt))
+		return;
 
-	buf = os_malloc(buflen);
-	if (buf == NULL) {
-		wpa_printf(MSG_ERROR, "wpa_msg: Failed to allocate message "
-			   "buffer");
+	va_copy(ap2, ap);
+	len = vsnprintf(buf, buflen, fmt, ap2);
+	va_end(ap2);
+	if (len < 0)
 		return;
+	if ((size_t) len >= buflen) {
+		buflen = len + 1;
+		buf = os_malloc(buflen);
+		if (buf == NULL) {
+			wpa_printf(MSG_ERROR,
+				   "wpa_msg: Failed to allocate message buffer");
+			return;
+		}
+		len = vsnprintf(buf, buflen, fmt, ap);
 	}
-	va_start(ap, fmt);
-	prefix[0] = '\0';
-	if (wpa_msg_ifname_cb) {
-		const char *ifname = wpa_msg_ifname_cb(ctx);
-		if (ifname) {
-			int res = os_snprintf(prefix, sizeof(prefix), "%s: ",
-					      ifname);
-			if (os_snprintf_error(sizeof(prefix), res))
-				prefix[0] = '\0';
+
+	if (print == WPA_MSG_PRINT_IFNAME) {
+		char prefix[130];
+
+		prefix[0] = '\0';
+		if (wpa_msg_ifname_cb) {
+			const char *ifname = wpa_msg_ifname_cb(ctx);
+			if (ifname) {
+				int res = os_snprintf(prefix, sizeof(prefix),
+						      "%s: ", ifname);
+				if (os_snprintf_error(sizeof(prefix), res))
+					prefix[0] = '\0';
+			}
 		}
+		wpa_printf(level, "%s%s", prefix, buf);
+	} else if (print == WPA_MSG_PRINT) {
+		wpa_printf(level, "%s", buf);
 	}
-	len = vsnprintf(buf, buflen, fmt, ap);
-	va_end(ap);
-	wpa_printf(level, "%s%s", prefix, buf);
 	if (wpa_msg_cb)
-		wpa_msg_cb(ctx, level, WPA_MSG_PER_INTERFACE, buf, len);
+		wpa_msg_cb(ctx, level, type, buf, len);
 	if (wpa_msg_aidl_cb)
-		wpa_msg_aidl_cb(ctx, level, WPA_MSG_PER_INTERFACE, buf, len);
-	bin_clear_free(buf, buflen);
+		wpa_msg_aidl_cb(ctx, level, type, buf, len);
+
+	if (buf == stack_buf)
+		forced_memzero(stack_buf, len);
+	else
+		bin_clear_free(buf, buflen);
 }
 
 
-void wpa_msg_ctrl(void *ctx, int level, const char *fmt, ...)
+void wpa_msg(void *ctx, int level, const char *fmt, ...)
 {
 	va_list ap;
-	char *buf;
-	int buflen;
-	int len;
-
-	if (!wpa_msg_cb && !wpa_msg_aidl_cb)
-		return;
 
 	va_start(ap, fmt);
-	buflen = vsnprintf(NULL, 0, fmt, ap) + 1;
+	wpa_msg_va(ctx, level, WPA_MSG_PER_INTERFACE, WPA_MSG_PRINT_IFNAME,
+		   fmt, ap);
 	va_end(ap);
+}
+
+
+void wpa_msg_ctrl(void *ctx, int level, const char *fmt, ...)
+{
+	va_list ap;
 
-	buf = os_malloc(buflen);
-	if (buf == NULL) {
-		wpa_printf(MSG_ERROR, "wpa_msg_ctrl: Failed to allocate "
-			   "message buffer");
-		return;
-	}
 	va_start(ap, fmt);
-	len = vsnprintf(buf, buflen, fmt, ap);
+	wpa_msg_va(ctx, level, WPA_MSG_PER_INTERFACE, WPA_MSG_PRINT_NONE,
+		   fmt, ap);
 	va_end(ap);
-	if (wpa_msg_cb)
-		wpa_msg_cb(ctx, level, WPA_MSG_PER_INTERFACE, buf, len);
-	if (wpa_msg_aidl_cb)
-		wpa_msg_aidl_cb(ctx, level, WPA_MSG_PER_INTERFACE, buf, len);
-	bin_clear_free(buf, buflen);
 }
 
 
 void wpa_msg_global(void *ctx, int level, const char *fmt, ...)
 {
 	va_list ap;
-	char *buf;
-	int buflen;
-	int len;
 
 	va_start(ap, fmt);
-	buflen = vsnprintf(NULL, 0, fmt, ap) + 1;
-	va_end(ap);
-
-	buf = os_malloc(buflen);
-	if (buf == NULL) {
-		wpa_printf(MSG_ERROR, "wpa_msg_global: Failed to allocate "
-			   "message buffer");
-		return;
-	}
-	va_start(ap, fmt);
-	len = vsnprintf(buf, buflen, fmt, ap);
+	wpa_msg_va(ctx, level, WPA_MSG_GLOBAL, WPA_MSG_PRINT, fmt, ap);
 	va_end(ap);
-	wpa_printf(level, "%s", buf);
-	if (wpa_msg_cb)
-		wpa_msg_cb(ctx, level, WPA_MSG_GLOBAL, buf, len);
-	if (wpa_msg_aidl_cb)
-		wpa_msg_aidl_cb(ctx, level, WPA_MSG_GLOBAL, buf, len);
-	bin_clear_free(buf, buflen);
 }
 
 
 void wpa_msg_global_ctrl(void *ctx, int level, const char *fmt, ...)
 {
 	va_list ap;
-	char *buf;
-	int buflen;
-	int len;
-
-	if (!wpa_msg_cb && !wpa_msg_aidl_cb)
-		return;
 
 	va_start(ap, fmt);
-	buflen = vsnprintf(NULL, 0, fmt, ap) + 1;
-	va_end(ap);
-
-	buf = os_malloc(buflen);
-	if (buf == NULL) {
-		wpa_printf(MSG_ERROR,
-			   "wpa_msg_global_ctrl: Failed to allocate message buffer");
-		return;
-	}
-	va_start(ap, fmt);
-	len = vsnprintf(buf, buflen, fmt, ap);
+	wpa_msg_va(ctx, level, WPA_MSG_GLOBAL, WPA_MSG_PRINT_NONE, fmt, ap);
 	va_end(ap);
-	if (wpa_msg_cb)
-		wpa_msg_cb(ctx, level, WPA_MSG_GLOBAL, buf, len);
-	if (wpa_msg_aidl_cb)
-		wpa_msg_aidl_cb(ctx, level, WPA_MSG_GLOBAL, buf, len);
-	bin_clear_free(buf, buflen);
 }
 
 
 void wpa_msg_no_global(void *ctx, int level, const char *fmt, ...)
 {
 	va_list ap;
-	char *buf;
-	int buflen;
-	int len;
-
-	va_start(ap, fmt);
-	buflen = vsnprintf(NULL, 0, fmt, ap) + 1;
-	va_end(ap);
 
-	buf = os_malloc(buflen);
-	if (buf == NULL) {
-		wpa_printf(MSG_ERROR, "wpa_msg_no_global: Failed to allocate "
-			   "message buffer");
-		return;
-	}
 	va_start(ap, fmt);
-	len = vsnprintf(buf, buflen, fmt, ap);
+	wpa_msg_va(ctx, level, WPA_MSG_NO_GLOBAL, WPA_MSG_PRINT, fmt, ap);
 	va_end(ap);
-	wpa_printf(level, "%s", buf);
-	if (wpa_msg_cb)
-		wpa_msg_cb(ctx, level, WPA_MSG_NO_GLOBAL, buf, len);
-	if (wpa_msg_aidl_cb)
-		wpa_msg_aidl_cb(ctx, level, WPA_MSG_NO_GLOBAL, buf, len);
-
-	bin_clear_free(buf, buflen);
 }
 
 
 void wpa_msg_global_only(void *ctx, int level, const char *fmt, ...)
 {
 	va_list ap;
-	char *buf;
-	int buflen;
-	int len;
-
-	va_start(ap, fmt);
-	buflen = vsnprintf(NULL, 0, fmt, ap) + 1;
-	va_end(ap);
 
-	buf = os_malloc(buflen);
-	if (buf == NULL) {
-		wpa_printf(MSG_ERROR, "%s: Failed to allocate message buffer",
-			   __func__);
-		return;
-	}
 	va_start(ap, fmt);
-	len = vsnprintf(buf, buflen, fmt, ap);
+	wpa_msg_va(ctx, level, WPA_MSG_ONLY_GLOBAL, WPA_MSG_PRINT, fmt, ap);
 	va_end(ap);
-	wpa_printf(level, "%s", buf);
-	if (wpa_msg_cb)
-		wpa_msg_cb(ctx, level, WPA_MSG_ONLY_GLOBAL, buf, len);
-	if (wpa_msg_aidl_cb)
-		wpa_msg_aidl_cb(ctx, level, WPA_MSG_ONLY_GLOBAL, buf, len);
-	os_free(buf);
 }
 
 #endif /* CONFIG_NO_WPA_MSG */
@@ -169,6 +169,7 @@ void wpa_hexdump_ascii_key(int level, const char *title, const void *buf,
 #define wpa_msg_register_cb(f) do { } while (0)
 #define wpa_msg_register_aidl_cb(f) do { } while (0)
 #define wpa_msg_register_ifname_cb(f) do { } while (0)
+#define wpa_msg_register_monitor_cb(f) do { } while (0)
 #else /* CONFIG_NO_WPA_MSG */
 /**
  * wpa_msg - Conditional printf for default target and ctrl_iface monitors
@@ -279,6 +280,23 @@ void wpa_msg_register_aidl_cb(wpa_msg_cb_func func);
 typedef const char * (*wpa_msg_get_ifname_func)(void *ctx);
 void wpa_msg_register_ifname_cb(wpa_msg_get_ifname_func func);
 
+typedef int (*wpa_msg_monitor_cb_func)(void *ctx, int level,
+				       enum wpa_msg_type type, const char *fmt);
+
+/**
+ * wpa_msg_register_monitor_cb - Register callback for checking message interest
+ * @func: Callback function (%NULL to unregister)
+ *
+ * The callback returns whether the callback registered with
+ * wpa_msg_register_cb() would deliver a message with the specified level and
+ * type to any recipient. This is used to skip formatting wpa_msg() messages
+ * that are not going to be written to the debug log nor delivered to any
+ * control interface monitor. The callback also gets the format string of the
+ * message. Event names are literal prefixes of it, so monitors that filter
+ * events by name can be checked before the message is formatted.
+ */
+void wpa_msg_register_monitor_cb(wpa_msg_monitor_cb_func func);
+
 #endif /* CONFIG_NO_WPA_MSG */
 
 #ifdef CONFIG_NO_HOSTAPD_LOGGER
@@ -134,6 +134,7 @@ OBJS += src/utils/wpabuf.c
 OBJS += src/utils/bitfield.c
 OBJS += src/utils/ip_addr.c
 OBJS += src/utils/crc32.c
+OBJS += src/utils/siphash.c
 OBJS += wmm_ac.c
 OBJS += op_classes.c
 OBJS += rrm.c
@@ -195,6 +196,10 @@ ifdef CONFIG_ELOOP_EPOLL
 L_CFLAGS += -DCONFIG_ELOOP_EPOLL
 endif
 
+ifdef CONFIG_ELOOP_TIMER_HEAP
+L_CFLAGS += -DCONFIG_ELOOP_TIMER_HEAP
+endif
+
 ifdef CONFIG_EAPOL_TEST
 L_CFLAGS += -Werror -DEAPOL_TEST
 endif
@@ -1636,8 +1641,19 @@ ifdef CONFIG_DEBUG_LINUX_TRACING
 L_CFLAGS += -DCONFIG_DEBUG_LINUX_TRACING
 endif
 
+ifdef CONFIG_FLIGHT_RECORDER
+L_CFLAGS += -DCONFIG_FLIGHT_RECORDER
+OBJS += src/utils/flight_recorder.c
+ifdef CONFIG_FLIGHT_RECORDER_DIR
+L_CFLAGS += -DFLIGHT_RECORDER_DIR=\"$(CONFIG_FLIGHT_RECORDER_DIR)\"
+endif
+endif
+
 ifdef CONFIG_DEBUG_FILE
 L_CFLAGS += -DCONFIG_DEBUG_FILE
+ifdef CONFIG_DEBUG_FILE_ASYNC
+L_CFLAGS += -DCONFIG_DEBUG_FILE_ASYNC
+endif
 endif
 
 ifdef CONFIG_DELAYED_MIC_ERROR_REPORT
@@ -208,6 +208,119 @@ static void wpa_bss_update_pending_connect(struct wpa_supplicant *wpa_s,
 }
 
 
+#define WPA_BSS_HASH_INIT_SIZE 16
+
+
+static unsigned int wpa_bss_hash_addr(const u8 *addr, size_t size)
+{
+	u32 h;
+
+	/* The OUI is often shared by most entries, so mix in the NIC specific
+	 * part of the address */
+	h = WPA_GET_BE32(&addr[2]) * 0x9e3779b1;
+	return (h ^ (h >> 16) ^ addr[0]) & (size - 1);
+}
+
+
+static void wpa_bss_hash_add(struct wpa_supplicant *wpa_s,
+			     struct wpa_bss *bss)
+{
+	size_t size = wpa_s->bss_hash_size;
+
+	dl_list_add_tail(&wpa_s->bss_hash_bssid[
+				 wpa_bss_hash_addr(bss->bssid, size)],
+			 &bss->hash_bssid);
+	dl_list_add_tail(&wpa_s->bss_hash_id[bss->id & (size - 1)],
+			 &bss->hash_id);
+#ifdef CONFIG_P2P
+	if (!is_zero_ether_addr(bss->p2p_dev_addr))
+		dl_list_add_tail(&wpa_s->bss_hash_p2p[
+					 wpa_bss_hash_addr(bss->p2p_dev_addr,
+							   size)],
+				 &bss->hash_p2p);
+#endif /* CONFIG_P2P */
+}
+
+
+static void wpa_bss_hash_del(struct wpa_bss *bss)
+{
+	dl_list_del(&bss->hash_bssid);
+	dl_list_del(&bss->hash_id);
+#ifdef CONFIG_P2P
+	if (bss->hash_p2p.next)
+		dl_list_del(&bss->hash_p2p);
+#endif /* CONFIG_P2P */
+}
+
+
+static int wpa_bss_hash_resize(struct wpa_supplicant *wpa_s, size_t size)
+{
+	struct dl_list *hash_bssid, *hash_id;
+#ifdef CONFIG_P2P
+	struct dl_list *hash_p2p;
+#endif /* CONFIG_P2P */
+	struct wpa_bss *bss;
+	size_t i;
+
+	hash_bssid = os_calloc(size, sizeof(struct dl_list));
+	hash_id = os_calloc(size, sizeof(struct dl_list));
+#ifdef CONFIG_P2P
+	hash_p2p = os_calloc(size, sizeof(struct dl_list));
+	if (!hash_p2p)
+		goto fail;
+#endif /* CONFIG_P2P */
+	if (!hash_bssid || !hash_id)
+		goto fail;
+
+	for (i = 0; i < size; i++) {
+		dl_list_init(&hash_bssid[i]);
+		dl_list_init(&hash_id[i]);
+#ifdef CONFIG_P2P
+		dl_list_init(&hash_p2p[i]);
+#endif /* CONFIG_P2P */
+	}
+
+	os_free(wpa_s->bss_hash_bssid);
+	os_free(wpa_s->bss_hash_id);
+	wpa_s->bss_hash_bssid = hash_bssid;
+	wpa_s->bss_hash_id = hash_id;
+#ifdef CONFIG_P2P
+	os_free(wpa_s->bss_hash_p2p);
+	wpa_s->bss_hash_p2p = hash_p2p;
+#endif /* CONFIG_P2P */
+	wpa_s->bss_hash_size = size;
+
+	/* Relink in the order of the BSS list to maintain the bucket order
+	 * that the lookup functions depend on */
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+#ifdef CONFIG_P2P
+		bss->hash_p2p.next = bss->hash_p2p.prev = NULL;
+#endif /* CONFIG_P2P */
+		wpa_bss_hash_add(wpa_s, bss);
+	}
+
+	return 0;
+
+fail:
+	os_free(hash_bssid);
+	os_free(hash_id);
+#ifdef CONFIG_P2P
+	os_free(hash_p2p);
+#endif /* CONFIG_P2P */
+	return -1;
+}
+
+
+#ifdef CONFIG_P2P
+static void wpa_bss_set_p2p_dev_addr(struct wpa_bss *bss)
+{
+	if (p2p_parse_dev_addr(wpa_bss_ie_ptr(bss), bss->ie_len,
+			       bss->p2p_dev_addr) != 0)
+		os_memset(bss->p2p_dev_addr, 0, ETH_ALEN);
+}
+#endif /* CONFIG_P2P */
+
+
 void wpa_bss_remove(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 		    const char *reason)
 {
@@ -227,6 +340,7 @@ void wpa_bss_remove(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 	wpa_bss_update_pending_connect(wpa_s, bss, NULL);
 	dl_list_del(&bss->list);
 	dl_list_del(&bss->list_id);
+	wpa_bss_hash_del(bss);
 	wpa_s->num_bss--;
 	wpa_dbg(wpa_s, MSG_DEBUG, "BSS: Remove id %u BSSID " MACSTR
 		" SSID '%s' due to %s", bss->id, MAC2STR(bss->bssid),
@@ -249,9 +363,14 @@ struct wpa_bss * wpa_bss_get(struct wpa_supplicant *wpa_s, const u8 *bssid,
 			     const u8 *ssid, size_t ssid_len)
 {
 	struct wpa_bss *bss;
-	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid))
+	struct dl_list *head;
+
+	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid) ||
+	    !wpa_s->bss_hash_size)
 		return NULL;
-	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+	head = &wpa_s->bss_hash_bssid[wpa_bss_hash_addr(bssid,
+							wpa_s->bss_hash_size)];
+	dl_list_for_each(bss, head, struct wpa_bss, hash_bssid) {
 		if (os_memcmp(bss->bssid, bssid, ETH_ALEN) == 0 &&
 		    bss->ssid_len == ssid_len &&
 		    os_memcmp(bss->ssid, ssid, ssid_len) == 0)
@@ -344,14 +463,12 @@ static bool is_p2p_pending_bss(struct wpa_supplicant *wpa_s,
 			       struct wpa_bss *bss)
 {
 #ifdef CONFIG_P2P
-	u8 addr[ETH_ALEN];
-
 	if (os_memcmp(bss->bssid, wpa_s->pending_join_iface_addr,
 		      ETH_ALEN) == 0)
 		return true;
 	if (!is_zero_ether_addr(wpa_s->pending_join_dev_addr) &&
-	    p2p_parse_dev_addr(wpa_bss_ie_ptr(bss), bss->ie_len, addr) == 0 &&
-	    os_memcmp(addr, wpa_s->pending_join_dev_addr, ETH_ALEN) == 0)
+	    os_memcmp(bss->p2p_dev_addr, wpa_s->pending_join_dev_addr,
+		      ETH_ALEN) == 0)
 		return true;
 #endif /* CONFIG_P2P */
 	return false;
@@ -475,6 +592,9 @@ static struct wpa_bss * wpa_bss_add(struct wpa_supplicant *wpa_s,
 	bss->beacon_ie_len = res->beacon_ie_len;
 	os_memcpy(bss->ies, res + 1, res->ie_len + res->beacon_ie_len);
 	wpa_bss_set_hessid(bss);
+#ifdef CONFIG_P2P
+	wpa_bss_set_p2p_dev_addr(bss);
+#endif /* CONFIG_P2P */
 
 	os_memset(bss->mld_addr, 0, ETH_ALEN);
 	ml_ie = wpa_scan_get_ml_ie(res, MULTI_LINK_CONTROL_TYPE_BASIC);
@@ -492,8 +612,14 @@ static struct wpa_bss * wpa_bss_add(struct wpa_supplicant *wpa_s,
 		wpa_s->conf->bss_max_count = wpa_s->num_bss + 1;
 	}
 
+	if (wpa_s->num_bss + 1 > 2 * wpa_s->bss_hash_size &&
+	    wpa_bss_hash_resize(wpa_s, 2 * wpa_s->bss_hash_size) < 0)
+		wpa_printf(MSG_DEBUG,
+			   "BSS: Failed to grow the BSS hash tables - continue with longer buckets");
+
 	dl_list_add_tail(&wpa_s->bss, &bss->list);
 	dl_list_add_tail(&wpa_s->bss_id, &bss->list_id);
+	wpa_bss_hash_add(wpa_s, bss);
 	wpa_s->num_bss++;
 
 	extra[0] = '\0';
@@ -700,6 +826,7 @@ wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 	wpa_bss_copy_res(bss, res, fetch_time);
 	/* Move the entry to the end of the list */
 	dl_list_del(&bss->list);
+	wpa_bss_hash_del(bss);
 #ifdef CONFIG_P2P
 	if (wpa_bss_get_vendor_ie(bss, P2P_IE_VENDOR_TYPE) &&
 	    !wpa_scan_get_vendor_ie(res, P2P_IE_VENDOR_TYPE)) {
@@ -716,8 +843,18 @@ wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 			MAC2STR(bss->bssid));
 	} else
 #endif /* CONFIG_P2P */
-	if (bss->ie_len + bss->beacon_ie_len >=
+	if (!(changes & WPA_BSS_IES_CHANGED_FLAG) &&
+	    bss->ie_len + bss->beacon_ie_len >=
 	    res->ie_len + res->beacon_ie_len) {
+		/* Probe Response IEs were already found to be identical in
+		 * wpa_bss_compare_res(), so only the Beacon IEs need to be
+		 * copied */
+		os_memcpy(bss->ies + bss->ie_len,
+			  ((const u8 *) (res + 1)) + res->ie_len,
+			  res->beacon_ie_len);
+		bss->beacon_ie_len = res->beacon_ie_len;
+	} else if (bss->ie_len + bss->beacon_ie_len >=
+		   res->ie_len + res->beacon_ie_len) {
 		os_memcpy(bss->ies, res + 1, res->ie_len + res->beacon_ie_len);
 		bss->ie_len = res->ie_len;
 		bss->beacon_ie_len = res->beacon_ie_len;
@@ -750,6 +887,9 @@ wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 		const u8 *ml_ie, *mld_addr;
 
 		wpa_bss_set_hessid(bss);
+#ifdef CONFIG_P2P
+		wpa_bss_set_p2p_dev_addr(bss);
+#endif /* CONFIG_P2P */
 		os_memset(bss->mld_addr, 0, ETH_ALEN);
 		ml_ie = wpa_scan_get_ml_ie(res, MULTI_LINK_CONTROL_TYPE_BASIC);
 		if (ml_ie) {
@@ -760,6 +900,7 @@ wpa_bss_update(struct wpa_supplicant *wpa_s, struct wpa_bss *bss,
 		}
 	}
 	dl_list_add_tail(&wpa_s->bss, &bss->list);
+	wpa_bss_hash_add(wpa_s, bss);
 
 	notify_bss_changes(wpa_s, changes, bss);
 
@@ -801,6 +942,7 @@ void wpa_bss_update_scan_res(struct wpa_supplicant *wpa_s,
 {
 	const u8 *ssid, *p2p, *mesh;
 	struct wpa_bss *bss;
+	bool seen;
 
 	if (wpa_s->conf->ignore_old_scan_res) {
 		struct os_reltime update;
@@ -858,8 +1000,11 @@ void wpa_bss_update_scan_res(struct wpa_supplicant *wpa_s,
 	if (bss == NULL)
 		bss = wpa_bss_add(wpa_s, ssid + 2, ssid[1], res, fetch_time);
 	else {
+		/* Only entries updated in this round can be in last_scan_res,
+		 * so the search is needed only for duplicate results */
+		seen = bss->last_update_idx == wpa_s->bss_update_idx;
 		bss = wpa_bss_update(wpa_s, bss, res, fetch_time);
-		if (wpa_s->last_scan_res) {
+		if (seen && wpa_s->last_scan_res) {
 			unsigned int i;
 			for (i = 0; i < wpa_s->last_scan_res_used; i++) {
 				if (bss == wpa_s->last_scan_res[i]) {
@@ -1012,6 +1157,8 @@ int wpa_bss_init(struct wpa_supplicant *wpa_s)
 {
 	dl_list_init(&wpa_s->bss);
 	dl_list_init(&wpa_s->bss_id);
+	if (wpa_bss_hash_resize(wpa_s, WPA_BSS_HASH_INIT_SIZE) < 0)
+		return -1;
 	return 0;
 }
 
@@ -1043,7 +1190,27 @@ void wpa_bss_flush(struct wpa_supplicant *wpa_s)
  */
 void wpa_bss_deinit(struct wpa_supplicant *wpa_s)
 {
+	struct wpa_bss *bss;
+
 	wpa_bss_flush(wpa_s);
+	/* Detach the entries that are still in use from the hash buckets so
+	 * that removing them later does not touch the freed tables */
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		dl_list_init(&bss->hash_bssid);
+		dl_list_init(&bss->hash_id);
+#ifdef CONFIG_P2P
+		bss->hash_p2p.next = bss->hash_p2p.prev = NULL;
+#endif /* CONFIG_P2P */
+	}
+	os_free(wpa_s->bss_hash_bssid);
+	wpa_s->bss_hash_bssid = NULL;
+	os_free(wpa_s->bss_hash_id);
+	wpa_s->bss_hash_id = NULL;
+#ifdef CONFIG_P2P
+	os_free(wpa_s->bss_hash_p2p);
+	wpa_s->bss_hash_p2p = NULL;
+#endif /* CONFIG_P2P */
+	wpa_s->bss_hash_size = 0;
 }
 
 
@@ -1057,9 +1224,14 @@ struct wpa_bss * wpa_bss_get_bssid(struct wpa_supplicant *wpa_s,
 				   const u8 *bssid)
 {
 	struct wpa_bss *bss;
-	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid))
+	struct dl_list *head;
+
+	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid) ||
+	    !wpa_s->bss_hash_size)
 		return NULL;
-	dl_list_for_each_reverse(bss, &wpa_s->bss, struct wpa_bss, list) {
+	head = &wpa_s->bss_hash_bssid[wpa_bss_hash_addr(bssid,
+							wpa_s->bss_hash_size)];
+	dl_list_for_each_reverse(bss, head, struct wpa_bss, hash_bssid) {
 		if (os_memcmp(bss->bssid, bssid, ETH_ALEN) == 0)
 			return bss;
 	}
@@ -1082,9 +1254,14 @@ struct wpa_bss * wpa_bss_get_bssid_latest(struct wpa_supplicant *wpa_s,
 					  const u8 *bssid)
 {
 	struct wpa_bss *bss, *found = NULL;
-	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid))
+	struct dl_list *head;
+
+	if (!wpa_supplicant_filter_bssid_match(wpa_s, bssid) ||
+	    !wpa_s->bss_hash_size)
 		return NULL;
-	dl_list_for_each_reverse(bss, &wpa_s->bss, struct wpa_bss, list) {
+	head = &wpa_s->bss_hash_bssid[wpa_bss_hash_addr(bssid,
+							wpa_s->bss_hash_size)];
+	dl_list_for_each_reverse(bss, head, struct wpa_bss, hash_bssid) {
 		if (os_memcmp(bss->bssid, bssid, ETH_ALEN) != 0)
 			continue;
 		if (found == NULL ||
@@ -1110,11 +1287,14 @@ struct wpa_bss * wpa_bss_get_p2p_dev_addr(struct wpa_supplicant *wpa_s,
 					  const u8 *dev_addr)
 {
 	struct wpa_bss *bss, *found = NULL;
-	dl_list_for_each_reverse(bss, &wpa_s->bss, struct wpa_bss, list) {
-		u8 addr[ETH_ALEN];
-		if (p2p_parse_dev_addr(wpa_bss_ie_ptr(bss), bss->ie_len,
-				       addr) != 0 ||
-		    os_memcmp(addr, dev_addr, ETH_ALEN) != 0)
+	struct dl_list *head;
+
+	if (!wpa_s->bss_hash_size)
+		return NULL;
+	head = &wpa_s->bss_hash_p2p[wpa_bss_hash_addr(dev_addr,
+						      wpa_s->bss_hash_size)];
+	dl_list_for_each_reverse(bss, head, struct wpa_bss, hash_p2p) {
+		if (os_memcmp(bss->p2p_dev_addr, dev_addr, ETH_ALEN) != 0)
 			continue;
 		if (!found ||
 		    os_reltime_before(&found->last_update, &bss->last_update))
@@ -1134,7 +1314,12 @@ struct wpa_bss * wpa_bss_get_p2p_dev_addr(struct wpa_supplicant *wpa_s,
 struct wpa_bss * wpa_bss_get_id(struct wpa_supplicant *wpa_s, unsigned int id)
 {
 	struct wpa_bss *bss;
-	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+	struct dl_list *head;
+
+	if (!wpa_s->bss_hash_size)
+		return NULL;
+	head = &wpa_s->bss_hash_id[id & (wpa_s->bss_hash_size - 1)];
+	dl_list_for_each(bss, head, struct wpa_bss, hash_id) {
 		if (bss->id == id)
 			return bss;
 	}
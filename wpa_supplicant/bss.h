@@ -78,6 +78,16 @@ struct wpa_bss {
 	struct dl_list list;
 	/** List entry for struct wpa_supplicant::bss_id */
 	struct dl_list list_id;
+	/** Hash bucket entry for struct wpa_supplicant::bss_hash_bssid */
+	struct dl_list hash_bssid;
+	/** Hash bucket entry for struct wpa_supplicant::bss_hash_id */
+	struct dl_list hash_id;
+#ifdef CONFIG_P2P
+	/** Hash bucket entry for struct wpa_supplicant::bss_hash_p2p */
+	struct dl_list hash_p2p;
+	/** P2P Device Address from the P2P IE or all zeros if not found */
+	u8 p2p_dev_addr[ETH_ALEN];
+#endif /* CONFIG_P2P */
 	/** Unique identifier for this BSS entry */
 	unsigned int id;
 	/** Number of counts without seeing this BSS */
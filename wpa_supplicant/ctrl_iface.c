@@ -7,12 +7,14 @@
  */
 
 #include "utils/includes.h"
+#include <limits.h>
 #ifdef CONFIG_TESTING_OPTIONS
 #include <netinet/ip.h>
 #endif /* CONFIG_TESTING_OPTIONS */
 
 #include "utils/common.h"
 #include "utils/eloop.h"
+#include "utils/flight_recorder.h"
 #include "utils/uuid.h"
 #include "utils/module_tests.h"
 #include "common/version.h"
@@ -489,6 +491,21 @@ static int wpas_ctrl_iface_set_dso(struct wpa_supplicant *wpa_s,
 #endif /* CONFIG_TESTING_OPTIONS */
 
 
+/* Parse a non-negative decimal/hex value for an unsigned int parameter */
+static int wpas_ctrl_parse_uint(const char *value, unsigned int *val)
+{
+	char *end;
+	long int res;
+
+	errno = 0;
+	res = strtol(value, &end, 0);
+	if (errno || end == value || *end || res < 0 || res > INT_MAX)
+		return -1;
+	*val = res;
+	return 0;
+}
+
+
 static int wpa_supplicant_ctrl_iface_set(struct wpa_supplicant *wpa_s,
 					 char *cmd)
 {
@@ -612,6 +629,24 @@ static int wpa_supplicant_ctrl_iface_set(struct wpa_supplicant *wpa_s,
 #endif /* CONFIG_TDLS */
 	} else if (os_strcasecmp(cmd, "pno") == 0) {
 		ret = wpas_ctrl_pno(wpa_s, value);
+	} else if (os_strcasecmp(cmd, "eloop_timeout_pool_max") == 0) {
+		unsigned int val;
+
+		if (wpas_ctrl_parse_uint(value, &val) < 0)
+			return -1;
+		eloop_set_timeout_pool_max(val);
+	} else if (os_strcasecmp(cmd, "eloop_handler_stats") == 0) {
+		unsigned int val;
+
+		if (wpas_ctrl_parse_uint(value, &val) < 0 || val > 1)
+			return -1;
+		ret = eloop_set_handler_stats(val);
+	} else if (os_strcasecmp(cmd, "eloop_slow_handler_ms") == 0) {
+		unsigned int val;
+
+		if (wpas_ctrl_parse_uint(value, &val) < 0)
+			return -1;
+		eloop_set_slow_handler_threshold(val);
 	} else if (os_strcasecmp(cmd, "radio_disabled") == 0) {
 		int disabled = atoi(value);
 		if (wpa_drv_radio_disable(wpa_s, disabled) < 0)
@@ -11928,6 +11963,14 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+#ifdef CONFIG_FLIGHT_RECORDER
+	} else if (os_strcmp(buf, "TRACE_DUMP") == 0) {
+		if (flight_recorder_dump(NULL) < 0)
+			reply_len = -1;
+	} else if (os_strncmp(buf, "TRACE_DUMP ", 11) == 0) {
+		if (flight_recorder_dump(buf + 11) < 0)
+			reply_len = -1;
+#endif /* CONFIG_FLIGHT_RECORDER */
 	} else if (os_strncmp(buf, "NOTE ", 5) == 0) {
 		wpa_printf(MSG_INFO, "NOTE: %s", buf + 5);
 	} else if (os_strcmp(buf, "MIB") == 0) {
@@ -11945,6 +11988,8 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
 	} else if (os_strncmp(buf, "STATUS", 6) == 0) {
 		reply_len = wpa_supplicant_ctrl_iface_status(
 			wpa_s, buf + 6, reply, reply_size);
+	} else if (os_strcmp(buf, "ELOOP_STATS") == 0) {
+		reply_len = eloop_get_stats(reply, reply_size);
 	} else if (os_strcmp(buf, "PMKSA") == 0) {
 		reply_len = wpas_ctrl_iface_pmksa(wpa_s, reply, reply_size);
 	} else if (os_strcmp(buf, "PMKSA_FLUSH") == 0) {
@@ -13591,6 +13636,8 @@ char * wpa_supplicant_global_ctrl_iface_process(struct wpa_global *global,
 	} else if (os_strcmp(buf, "STATUS") == 0) {
 		reply_len = wpas_global_ctrl_iface_status(global, reply,
 							  reply_size);
+	} else if (os_strcmp(buf, "ELOOP_STATS") == 0) {
+		reply_len = eloop_get_stats(reply, reply_size);
 #ifdef CONFIG_MODULE_TESTS
 	} else if (os_strcmp(buf, "MODULE_TESTS") == 0) {
 		if (wpas_module_tests() < 0)
@@ -13599,6 +13646,14 @@ char * wpa_supplicant_global_ctrl_iface_process(struct wpa_global *global,
 	} else if (os_strncmp(buf, "RELOG", 5) == 0) {
 		if (wpa_debug_reopen_file() < 0)
 			reply_len = -1;
+#ifdef CONFIG_FLIGHT_RECORDER
+	} else if (os_strcmp(buf, "TRACE_DUMP") == 0) {
+		if (flight_recorder_dump(NULL) < 0)
+			reply_len = -1;
+	} else if (os_strncmp(buf, "TRACE_DUMP ", 11) == 0) {
+		if (flight_recorder_dump(buf + 11) < 0)
+			reply_len = -1;
+#endif /* CONFIG_FLIGHT_RECORDER */
 	} else {
 		os_memcpy(reply, "UNKNOWN COMMAND\n", 16);
 		reply_len = 16;
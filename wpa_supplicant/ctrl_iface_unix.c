@@ -498,6 +498,28 @@ static void wpa_supplicant_ctrl_iface_msg_cb(void *ctx, int level,
 }
 
 
+static int wpa_supplicant_ctrl_iface_msg_monitor_cb(void *ctx, int level,
+						    enum wpa_msg_type type,
+						    const char *fmt)
+{
+	struct wpa_supplicant *wpa_s = ctx;
+	struct ctrl_iface_priv *priv;
+	struct ctrl_iface_global_priv *gpriv;
+
+	if (wpa_s == NULL)
+		return 0;
+
+	gpriv = wpa_s->global->ctrl_iface;
+	if (type != WPA_MSG_NO_GLOBAL && gpriv &&
+	    ctrl_iface_has_monitor(&gpriv->ctrl_dst, level, 0))
+		return 1;
+
+	priv = wpa_s->ctrl_iface;
+	return type != WPA_MSG_ONLY_GLOBAL && priv &&
+		ctrl_iface_has_monitor(&priv->ctrl_dst, level, 0);
+}
+
+
 static int wpas_ctrl_iface_open_sock(struct wpa_supplicant *wpa_s,
 				     struct ctrl_iface_priv *priv)
 {
@@ -685,6 +707,8 @@ havesock:
 	eloop_register_read_sock(priv->sock, wpa_supplicant_ctrl_iface_receive,
 				 wpa_s, priv);
 	wpa_msg_register_cb(wpa_supplicant_ctrl_iface_msg_cb);
+	wpa_msg_register_monitor_cb(
+		wpa_supplicant_ctrl_iface_msg_monitor_cb);
 
 	os_free(buf);
 	return 0;
@@ -1375,6 +1399,8 @@ wpa_supplicant_global_ctrl_iface_init(struct wpa_global *global)
 	}
 
 	wpa_msg_register_cb(wpa_supplicant_ctrl_iface_msg_cb);
+	wpa_msg_register_monitor_cb(
+		wpa_supplicant_ctrl_iface_msg_monitor_cb);
 
 	return priv;
 }
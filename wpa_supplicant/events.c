@@ -9,6 +9,7 @@
 #include "includes.h"
 
 #include "common.h"
+#include "utils/flight_recorder.h"
 #include "eapol_supp/eapol_supp_sm.h"
 #include "rsn_supp/wpa.h"
 #include "eloop.h"
@@ -3684,6 +3685,9 @@ static void wpa_supplicant_event_assoc(struct wpa_supplicant *wpa_s,
 		return;
 	}
 
+	flight_recorder_record(FR_EV_WPAS_ASSOC, wpa_s->ifname, bssid,
+			       wpa_s->assoc_freq, ft_completed);
+
 	if (ft_completed &&
 	    (wpa_s->drv_flags & WPA_DRIVER_FLAGS_BSS_SELECTION)) {
 		wpa_msg(wpa_s, MSG_INFO, "Attempt to roam to " MACSTR,
@@ -4079,6 +4083,8 @@ static void wpa_supplicant_event_disassoc_finish(struct wpa_supplicant *wpa_s,
 	if (could_be_psk_mismatch(wpa_s, reason_code, locally_generated)) {
 		wpa_msg(wpa_s, MSG_INFO, "WPA: 4-Way Handshake failed - "
 			"pre-shared key may be incorrect");
+		flight_recorder_record(FR_EV_SUPP_4WAY_FAILED, wpa_s->ifname,
+				       wpa_s->bssid, reason_code, 0);
 		if (wpas_p2p_4way_hs_failed(wpa_s) > 0)
 			return; /* P2P group removed */
 		wpas_auth_failed(wpa_s, "WRONG_KEY");
@@ -4622,6 +4628,8 @@ static void wpas_event_disassoc(struct wpa_supplicant *wpa_s,
 		ie_len = info->ie_len;
 		reason_code = info->reason_code;
 		locally_generated = info->locally_generated;
+		flight_recorder_record(FR_EV_WPAS_DISASSOC, wpa_s->ifname,
+				       addr, reason_code, locally_generated);
 		wpa_dbg(wpa_s, MSG_DEBUG, " * reason %u (%s)%s", reason_code,
 			reason2str(reason_code),
 			locally_generated ? " locally_generated=1" : "");
@@ -4677,6 +4685,8 @@ static void wpas_event_deauth(struct wpa_supplicant *wpa_s,
 		ie_len = info->ie_len;
 		reason_code = info->reason_code;
 		locally_generated = info->locally_generated;
+		flight_recorder_record(FR_EV_WPAS_DEAUTH, wpa_s->ifname,
+				       addr, reason_code, locally_generated);
 		wpa_dbg(wpa_s, MSG_DEBUG, " * reason %u (%s)%s",
 			reason_code, reason2str(reason_code),
 			locally_generated ? " locally_generated=1" : "");
@@ -5372,6 +5382,8 @@ void wpa_supplicant_event(void *ctx, enum wpa_event_type event,
 	wpa_dbg(wpa_s, level, "Event %s (%d) received",
 		event_to_string(event), event);
 #endif /* CONFIG_NO_STDOUT_DEBUG */
+	flight_recorder_record(FR_EV_WPAS_DRIVER_EVENT, wpa_s->ifname, NULL,
+			       event, 0);
 
 	switch (event) {
 	case EVENT_AUTH:
@@ -5525,6 +5537,10 @@ void wpa_supplicant_event(void *ctx, enum wpa_event_type event,
 		break;
 #endif /* CONFIG_IBSS_RSN */
 	case EVENT_ASSOC_REJECT:
+		flight_recorder_record(FR_EV_WPAS_ASSOC_REJECT, wpa_s->ifname,
+				       data->assoc_reject.bssid,
+				       data->assoc_reject.status_code,
+				       data->assoc_reject.timed_out);
 		wpas_event_assoc_reject(wpa_s, data);
 		break;
 	case EVENT_AUTH_TIMED_OUT:
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# Decode a wpa_supplicant/hostapd flight recorder dump (TRACE_DUMP/SIGUSR1)
+#
+# This software may be distributed under the terms of the BSD license.
+# See README for more details.
+
+import sys, struct, time, socket
+
+HDR_FMT = '<4sHHIIII'
+HDR_LEN = struct.calcsize(HDR_FMT)
+REC_FMT = '<IH6sIIIII'
+
+# enum flight_recorder_event in src/utils/flight_recorder.h
+EVENTS = {
+    1: 'WPAS_DRIVER_EVENT',
+    2: 'WPAS_STATE',
+    3: 'WPAS_ASSOC',
+    4: 'WPAS_ASSOC_REJECT',
+    5: 'WPAS_DISASSOC',
+    6: 'WPAS_DEAUTH',
+    32: 'SUPP_EAPOL_KEY_RX',
+    33: 'SUPP_KEY_MIC_FAILURE',
+    34: 'SUPP_PTK_INSTALLED',
+    35: 'SUPP_GTK_INSTALLED',
+    36: 'SUPP_4WAY_FAILED',
+    64: 'AUTH_SM_EVENT',
+    65: 'AUTH_EAPOL_KEY_RX',
+    66: 'AUTH_KEY_MIC_FAILURE',
+    67: 'AUTH_PTK_INSTALLED',
+    68: 'AUTH_4WAY_FAILED',
+}
+
+# enum wpa_states in src/common/defs.h
+WPA_STATES = ['DISCONNECTED', 'INTERFACE_DISABLED', 'INACTIVE', 'SCANNING',
+              'AUTHENTICATING', 'ASSOCIATING', 'ASSOCIATED', '4WAY_HANDSHAKE',
+              'GROUP_HANDSHAKE', 'COMPLETED']
+
+# enum wpa_event in src/ap/wpa_auth.h
+WPA_AUTH_EVENTS = ['AUTH', 'ASSOC', 'DISASSOC', 'DEAUTH', 'REAUTH',
+                   'REAUTH_EAPOL', 'ASSOC_FT', 'ASSOC_FILS', 'DRV_STA_REMOVED']
+
+# WPA_PTK states in src/ap/wpa_auth_i.h
+WPA_PTK_STATES = ['INITIALIZE', 'DISCONNECT', 'DISCONNECTED', 'AUTHENTICATION',
+                  'AUTHENTICATION2', 'INITPMK', 'INITPSK', 'PTKSTART',
+                  'PTKCALCNEGOTIATING', 'PTKCALCNEGOTIATING2',
+                  'PTKINITNEGOTIATING', 'PTKINITDONE']
+
+def name(table, val):
+    if val < len(table):
+        return table[val]
+    return str(val)
+
+def describe(event, arg0, arg1):
+    if event == 2:
+        return '%s -> %s' % (name(WPA_STATES, arg0), name(WPA_STATES, arg1))
+    if event == 64:
+        return 'event=%s' % name(WPA_AUTH_EVENTS, arg0)
+    if event == 68:
+        return 'state=%s TimeoutCtr=%d' % (name(WPA_PTK_STATES, arg0), arg1)
+    if event in (32, 33, 65, 66):
+        return 'key_info=0x%04x key_data_len=%d' % (arg0, arg1)
+    if event in (5, 6):
+        return 'reason=%d locally_generated=%d' % (arg0, arg1)
+    if event == 4:
+        return 'status=%d timed_out=%d' % (arg0, arg1)
+    return 'arg0=%d arg1=%d' % (arg0, arg1)
+
+def ifname(ifindex):
+    if ifindex == 0:
+        return '-'
+    try:
+        return socket.if_indextoname(ifindex)
+    except (OSError, AttributeError):
+        return '#%d' % ifindex
+
+def decode(data, out):
+    if len(data) < HDR_LEN:
+        raise ValueError('Too short file')
+    magic, version, rec_len, count, seq, sec, usec = \
+        struct.unpack(HDR_FMT, data[0:HDR_LEN])
+    if magic != b'WPFR':
+        raise ValueError('Not a flight recorder dump')
+    if version != 1:
+        raise ValueError('Unsupported version %d' % version)
+    dump_time = sec + usec / 1000000.0
+    out.write('# %d records (%d recorded in total), dumped at %s\n' %
+              (count, seq, time.strftime('%Y-%m-%d %H:%M:%S',
+                                          time.localtime(sec))))
+    pos = HDR_LEN
+    for i in range(count):
+        rec = data[pos:pos + rec_len]
+        pos += rec_len
+        if len(rec) < struct.calcsize(REC_FMT):
+            break
+        rseq, event, addr, rsec, rusec, ifindex, arg0, arg1 = \
+            struct.unpack(REC_FMT, rec[0:struct.calcsize(REC_FMT)])
+        ts = rsec + rusec / 1000000.0
+        out.write('%u %d.%06d (-%.3f) %s %s %s %s\n' %
+                  (rseq, rsec, rusec, dump_time - ts, ifname(ifindex),
+                   ':'.join('%02x' % b for b in bytearray(addr)),
+                   EVENTS.get(event, 'EVENT_%d' % event),
+                   describe(event, arg0, arg1)))
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print("Usage: %s <flight recorder dump>" % sys.argv[0])
+        sys.exit(2)
+    with open(sys.argv[1], 'rb') as f:
+        decode(f.read(), sys.stdout)
@@ -329,6 +329,20 @@ static int wpa_cli_cmd_mib(struct wpa_ctrl *ctrl, int argc, char *argv[])
 }
 
 
+static int wpa_cli_cmd_eloop_stats(struct wpa_ctrl *ctrl, int argc,
+				   char *argv[])
+{
+	return wpa_ctrl_command(ctrl, "ELOOP_STATS");
+}
+
+
+static int wpa_cli_cmd_trace_dump(struct wpa_ctrl *ctrl, int argc,
+				  char *argv[])
+{
+	return wpa_cli_cmd(ctrl, "TRACE_DUMP", 0, argc, argv);
+}
+
+
 static int wpa_cli_cmd_pmksa(struct wpa_ctrl *ctrl, int argc, char *argv[])
 {
 	return wpa_ctrl_command(ctrl, "PMKSA");
@@ -3336,6 +3350,12 @@ static const struct wpa_cli_cmd wpa_cli_commands[] = {
 	{ "mib", wpa_cli_cmd_mib, NULL,
 	  cli_cmd_flag_none,
 	  "= get MIB variables (dot1x, dot11)" },
+	{ "eloop_stats", wpa_cli_cmd_eloop_stats, NULL,
+	  cli_cmd_flag_none,
+	  "= get event loop statistics" },
+	{ "trace_dump", wpa_cli_cmd_trace_dump, NULL,
+	  cli_cmd_flag_none,
+	  "[<name>] = write flight recorder contents into the dump directory" },
 	{ "help", wpa_cli_cmd_help, wpa_cli_complete_help,
 	  cli_cmd_flag_none,
 	  "[command] = show usage help" },
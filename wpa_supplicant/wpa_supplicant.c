@@ -28,6 +28,7 @@
 #include "eloop.h"
 #include "config.h"
 #include "utils/ext_password.h"
+#include "utils/flight_recorder.h"
 #include "l2_packet/l2_packet.h"
 #include "wpa_supplicant_i.h"
 #include "driver_i.h"
@@ -930,6 +931,8 @@ void wpa_supplicant_set_state(struct wpa_supplicant *wpa_s,
 	wpa_dbg(wpa_s, MSG_DEBUG, "State: %s -> %s",
 		wpa_supplicant_state_txt(wpa_s->wpa_state),
 		wpa_supplicant_state_txt(state));
+	flight_recorder_record(FR_EV_WPAS_STATE, wpa_s->ifname, NULL,
+			       old_state, state);
 
 	if (state == WPA_COMPLETED &&
 	    os_reltime_initialized(&wpa_s->roam_start)) {
@@ -1255,6 +1258,14 @@ static void wpa_supplicant_reconfig(int sig, void *signal_ctx)
 }
 
 
+#ifdef CONFIG_FLIGHT_RECORDER
+static void wpa_supplicant_dump_flight_recorder(int sig, void *signal_ctx)
+{
+	flight_recorder_dump(NULL);
+}
+#endif /* CONFIG_FLIGHT_RECORDER */
+
+
 static int wpa_supplicant_suites_from_ai(struct wpa_supplicant *wpa_s,
 					 struct wpa_ssid *ssid,
 					 struct wpa_ie_data *ie)
@@ -7739,6 +7750,10 @@ int wpa_supplicant_run(struct wpa_global *global)
 
 	eloop_register_signal_terminate(wpa_supplicant_terminate, global);
 	eloop_register_signal_reconfig(wpa_supplicant_reconfig, global);
+#ifdef CONFIG_FLIGHT_RECORDER
+	eloop_register_signal(SIGUSR1, wpa_supplicant_dump_flight_recorder,
+			      NULL);
+#endif /* CONFIG_FLIGHT_RECORDER */
 
 	eloop_run();
 
@@ -784,6 +784,14 @@ struct wpa_supplicant {
 	void (*scan_res_fail_handler)(struct wpa_supplicant *wpa_s);
 	struct dl_list bss; /* struct wpa_bss::list */
 	struct dl_list bss_id; /* struct wpa_bss::list_id */
+	/* Hash tables of bss_hash_size buckets (power of two) for BSS lookups;
+	 * entries within a bucket are kept in the order of the bss list */
+	struct dl_list *bss_hash_bssid; /* struct wpa_bss::hash_bssid */
+	struct dl_list *bss_hash_id; /* struct wpa_bss::hash_id */
+#ifdef CONFIG_P2P
+	struct dl_list *bss_hash_p2p; /* struct wpa_bss::hash_p2p */
+#endif /* CONFIG_P2P */
+	size_t bss_hash_size;
 	size_t num_bss;
 	unsigned int bss_update_idx;
 	unsigned int bss_next_id;
@@ -10,7 +10,11 @@
 
 #include "utils/common.h"
 #include "utils/module_tests.h"
+#include "common/ieee802_11_defs.h"
+#include "drivers/driver.h"
 #include "wpa_supplicant_i.h"
+#include "config.h"
+#include "bss.h"
 #include "bssid_ignore.h"
 
 
@@ -87,6 +91,177 @@ fail:
 }
 
 
+#define WPAS_BSS_TEST_COUNT 500
+
+static void wpas_bss_test_res(struct wpa_scan_res *res, unsigned int idx,
+			      const char *ssid, size_t extra_ie_len)
+{
+	u8 *pos;
+
+	os_memset(res, 0, sizeof(*res));
+	res->bssid[0] = 0x02;
+	res->bssid[4] = idx >> 8;
+	res->bssid[5] = idx & 0xff;
+	res->freq = 2412;
+	res->level = -50;
+	pos = (u8 *) (res + 1);
+	*pos++ = WLAN_EID_SSID;
+	*pos++ = os_strlen(ssid);
+	os_memcpy(pos, ssid, os_strlen(ssid));
+	pos += os_strlen(ssid);
+	if (idx % 10 == 0) {
+		/* P2P IE with a P2P Device ID attribute */
+		*pos++ = WLAN_EID_VENDOR_SPECIFIC;
+		*pos++ = 4 + 3 + ETH_ALEN;
+		WPA_PUT_BE32(pos, P2P_IE_VENDOR_TYPE);
+		pos += 4;
+		*pos++ = P2P_ATTR_DEVICE_ID;
+		WPA_PUT_LE16(pos, ETH_ALEN);
+		pos += 2;
+		os_memcpy(pos, res->bssid, ETH_ALEN);
+		pos[1] = 0x11;
+		pos += ETH_ALEN;
+	}
+	if (extra_ie_len) {
+		*pos++ = WLAN_EID_VENDOR_SPECIFIC;
+		*pos++ = extra_ie_len;
+		os_memset(pos, 0xdd, extra_ie_len);
+		pos += extra_ie_len;
+	}
+	res->ie_len = pos - (u8 *) (res + 1);
+}
+
+
+static int wpas_bss_test_check(struct wpa_supplicant *wpa_s,
+			       struct wpa_scan_res *res)
+{
+	unsigned int i;
+	struct wpa_bss *bss;
+
+	for (i = 0; i < WPAS_BSS_TEST_COUNT; i++) {
+		wpas_bss_test_res(res, i, "test", 0);
+		bss = wpa_bss_get(wpa_s, res->bssid, (const u8 *) "test", 4);
+		if (!bss || os_memcmp(bss->bssid, res->bssid, ETH_ALEN) != 0 ||
+		    wpa_bss_get_id(wpa_s, bss->id) != bss) {
+			wpa_printf(MSG_ERROR, "BSS: Lookup of entry %u failed",
+				   i);
+			return -1;
+		}
+#ifdef CONFIG_P2P
+		if (i % 10 == 0) {
+			u8 dev_addr[ETH_ALEN];
+
+			os_memcpy(dev_addr, res->bssid, ETH_ALEN);
+			dev_addr[1] = 0x11;
+			if (wpa_bss_get_p2p_dev_addr(wpa_s, dev_addr) != bss) {
+				wpa_printf(MSG_ERROR,
+					   "BSS: P2P lookup of entry %u failed",
+					   i);
+				return -1;
+			}
+		}
+#endif /* CONFIG_P2P */
+	}
+
+	return 0;
+}
+
+
+static int wpas_bss_module_tests(void)
+{
+	struct wpa_supplicant wpa_s;
+	struct wpa_global global;
+	struct wpa_config conf;
+	struct wpa_radio radio;
+	struct wpa_scan_res *res;
+	struct os_reltime fetch_time;
+	struct wpa_bss *bss, *other;
+	unsigned int i;
+	int ret = -1;
+
+	wpa_printf(MSG_INFO, "BSS table tests");
+
+	os_memset(&wpa_s, 0, sizeof(wpa_s));
+	os_memset(&global, 0, sizeof(global));
+	os_memset(&conf, 0, sizeof(conf));
+	os_memset(&radio, 0, sizeof(radio));
+	dl_list_init(&radio.work);
+	conf.bss_max_count = 2 * WPAS_BSS_TEST_COUNT;
+	wpa_s.global = &global;
+	wpa_s.conf = &conf;
+	wpa_s.radio = &radio;
+	wpa_s.p2p_mgmt = 1; /* no control interface/D-Bus notifications */
+
+	res = os_malloc(sizeof(*res) + 300);
+	if (!res || wpa_bss_init(&wpa_s) < 0) {
+		os_free(res);
+		return -1;
+	}
+	os_get_reltime(&fetch_time);
+
+	wpa_bss_update_start(&wpa_s);
+	for (i = 0; i < WPAS_BSS_TEST_COUNT; i++) {
+		wpas_bss_test_res(res, i, "test", 0);
+		wpa_bss_update_scan_res(&wpa_s, res, &fetch_time);
+	}
+	/* Same BSSID with another SSID */
+	wpas_bss_test_res(res, 1, "other", 0);
+	wpa_bss_update_scan_res(&wpa_s, res, &fetch_time);
+	other = wpa_bss_get(&wpa_s, res->bssid, (const u8 *) "other", 5);
+	if (wpa_s.num_bss != WPAS_BSS_TEST_COUNT + 1 ||
+	    wpa_s.last_scan_res_used != WPAS_BSS_TEST_COUNT + 1 || !other ||
+	    wpa_bss_get_bssid(&wpa_s, res->bssid) != other ||
+	    wpa_bss_get_bssid_latest(&wpa_s, res->bssid) != other ||
+	    wpas_bss_test_check(&wpa_s, res) < 0)
+		goto fail;
+
+	/* New round: duplicate results and growing IEs (realloc) */
+	wpa_bss_update_start(&wpa_s);
+	for (i = 0; i < WPAS_BSS_TEST_COUNT; i++) {
+		wpas_bss_test_res(res, i, "test", i % 3 == 0 ? 200 : 0);
+		wpa_bss_update_scan_res(&wpa_s, res, &fetch_time);
+		if (i == 1)
+			wpa_bss_update_scan_res(&wpa_s, res, &fetch_time);
+	}
+	wpas_bss_test_res(res, 1, "test", 0);
+	bss = wpa_bss_get(&wpa_s, res->bssid, (const u8 *) "test", 4);
+	if (wpa_s.num_bss != WPAS_BSS_TEST_COUNT + 1 ||
+	    wpa_s.last_scan_res_used != WPAS_BSS_TEST_COUNT || !bss ||
+	    wpa_bss_get_bssid(&wpa_s, res->bssid) != bss ||
+	    wpas_bss_test_check(&wpa_s, res) < 0)
+		goto fail;
+
+	/* Removal */
+	wpas_bss_test_res(res, 10, "test", 0);
+	bss = wpa_bss_get(&wpa_s, res->bssid, (const u8 *) "test", 4);
+	if (!bss)
+		goto fail;
+	i = bss->id;
+	wpa_bss_remove(&wpa_s, bss, "test");
+	if (wpa_bss_get(&wpa_s, res->bssid, (const u8 *) "test", 4) ||
+	    wpa_bss_get_bssid(&wpa_s, res->bssid) ||
+	    wpa_bss_get_id(&wpa_s, i))
+		goto fail;
+#ifdef CONFIG_P2P
+	res->bssid[1] = 0x11;
+	if (wpa_bss_get_p2p_dev_addr(&wpa_s, res->bssid))
+		goto fail;
+#endif /* CONFIG_P2P */
+
+	ret = 0;
+fail:
+	if (ret)
+		wpa_printf(MSG_ERROR, "BSS table module test failure");
+	wpa_bss_deinit(&wpa_s);
+	os_free(wpa_s.last_scan_res);
+	os_free(res);
+	if (wpa_s.num_bss)
+		ret = -1;
+
+	return ret;
+}
+
+
 int wpas_module_tests(void)
 {
 	int ret = 0;
@@ -96,6 +271,9 @@ int wpas_module_tests(void)
 	if (wpas_bssid_ignore_module_tests() < 0)
 		ret = -1;
 
+	if (wpas_bss_module_tests() < 0)
+		ret = -1;
+
 #ifdef CONFIG_WPS
 	if (wps_module_tests() < 0)
 		ret = -1;